@@ -0,0 +1,39 @@
+#ifndef _ALIGNED_ALLOCATOR_H
+#define _ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+// Allocator for std::vector that aligns its storage to a cache line,
+// so that SIMD loads from the start of the array never split a line
+template <typename T, std::size_t ALIGNMENT = 64>
+class AlignedAllocator
+{
+    public:
+
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef AlignedAllocator<U, ALIGNMENT> other; };
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+    T* allocate(std::size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(ALIGNMENT)));
+    }
+
+    void deallocate(T* data, std::size_t)
+    {
+        ::operator delete(data, std::align_val_t(ALIGNMENT));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, ALIGNMENT>&) const { return false; }
+};
+
+#endif
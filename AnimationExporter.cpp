@@ -0,0 +1,199 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "AnimationExporter.h"
+#include "BoundedQueue.h"
+#include "MeshFile.h"
+
+// frame buffers in the pipeline, one for each stage and one more so that a stage
+// finishing early can start on the next frame
+static const int FRAME_BUFFERS = 4;
+// digits of the frame number in a pattern without #
+static const int DEFAULT_FRAME_DIGITS = 4;
+
+// a frame of the animation on its way through the pipeline
+struct AnimationFrame
+{
+    int index;
+    std::vector<Vector> grid;
+    std::vector<Vector> deformed;
+    // the centred deformed vertices go to a binary file with this header, text files
+    // are written from the formatted text
+    MeshFileHeader header;
+    std::vector<std::string> text;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the grid at the frame's time, frames being evenly spread over the keyframes
+static void interpolateFrame(const LatticeAnimation& animation, int frameCount, AnimationFrame& frame)
+{
+    double start = animation.getStartTime();
+    double end = animation.getEndTime();
+    double time = frameCount > 1 ? start + (end - start) * frame.index / (frameCount - 1) : start;
+    animation.evaluate(time, frame.grid);
+}
+
+// the mesh deformed by the frame's grid, made ready to write
+static void deformFrame(Mesh& mesh, GridBuilder& frameGrid, bool binary, AnimationFrame& frame)
+{
+    frameGrid.setGrid(frame.grid);
+    mesh.deformMesh(&frameGrid, frame.deformed);
+    if (binary)
+        mesh.centreDeformedMesh(frame.deformed, frame.header);
+    else
+        mesh.formatTextMesh(frame.deformed, frame.text);
+}
+
+static bool writeFrame(const Mesh& mesh, std::string fileName, bool binary, AnimationFrame& frame)
+{
+    if (binary)
+        return writeMeshFile(fileName, frame.header, frame.deformed.data(), mesh.getIndices(), nullptr, nullptr);
+
+    std::ofstream meshFile(fileName, std::ofstream::trunc);
+    if (!meshFile.is_open())
+        return false;
+    for (std::size_t part = 0; part < frame.text.size(); part++)
+        meshFile.write(frame.text[part].data(), frame.text[part].size());
+    meshFile.close();
+    return !meshFile.fail();
+}
+
+AnimationExporter::AnimationExporter()
+{
+    _pipelined = true;
+    _stats = { 0.0, 0.0, 0.0, 0.0 };
+}
+
+void AnimationExporter::setPipelined(bool pipelined)
+{
+    _pipelined = pipelined;
+}
+
+const ExportStats& AnimationExporter::getStats() const
+{
+    return _stats;
+}
+
+std::string AnimationExporter::frameFileName(std::string framePattern, int frame)
+{
+    std::size_t last = framePattern.rfind('#');
+    if (last == std::string::npos)
+    {
+        // no place for the number, so it goes before the extension
+        std::size_t name = framePattern.rfind('/');
+        std::size_t extension = framePattern.rfind('.');
+        if (extension == std::string::npos || (name != std::string::npos && extension < name))
+            extension = framePattern.size();
+        framePattern.insert(extension, DEFAULT_FRAME_DIGITS, '#');
+        last = extension + DEFAULT_FRAME_DIGITS - 1;
+    }
+    std::size_t first = last;
+    while (first > 0 && framePattern[first - 1] == '#')
+        first--;
+
+    std::string number = std::to_string(frame);
+    std::size_t digits = last - first + 1;
+    if (number.size() < digits)
+        number.insert(0, digits - number.size(), '0');
+    return framePattern.replace(first, digits, number);
+}
+
+bool AnimationExporter::exportFrames(Mesh& mesh, GridBuilder* restGrid, const LatticeAnimation& animation,
+    int frameCount, std::string framePattern)
+{
+    _stats = { 0.0, 0.0, 0.0, 0.0 };
+    if (animation.getKeyframeCount() == 0 || animation.getKeyframe(0).size() != restGrid->_grid.size())
+        return false;
+
+    std::chrono::steady_clock::time_point exportStart = std::chrono::steady_clock::now();
+    bool binary = hasMeshFileExtension(framePattern);
+    // the rest grid with each frame's points moved in, for deforming
+    GridBuilder frameGrid = *restGrid;
+
+    if (!_pipelined)
+    {
+        AnimationFrame frame;
+        for (frame.index = 0; frame.index < frameCount; frame.index++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            interpolateFrame(animation, frameCount, frame);
+            _stats.interpolateTime += secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            deformFrame(mesh, frameGrid, binary, frame);
+            _stats.deformTime += secondsSince(start);
+
+            start = std::chrono::steady_clock::now();
+            bool written = writeFrame(mesh, frameFileName(framePattern, frame.index), binary, frame);
+            _stats.writeTime += secondsSince(start);
+            if (!written)
+                return false;
+        }
+        _stats.totalTime = secondsSince(exportStart);
+        return true;
+    }
+
+    // every frame buffer the pipeline will ever use is allocated here
+    std::vector<AnimationFrame> frames(FRAME_BUFFERS);
+    BoundedQueue<AnimationFrame*> freeFrames(frames.size());
+    BoundedQueue<AnimationFrame*> interpolatedFrames(frames.size());
+    BoundedQueue<AnimationFrame*> deformedFrames(frames.size());
+    for (unsigned int frame = 0; frame < frames.size(); frame++)
+        freeFrames.push(&frames[frame]);
+
+    std::atomic<bool> failed(false);
+
+    // interpolate stage, on this thread alone so that the deform stage has every worker
+    std::thread interpolator([&]()
+    {
+        AnimationFrame* frame;
+        for (int index = 0; index < frameCount && !failed && freeFrames.pop(frame); index++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            frame->index = index;
+            interpolateFrame(animation, frameCount, *frame);
+            _stats.interpolateTime += secondsSince(start);
+            interpolatedFrames.push(frame);
+        }
+        interpolatedFrames.close();
+    });
+
+    // write stage, frames arrive in order as there is a single deforming stage
+    std::thread writer([&]()
+    {
+        AnimationFrame* frame;
+        while (deformedFrames.pop(frame))
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (!failed && !writeFrame(mesh, frameFileName(framePattern, frame->index), binary, *frame))
+                failed = true;
+            _stats.writeTime += secondsSince(start);
+            freeFrames.push(frame);
+        }
+    });
+
+    // deform stage, on every thread
+    AnimationFrame* frame;
+    while (interpolatedFrames.pop(frame))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!failed)
+            deformFrame(mesh, frameGrid, binary, *frame);
+        _stats.deformTime += secondsSince(start);
+        deformedFrames.push(frame);
+    }
+    deformedFrames.close();
+    writer.join();
+    freeFrames.close();
+    interpolator.join();
+
+    _stats.totalTime = secondsSince(exportStart);
+    return !failed;
+}
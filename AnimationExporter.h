@@ -0,0 +1,52 @@
+#ifndef _ANIMATION_EXPORTER_H
+#define _ANIMATION_EXPORTER_H
+
+#include <string>
+
+#include "GridBuilder.h"
+#include "LatticeAnimation.h"
+#include "Mesh.h"
+
+// time spent in each stage of an export and in the whole of it, in seconds
+struct ExportStats
+{
+    double interpolateTime;
+    double deformTime;
+    double writeTime;
+    double totalTime;
+};
+
+// Writes a deformed mesh file for every frame of a lattice animation. The frames go
+// through three stages: an interpolating thread works out the grid of the next frame,
+// the calling thread deforms the mesh by the grid of the frame before it on every
+// thread and centres or formats it, and a writing thread writes out the frame before
+// that. The stages are connected by bounded queues and frame buffers are recycled,
+// so once the pipeline is full it goes as fast as its slowest stage, which for large
+// meshes should be the disk.
+class AnimationExporter
+{
+    public:
+
+    AnimationExporter();
+
+    // write frameCount frames evenly spread from the first keyframe to the last, the mesh
+    // must be bound to restGrid's grid, the files are named by framePattern and written in
+    // the binary format if it ends in .bmesh. Returns false if a file could not be written
+    bool exportFrames(Mesh& mesh, GridBuilder* restGrid, const LatticeAnimation& animation,
+        int frameCount, std::string framePattern);
+
+    // overlap the stages, or go through them one frame at a time on the calling thread
+    void setPipelined(bool pipelined);
+    // the times of the last export
+    const ExportStats& getStats() const;
+
+    // the file name of a frame: the last run of # in the pattern replaced by the frame
+    // number padded with zeros to as many digits, or the number put before the extension
+    static std::string frameFileName(std::string framePattern, int frame);
+
+    private:
+    bool _pipelined;
+    ExportStats _stats;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _BUFFER_WRITER_H
+#define _BUFFER_WRITER_H
+
+#include <cstddef>
+#include <vector>
+
+// the including file defines GL_GLEXT_PROTOTYPES before including the GL headers
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// write the listed elements of the bound array buffer, elements of elementSize bytes
+// in increasing order, write(destination, element) fills one in. The span they cover
+// is mapped once and only the runs of consecutive elements are flushed, so that just
+// those are sent; returns false if the buffer could not be mapped
+template <typename Index, typename Write>
+bool writeElements(const std::vector<Index>& elements, std::size_t elementSize, Write write)
+{
+    if (elements.empty())
+        return true;
+    GLintptr first = elements.front() * elementSize;
+    GLsizeiptr span = (elements.back() + 1) * elementSize - first;
+    char* mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, first, span,
+        GL_MAP_WRITE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+    if (mapped == nullptr)
+        return false;
+
+    std::size_t runStart = 0;
+    for (std::size_t element = 0; element < elements.size(); element++)
+    {
+        write(mapped + elements[element] * elementSize - first, elements[element]);
+        if (element + 1 == elements.size() || elements[element + 1] != elements[element] + 1)
+        {
+            glFlushMappedBufferRange(GL_ARRAY_BUFFER, elements[runStart] * elementSize - first,
+                (elements[element] - elements[runStart] + 1) * elementSize);
+            runStart = element + 1;
+        }
+    }
+    return glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+}
+
+#endif
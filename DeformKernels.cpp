@@ -0,0 +1,1242 @@
+#include <algorithm>
+#include <atomic>
+
+#include "DeformKernels.h"
+
+// the SIMD kernels are compiled for their instruction set with function
+// attributes and only called once the cpu is known to support it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEFORM_KERNELS_X86
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx512f")))
+#endif
+
+void WeightStreams::resize(std::size_t count)
+{
+    u.resize(count);
+    v.resize(count);
+    w.resize(count);
+    cell.resize(count);
+    // filled by B-spline bindings after they resize
+    basis.clear();
+}
+
+void WeightStreams::clear()
+{
+    u.clear();
+    v.clear();
+    w.clear();
+    cell.clear();
+    basis.clear();
+}
+
+std::size_t WeightStreams::size() const
+{
+    return cell.size();
+}
+
+void WeightMatrix::resize(std::size_t count, int rowLength)
+{
+    rowStart.resize(count + 1);
+    for (std::size_t row = 0; row <= count; row++)
+        rowStart[row] = row * rowLength;
+    columns.resize(count * rowLength);
+    values.resize(count * rowLength);
+}
+
+void WeightMatrix::clear()
+{
+    rowStart.clear();
+    columns.clear();
+    values.clear();
+}
+
+std::size_t WeightMatrix::rows() const
+{
+    return rowStart.empty() ? 0 : rowStart.size() - 1;
+}
+
+std::size_t WeightMatrix::entries() const
+{
+    return columns.size();
+}
+
+// Scalar                                                           //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+// the arithmetic is written out in the order the Vector operators did it,
+// so that every kernel gives the same floats as before
+
+static inline void bilinearVertex(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t vertex)
+{
+    float u = weights.u[vertex];
+    float v = weights.v[vertex];
+    const Vector& p01 = grid[weights.cell[vertex]];
+    const Vector& p11 = grid[weights.cell[vertex] + 1];
+    const Vector& p00 = grid[weights.cell[vertex] + gridSize];
+    const Vector& p10 = grid[weights.cell[vertex] + gridSize + 1];
+
+    deformed[vertex].x = p10.x * u * v + p00.x * v * (1 - u) + p11.x * u * (1 - v) + p01.x * (1 - u) * (1 - v);
+    deformed[vertex].y = p10.y * u * v + p00.y * v * (1 - u) + p11.y * u * (1 - v) + p01.y * (1 - u) * (1 - v);
+    deformed[vertex].z = p10.z * u * v + p00.z * v * (1 - u) + p11.z * u * (1 - v) + p01.z * (1 - u) * (1 - v);
+}
+
+static void bilinearScalar(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    for (std::size_t vertex = begin; vertex < end; vertex++)
+        bilinearVertex(weights, grid, gridSize, deformed, vertex);
+}
+
+static inline void barycentricVertex(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, std::size_t vertex)
+{
+    const int* triangle = triangles + weights.cell[vertex];
+    const Vector& p0 = grid[triangle[0]];
+    const Vector& p1 = grid[triangle[1]];
+    const Vector& p2 = grid[triangle[2]];
+    float alpha = weights.u[vertex];
+    float beta = weights.v[vertex];
+    float gamma = weights.w[vertex];
+
+    deformed[vertex].x = p0.x * alpha + p1.x * beta + p2.x * gamma;
+    deformed[vertex].y = p0.y * alpha + p1.y * beta + p2.y * gamma;
+    deformed[vertex].z = p0.z * alpha + p1.z * beta + p2.z * gamma;
+}
+
+static void barycentricScalar(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    for (std::size_t vertex = begin; vertex < end; vertex++)
+        barycentricVertex(weights, grid, triangles, deformed, vertex);
+}
+
+// bilinear interpolation of one component of a face of a trilinear cell
+static inline float trilinearFace(float p011, float p010, float p001, float p000, float u, float v)
+{
+    return p011 * u * v + p010 * v * (1 - u) + p001 * u * (1 - v) + p000 * (1 - u) * (1 - v);
+}
+
+static inline void trilinearVertex(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t vertex)
+{
+    float u = weights.u[vertex];
+    float v = weights.v[vertex];
+    float w = weights.w[vertex];
+    const Vector* p000 = grid + weights.cell[vertex];
+    const Vector* p100 = p000 + gridSize * gridSize;
+
+    float x0 = trilinearFace(p000[gridSize + 1].x, p000[gridSize].x, p000[1].x, p000[0].x, u, v);
+    float y0 = trilinearFace(p000[gridSize + 1].y, p000[gridSize].y, p000[1].y, p000[0].y, u, v);
+    float z0 = trilinearFace(p000[gridSize + 1].z, p000[gridSize].z, p000[1].z, p000[0].z, u, v);
+    float x1 = trilinearFace(p100[gridSize + 1].x, p100[gridSize].x, p100[1].x, p100[0].x, u, v);
+    float y1 = trilinearFace(p100[gridSize + 1].y, p100[gridSize].y, p100[1].y, p100[0].y, u, v);
+    float z1 = trilinearFace(p100[gridSize + 1].z, p100[gridSize].z, p100[1].z, p100[0].z, u, v);
+
+    deformed[vertex].x = x0 * (1 - w) + x1 * w;
+    deformed[vertex].y = y0 * (1 - w) + y1 * w;
+    deformed[vertex].z = z0 * (1 - w) + z1 * w;
+}
+
+static void trilinearScalar(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    for (std::size_t vertex = begin; vertex < end; vertex++)
+        trilinearVertex(weights, grid, gridSize, deformed, vertex);
+}
+
+static inline void sparseTrilinearVertex(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, std::size_t vertex)
+{
+    float u = weights.u[vertex];
+    float v = weights.v[vertex];
+    float w = weights.w[vertex];
+    const int32_t* corner = corners + 8 * weights.cell[vertex];
+    const Vector& p000 = grid[corner[0]];
+    const Vector& p001 = grid[corner[1]];
+    const Vector& p010 = grid[corner[2]];
+    const Vector& p011 = grid[corner[3]];
+    const Vector& p100 = grid[corner[4]];
+    const Vector& p101 = grid[corner[5]];
+    const Vector& p110 = grid[corner[6]];
+    const Vector& p111 = grid[corner[7]];
+
+    float x0 = trilinearFace(p011.x, p010.x, p001.x, p000.x, u, v);
+    float y0 = trilinearFace(p011.y, p010.y, p001.y, p000.y, u, v);
+    float z0 = trilinearFace(p011.z, p010.z, p001.z, p000.z, u, v);
+    float x1 = trilinearFace(p111.x, p110.x, p101.x, p100.x, u, v);
+    float y1 = trilinearFace(p111.y, p110.y, p101.y, p100.y, u, v);
+    float z1 = trilinearFace(p111.z, p110.z, p101.z, p100.z, u, v);
+
+    deformed[vertex].x = x0 * (1 - w) + x1 * w;
+    deformed[vertex].y = y0 * (1 - w) + y1 * w;
+    deformed[vertex].z = z0 * (1 - w) + z1 * w;
+}
+
+static void sparseTrilinearScalar(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    for (std::size_t vertex = begin; vertex < end; vertex++)
+        sparseTrilinearVertex(weights, grid, corners, deformed, vertex);
+}
+
+// one component of a row of four control points, row points at that component of the first
+static inline float bsplineRow(const float* row, const float* b)
+{
+    return row[0] * b[0] + row[3] * b[1] + row[6] * b[2] + row[9] * b[3];
+}
+
+// the rows are summed along x, then along y into planes, then the planes along z,
+// every sum starting from its first product so that the kernels agree on signed zeros
+static inline void bsplineVertex(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t vertex)
+{
+    std::size_t count = weights.size();
+    const float* basis = weights.basis.data() + vertex;
+    float bx[4], by[4], bz[4];
+    for (int k = 0; k < 4; k++)
+    {
+        bx[k] = basis[k * count];
+        by[k] = basis[(4 + k) * count];
+        bz[k] = basis[(8 + k) * count];
+    }
+    int down = 3 * gridSize;
+    int back = 3 * gridSize * gridSize;
+
+    float sum[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float* first = &grid[weights.cell[vertex]].x + axis;
+        float volume = 0.0;
+        for (int layer = 0; layer < 4; layer++)
+        {
+            const float* points = first + layer * back;
+            float plane = bsplineRow(points, bx) * by[0];
+            for (int row = 1; row < 4; row++)
+                plane = plane + bsplineRow(points + row * down, bx) * by[row];
+            volume = layer == 0 ? plane * bz[0] : volume + plane * bz[layer];
+        }
+        sum[axis] = volume;
+    }
+    deformed[vertex].x = sum[0];
+    deformed[vertex].y = sum[1];
+    deformed[vertex].z = sum[2];
+}
+
+static void bsplineScalar(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    for (std::size_t vertex = begin; vertex < end; vertex++)
+        bsplineVertex(weights, grid, gridSize, deformed, vertex);
+}
+
+// an empty row leaves its vertex at the origin
+static inline void sparseRow(const WeightMatrix& matrix, const Vector* grid, Vector* deformed, std::size_t row)
+{
+    uint32_t first = matrix.rowStart[row];
+    uint32_t last = matrix.rowStart[row + 1];
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (uint32_t entry = first; entry < last; entry++)
+    {
+        const Vector& point = grid[matrix.columns[entry]];
+        float weight = matrix.values[entry];
+        if (entry == first)
+        {
+            x = point.x * weight;
+            y = point.y * weight;
+            z = point.z * weight;
+        }
+        else
+        {
+            x = x + point.x * weight;
+            y = y + point.y * weight;
+            z = z + point.z * weight;
+        }
+    }
+    deformed[row].x = x;
+    deformed[row].y = y;
+    deformed[row].z = z;
+}
+
+static void sparseScalar(const WeightMatrix& matrix, const Vector* grid,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    for (std::size_t row = begin; row < end; row++)
+        sparseRow(matrix, grid, deformed, row);
+}
+
+// write the x, y and z of every pose of a vertex out to its own deformed mesh
+static inline void storePoses(const float* x, const float* y, const float* z, int lanes,
+    Vector* const* deformed, std::size_t vertex)
+{
+    for (int lane = 0; lane < lanes; lane++)
+    {
+        deformed[lane][vertex].x = x[lane];
+        deformed[lane][vertex].y = y[lane];
+        deformed[lane][vertex].z = z[lane];
+    }
+}
+
+// every pose of a row summed as sparseRow sums it, the poses of a grid point being
+// next to one another rather than gathered
+static void sparsePosesScalar(const WeightMatrix& matrix, const float* poses, int lanes,
+    Vector* const* deformed, std::size_t first)
+{
+    float x[POSE_LANES], y[POSE_LANES], z[POSE_LANES];
+    for (std::size_t row = 0; row < matrix.rows(); row++)
+    {
+        uint32_t begin = matrix.rowStart[row];
+        uint32_t end = matrix.rowStart[row + 1];
+        std::fill(x, x + POSE_LANES, 0.0f);
+        std::fill(y, y + POSE_LANES, 0.0f);
+        std::fill(z, z + POSE_LANES, 0.0f);
+        for (uint32_t entry = begin; entry < end; entry++)
+        {
+            const float* point = poses + matrix.columns[entry] * 3 * POSE_LANES;
+            float weight = matrix.values[entry];
+            for (int lane = 0; lane < POSE_LANES; lane++)
+            {
+                if (entry == begin)
+                {
+                    x[lane] = point[lane] * weight;
+                    y[lane] = point[POSE_LANES + lane] * weight;
+                    z[lane] = point[2 * POSE_LANES + lane] * weight;
+                }
+                else
+                {
+                    x[lane] = x[lane] + point[lane] * weight;
+                    y[lane] = y[lane] + point[POSE_LANES + lane] * weight;
+                    z[lane] = z[lane] + point[2 * POSE_LANES + lane] * weight;
+                }
+            }
+        }
+        storePoses(x, y, z, lanes, deformed, first + row);
+    }
+}
+
+#ifdef DEFORM_KERNELS_X86
+
+// AVX2, 8 vertices at a time                                       //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+// the grid points are gathered straight from the array of Vectors,
+// offsets are in floats
+AVX2_TARGET static inline void gather8(const float* grid, __m256i offset, __m256& x, __m256& y, __m256& z)
+{
+    x = _mm256_i32gather_ps(grid, offset, 4);
+    y = _mm256_i32gather_ps(grid + 1, offset, 4);
+    z = _mm256_i32gather_ps(grid + 2, offset, 4);
+}
+
+// interleave 8 x, y and z values back into 8 Vectors
+AVX2_TARGET static inline void store8(Vector* deformed, __m256 x, __m256 y, __m256 z)
+{
+    __m256 xy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));   // x0 x2 y0 y2
+    __m256 yz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));   // y1 y3 z1 z3
+    __m256 zx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));   // z0 z2 x1 x3
+    __m256 r03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0)); // x0 y0 z0 x1
+    __m256 r14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)); // y1 z1 x2 y2
+    __m256 r25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1)); // z2 x3 y3 z3
+
+    float* out = &deformed->x;
+    _mm256_storeu_ps(out, _mm256_permute2f128_ps(r03, r14, 0x20));
+    _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(r25, r03, 0x30));
+    _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(r14, r25, 0x31));
+}
+
+// p10 * u * v + p00 * v * (1 - u) + p11 * u * (1 - v) + p01 * (1 - u) * (1 - v)
+AVX2_TARGET static inline __m256 bilinear8(__m256 p10, __m256 p00, __m256 p11, __m256 p01,
+    __m256 u, __m256 v, __m256 oneMinusU, __m256 oneMinusV)
+{
+    __m256 sum = _mm256_mul_ps(_mm256_mul_ps(p10, u), v);
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(p00, v), oneMinusU));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(p11, u), oneMinusV));
+    return _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(p01, oneMinusU), oneMinusV));
+}
+
+AVX2_TARGET static void bilinearAVX2(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m256 one = _mm256_set1_ps(1.0f);
+    // a point is three floats, so the point of the next column is three floats on
+    __m256i three = _mm256_set1_epi32(3);
+    __m256i down = _mm256_set1_epi32(3 * gridSize);
+
+    std::size_t vertex = begin;
+    for (; vertex + 8 <= end; vertex += 8)
+    {
+        __m256 u = _mm256_loadu_ps(weights.u.data() + vertex);
+        __m256 v = _mm256_loadu_ps(weights.v.data() + vertex);
+        __m256 oneMinusU = _mm256_sub_ps(one, u);
+        __m256 oneMinusV = _mm256_sub_ps(one, v);
+        __m256i p01 = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(weights.cell.data() + vertex)), three);
+        __m256i p11 = _mm256_add_epi32(p01, three);
+        __m256i p00 = _mm256_add_epi32(p01, down);
+        __m256i p10 = _mm256_add_epi32(p00, three);
+
+        __m256 x10, y10, z10, x00, y00, z00, x11, y11, z11, x01, y01, z01;
+        gather8(points, p10, x10, y10, z10);
+        gather8(points, p00, x00, y00, z00);
+        gather8(points, p11, x11, y11, z11);
+        gather8(points, p01, x01, y01, z01);
+
+        store8(deformed + vertex,
+            bilinear8(x10, x00, x11, x01, u, v, oneMinusU, oneMinusV),
+            bilinear8(y10, y00, y11, y01, u, v, oneMinusU, oneMinusV),
+            bilinear8(z10, z00, z11, z01, u, v, oneMinusU, oneMinusV));
+    }
+    bilinearScalar(weights, grid, gridSize, deformed, vertex, end);
+}
+
+AVX2_TARGET static void barycentricAVX2(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m256i three = _mm256_set1_epi32(3);
+
+    std::size_t vertex = begin;
+    for (; vertex + 8 <= end; vertex += 8)
+    {
+        __m256 alpha = _mm256_loadu_ps(weights.u.data() + vertex);
+        __m256 beta = _mm256_loadu_ps(weights.v.data() + vertex);
+        __m256 gamma = _mm256_loadu_ps(weights.w.data() + vertex);
+        // the corners of each triangle are looked up in the triangulation first
+        __m256i triangle = _mm256_loadu_si256((const __m256i*)(weights.cell.data() + vertex));
+        __m256i t0 = _mm256_mullo_epi32(_mm256_i32gather_epi32(triangles, triangle, 4), three);
+        __m256i t1 = _mm256_mullo_epi32(_mm256_i32gather_epi32(triangles + 1, triangle, 4), three);
+        __m256i t2 = _mm256_mullo_epi32(_mm256_i32gather_epi32(triangles + 2, triangle, 4), three);
+
+        __m256 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+        gather8(points, t0, x0, y0, z0);
+        gather8(points, t1, x1, y1, z1);
+        gather8(points, t2, x2, y2, z2);
+
+        store8(deformed + vertex,
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x0, alpha), _mm256_mul_ps(x1, beta)), _mm256_mul_ps(x2, gamma)),
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(y0, alpha), _mm256_mul_ps(y1, beta)), _mm256_mul_ps(y2, gamma)),
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(z0, alpha), _mm256_mul_ps(z1, beta)), _mm256_mul_ps(z2, gamma)));
+    }
+    barycentricScalar(weights, grid, triangles, deformed, vertex, end);
+}
+
+// one component of a trilinear cell, offsets are those of the cell's front top left point
+AVX2_TARGET static inline __m256 trilinear8(const float* points, __m256i p000, __m256i right, __m256i down, __m256i back,
+    __m256 u, __m256 v, __m256 w, __m256 oneMinusU, __m256 oneMinusV, __m256 oneMinusW)
+{
+    __m256i p100 = _mm256_add_epi32(p000, back);
+    __m256 front = bilinear8(
+        _mm256_i32gather_ps(points, _mm256_add_epi32(_mm256_add_epi32(p000, down), right), 4),
+        _mm256_i32gather_ps(points, _mm256_add_epi32(p000, down), 4),
+        _mm256_i32gather_ps(points, _mm256_add_epi32(p000, right), 4),
+        _mm256_i32gather_ps(points, p000, 4),
+        u, v, oneMinusU, oneMinusV);
+    __m256 rear = bilinear8(
+        _mm256_i32gather_ps(points, _mm256_add_epi32(_mm256_add_epi32(p100, down), right), 4),
+        _mm256_i32gather_ps(points, _mm256_add_epi32(p100, down), 4),
+        _mm256_i32gather_ps(points, _mm256_add_epi32(p100, right), 4),
+        _mm256_i32gather_ps(points, p100, 4),
+        u, v, oneMinusU, oneMinusV);
+    return _mm256_add_ps(_mm256_mul_ps(front, oneMinusW), _mm256_mul_ps(rear, w));
+}
+
+AVX2_TARGET static void trilinearAVX2(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m256 one = _mm256_set1_ps(1.0f);
+    // a point is three floats, so the point of the next column is three floats on
+    __m256i three = _mm256_set1_epi32(3);
+    __m256i down = _mm256_set1_epi32(3 * gridSize);
+    __m256i back = _mm256_set1_epi32(3 * gridSize * gridSize);
+
+    std::size_t vertex = begin;
+    for (; vertex + 8 <= end; vertex += 8)
+    {
+        __m256 u = _mm256_loadu_ps(weights.u.data() + vertex);
+        __m256 v = _mm256_loadu_ps(weights.v.data() + vertex);
+        __m256 w = _mm256_loadu_ps(weights.w.data() + vertex);
+        __m256 oneMinusU = _mm256_sub_ps(one, u);
+        __m256 oneMinusV = _mm256_sub_ps(one, v);
+        __m256 oneMinusW = _mm256_sub_ps(one, w);
+        __m256i p000 = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(weights.cell.data() + vertex)), three);
+
+        store8(deformed + vertex,
+            trilinear8(points, p000, three, down, back, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            trilinear8(points + 1, p000, three, down, back, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            trilinear8(points + 2, p000, three, down, back, u, v, w, oneMinusU, oneMinusV, oneMinusW));
+    }
+    trilinearScalar(weights, grid, gridSize, deformed, vertex, end);
+}
+
+// one component of a sparse lattice cell, from the offsets of its eight corners
+AVX2_TARGET static inline __m256 sparseTrilinear8(const float* points, const __m256i* corner,
+    __m256 u, __m256 v, __m256 w, __m256 oneMinusU, __m256 oneMinusV, __m256 oneMinusW)
+{
+    __m256 front = bilinear8(
+        _mm256_i32gather_ps(points, corner[3], 4),
+        _mm256_i32gather_ps(points, corner[2], 4),
+        _mm256_i32gather_ps(points, corner[1], 4),
+        _mm256_i32gather_ps(points, corner[0], 4),
+        u, v, oneMinusU, oneMinusV);
+    __m256 rear = bilinear8(
+        _mm256_i32gather_ps(points, corner[7], 4),
+        _mm256_i32gather_ps(points, corner[6], 4),
+        _mm256_i32gather_ps(points, corner[5], 4),
+        _mm256_i32gather_ps(points, corner[4], 4),
+        u, v, oneMinusU, oneMinusV);
+    return _mm256_add_ps(_mm256_mul_ps(front, oneMinusW), _mm256_mul_ps(rear, w));
+}
+
+AVX2_TARGET static void sparseTrilinearAVX2(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256i three = _mm256_set1_epi32(3);
+    __m256i eight = _mm256_set1_epi32(8);
+
+    std::size_t vertex = begin;
+    for (; vertex + 8 <= end; vertex += 8)
+    {
+        __m256 u = _mm256_loadu_ps(weights.u.data() + vertex);
+        __m256 v = _mm256_loadu_ps(weights.v.data() + vertex);
+        __m256 w = _mm256_loadu_ps(weights.w.data() + vertex);
+        __m256 oneMinusU = _mm256_sub_ps(one, u);
+        __m256 oneMinusV = _mm256_sub_ps(one, v);
+        __m256 oneMinusW = _mm256_sub_ps(one, w);
+        // the corners of each cell are looked up in the lattice first
+        __m256i cell = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(weights.cell.data() + vertex)), eight);
+        __m256i corner[8];
+        for (int k = 0; k < 8; k++)
+            corner[k] = _mm256_mullo_epi32(_mm256_i32gather_epi32(corners + k, cell, 4), three);
+
+        store8(deformed + vertex,
+            sparseTrilinear8(points, corner, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            sparseTrilinear8(points + 1, corner, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            sparseTrilinear8(points + 2, corner, u, v, w, oneMinusU, oneMinusV, oneMinusW));
+    }
+    sparseTrilinearScalar(weights, grid, corners, deformed, vertex, end);
+}
+
+// one component of a row of four control points, as bsplineRow
+AVX2_TARGET static inline __m256 bsplineRow8(const float* points, __m256i offset, const __m256* b)
+{
+    __m256 sum = _mm256_mul_ps(_mm256_i32gather_ps(points, offset, 4), b[0]);
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_i32gather_ps(points + 3, offset, 4), b[1]));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_i32gather_ps(points + 6, offset, 4), b[2]));
+    return _mm256_add_ps(sum, _mm256_mul_ps(_mm256_i32gather_ps(points + 9, offset, 4), b[3]));
+}
+
+// one component of 8 vertices, offsets are those of their first control point
+AVX2_TARGET static inline __m256 bspline8(const float* points, __m256i first, int down, int back,
+    const __m256* bx, const __m256* by, const __m256* bz)
+{
+    __m256 volume = _mm256_setzero_ps();
+    for (int layer = 0; layer < 4; layer++)
+    {
+        const float* layerPoints = points + layer * back;
+        __m256 plane = _mm256_mul_ps(bsplineRow8(layerPoints, first, bx), by[0]);
+        for (int row = 1; row < 4; row++)
+            plane = _mm256_add_ps(plane, _mm256_mul_ps(bsplineRow8(layerPoints + row * down, first, bx), by[row]));
+        volume = layer == 0 ? _mm256_mul_ps(plane, bz[0]) : _mm256_add_ps(volume, _mm256_mul_ps(plane, bz[layer]));
+    }
+    return volume;
+}
+
+AVX2_TARGET static void bsplineAVX2(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    std::size_t count = weights.size();
+    __m256i three = _mm256_set1_epi32(3);
+    int down = 3 * gridSize;
+    int back = 3 * gridSize * gridSize;
+
+    std::size_t vertex = begin;
+    for (; vertex + 8 <= end; vertex += 8)
+    {
+        const float* basis = weights.basis.data() + vertex;
+        __m256 bx[4], by[4], bz[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bx[k] = _mm256_loadu_ps(basis + k * count);
+            by[k] = _mm256_loadu_ps(basis + (4 + k) * count);
+            bz[k] = _mm256_loadu_ps(basis + (8 + k) * count);
+        }
+        __m256i first = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(weights.cell.data() + vertex)), three);
+
+        store8(deformed + vertex,
+            bspline8(points, first, down, back, bx, by, bz),
+            bspline8(points + 1, first, down, back, bx, by, bz),
+            bspline8(points + 2, first, down, back, bx, by, bz));
+    }
+    bsplineScalar(weights, grid, gridSize, deformed, vertex, end);
+}
+
+// 8 rows at a time, entry k of every row together, rows shorter than the longest
+// of the 8 are masked off once they end
+AVX2_TARGET static void sparseAVX2(const WeightMatrix& matrix, const Vector* grid,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    const int* columns = matrix.columns.data();
+    const float* values = matrix.values.data();
+    __m256i three = _mm256_set1_epi32(3);
+
+    std::size_t row = begin;
+    for (; row + 8 <= end; row += 8)
+    {
+        __m256i first = _mm256_loadu_si256((const __m256i*)(matrix.rowStart.data() + row));
+        __m256i length = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(matrix.rowStart.data() + row + 1)), first);
+        alignas(32) int32_t lengths[8];
+        _mm256_store_si256((__m256i*)lengths, length);
+        int longest = *std::max_element(lengths, lengths + 8);
+
+        __m256 x = _mm256_setzero_ps(), y = _mm256_setzero_ps(), z = _mm256_setzero_ps();
+        for (int k = 0; k < longest; k++)
+        {
+            __m256i inRow = _mm256_cmpgt_epi32(length, _mm256_set1_epi32(k));
+            __m256 mask = _mm256_castsi256_ps(inRow);
+            __m256i entry = _mm256_add_epi32(first, _mm256_set1_epi32(k));
+            __m256i offset = _mm256_mullo_epi32(_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), columns, entry, inRow, 4), three);
+            __m256 weight = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), values, entry, mask, 4);
+            __m256 px = _mm256_mul_ps(_mm256_mask_i32gather_ps(_mm256_setzero_ps(), points, offset, mask, 4), weight);
+            __m256 py = _mm256_mul_ps(_mm256_mask_i32gather_ps(_mm256_setzero_ps(), points + 1, offset, mask, 4), weight);
+            __m256 pz = _mm256_mul_ps(_mm256_mask_i32gather_ps(_mm256_setzero_ps(), points + 2, offset, mask, 4), weight);
+            if (k == 0)
+            {
+                x = _mm256_blendv_ps(x, px, mask);
+                y = _mm256_blendv_ps(y, py, mask);
+                z = _mm256_blendv_ps(z, pz, mask);
+            }
+            else
+            {
+                x = _mm256_blendv_ps(x, _mm256_add_ps(x, px), mask);
+                y = _mm256_blendv_ps(y, _mm256_add_ps(y, py), mask);
+                z = _mm256_blendv_ps(z, _mm256_add_ps(z, pz), mask);
+            }
+        }
+        store8(deformed + row, x, y, z);
+    }
+    sparseScalar(matrix, grid, deformed, row, end);
+}
+
+// the poses of a row in two halves of 8
+AVX2_TARGET static void sparsePosesAVX2(const WeightMatrix& matrix, const float* poses, int lanes,
+    Vector* const* deformed, std::size_t first)
+{
+    alignas(32) float x[POSE_LANES], y[POSE_LANES], z[POSE_LANES];
+    for (std::size_t row = 0; row < matrix.rows(); row++)
+    {
+        uint32_t begin = matrix.rowStart[row];
+        uint32_t end = matrix.rowStart[row + 1];
+        __m256 sums[6];
+        for (int sum = 0; sum < 6; sum++)
+            sums[sum] = _mm256_setzero_ps();
+        for (uint32_t entry = begin; entry < end; entry++)
+        {
+            const float* point = poses + matrix.columns[entry] * 3 * POSE_LANES;
+            __m256 weight = _mm256_set1_ps(matrix.values[entry]);
+            for (int sum = 0; sum < 6; sum++)
+            {
+                __m256 product = _mm256_mul_ps(_mm256_load_ps(point + 8 * sum), weight);
+                sums[sum] = entry == begin ? product : _mm256_add_ps(sums[sum], product);
+            }
+        }
+        _mm256_store_ps(x, sums[0]);
+        _mm256_store_ps(x + 8, sums[1]);
+        _mm256_store_ps(y, sums[2]);
+        _mm256_store_ps(y + 8, sums[3]);
+        _mm256_store_ps(z, sums[4]);
+        _mm256_store_ps(z + 8, sums[5]);
+        storePoses(x, y, z, lanes, deformed, first + row);
+    }
+}
+
+// AVX-512, 16 vertices at a time                                   //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+// the masked gather starts from zeros, the unmasked one from an undefined
+// register that GCC warns about
+AVX512_TARGET static inline __m512 gatherFloats16(const float* grid, __m512i offset)
+{
+    return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, offset, grid, 4);
+}
+
+AVX512_TARGET static inline __m512i gatherInts16(const int* values, __m512i offset)
+{
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xffff, offset, values, 4);
+}
+
+AVX512_TARGET static inline void gather16(const float* grid, __m512i offset, __m512& x, __m512& y, __m512& z)
+{
+    x = gatherFloats16(grid, offset);
+    y = gatherFloats16(grid + 1, offset);
+    z = gatherFloats16(grid + 2, offset);
+}
+
+// permutation indices that interleave 16 x, y and z values into 16 Vectors,
+// each of the three outputs is x and y permuted together then merged with z
+struct InterleaveIndices
+{
+    alignas(64) int32_t xy[3][16];
+    alignas(64) int32_t z[3][16];
+
+    InterleaveIndices()
+    {
+        for (int output = 0; output < 3; output++)
+        {
+            for (int element = 0; element < 16; element++)
+            {
+                int vertex = (output * 16 + element) / 3;
+                int component = (output * 16 + element) % 3;
+                // indices above 15 pick from the second source
+                xy[output][element] = component == 1 ? 16 + vertex : vertex;
+                z[output][element] = component == 2 ? 16 + vertex : element;
+            }
+        }
+    }
+};
+
+static const InterleaveIndices interleaveIndices;
+
+AVX512_TARGET static inline void store16(Vector* deformed, __m512 x, __m512 y, __m512 z)
+{
+    float* out = &deformed->x;
+    for (int output = 0; output < 3; output++)
+    {
+        __m512 xy = _mm512_permutex2var_ps(x, _mm512_load_si512(interleaveIndices.xy[output]), y);
+        _mm512_storeu_ps(out + 16 * output, _mm512_permutex2var_ps(xy, _mm512_load_si512(interleaveIndices.z[output]), z));
+    }
+}
+
+AVX512_TARGET static inline __m512 bilinear16(__m512 p10, __m512 p00, __m512 p11, __m512 p01,
+    __m512 u, __m512 v, __m512 oneMinusU, __m512 oneMinusV)
+{
+    __m512 sum = _mm512_mul_ps(_mm512_mul_ps(p10, u), v);
+    sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_mul_ps(p00, v), oneMinusU));
+    sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_mul_ps(p11, u), oneMinusV));
+    return _mm512_add_ps(sum, _mm512_mul_ps(_mm512_mul_ps(p01, oneMinusU), oneMinusV));
+}
+
+AVX512_TARGET static void bilinearAVX512(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m512 one = _mm512_set1_ps(1.0f);
+    // a point is three floats, so the point of the next column is three floats on
+    __m512i three = _mm512_set1_epi32(3);
+    __m512i down = _mm512_set1_epi32(3 * gridSize);
+
+    std::size_t vertex = begin;
+    for (; vertex + 16 <= end; vertex += 16)
+    {
+        __m512 u = _mm512_loadu_ps(weights.u.data() + vertex);
+        __m512 v = _mm512_loadu_ps(weights.v.data() + vertex);
+        __m512 oneMinusU = _mm512_sub_ps(one, u);
+        __m512 oneMinusV = _mm512_sub_ps(one, v);
+        __m512i p01 = _mm512_mullo_epi32(_mm512_loadu_si512(weights.cell.data() + vertex), three);
+        __m512i p11 = _mm512_add_epi32(p01, three);
+        __m512i p00 = _mm512_add_epi32(p01, down);
+        __m512i p10 = _mm512_add_epi32(p00, three);
+
+        __m512 x10, y10, z10, x00, y00, z00, x11, y11, z11, x01, y01, z01;
+        gather16(points, p10, x10, y10, z10);
+        gather16(points, p00, x00, y00, z00);
+        gather16(points, p11, x11, y11, z11);
+        gather16(points, p01, x01, y01, z01);
+
+        store16(deformed + vertex,
+            bilinear16(x10, x00, x11, x01, u, v, oneMinusU, oneMinusV),
+            bilinear16(y10, y00, y11, y01, u, v, oneMinusU, oneMinusV),
+            bilinear16(z10, z00, z11, z01, u, v, oneMinusU, oneMinusV));
+    }
+    bilinearScalar(weights, grid, gridSize, deformed, vertex, end);
+}
+
+AVX512_TARGET static void barycentricAVX512(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m512i three = _mm512_set1_epi32(3);
+
+    std::size_t vertex = begin;
+    for (; vertex + 16 <= end; vertex += 16)
+    {
+        __m512 alpha = _mm512_loadu_ps(weights.u.data() + vertex);
+        __m512 beta = _mm512_loadu_ps(weights.v.data() + vertex);
+        __m512 gamma = _mm512_loadu_ps(weights.w.data() + vertex);
+        // the corners of each triangle are looked up in the triangulation first
+        __m512i triangle = _mm512_loadu_si512(weights.cell.data() + vertex);
+        __m512i t0 = _mm512_mullo_epi32(gatherInts16(triangles, triangle), three);
+        __m512i t1 = _mm512_mullo_epi32(gatherInts16(triangles + 1, triangle), three);
+        __m512i t2 = _mm512_mullo_epi32(gatherInts16(triangles + 2, triangle), three);
+
+        __m512 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+        gather16(points, t0, x0, y0, z0);
+        gather16(points, t1, x1, y1, z1);
+        gather16(points, t2, x2, y2, z2);
+
+        store16(deformed + vertex,
+            _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x0, alpha), _mm512_mul_ps(x1, beta)), _mm512_mul_ps(x2, gamma)),
+            _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(y0, alpha), _mm512_mul_ps(y1, beta)), _mm512_mul_ps(y2, gamma)),
+            _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(z0, alpha), _mm512_mul_ps(z1, beta)), _mm512_mul_ps(z2, gamma)));
+    }
+    barycentricScalar(weights, grid, triangles, deformed, vertex, end);
+}
+
+AVX512_TARGET static inline __m512 trilinear16(const float* points, __m512i p000, __m512i right, __m512i down, __m512i back,
+    __m512 u, __m512 v, __m512 w, __m512 oneMinusU, __m512 oneMinusV, __m512 oneMinusW)
+{
+    __m512i p100 = _mm512_add_epi32(p000, back);
+    __m512 front = bilinear16(
+        gatherFloats16(points, _mm512_add_epi32(_mm512_add_epi32(p000, down), right)),
+        gatherFloats16(points, _mm512_add_epi32(p000, down)),
+        gatherFloats16(points, _mm512_add_epi32(p000, right)),
+        gatherFloats16(points, p000),
+        u, v, oneMinusU, oneMinusV);
+    __m512 rear = bilinear16(
+        gatherFloats16(points, _mm512_add_epi32(_mm512_add_epi32(p100, down), right)),
+        gatherFloats16(points, _mm512_add_epi32(p100, down)),
+        gatherFloats16(points, _mm512_add_epi32(p100, right)),
+        gatherFloats16(points, p100),
+        u, v, oneMinusU, oneMinusV);
+    return _mm512_add_ps(_mm512_mul_ps(front, oneMinusW), _mm512_mul_ps(rear, w));
+}
+
+AVX512_TARGET static void trilinearAVX512(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m512 one = _mm512_set1_ps(1.0f);
+    // a point is three floats, so the point of the next column is three floats on
+    __m512i three = _mm512_set1_epi32(3);
+    __m512i down = _mm512_set1_epi32(3 * gridSize);
+    __m512i back = _mm512_set1_epi32(3 * gridSize * gridSize);
+
+    std::size_t vertex = begin;
+    for (; vertex + 16 <= end; vertex += 16)
+    {
+        __m512 u = _mm512_loadu_ps(weights.u.data() + vertex);
+        __m512 v = _mm512_loadu_ps(weights.v.data() + vertex);
+        __m512 w = _mm512_loadu_ps(weights.w.data() + vertex);
+        __m512 oneMinusU = _mm512_sub_ps(one, u);
+        __m512 oneMinusV = _mm512_sub_ps(one, v);
+        __m512 oneMinusW = _mm512_sub_ps(one, w);
+        __m512i p000 = _mm512_mullo_epi32(_mm512_loadu_si512(weights.cell.data() + vertex), three);
+
+        store16(deformed + vertex,
+            trilinear16(points, p000, three, down, back, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            trilinear16(points + 1, p000, three, down, back, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            trilinear16(points + 2, p000, three, down, back, u, v, w, oneMinusU, oneMinusV, oneMinusW));
+    }
+    trilinearScalar(weights, grid, gridSize, deformed, vertex, end);
+}
+
+AVX512_TARGET static inline __m512 sparseTrilinear16(const float* points, const __m512i* corner,
+    __m512 u, __m512 v, __m512 w, __m512 oneMinusU, __m512 oneMinusV, __m512 oneMinusW)
+{
+    __m512 front = bilinear16(
+        gatherFloats16(points, corner[3]),
+        gatherFloats16(points, corner[2]),
+        gatherFloats16(points, corner[1]),
+        gatherFloats16(points, corner[0]),
+        u, v, oneMinusU, oneMinusV);
+    __m512 rear = bilinear16(
+        gatherFloats16(points, corner[7]),
+        gatherFloats16(points, corner[6]),
+        gatherFloats16(points, corner[5]),
+        gatherFloats16(points, corner[4]),
+        u, v, oneMinusU, oneMinusV);
+    return _mm512_add_ps(_mm512_mul_ps(front, oneMinusW), _mm512_mul_ps(rear, w));
+}
+
+AVX512_TARGET static void sparseTrilinearAVX512(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512i three = _mm512_set1_epi32(3);
+    __m512i eight = _mm512_set1_epi32(8);
+
+    std::size_t vertex = begin;
+    for (; vertex + 16 <= end; vertex += 16)
+    {
+        __m512 u = _mm512_loadu_ps(weights.u.data() + vertex);
+        __m512 v = _mm512_loadu_ps(weights.v.data() + vertex);
+        __m512 w = _mm512_loadu_ps(weights.w.data() + vertex);
+        __m512 oneMinusU = _mm512_sub_ps(one, u);
+        __m512 oneMinusV = _mm512_sub_ps(one, v);
+        __m512 oneMinusW = _mm512_sub_ps(one, w);
+        // the corners of each cell are looked up in the lattice first
+        __m512i cell = _mm512_mullo_epi32(_mm512_loadu_si512(weights.cell.data() + vertex), eight);
+        __m512i corner[8];
+        for (int k = 0; k < 8; k++)
+            corner[k] = _mm512_mullo_epi32(gatherInts16(corners + k, cell), three);
+
+        store16(deformed + vertex,
+            sparseTrilinear16(points, corner, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            sparseTrilinear16(points + 1, corner, u, v, w, oneMinusU, oneMinusV, oneMinusW),
+            sparseTrilinear16(points + 2, corner, u, v, w, oneMinusU, oneMinusV, oneMinusW));
+    }
+    sparseTrilinearScalar(weights, grid, corners, deformed, vertex, end);
+}
+
+AVX512_TARGET static inline __m512 bsplineRow16(const float* points, __m512i offset, const __m512* b)
+{
+    __m512 sum = _mm512_mul_ps(gatherFloats16(points, offset), b[0]);
+    sum = _mm512_add_ps(sum, _mm512_mul_ps(gatherFloats16(points + 3, offset), b[1]));
+    sum = _mm512_add_ps(sum, _mm512_mul_ps(gatherFloats16(points + 6, offset), b[2]));
+    return _mm512_add_ps(sum, _mm512_mul_ps(gatherFloats16(points + 9, offset), b[3]));
+}
+
+AVX512_TARGET static inline __m512 bspline16(const float* points, __m512i first, int down, int back,
+    const __m512* bx, const __m512* by, const __m512* bz)
+{
+    __m512 volume = _mm512_setzero_ps();
+    for (int layer = 0; layer < 4; layer++)
+    {
+        const float* layerPoints = points + layer * back;
+        __m512 plane = _mm512_mul_ps(bsplineRow16(layerPoints, first, bx), by[0]);
+        for (int row = 1; row < 4; row++)
+            plane = _mm512_add_ps(plane, _mm512_mul_ps(bsplineRow16(layerPoints + row * down, first, bx), by[row]));
+        volume = layer == 0 ? _mm512_mul_ps(plane, bz[0]) : _mm512_add_ps(volume, _mm512_mul_ps(plane, bz[layer]));
+    }
+    return volume;
+}
+
+AVX512_TARGET static void bsplineAVX512(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    std::size_t count = weights.size();
+    __m512i three = _mm512_set1_epi32(3);
+    int down = 3 * gridSize;
+    int back = 3 * gridSize * gridSize;
+
+    std::size_t vertex = begin;
+    for (; vertex + 16 <= end; vertex += 16)
+    {
+        const float* basis = weights.basis.data() + vertex;
+        __m512 bx[4], by[4], bz[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bx[k] = _mm512_loadu_ps(basis + k * count);
+            by[k] = _mm512_loadu_ps(basis + (4 + k) * count);
+            bz[k] = _mm512_loadu_ps(basis + (8 + k) * count);
+        }
+        __m512i first = _mm512_mullo_epi32(_mm512_loadu_si512(weights.cell.data() + vertex), three);
+
+        store16(deformed + vertex,
+            bspline16(points, first, down, back, bx, by, bz),
+            bspline16(points + 1, first, down, back, bx, by, bz),
+            bspline16(points + 2, first, down, back, bx, by, bz));
+    }
+    bsplineScalar(weights, grid, gridSize, deformed, vertex, end);
+}
+
+// as sparseAVX2, 16 rows at a time
+AVX512_TARGET static void sparseAVX512(const WeightMatrix& matrix, const Vector* grid,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    const float* points = &grid->x;
+    const int* columns = matrix.columns.data();
+    const float* values = matrix.values.data();
+    __m512i three = _mm512_set1_epi32(3);
+
+    std::size_t row = begin;
+    for (; row + 16 <= end; row += 16)
+    {
+        __m512i first = _mm512_loadu_si512(matrix.rowStart.data() + row);
+        __m512i length = _mm512_sub_epi32(_mm512_loadu_si512(matrix.rowStart.data() + row + 1), first);
+        alignas(64) int32_t lengths[16];
+        _mm512_store_si512(lengths, length);
+        int longest = *std::max_element(lengths, lengths + 16);
+
+        __m512 x = _mm512_setzero_ps(), y = _mm512_setzero_ps(), z = _mm512_setzero_ps();
+        for (int k = 0; k < longest; k++)
+        {
+            __mmask16 inRow = _mm512_cmpgt_epi32_mask(length, _mm512_set1_epi32(k));
+            __m512i entry = _mm512_add_epi32(first, _mm512_set1_epi32(k));
+            __m512i offset = _mm512_mullo_epi32(_mm512_mask_i32gather_epi32(_mm512_setzero_si512(), inRow, entry, columns, 4), three);
+            __m512 weight = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inRow, entry, values, 4);
+            __m512 px = _mm512_mul_ps(_mm512_mask_i32gather_ps(_mm512_setzero_ps(), inRow, offset, points, 4), weight);
+            __m512 py = _mm512_mul_ps(_mm512_mask_i32gather_ps(_mm512_setzero_ps(), inRow, offset, points + 1, 4), weight);
+            __m512 pz = _mm512_mul_ps(_mm512_mask_i32gather_ps(_mm512_setzero_ps(), inRow, offset, points + 2, 4), weight);
+            if (k == 0)
+            {
+                x = _mm512_mask_mov_ps(x, inRow, px);
+                y = _mm512_mask_mov_ps(y, inRow, py);
+                z = _mm512_mask_mov_ps(z, inRow, pz);
+            }
+            else
+            {
+                x = _mm512_mask_add_ps(x, inRow, x, px);
+                y = _mm512_mask_add_ps(y, inRow, y, py);
+                z = _mm512_mask_add_ps(z, inRow, z, pz);
+            }
+        }
+        store16(deformed + row, x, y, z);
+    }
+    sparseScalar(matrix, grid, deformed, row, end);
+}
+
+// the 16 poses of a row in one register per component
+AVX512_TARGET static void sparsePosesAVX512(const WeightMatrix& matrix, const float* poses, int lanes,
+    Vector* const* deformed, std::size_t first)
+{
+    alignas(64) float x[POSE_LANES], y[POSE_LANES], z[POSE_LANES];
+    for (std::size_t row = 0; row < matrix.rows(); row++)
+    {
+        uint32_t begin = matrix.rowStart[row];
+        uint32_t end = matrix.rowStart[row + 1];
+        __m512 sumX = _mm512_setzero_ps(), sumY = _mm512_setzero_ps(), sumZ = _mm512_setzero_ps();
+        for (uint32_t entry = begin; entry < end; entry++)
+        {
+            const float* point = poses + matrix.columns[entry] * 3 * POSE_LANES;
+            __m512 weight = _mm512_set1_ps(matrix.values[entry]);
+            __m512 productX = _mm512_mul_ps(_mm512_load_ps(point), weight);
+            __m512 productY = _mm512_mul_ps(_mm512_load_ps(point + POSE_LANES), weight);
+            __m512 productZ = _mm512_mul_ps(_mm512_load_ps(point + 2 * POSE_LANES), weight);
+            if (entry == begin)
+            {
+                sumX = productX;
+                sumY = productY;
+                sumZ = productZ;
+            }
+            else
+            {
+                sumX = _mm512_add_ps(sumX, productX);
+                sumY = _mm512_add_ps(sumY, productY);
+                sumZ = _mm512_add_ps(sumZ, productZ);
+            }
+        }
+        _mm512_store_ps(x, sumX);
+        _mm512_store_ps(y, sumY);
+        _mm512_store_ps(z, sumZ);
+        storePoses(x, y, z, lanes, deformed, first + row);
+    }
+}
+
+#endif
+
+// Dispatch                                                         //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+KernelLevel supportedKernelLevel()
+{
+#ifdef DEFORM_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return KernelLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return KernelLevel::AVX2;
+#endif
+    return KernelLevel::Scalar;
+}
+
+static std::atomic<KernelLevel> currentKernelLevel(supportedKernelLevel());
+
+KernelLevel getKernelLevel()
+{
+    return currentKernelLevel;
+}
+
+KernelLevel setKernelLevel(KernelLevel level)
+{
+    if (level > supportedKernelLevel())
+        level = supportedKernelLevel();
+    currentKernelLevel = level;
+    return level;
+}
+
+const char* kernelLevelName(KernelLevel level)
+{
+    switch (level)
+    {
+        case KernelLevel::AVX2:
+            return "avx2";
+        case KernelLevel::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+void deformBilinearStreams(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            bilinearAVX512(weights, grid, gridSize, deformed, begin, end);
+            break;
+        case KernelLevel::AVX2:
+            bilinearAVX2(weights, grid, gridSize, deformed, begin, end);
+            break;
+#endif
+        default:
+            bilinearScalar(weights, grid, gridSize, deformed, begin, end);
+            break;
+    }
+}
+
+void deformBarycentricStreams(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            barycentricAVX512(weights, grid, triangles, deformed, begin, end);
+            break;
+        case KernelLevel::AVX2:
+            barycentricAVX2(weights, grid, triangles, deformed, begin, end);
+            break;
+#endif
+        default:
+            barycentricScalar(weights, grid, triangles, deformed, begin, end);
+            break;
+    }
+}
+
+void deformTrilinearStreams(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            trilinearAVX512(weights, grid, gridSize, deformed, begin, end);
+            break;
+        case KernelLevel::AVX2:
+            trilinearAVX2(weights, grid, gridSize, deformed, begin, end);
+            break;
+#endif
+        default:
+            trilinearScalar(weights, grid, gridSize, deformed, begin, end);
+            break;
+    }
+}
+
+void deformBSplineStreams(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            bsplineAVX512(weights, grid, gridSize, deformed, begin, end);
+            break;
+        case KernelLevel::AVX2:
+            bsplineAVX2(weights, grid, gridSize, deformed, begin, end);
+            break;
+#endif
+        default:
+            bsplineScalar(weights, grid, gridSize, deformed, begin, end);
+            break;
+    }
+}
+
+void deformSparseTrilinearStreams(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            sparseTrilinearAVX512(weights, grid, corners, deformed, begin, end);
+            break;
+        case KernelLevel::AVX2:
+            sparseTrilinearAVX2(weights, grid, corners, deformed, begin, end);
+            break;
+#endif
+        default:
+            sparseTrilinearScalar(weights, grid, corners, deformed, begin, end);
+            break;
+    }
+}
+
+void deformSparse(const WeightMatrix& matrix, const Vector* grid,
+    Vector* deformed, std::size_t begin, std::size_t end)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            sparseAVX512(matrix, grid, deformed, begin, end);
+            break;
+        case KernelLevel::AVX2:
+            sparseAVX2(matrix, grid, deformed, begin, end);
+            break;
+#endif
+        default:
+            sparseScalar(matrix, grid, deformed, begin, end);
+            break;
+    }
+}
+
+void deformSparsePoses(const WeightMatrix& matrix, const float* poses, int lanes,
+    Vector* const* deformed, std::size_t first)
+{
+    switch (getKernelLevel())
+    {
+#ifdef DEFORM_KERNELS_X86
+        case KernelLevel::AVX512:
+            sparsePosesAVX512(matrix, poses, lanes, deformed, first);
+            break;
+        case KernelLevel::AVX2:
+            sparsePosesAVX2(matrix, poses, lanes, deformed, first);
+            break;
+#endif
+        default:
+            sparsePosesScalar(matrix, poses, lanes, deformed, first);
+            break;
+    }
+}
+
+// the vertices are scattered over the mesh, so they are deformed one at a time
+// with the scalar arithmetic, which every level agrees with
+
+void deformBilinearVertices(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, const uint32_t* vertices, std::size_t count)
+{
+    for (std::size_t vertex = 0; vertex < count; vertex++)
+        bilinearVertex(weights, grid, gridSize, deformed, vertices[vertex]);
+}
+
+void deformBarycentricVertices(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, const uint32_t* vertices, std::size_t count)
+{
+    for (std::size_t vertex = 0; vertex < count; vertex++)
+        barycentricVertex(weights, grid, triangles, deformed, vertices[vertex]);
+}
+
+void deformTrilinearVertices(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, const uint32_t* vertices, std::size_t count)
+{
+    for (std::size_t vertex = 0; vertex < count; vertex++)
+        trilinearVertex(weights, grid, gridSize, deformed, vertices[vertex]);
+}
+
+void deformBSplineVertices(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, const uint32_t* vertices, std::size_t count)
+{
+    for (std::size_t vertex = 0; vertex < count; vertex++)
+        bsplineVertex(weights, grid, gridSize, deformed, vertices[vertex]);
+}
+
+void deformSparseTrilinearVertices(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, const uint32_t* vertices, std::size_t count)
+{
+    for (std::size_t vertex = 0; vertex < count; vertex++)
+        sparseTrilinearVertex(weights, grid, corners, deformed, vertices[vertex]);
+}
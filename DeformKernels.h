@@ -0,0 +1,104 @@
+#ifndef _DEFORM_KERNELS_H
+#define _DEFORM_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Vector.h"
+
+// Binding of every vertex to its grid in structure of arrays form, one stream
+// per weight and one for the index of the first grid point the vertex depends on:
+//  bilinear:    u, v and the top left point of the cell (row * gridSize + col)
+//  barycentric: alpha, beta, gamma in u, v, w and the triangle's first index in the triangulation
+//  trilinear:   u, v, w and the front top left point of the cell
+//  B-spline:    u, v, w within the span and the front top left of its 4x4x4 control points
+//  sparse trilinear: u, v, w and the cell's index in the lattice, which lists its eight corners
+struct WeightStreams
+{
+    std::vector<float, AlignedAllocator<float> > u, v, w;
+    std::vector<int32_t, AlignedAllocator<int32_t> > cell;
+    // B-spline bindings only, the cubic basis along x, y then z: 12 streams of size()
+    // weights one after another, the weights of control points 0 to 3 of each axis
+    std::vector<float, AlignedAllocator<float> > basis;
+
+    void resize(std::size_t count);
+    void clear();
+    std::size_t size() const;
+};
+
+// Binding of every vertex as a sparse matrix B in compressed rows, row i the grid
+// points vertex i depends on and their weights, so that the deformed mesh is B times
+// the grid whatever grid it is bound to. Every grid type can be written this way,
+// at the cost of an index and a weight per grid point of every vertex.
+struct WeightMatrix
+{
+    // the entries of row i are [rowStart[i], rowStart[i + 1])
+    std::vector<uint32_t, AlignedAllocator<uint32_t> > rowStart;
+    std::vector<int32_t, AlignedAllocator<int32_t> > columns;
+    std::vector<float, AlignedAllocator<float> > values;
+
+    // count rows of rowLength entries each, to be filled in
+    void resize(std::size_t count, int rowLength);
+    void clear();
+    std::size_t rows() const;
+    std::size_t entries() const;
+};
+
+// instruction sets the deformation kernels are compiled for
+enum struct KernelLevel
+{
+    Scalar, AVX2, AVX512
+};
+
+// the kernels used, the best the cpu supports unless set otherwise
+KernelLevel getKernelLevel();
+// use the given kernels, capped to what the cpu supports, returns the level used
+KernelLevel setKernelLevel(KernelLevel level);
+// best kernels the cpu supports
+KernelLevel supportedKernelLevel();
+const char* kernelLevelName(KernelLevel level);
+
+// deform vertices [begin, end) into deformed, every level gives exactly the same
+// result as the scalar kernels, which do the arithmetic in the order Vector did
+void deformBilinearStreams(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end);
+void deformBarycentricStreams(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, std::size_t begin, std::size_t end);
+void deformTrilinearStreams(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end);
+void deformBSplineStreams(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, std::size_t begin, std::size_t end);
+// corners are the eight points of every cell of a SparseLattice, the same arithmetic as
+// the trilinear kernels with each corner looked up rather than offset from the first
+void deformSparseTrilinearStreams(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, std::size_t begin, std::size_t end);
+
+// the deformed vertices [begin, end) as rows of B times the grid, each row summed in
+// the order of its entries starting from the first product, on every level
+void deformSparse(const WeightMatrix& matrix, const Vector* grid,
+    Vector* deformed, std::size_t begin, std::size_t end);
+
+// poses are deformed this many at a time, each group of poses laid out as the x of
+// every pose of a grid point, then their y and z, for every point in turn
+static const int POSE_LANES = 16;
+
+// row r of matrix times each of the first lanes poses of a group into
+// deformed[pose][first + r], every pose giving exactly what deformSparse gives
+void deformSparsePoses(const WeightMatrix& matrix, const float* poses, int lanes,
+    Vector* const* deformed, std::size_t first);
+
+// deform just the listed vertices, in place in deformed
+void deformBilinearVertices(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, const uint32_t* vertices, std::size_t count);
+void deformBarycentricVertices(const WeightStreams& weights, const Vector* grid, const int* triangles,
+    Vector* deformed, const uint32_t* vertices, std::size_t count);
+void deformTrilinearVertices(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, const uint32_t* vertices, std::size_t count);
+void deformBSplineVertices(const WeightStreams& weights, const Vector* grid, int gridSize,
+    Vector* deformed, const uint32_t* vertices, std::size_t count);
+void deformSparseTrilinearVertices(const WeightStreams& weights, const Vector* grid, const int32_t* corners,
+    Vector* deformed, const uint32_t* vertices, std::size_t count);
+
+#endif
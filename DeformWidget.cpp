@@ -1,19 +1,28 @@
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 #include <math.h>
 
 #include <GL/gl.h>
 #include <GL/glu.h>
 
+#include <QGuiApplication>
 #include <QMessageBox>
+#include <QScreen>
 
 #include "DeformWidget.h"
 
 static float light_position[] = {0.0, 0.0, 1.0, 0.0};		
 
+// frames further apart than this follow a pause rather than one another, in nanoseconds
+static const qint64 FRAME_PAUSE = 250000000;
+// frames between two summaries of the frame times
+static const int STATS_FRAMES = 30;
+
 // Constructor
 DeformWidget::DeformWidget(QWidget *parent) 
-    : QGLWidget(parent)
+    : QOpenGLWidget(parent)
 {
 
     mesh = Mesh();
@@ -34,7 +43,30 @@ DeformWidget::DeformWidget(QWidget *parent)
     closest = -1;
     previousMousePos = Vector(0.0, 0.0, 0.0);
     currentPos = Vector(0.0, 0.0, 0.0);
+    pendingMousePos = Vector(0.0, 0.0, 0.0);
+    inputPending = false;
+    pendingEvents = 0;
     attenuationScale = 1;
+    attenuationRadius = 0;
+    draggingSelection = false;
+    selecting = false;
+    lasso = false;
+    meshDragging = false;
+    draggingMesh = false;
+    draggedVertex = -1;
+
+    // the frame timer asks for a repaint, which applies the input gathered until then
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&frameTimer, SIGNAL(timeout()), this, SLOT(update()));
+    frameClock.start();
+    lastFrameStart = -1;
+
+    // repaint when the worker has a new deformation, update is queued to the GUI thread
+    deformWorker.setFrameCallback([this]()
+    {
+        QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+    });
 }
 
 //
@@ -55,35 +87,47 @@ void DeformWidget::initializeGL()
     glClearColor(1.0, 0.7, 0.7, 1.0);
 }
 
-// called every time the widget is resized
+// called every time the widget is resized, the viewport is set by Qt
 void DeformWidget::resizeGL(int w, int h)
 {
-    glViewport(0, 0, w, h);
+    Q_UNUSED(w);
+    Q_UNUSED(h);
+    updateProjection();
+}
 
-    // set projection matrix to be glOrtho based on zoom & window size
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
+// set projection matrix to be an orthographic one based on zoom & window size,
+// it is kept rather than set on the GL state so that it can be changed outside paintGL
+void DeformWidget::updateProjection()
+{
+    projection.setToIdentity();
 
     float dimensions = mesh.getModelSize();
     // stick with orthogonal projection
-    float aspectRatio = (float) w / (float) h;
+    float aspectRatio = (float) width() / (float) height();
 
     if (aspectRatio > 1.0)
-		glOrtho(-aspectRatio * dimensions, aspectRatio * dimensions, -dimensions, dimensions, -dimensions, dimensions);
+		projection.ortho(-aspectRatio * dimensions, aspectRatio * dimensions, -dimensions, dimensions, -dimensions, dimensions);
 	else
-        glOrtho(-dimensions, dimensions, -dimensions/aspectRatio, dimensions/aspectRatio, -dimensions, dimensions);
-	
-    
+        projection.ortho(-dimensions, dimensions, -dimensions/aspectRatio, dimensions/aspectRatio, -dimensions, dimensions);
 }
 	
 // called every time the widget needs painting
 void DeformWidget::paintGL()
 {
+    qint64 frameStart = frameClock.nsecsElapsed();
+    // the mouse movement since the last frame, however many events it came in
+    int events = pendingEvents;
+    pendingEvents = 0;
+    applyInput();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // set lighting on
     glEnable(GL_LIGHTING);
 
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projection.constData());
+
     // set model view matrix based on stored translation, rotation &c.
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
@@ -95,10 +139,32 @@ void DeformWidget::paintGL()
     Ball_Value(&objectBall, mNow);
 	glMultMatrixf(mNow);
 
-    gridBuilder.drawGrid();
+    // the grid is drawn with shaders, so it is given the same transform as a matrix,
+    // mNow is column major where QMatrix4x4 reads rows
+    QMatrix4x4 matrix = projection * QMatrix4x4(mNow).transposed();
+    gridRenderer.drawGrid(gridBuilder, matrix.constData(), width(), height(), dragging ? closest : -1);
 
-    if (!mesh.isEmpty())
-        mesh.drawMesh(&gridBuilder);
+    // the latest deformation the worker finished, which may be a grid move or two behind
+    DeformedFrame frame;
+    if (!mesh.isEmpty() && deformWorker.acquireFrame(frame))
+    {
+        meshRenderer.drawMesh(mesh, frame);
+        deformWorker.releaseFrame();
+    }
+
+    if (selecting)
+        drawSelectionPath();
+
+    qint64 frameEnd = frameClock.nsecsElapsed();
+    bool following = lastFrameStart >= 0 && frameStart - lastFrameStart < FRAME_PAUSE;
+    frameStats.addFrame(following ? (frameStart - lastFrameStart) * 1e-9 : 0.0, (frameEnd - frameStart) * 1e-9, events);
+    lastFrameStart = frameStart;
+    if (frameStats.getTotalFrames() % STATS_FRAMES == 0)
+    {
+        emit frameStatsChanged(QString::asprintf("frame %.1f ms (max %.1f), draw %.1f ms (max %.1f), %.1f events per frame",
+            frameStats.getAverageInterval() * 1e3, frameStats.getMaxInterval() * 1e3,
+            frameStats.getAverageDrawTime() * 1e3, frameStats.getMaxDrawTime() * 1e3, frameStats.getAverageEvents()));
+    }
 
     // drawPoints();
 }
@@ -129,26 +195,106 @@ void DeformWidget::mousePressEvent(QMouseEvent *event)
     switch(mouseButton)
     {
         case(Qt::LeftButton):
-            if (checkClick2D(vNow.x, vNow.y))
+            if (meshDragging && checkMeshClick(vNow.x, vNow.y))
+            {
+                // the binding is factored on the first grab after the mesh was bound, then each
+                // drag solves for how the grid follows the grabbed vertex once, a lattice too
+                // fine to factor while the user waits is only moved by its points
+                clearSelection();
+                if (!directManipulator.bind(mesh, gridBuilder))
+                {
+                    showError("The grid is too fine to drag the mesh surface by, move its points instead.");
+                    break;
+                }
+                directManipulator.beginDrag(std::vector<int>(1, draggedVertex));
+                dragStartGrid = gridBuilder._grid;
+                meshDragOffset = Vector(0.0, 0.0, 0.0);
+                draggingMesh = true;
+                previousMousePos = Vector(vNow.x, vNow.y, 0.0);
+            }
+            // a 3D cage has points behind one another, they are looked for along the ray
+            else if (gridBuilder.isVolumetric() ? checkClick3D(vNow.x, vNow.y) : checkClick2D(vNow.x, vNow.y))
+            {
                 dragging = true;
+                // grabbing a selected vertex drags the whole selection, any other drags it alone
+                draggingSelection = std::binary_search(selection.begin(), selection.end(), closest);
+                if (!draggingSelection)
+                    clearSelection();
+            }
+            else
+            {
+                // clicking away from the vertices starts a box, or with shift a lasso
+                selecting = true;
+                lasso = event->modifiers() & Qt::ShiftModifier;
+                selectionPath.assign(2, Vector(vNow.x, vNow.y, 0.0));
+                previousMousePos = Vector(vNow.x, vNow.y, 0.0);
+                update();
+            }
             break;
         case(Qt::RightButton):
             Ball_Mouse(&objectBall, vNow);
 			// start dragging
 			Ball_BeginDrag(&objectBall);
 			// update the widget
-			updateGL();
+			update();
             break;
     }
 }
 
-// process mouse movement (deform the grid according the direction we are travelling in)
+// keep the latest mouse position, the movement is applied once per frame so that the
+// work per frame stays the same whatever rate the mouse sends events at
 void DeformWidget::mouseMoveEvent(QMouseEvent *event)
 {
+    pendingMousePos.x =   (2.0 * event->localPos().x() / width()  - 1 ) * mesh.getModelSize(); // worldX
+    pendingMousePos.y = (-2.0 * event->localPos().y() / height() + 1 ) * mesh.getModelSize(); // worldY
+    pendingMousePos.z = 0.0;
+    // without a button held there is nothing to apply
+    if (event->buttons() == Qt::NoButton && !inputPending)
+    {
+        previousMousePos = pendingMousePos;
+        return;
+    }
+    inputPending = true;
+    pendingEvents++;
+    scheduleFrame();
+}
+
+// ask for a frame one display refresh after the start of the last one, or straight away
+void DeformWidget::scheduleFrame()
+{
+    if (frameTimer.isActive())
+        return;
+    QScreen* screen = QGuiApplication::primaryScreen();
+    double refreshRate = screen != nullptr && screen->refreshRate() > 0.0 ? screen->refreshRate() : 60.0;
+    qint64 period = (qint64)(1e9 / refreshRate);
+    qint64 sinceFrame = lastFrameStart >= 0 ? frameClock.nsecsElapsed() - lastFrameStart : period;
+    frameTimer.start(sinceFrame < period ? (int)((period - sinceFrame) / 1000000) : 0);
+}
+
+// process mouse movement (deform the grid according the direction we are travelling in)
+void DeformWidget::applyInput()
+{
+    if (!inputPending)
+        return;
+    inputPending = false;
+
+    // a box follows the mouse with its second corner, a lasso gets a point per frame
+    if (selecting)
+    {
+        if (lasso)
+            selectionPath.push_back(pendingMousePos);
+        else
+            selectionPath.back() = pendingMousePos;
+        previousMousePos = pendingMousePos;
+        return;
+    }
+
     // get mouse movement direction vector
     HVect vNow;
-    vNow.x =   (2.0 * event->localPos().x() / width()  - 1 ) * mesh.getModelSize(); // worldX
-    vNow.y = (-2.0 * event->localPos().y() / height() + 1 ) * mesh.getModelSize(); // worldY
+    vNow.x = pendingMousePos.x;
+    vNow.y = pendingMousePos.y;
+    vNow.z = pendingMousePos.z;
+    vNow.w = 0.0;
 
     // invert by the rotation in objectBall (the transpose since it is a rotation/orthogonal matrix)
     float rotatedX = objectBall.mNow[0][0]*(vNow.x - previousMousePos.x) + objectBall.mNow[0][1]*(vNow.y - previousMousePos.y) + objectBall.mNow[0][2]*(vNow.z - previousMousePos.z); 
@@ -158,34 +304,65 @@ void DeformWidget::mouseMoveEvent(QMouseEvent *event)
     switch(mouseButton)
     {
         case(Qt::LeftButton):
-            if(dragging)
-                gridBuilder.moveVertex(Vector(rotatedX, rotatedY, rotatedZ), closest, attenuation, attenuationScale);        
+            if(draggingMesh)
+            {
+                // the grid that takes the vertex the whole way from where it was grabbed
+                meshDragOffset = meshDragOffset + Vector(rotatedX, rotatedY, rotatedZ);
+                std::vector<Vector> gridOffsets;
+                directManipulator.solveDrag(std::vector<Vector>(1, meshDragOffset), gridOffsets);
+                std::vector<Vector> grid(dragStartGrid.size());
+                for (unsigned int point = 0; point < grid.size(); point++)
+                    grid[point] = dragStartGrid[point] + gridOffsets[point];
+                gridBuilder.setGrid(grid);
+                deformWorker.publishGrid(gridBuilder);
+            }
+            else if(dragging && draggingSelection)
+            {
+                // the selection moves as one, its followers are weighed once for all of it
+                gridBuilder.moveVertices(Vector(rotatedX, rotatedY, rotatedZ), selection, attenuation, attenuationScale,
+                    attenuationRadius * mesh.getModelSize() / 10.0);
+                deformWorker.publishGrid(gridBuilder);
+            }
+            else if(dragging)
+            {
+                gridBuilder.moveVertex(Vector(rotatedX, rotatedY, rotatedZ), closest, attenuation, attenuationScale,
+                    attenuationRadius * mesh.getModelSize() / 10.0);        
+                // the mesh is deformed on the worker, the grid is redrawn straight away
+                deformWorker.publishGrid(gridBuilder);
+            }
             break;
         case(Qt::RightButton):
             Ball_Mouse(&objectBall, vNow);
 			Ball_Update(&objectBall);
             break;
     }    
-    updateGL();
     // update mouse position
-    previousMousePos.x = (2.0 * event->localPos().x() / width()  - 1 ) * mesh.getModelSize();
-    previousMousePos.y = (-2.0 * event->localPos().y() / height() + 1 ) * mesh.getModelSize();
+    previousMousePos = pendingMousePos;
 }
 
 // stop processing the mouses movement
 void DeformWidget::mouseReleaseEvent(QMouseEvent *event)
 {
+    // the last movement belongs to the drag that is ending
+    applyInput();
     switch(mouseButton)
     {
         case(Qt::LeftButton):
+            if (selecting)
+                selectVertices(event->modifiers() & Qt::ControlModifier);
             dragging = false;
-            updateGL();
+            draggingSelection = false;
+            draggingMesh = false;
+            selecting = false;
+            update();
             break;
         case(Qt::RightButton):
             Ball_EndDrag(&objectBall);
-            updateGL();
+            update();
             break;
     }
+    // get the picking caches ready for the moved grid or the new view before the next click
+    pointPicker.update(gridBuilder, objectBall.mNow);
 }
 
 // for given coordinates, check if within a vertex's radius
@@ -193,35 +370,106 @@ bool DeformWidget::checkClick2D(float mouseX, float mouseY)
 {
     // fraction of sphere size guarantees the same pixel radius for any mesh 
     float clickRadius = mesh.getModelSize() / 8.0;
-    Vector clickOnXY = Vector(mouseX, mouseY, 0.0);
 
-    closest = -1;
-    // iterate over the list of grid vertices to find the one within the clicked area's radius
-    for(unsigned int i = 0; i < gridBuilder._grid.size(); i++)
+    // the grid vertices rotated by the arc ball are kept in screen buckets, so only the
+    // few near the click are tested; of those within the radius the closest to us is kept
+    closest = pointPicker.pickScreen(gridBuilder, objectBall.mNow, mouseX, mouseY, clickRadius);
+    return closest != -1;
+}
+
+// for given coordinates, check the grid vertices around the ray cast through them
+bool DeformWidget::checkClick3D(float mouseX, float mouseY)
+{
+    // same radius as the 2D check so both pick the same vertex
+    float clickRadius = mesh.getModelSize() / 8.0;
+
+    // the hierarchy over the unrotated grid is walked front to back along the view
+    closest = pointPicker.pickRay(gridBuilder, objectBall.mNow, mouseX, mouseY, clickRadius);
+    return closest != -1;
+}
+
+// for given coordinates, check the vertices of the mesh as it was last drawn
+bool DeformWidget::checkMeshClick(float mouseX, float mouseY)
+{
+    // a smaller radius than the grid's, as the mesh's vertices are much closer together
+    float clickRadius = mesh.getModelSize() / 40.0;
+
+    draggedVertex = -1;
+    DeformedFrame frame;
+    if (!mesh.isEmpty() && deformWorker.acquireFrame(frame))
     {
-        // rotate the grid vertex according to the arc ball rotation
-        // just get the x and y values
-        float rotatedX = objectBall.mNow[0][0]*gridBuilder._grid[i].x + objectBall.mNow[1][0]*gridBuilder._grid[i].y + objectBall.mNow[2][0]*gridBuilder._grid[i].z; 
-        float rotatedY = objectBall.mNow[0][1]*gridBuilder._grid[i].x + objectBall.mNow[1][1]*gridBuilder._grid[i].y + objectBall.mNow[2][1]*gridBuilder._grid[i].z; 
-        float rotatedZ = objectBall.mNow[0][2]*gridBuilder._grid[i].x + objectBall.mNow[1][2]*gridBuilder._grid[i].y + objectBall.mNow[2][2]*gridBuilder._grid[i].z; 
-        
-        // then project mesh vertex on x y plane
-        Vector vertexOnXY = Vector(rotatedX, rotatedY, 0.0);
-        // find the closest 
-        if((clickOnXY - vertexOnXY).magnitude() < clickRadius)
-        {
-            // if we have multiple points in the click radius, keep the closest
-            if ((closest == -1) || (objectBall.mNow[0][2]*gridBuilder._grid[closest].x + objectBall.mNow[1][2]*gridBuilder._grid[closest].y + objectBall.mNow[2][2]*gridBuilder._grid[closest].z < rotatedZ))
-                closest = i;
-        }
+        draggedVertex = PointPicker::pickPoints(*frame.vertices, objectBall.mNow, mouseX, mouseY, clickRadius);
+        deformWorker.releaseFrame();
     }
+    return draggedVertex != -1;
+}
 
-    if (closest != -1)
+// select the vertices seen inside the box or lasso drawn
+void DeformWidget::selectVertices(bool add)
+{
+    std::vector<float> polygon;
+    if (lasso)
     {
-        return true;
+        for (unsigned int point = 0; point < selectionPath.size(); point++)
+            polygon.insert(polygon.end(), { selectionPath[point].x, selectionPath[point].y });
     }
+    else
+    {
+        const Vector& first = selectionPath.front();
+        const Vector& last = selectionPath.back();
+        polygon = { first.x, first.y, last.x, first.y, last.x, last.y, first.x, last.y };
+    }
+    std::vector<int> selected;
+    pointPicker.selectPolygon(gridBuilder, objectBall.mNow, polygon, selected);
+
+    if (add)
+    {
+        std::vector<int> previous;
+        previous.swap(selection);
+        std::set_union(previous.begin(), previous.end(), selected.begin(), selected.end(), std::back_inserter(selection));
+    }
+    else
+        selection.swap(selected);
+    gridRenderer.setSelection(selection);
+}
+
+void DeformWidget::clearSelection()
+{
+    selection.clear();
+    gridRenderer.setSelection(selection);
+}
+
+// outline the box or lasso being drawn, in the mouse's coordinates
+void DeformWidget::drawSelectionPath()
+{
+    // drawn over the mesh, with the lighting back on for the next frame
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glColor3f(0.95, 0.6, 0.1);
+    glBegin(GL_LINE_LOOP);
+    if (lasso)
+    {
+        for (unsigned int point = 0; point < selectionPath.size(); point++)
+            glVertex3f(selectionPath[point].x, selectionPath[point].y, 0.0);
+    }
+    else
+    {
+        const Vector& first = selectionPath.front();
+        const Vector& last = selectionPath.back();
+        glVertex3f(first.x, first.y, 0.0);
+        glVertex3f(last.x, first.y, 0.0);
+        glVertex3f(last.x, last.y, 0.0);
+        glVertex3f(first.x, last.y, 0.0);
+    }
+    glEnd();
+    glEnable(GL_DEPTH_TEST);
+}
 
-    return false;
+const FrameStats& DeformWidget::getFrameStats() const
+{
+    return frameStats;
 }
 
 //
@@ -231,8 +479,11 @@ bool DeformWidget::checkClick2D(float mouseX, float mouseY)
 // load a mesh when a file has been chosen
 void DeformWidget::loadMesh(QString fileName)
 {
+    // the worker must not deform the mesh while it is replaced
+    deformWorker.stop();
     // load mesh in Mesh object
-    mesh.loadMesh(fileName.toStdString());
+    if (!mesh.loadMesh(fileName.toStdString()))
+        showFileError();
     // generate a new grid
     buildGrid();
     // update arcBall to be 0.8 of the model
@@ -242,8 +493,57 @@ void DeformWidget::loadMesh(QString fileName)
 
 void DeformWidget::saveMesh(QString fileName)
 {
-    // do the mesh saving
-    mesh.saveMesh(fileName.toStdString(), &gridBuilder);
+    // do the mesh saving, with the worker's copy of the grid which the mesh's
+    // deformation is cached against, once it has caught up with this one
+    deformWorker.stop();
+    bool saved = mesh.saveMesh(fileName.toStdString(), deformWorker.getGrid());
+    deformWorker.resume();
+    if (!saved)
+        showFileError();
+}
+
+void DeformWidget::loadGrid(QString fileName)
+{
+    std::vector<Vector> deformedGrid;
+    deformWorker.stop();
+    // the grid is loaded in its rest state
+    if (!gridBuilder.loadGrid(fileName.toStdString(), mesh.getModelSize(), deformedGrid))
+    {
+        deformWorker.resume();
+        showFileError();
+        return;
+    }
+    // bind the mesh to the rest grid, then move the grid to its saved positions, a sparse
+    // grid saved around another mesh is swapped for one built around this mesh
+    clearSelection();
+    if (!mesh.getVertexWeights(&gridBuilder))
+    {
+        showError("The mesh lies outside the cells of the grid.");
+        buildGrid();
+        return;
+    }
+    gridBuilder.setGrid(deformedGrid);
+    deformWorker.start(&mesh, gridBuilder);
+    pointPicker.update(gridBuilder, objectBall.mNow);
+    update();
+}
+
+void DeformWidget::saveGrid(QString fileName)
+{
+    if (!gridBuilder.saveGrid(fileName.toStdString(), mesh.getModelSize()))
+        showFileError();
+}
+
+void DeformWidget::showFileError()
+{
+    showError("Could not open file.");
+}
+
+void DeformWidget::showError(QString text)
+{
+    QMessageBox errorMsg;
+    errorMsg.setText(text);
+    errorMsg.exec();
 }
 
 //
@@ -263,19 +563,21 @@ void DeformWidget::changeGridType(int value)
 // slot for creating a new grid 
 void DeformWidget::buildGrid()
 {
-    // update the grid
-    gridBuilder.generateGrid(mesh.getModelSize());
+    deformWorker.stop();
+    // update the grid, the selected vertices go with the old one, a sparse grid
+    // is built around the mesh's vertices
+    clearSelection();
+    gridBuilder.generateGrid(mesh.getModelSize(), mesh.getVertices(), mesh.getVertexCount());
     // update the mesh weights 
     mesh.getVertexWeights(&gridBuilder);
+    // deform the mesh by the new grid on the worker from now on
+    deformWorker.start(&mesh, gridBuilder);
+    pointPicker.update(gridBuilder, objectBall.mNow);
 
     // update projection
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    float dimensions = mesh.getModelSize();
-    // stick with orthogonal projection
-    glOrtho(-dimensions, dimensions, -dimensions, dimensions, -dimensions, dimensions);
+    updateProjection();
     // update gl widget
-    updateGL();
+    update();
 }
 // slot for activating/deactivating attenuation
 void DeformWidget::setAttenuation(int value)
@@ -287,12 +589,22 @@ void DeformWidget::changeAttenuation(int value)
 {
     attenuationScale = value;
 }
+// change the attenuation radius
+void DeformWidget::changeAttenuationRadius(int value)
+{
+    attenuationRadius = value;
+}
+// slot for grabbing the mesh rather than the grid
+void DeformWidget::setMeshDragging(int value)
+{
+    meshDragging = value;
+}
 // reset the arc ball rotation
 void DeformWidget::resetRotation()
 {
     Ball_Init(&objectBall);		
     Ball_Place(&objectBall, qOne, 0.80 * mesh.getModelSize());
-    updateGL();
+    update();
 }
 
 //
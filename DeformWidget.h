@@ -1,22 +1,31 @@
 #ifndef _DEFORM_WIDGET_H
 #define _DEFORM_WIDGET_H
 
-#include <QGLWidget>
+#include <QOpenGLWidget>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <QGridLayout>
 #include <QSize>
 #include <QString>
+#include <QTimer>
 
 #include <vector>
 
 // utility class defining vector object (3 floats) and operations 
 #include "Vector.h"
 #include "Ball.h"
+#include "DeformWorker.h"
+#include "DirectManipulator.h"
+#include "FrameStats.h"
 #include "GridBuilder.h"
+#include "GridRenderer.h"
 #include "Mesh.h"
+#include "MeshRenderer.h"
+#include "PointPicker.h"
 
-class DeformWidget : public QGLWidget
+class DeformWidget : public QOpenGLWidget
 {
     Q_OBJECT
     public:
@@ -24,12 +33,19 @@ class DeformWidget : public QGLWidget
     // constructor
     DeformWidget(QWidget *parent);
 
+    // times of the last frames drawn
+    const FrameStats& getFrameStats() const;
+
     // slots
     public slots:
     // get a mesh file name from parent widget to be loaded 
     void loadMesh(QString fileName);
     // save the current mesh to a .mesh file
     void saveMesh(QString fileName);
+    // load a saved grid and apply it to the current mesh
+    void loadGrid(QString fileName);
+    // save the current grid to a .grid file
+    void saveGrid(QString fileName);
     // upon click a button, create a grid
     void buildGrid();
     // get the new value of the slider
@@ -40,10 +56,16 @@ class DeformWidget : public QGLWidget
     void setAttenuation(int value);
     // change the attenuation scale
     void changeAttenuation(int value);
+    // change the attenuation radius, in tenths of the model size, 0 for the whole grid
+    void changeAttenuationRadius(int value);
     // reset arc ball rotation to initial state
     void resetRotation();
+    // set whether clicks grab the mesh surface rather than the grid
+    void setMeshDragging(int value);
 
-    //signals
+    signals:
+    // a summary of the frame times, sent every so many frames
+    void frameStatsChanged(QString stats);
 
     protected:
     // Qt opengl functions
@@ -64,28 +86,82 @@ class DeformWidget : public QGLWidget
     int mouseButton;
     // flag representing drag status
     bool dragging;
+    // the grabbed vertex is part of the selection, which is dragged with it
+    bool draggingSelection;
+    // flag representing a box (or with shift, lasso) being drawn around vertices
+    bool selecting;
+    bool lasso;
+    // the corners of the box or the points of the lasso, in the same coordinates as the mouse
+    std::vector<Vector> selectionPath;
+    // the selected grid vertices, in index order
+    std::vector<int> selection;
+    // select the vertices inside the drawn box or lasso, added to the selection with ctrl
+    void selectVertices(bool add);
+    void clearSelection();
+    void drawSelectionPath();
+    // clicks grab the mesh surface, and the grid is solved for to follow it
+    bool meshDragging;
+    // a mesh vertex is being dragged, by meshDragOffset so far from where it was
+    bool draggingMesh;
+    int draggedVertex;
+    Vector meshDragOffset;
+    // the grid as it was when the drag began, which the solved moves are added to
+    std::vector<Vector> dragStartGrid;
+    // the factored binding, built again only when the mesh is bound anew
+    DirectManipulator directManipulator;
+    // check that the area clicked on screen is close to a vertex of the deformed mesh
+    bool checkMeshClick(float mouseX, float mouseY);
     // flag representing rotation status
     bool rotating;
     // flag representing attenuation 
     bool attenuation;
     // attenuation scale
     int attenuationScale;
+    // attenuation radius in tenths of the model size
+    int attenuationRadius;
 
     // mouse Input
     Vector previousMousePos;
     Vector currentPos;
+    // the mouse is only followed once per frame, from the latest position it was seen at
+    Vector pendingMousePos;
+    bool inputPending;
+    int pendingEvents;
+    // move the grid or turn the ball by the mouse movement since the last frame
+    void applyInput();
+
+    // frames are asked for at most once per display refresh
+    QTimer frameTimer;
+    QElapsedTimer frameClock;
+    qint64 lastFrameStart;
+    FrameStats frameStats;
+    void scheduleFrame();
 
     BallData objectBall;
 
     GLfloat translate_x, translate_y;
 	GLfloat last_x, last_y;
 
+    // orthographic projection fitted to the mesh and the widget
+    QMatrix4x4 projection;
+    void updateProjection();
+
     // mesh data
     Mesh mesh;
+    MeshRenderer meshRenderer;
 
     // grid vertices (array)
     int closest;
     GridBuilder gridBuilder;
+    GridRenderer gridRenderer;
+
+    // deforms the mesh by the grid off the GUI thread, declared last so that it
+    // stops before the mesh goes
+    DeformWorker deformWorker;
+
+    // show a message box when a file operation, or anything else the user asked for, fails
+    void showFileError();
+    void showError(QString text);
 
     // widget size
     QSize minimumSizeHint() const;
@@ -93,8 +169,10 @@ class DeformWidget : public QGLWidget
 
     // check that area clicked on screen is close to a grid vertex
     bool checkClick2D(float mouseX, float mouseY);
-    // check the volume around the point along 
-    bool checkClick3D();
+    // check the volume around the ray through the clicked point, along the view
+    bool checkClick3D(float mouseX, float mouseY);
+    // grid points turned by the view and a hierarchy over them, for both checks
+    PointPicker pointPicker;
 
     // 
     // debug
@@ -0,0 +1,309 @@
+#include <algorithm>
+
+#include "DeformWorker.h"
+
+// set on the middle grid slot when it holds positions the worker has not seen
+static const int FRESH_SLOT = 4;
+// past this share of the mesh a frame is copied whole rather than by the changes listed
+static const std::size_t CHANGE_SHARE = 4;
+// updates kept for frames and copies that fell behind, those further behind are copied whole
+static const std::size_t MAX_CHANGES = 64;
+
+DeformWorker::DeformWorker()
+{
+    _mesh = nullptr;
+    _stopping = false;
+    for (int slot = 0; slot < 3; slot++)
+        _snapshots[slot].version = 0;
+    _publishSlot = 0;
+    _middleSlot = 1;
+    _readSlot = 2;
+    for (int frame = 0; frame < 2; frame++)
+    {
+        _frames[frame].vertexStamp = 0;
+        _frames[frame].normalStamp = 0;
+        _frames[frame].verticesUpdatedFrom = 0;
+        _frames[frame].normalsUpdatedFrom = 0;
+    }
+    _latestFrame = -1;
+    _readingFrame = -1;
+    _drawnVertexStamp = 0;
+    _drawnNormalStamp = 0;
+    _vertexStamp = 0;
+    _normalStamp = 0;
+}
+
+DeformWorker::~DeformWorker()
+{
+    stop();
+}
+
+void DeformWorker::start(Mesh* mesh, const GridBuilder& gridBuilder)
+{
+    stop();
+    _mesh = mesh;
+    _grid = gridBuilder;
+
+    // nothing published or deformed before belongs to this mesh and grid
+    for (int slot = 0; slot < 3; slot++)
+        _snapshots[slot].version = 0;
+    _publishSlot = 0;
+    _middleSlot = 1;
+    _readSlot = 2;
+    for (int frame = 0; frame < 2; frame++)
+    {
+        _frames[frame].vertexStamp = 0;
+        _frames[frame].normalStamp = 0;
+    }
+    _latestFrame = -1;
+    _readingFrame = -1;
+    _drawnVertexStamp = 0;
+    _drawnNormalStamp = 0;
+    _changes.clear();
+    _vertexStamp = 0;
+    _normalStamp = 0;
+
+    resume();
+}
+
+void DeformWorker::stop()
+{
+    if (!_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+    _stopping = false;
+}
+
+void DeformWorker::resume()
+{
+    if (_thread.joinable() || _mesh == nullptr)
+        return;
+    _thread = std::thread(&DeformWorker::run, this);
+}
+
+bool DeformWorker::isRunning() const
+{
+    return _thread.joinable();
+}
+
+GridBuilder* DeformWorker::getGrid()
+{
+    return &_grid;
+}
+
+void DeformWorker::setFrameCallback(std::function<void()> callback)
+{
+    _frameCallback = callback;
+}
+
+void DeformWorker::publishGrid(const GridBuilder& gridBuilder)
+{
+    // the slot still holds the positions of an earlier version, so only the points moved since are copied
+    GridSnapshot& snapshot = _snapshots[_publishSlot];
+    std::vector<int> points;
+    if (snapshot.grid.size() == gridBuilder._grid.size() && gridBuilder.getChangedPoints(snapshot.version, points))
+    {
+        for (unsigned int point = 0; point < points.size(); point++)
+            snapshot.grid[points[point]] = gridBuilder._grid[points[point]];
+    }
+    else
+        snapshot.grid = gridBuilder._grid;
+    snapshot.version = gridBuilder.getVersion();
+    _publishSlot = _middleSlot.exchange(_publishSlot | FRESH_SLOT) & ~FRESH_SLOT;
+
+    // the worker only holds the mutex while going to sleep, never while deforming
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+    }
+    _wake.notify_one();
+}
+
+bool DeformWorker::acquireFrame(DeformedFrame& frame)
+{
+    // the worker checks which frame is being read after publishing a new one, so the
+    // frame is only taken once it is still the latest after being marked as read
+    int latest;
+    do
+    {
+        latest = _latestFrame.load();
+        _readingFrame.store(latest);
+    } while (latest != _latestFrame.load());
+    if (latest < 0)
+        return false;
+
+    const Frame& latestFrame = _frames[latest];
+    frame.vertices = &latestFrame.vertices;
+    frame.normals = latestFrame.normalStamp != 0 ? &latestFrame.normals : nullptr;
+    frame.vertexStamp = latestFrame.vertexStamp;
+    frame.normalStamp = latestFrame.normalStamp;
+    frame.updatedVertices = &latestFrame.updatedVertices;
+    frame.updatedTriangles = &latestFrame.updatedTriangles;
+    frame.verticesUpdatedFrom = latestFrame.verticesUpdatedFrom;
+    frame.normalsUpdatedFrom = latestFrame.normalsUpdatedFrom;
+    _drawnVertexStamp = latestFrame.vertexStamp;
+    _drawnNormalStamp = latestFrame.normalStamp;
+    return true;
+}
+
+void DeformWorker::releaseFrame()
+{
+    _readingFrame = -1;
+}
+
+void DeformWorker::run()
+{
+    // the grid as it was copied
+    deformFrame();
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return (_middleSlot.load() & FRESH_SLOT) != 0 || _stopping; });
+        }
+        // positions published before stopping are still deformed
+        if ((_middleSlot.load() & FRESH_SLOT) != 0)
+        {
+            _readSlot = _middleSlot.exchange(_readSlot) & ~FRESH_SLOT;
+            applyGrid(_snapshots[_readSlot]);
+            deformFrame();
+        }
+        else if (_stopping)
+            return;
+    }
+}
+
+void DeformWorker::applyGrid(const GridSnapshot& snapshot)
+{
+    std::vector<Vector>& grid = _grid._grid;
+    if (snapshot.grid.size() != grid.size())
+        return;
+    // setting only the points that moved lets the mesh deform just their vertices again
+    for (unsigned int point = 0; point < grid.size(); point++)
+    {
+        const Vector& position = snapshot.grid[point];
+        if (position.x != grid[point].x || position.y != grid[point].y || position.z != grid[point].z)
+            _grid.setGridVector(point, position);
+    }
+}
+
+void DeformWorker::deformFrame()
+{
+    bool normals = _grid.isVolumetric();
+    DeformedFrame deformed;
+    _mesh->getDeformedFrame(&_grid, normals, deformed);
+    if (deformed.vertexStamp == _vertexStamp && deformed.normalStamp == _normalStamp)
+        return;
+
+    // keep what this update touched for the frames and copies that are behind it
+    Change change;
+    change.vertexFrom = _vertexStamp;
+    change.normalFrom = _normalStamp;
+    change.allVertices = deformed.verticesUpdatedFrom == 0 || deformed.verticesUpdatedFrom != _vertexStamp;
+    change.allTriangles = deformed.normalsUpdatedFrom == 0 || deformed.normalsUpdatedFrom != _normalStamp;
+    if (!change.allVertices)
+        change.vertices = *deformed.updatedVertices;
+    if (normals && !change.allTriangles)
+        change.triangles = *deformed.updatedTriangles;
+    _changes.push_back(change);
+    _vertexStamp = deformed.vertexStamp;
+    _normalStamp = deformed.normalStamp;
+
+    // write into the frame that is not the latest, once the renderer is done with it
+    int back = _latestFrame.load() == 0 ? 1 : 0;
+    while (_readingFrame.load() == back)
+        std::this_thread::yield();
+    Frame& frame = _frames[back];
+
+    // the frame is two updates behind, so most of the time only a few vertices are copied
+    std::vector<uint32_t> changed;
+    const std::vector<Vector>& vertices = *deformed.vertices;
+    if (frame.vertices.size() == vertices.size() && changedSince(frame.vertexStamp, false, changed))
+    {
+        for (std::size_t vertex = 0; vertex < changed.size(); vertex++)
+            frame.vertices[changed[vertex]] = vertices[changed[vertex]];
+    }
+    else
+        frame.vertices = vertices;
+    if (normals)
+    {
+        const std::vector<Vector>& triangleNormals = *deformed.normals;
+        if (frame.normals.size() == triangleNormals.size() && changedSince(frame.normalStamp, true, changed))
+        {
+            for (std::size_t triangle = 0; triangle < changed.size(); triangle++)
+                frame.normals[changed[triangle]] = triangleNormals[changed[triangle]];
+        }
+        else
+            frame.normals = triangleNormals;
+    }
+    else
+        frame.normals.clear();
+    frame.vertexStamp = _vertexStamp;
+    frame.normalStamp = _normalStamp;
+
+    // the renderer's copy is at the frame it last acquired or after, so it
+    // only has to write again what changed since that one
+    unsigned long long drawnVertexStamp = _drawnVertexStamp.load();
+    unsigned long long drawnNormalStamp = _drawnNormalStamp.load();
+    frame.verticesUpdatedFrom = changedSince(drawnVertexStamp, false, frame.updatedVertices) ? drawnVertexStamp : 0;
+    frame.normalsUpdatedFrom = normals && changedSince(drawnNormalStamp, true, frame.updatedTriangles) ? drawnNormalStamp : 0;
+
+    _latestFrame.store(back);
+    trimChanges();
+    if (_frameCallback)
+        _frameCallback();
+}
+
+bool DeformWorker::changedSince(unsigned long long stamp, bool triangles, std::vector<uint32_t>& changed) const
+{
+    changed.clear();
+    if (stamp == 0)
+        return false;
+    if (stamp == (triangles ? _normalStamp : _vertexStamp))
+        return true;
+
+    std::size_t first = 0;
+    while (first < _changes.size() && (triangles ? _changes[first].normalFrom : _changes[first].vertexFrom) != stamp)
+        first++;
+    if (first == _changes.size())
+        return false;
+
+    std::size_t count = triangles ? _mesh->getIndexCount() / 3 : _mesh->getVertexCount();
+    for (std::size_t update = first; update < _changes.size(); update++)
+    {
+        const Change& change = _changes[update];
+        if (triangles ? change.allTriangles : change.allVertices)
+            return false;
+        const std::vector<uint32_t>& elements = triangles ? change.triangles : change.vertices;
+        changed.insert(changed.end(), elements.begin(), elements.end());
+        if (changed.size() > count)
+            return false;
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed.size() <= count / CHANGE_SHARE;
+}
+
+void DeformWorker::trimChanges()
+{
+    // the other frame and the renderer's copy are the furthest behind
+    unsigned long long oldest = _vertexStamp;
+    int latest = _latestFrame.load();
+    unsigned long long previous = _frames[latest == 0 ? 1 : 0].vertexStamp;
+    unsigned long long drawn = _drawnVertexStamp.load();
+    if (previous != 0 && previous < oldest)
+        oldest = previous;
+    if (drawn != 0 && drawn < oldest)
+        oldest = drawn;
+
+    std::size_t needed = 0;
+    while (needed < _changes.size() && _changes[needed].vertexFrom < oldest)
+        needed++;
+    if (_changes.size() - needed > MAX_CHANGES)
+        needed = _changes.size() - MAX_CHANGES;
+    _changes.erase(_changes.begin(), _changes.begin() + needed);
+}
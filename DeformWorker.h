@@ -0,0 +1,122 @@
+#ifndef _DEFORM_WORKER_H
+#define _DEFORM_WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Vector.h"
+#include "GridBuilder.h"
+#include "Mesh.h"
+
+// Deforms a mesh on a thread of its own so that the thread moving the grid never waits
+// for the deformation. Grid positions are handed over through a triple buffer, so that
+// publishing one never blocks, and the deformed mesh is written into two frames taken
+// in turn, the latest complete one being left alone for the renderer to draw.
+class DeformWorker
+{
+    public:
+
+    DeformWorker();
+    ~DeformWorker();
+
+    // deform mesh by a copy of gridBuilder's grid from now on, the mesh and its binding
+    // must not be changed until the worker is stopped
+    void start(Mesh* mesh, const GridBuilder& gridBuilder);
+    // deform the last grid published, then stop the thread, waiting for it
+    void stop();
+    // start the thread again after stop, with the same mesh and grid
+    void resume();
+    bool isRunning() const;
+
+    // the worker's copy of the grid, which the mesh's cached deformation is kept
+    // against, only to be used while the worker is stopped
+    GridBuilder* getGrid();
+
+    // hand the positions of gridBuilder's grid, which must have the layout the worker
+    // was started with, over to the worker, only the points moved since the last call are copied
+    void publishGrid(const GridBuilder& gridBuilder);
+    // called on the worker thread every time a new frame is complete
+    void setFrameCallback(std::function<void()> callback);
+
+    // the latest complete frame, which the worker leaves alone until it is released,
+    // returns false if there is none yet
+    bool acquireFrame(DeformedFrame& frame);
+    void releaseFrame();
+
+    private:
+    // grid positions as published, and the version of the grid they were copied from
+    struct GridSnapshot
+    {
+        std::vector<Vector> grid;
+        unsigned long long version;
+    };
+    // a deformation of the mesh, with the changes since the frame last acquired
+    struct Frame
+    {
+        std::vector<Vector> vertices;
+        std::vector<Vector> normals;
+        unsigned long long vertexStamp;
+        unsigned long long normalStamp;
+        std::vector<uint32_t> updatedVertices;
+        std::vector<uint32_t> updatedTriangles;
+        unsigned long long verticesUpdatedFrom;
+        unsigned long long normalsUpdatedFrom;
+    };
+    // the vertices and triangles one update of the mesh's cached deformation touched,
+    // from the stamps it had before, all of them if the whole mesh was deformed
+    struct Change
+    {
+        unsigned long long vertexFrom;
+        unsigned long long normalFrom;
+        bool allVertices;
+        bool allTriangles;
+        std::vector<uint32_t> vertices;
+        std::vector<uint32_t> triangles;
+    };
+
+    void run();
+    // move the worker's grid to the published positions
+    void applyGrid(const GridSnapshot& snapshot);
+    // deform the mesh by the worker's grid and publish the result as the latest frame
+    void deformFrame();
+    // the vertices (triangles) that changed after the deformation had the given vertex
+    // (normal) stamp, returns false if that is not known or too many to be worth listing
+    bool changedSince(unsigned long long stamp, bool triangles, std::vector<uint32_t>& changed) const;
+    // forget the changes that no frame and no copy of a frame can still be behind
+    void trimChanges();
+
+    Mesh* _mesh;
+    GridBuilder _grid;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _stopping;
+    std::function<void()> _frameCallback;
+
+    // the publishing thread fills _snapshots[_publishSlot] then swaps it with the middle
+    // slot, flagged as fresh, and the worker swaps the middle slot for _snapshots[_readSlot]
+    GridSnapshot _snapshots[3];
+    int _publishSlot;
+    std::atomic<int> _middleSlot;
+    int _readSlot;
+
+    Frame _frames[2];
+    // the latest complete frame and the one being drawn, -1 if none
+    std::atomic<int> _latestFrame;
+    std::atomic<int> _readingFrame;
+    // the stamps of the frame last acquired, which the renderer's copy is at or after
+    std::atomic<unsigned long long> _drawnVertexStamp;
+    std::atomic<unsigned long long> _drawnNormalStamp;
+    // the updates of the cached deformation since the oldest stamp still needed, in order
+    std::vector<Change> _changes;
+    unsigned long long _vertexStamp;
+    unsigned long long _normalStamp;
+};
+
+#endif
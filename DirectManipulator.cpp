@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <cmath>
+
+#include "DirectManipulator.h"
+#include "Parallel.h"
+
+// how much A weighs the change of the grid against the change of the mesh, as a share of
+// the mean weight of a grid point's vertices, enough to keep points no vertex is bound
+// to still and to damp the ripples the mesh alone would leave around a drag
+static const double GRID_STIFFNESS = 0.1;
+// B_c A^-1 B_c^T is made this much heavier on its diagonal, relative to its mean, so
+// that two dragged vertices bound by the same weights can't make it singular
+static const double DRAG_RIDGE = 1e-9;
+// the most grid points a vertex depends on, the control points of a B-spline span,
+// every row of the weight matrix is at most this long
+static const int MAX_ROW = 64;
+// the most entries the lower triangle of A may have within its envelope, 16 MB of doubles
+static const std::size_t MAX_ENVELOPE = 1 << 21;
+// the most copies of the envelope A is summed into at once, each part of the cells
+// having one of its own, so that binding takes a few envelopes however many threads
+static const unsigned int MAX_SUM_PARTS = 4;
+// the distinct products of two of the four weights of a B-spline vertex along an axis
+static const int AXIS_PAIRS = 10;
+
+// where the product of weights i and j along an axis is kept among the AXIS_PAIRS
+static inline int axisPair(int i, int j)
+{
+    int high = std::max(i, j);
+    return high * (high + 1) / 2 + std::min(i, j);
+}
+
+DirectManipulator::DirectManipulator()
+{
+    clear();
+}
+
+void DirectManipulator::clear()
+{
+    _weights = nullptr;
+    _matrix = nullptr;
+    _gridType = Grid::Bilinear;
+    _gridSize = 0;
+    _pointCount = 0;
+    _bindingStamp = 0;
+    _grid = nullptr;
+    _layoutVersion = 0;
+    _first.clear();
+    _rowStart.clear();
+    _factor.clear();
+    _dragged.clear();
+    _columns.clear();
+    _dragFactor.clear();
+}
+
+bool DirectManipulator::isBound() const
+{
+    return _weights != nullptr;
+}
+
+int DirectManipulator::getRow(int vertex, int* points, double* weights) const
+{
+    if (_gridType == Grid::BSpline)
+    {
+        // the product of the basis along x, y and z, in the order of the matrix's rows
+        int layer = _gridSize * _gridSize;
+        std::size_t count = _weights->size();
+        const float* basis = _weights->basis.data() + vertex;
+        for (int corner = 0; corner < 64; corner++)
+        {
+            int x = corner & 3;
+            int y = (corner >> 2) & 3;
+            int z = corner >> 4;
+            points[corner] = _weights->cell[vertex] + x + y * _gridSize + z * layer;
+            weights[corner] = (double)basis[x * count] * basis[(4 + y) * count] * basis[(8 + z) * count];
+        }
+        return 64;
+    }
+    uint32_t first = _matrix->rowStart[vertex];
+    int count = _matrix->rowStart[vertex + 1] - first;
+    for (int entry = 0; entry < count; entry++)
+    {
+        points[entry] = _matrix->columns[first + entry];
+        weights[entry] = _matrix->values[first + entry];
+    }
+    return count;
+}
+
+void DirectManipulator::sumBSplineCell(const uint32_t* vertices, int count, double* local) const
+{
+    // the weight of control point (x, y, z) is bx[x] by[y] bz[z], so the product of two
+    // weights is that of the pairs along each axis, of which there are only
+    // AXIS_PAIRS^3 rather than the 64 * 65 / 2 pairs of weights
+    std::size_t streamSize = _weights->size();
+    double sums[AXIS_PAIRS * AXIS_PAIRS * AXIS_PAIRS] = {};
+    for (int entry = 0; entry < count; entry++)
+    {
+        const float* basis = _weights->basis.data() + vertices[entry];
+        double pairs[3][AXIS_PAIRS];
+        for (int axis = 0; axis < 3; axis++)
+            for (int i = 0; i < 4; i++)
+                for (int j = 0; j <= i; j++)
+                    pairs[axis][axisPair(i, j)] = (double)basis[(4 * axis + i) * streamSize] * basis[(4 * axis + j) * streamSize];
+        for (int z = 0; z < AXIS_PAIRS; z++)
+        {
+            for (int y = 0; y < AXIS_PAIRS; y++)
+            {
+                double zy = pairs[2][z] * pairs[1][y];
+                double* row = sums + (z * AXIS_PAIRS + y) * AXIS_PAIRS;
+                for (int x = 0; x < AXIS_PAIRS; x++)
+                    row[x] += zy * pairs[0][x];
+            }
+        }
+    }
+
+    // then spread to the lower triangle of the cell's 64 control points, in getRow's order
+    for (int a = 0; a < 64; a++)
+    {
+        for (int b = 0; b <= a; b++)
+        {
+            int x = axisPair(a & 3, b & 3);
+            int y = axisPair((a >> 2) & 3, (b >> 2) & 3);
+            int z = axisPair(a >> 4, b >> 4);
+            local[a * MAX_ROW + b] = sums[(z * AXIS_PAIRS + y) * AXIS_PAIRS + x];
+        }
+    }
+}
+
+bool DirectManipulator::bind(Mesh& mesh, GridBuilder& gridBuilder)
+{
+    if (_weights == &mesh.getWeights() && _bindingStamp == mesh.getBindingStamp()
+        && _grid == &gridBuilder && _layoutVersion == gridBuilder.getLayoutVersion())
+        return true;
+    clear();
+    _weights = &mesh.getWeights();
+    _gridType = gridBuilder._gridType;
+    _gridSize = gridBuilder._gridSize;
+    // a B-spline row is 64 entries, the matrix would be eight times the binding,
+    // so its rows are worked out from the basis as they are needed
+    if (_gridType != Grid::BSpline)
+        _matrix = &mesh.getWeightMatrix(&gridBuilder);
+    _pointCount = gridBuilder._grid.size();
+    _bindingStamp = mesh.getBindingStamp();
+    _grid = &gridBuilder;
+    _layoutVersion = gridBuilder.getLayoutVersion();
+
+    // the envelope: every row starts at the lowest point sharing a vertex with it
+    std::size_t vertexCount = _weights->size();
+    _first.resize(_pointCount);
+    for (std::size_t point = 0; point < _pointCount; point++)
+        _first[point] = point;
+    int points[MAX_ROW];
+    double weights[MAX_ROW];
+    for (std::size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        int count = getRow(vertex, points, weights);
+        int lowest = *std::min_element(points, points + count);
+        for (int entry = 0; entry < count; entry++)
+            _first[points[entry]] = std::min(_first[points[entry]], lowest);
+    }
+    _rowStart.resize(_pointCount + 1);
+    _rowStart[0] = 0;
+    for (std::size_t point = 0; point < _pointCount; point++)
+        _rowStart[point + 1] = _rowStart[point] + (point - _first[point] + 1);
+    // a fine lattice's envelope reaches back a whole layer of points from every row, too
+    // large to sum and factor while the user waits
+    if (_rowStart[_pointCount] > MAX_ENVELOPE)
+    {
+        clear();
+        return false;
+    }
+
+    // the vertices of every cell together, as they all depend on the same points
+    int cells = 0;
+    for (std::size_t vertex = 0; vertex < vertexCount; vertex++)
+        cells = std::max(cells, _weights->cell[vertex] + 1);
+    std::vector<uint32_t> cellStart(cells + 1, 0);
+    for (std::size_t vertex = 0; vertex < vertexCount; vertex++)
+        cellStart[_weights->cell[vertex] + 1]++;
+    for (int cell = 0; cell < cells; cell++)
+        cellStart[cell + 1] += cellStart[cell];
+    std::vector<uint32_t> cellVertices(vertexCount);
+    std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+    for (std::size_t vertex = 0; vertex < vertexCount; vertex++)
+        cellVertices[next[_weights->cell[vertex]]++] = vertex;
+
+    // sum B^T B a cell at a time into a small dense matrix, which then goes into the envelope
+    // once, each of a few parts of the cells summing into a copy of its own, the copies then added up
+    unsigned int parts = std::min(std::max(1u, threadCount()), MAX_SUM_PARTS);
+    std::vector<std::vector<double>> sums(parts);
+    parallelFor(parts, [&](std::size_t begin, std::size_t end)
+    {
+        int rowPoints[MAX_ROW];
+        double rowWeights[MAX_ROW];
+        std::vector<double> local(MAX_ROW * MAX_ROW);
+        for (std::size_t part = begin; part < end; part++)
+        {
+            std::vector<double>& sum = sums[part];
+            sum.assign(_rowStart[_pointCount], 0.0);
+            for (std::size_t cell = cells * part / parts; cell < cells * (part + 1) / parts; cell++)
+            {
+                if (cellStart[cell] == cellStart[cell + 1])
+                    continue;
+                int count = getRow(cellVertices[cellStart[cell]], rowPoints, rowWeights);
+                if (_gridType == Grid::BSpline)
+                    sumBSplineCell(cellVertices.data() + cellStart[cell], cellStart[cell + 1] - cellStart[cell], local.data());
+                else
+                {
+                    std::fill(local.begin(), local.end(), 0.0);
+                    for (uint32_t entry = cellStart[cell]; entry < cellStart[cell + 1]; entry++)
+                    {
+                        getRow(cellVertices[entry], rowPoints, rowWeights);
+                        for (int a = 0; a < count; a++)
+                        {
+                            double* localRow = local.data() + a * MAX_ROW;
+                            for (int b = 0; b <= a; b++)
+                                localRow[b] += rowWeights[a] * rowWeights[b];
+                        }
+                    }
+                }
+                // the points of a triangle need not be in order, so each entry goes below the diagonal
+                for (int a = 0; a < count; a++)
+                {
+                    for (int b = 0; b <= a; b++)
+                    {
+                        int high = std::max(rowPoints[a], rowPoints[b]);
+                        int low = std::min(rowPoints[a], rowPoints[b]);
+                        sum[_rowStart[high] + low - _first[high]] += local[a * MAX_ROW + b];
+                    }
+                }
+            }
+        }
+    });
+    _factor.assign(_rowStart[_pointCount], 0.0);
+    for (unsigned int part = 0; part < parts; part++)
+        for (std::size_t entry = 0; entry < _factor.size(); entry++)
+            _factor[entry] += sums[part][entry];
+
+    double diagonal = 0.0;
+    for (std::size_t point = 0; point < _pointCount; point++)
+        diagonal += _factor[_rowStart[point + 1] - 1];
+    double stiffness = GRID_STIFFNESS * std::max(diagonal / _pointCount, 1e-12);
+    for (std::size_t point = 0; point < _pointCount; point++)
+        _factor[_rowStart[point + 1] - 1] += stiffness;
+
+    // Cholesky factor in place, row by row, a row only reaching back to its first column
+    for (std::size_t row = 0; row < _pointCount; row++)
+    {
+        double* rowEntries = _factor.data() + _rowStart[row] - _first[row];
+        for (std::size_t column = _first[row]; column <= row; column++)
+        {
+            const double* columnEntries = _factor.data() + _rowStart[column] - _first[column];
+            std::size_t from = std::max(_first[row], _first[column]);
+            double sum = rowEntries[column];
+            for (std::size_t k = from; k < column; k++)
+                sum -= rowEntries[k] * columnEntries[k];
+            if (column < row)
+                rowEntries[column] = sum / columnEntries[column];
+            else
+                rowEntries[row] = std::sqrt(sum);
+        }
+    }
+    return true;
+}
+
+void DirectManipulator::solveFactor(std::vector<double>& x) const
+{
+    // L y = x forward along the rows, then L^T x = y back, going down the columns of L^T
+    for (std::size_t row = 0; row < _pointCount; row++)
+    {
+        const double* rowEntries = _factor.data() + _rowStart[row] - _first[row];
+        double sum = x[row];
+        for (std::size_t k = _first[row]; k < row; k++)
+            sum -= rowEntries[k] * x[k];
+        x[row] = sum / rowEntries[row];
+    }
+    for (std::size_t row = _pointCount; row-- > 0;)
+    {
+        const double* rowEntries = _factor.data() + _rowStart[row] - _first[row];
+        x[row] /= rowEntries[row];
+        for (std::size_t k = _first[row]; k < row; k++)
+            x[k] -= rowEntries[k] * x[row];
+    }
+}
+
+void DirectManipulator::beginDrag(const std::vector<int>& vertices)
+{
+    _dragged = vertices;
+    std::size_t dragged = _dragged.size();
+    _columns.assign(dragged * _pointCount, 0.0);
+    _dragFactor.assign(dragged * dragged, 0.0);
+    if (!isBound() || dragged == 0)
+        return;
+
+    // a column of A^-1 B_c^T per dragged vertex, each solved on its own
+    parallelFor(dragged, [&](std::size_t begin, std::size_t end)
+    {
+        int points[MAX_ROW];
+        double weights[MAX_ROW];
+        std::vector<double> column(_pointCount);
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            std::fill(column.begin(), column.end(), 0.0);
+            int count = getRow(_dragged[vertex], points, weights);
+            for (int entry = 0; entry < count; entry++)
+                column[points[entry]] += weights[entry];
+            solveFactor(column);
+            std::copy(column.begin(), column.end(), _columns.begin() + vertex * _pointCount);
+        }
+    });
+
+    // B_c A^-1 B_c^T, then its Cholesky factor, dense
+    int points[MAX_ROW];
+    double weights[MAX_ROW];
+    double trace = 0.0;
+    for (std::size_t a = 0; a < dragged; a++)
+    {
+        int count = getRow(_dragged[a], points, weights);
+        for (std::size_t b = 0; b <= a; b++)
+        {
+            const double* column = _columns.data() + b * _pointCount;
+            double sum = 0.0;
+            for (int entry = 0; entry < count; entry++)
+                sum += weights[entry] * column[points[entry]];
+            _dragFactor[a * dragged + b] = sum;
+        }
+        trace += _dragFactor[a * dragged + a];
+    }
+    double ridge = DRAG_RIDGE * trace / dragged;
+    for (std::size_t a = 0; a < dragged; a++)
+    {
+        _dragFactor[a * dragged + a] += ridge;
+        for (std::size_t b = 0; b <= a; b++)
+        {
+            double sum = _dragFactor[a * dragged + b];
+            for (std::size_t k = 0; k < b; k++)
+                sum -= _dragFactor[a * dragged + k] * _dragFactor[b * dragged + k];
+            _dragFactor[a * dragged + b] = a == b ? std::sqrt(sum) : sum / _dragFactor[b * dragged + b];
+        }
+    }
+}
+
+int DirectManipulator::getDraggedCount() const
+{
+    return _dragged.size();
+}
+
+void DirectManipulator::solveDrag(const std::vector<Vector>& offsets, std::vector<Vector>& gridOffsets) const
+{
+    gridOffsets.assign(_pointCount, Vector(0.0, 0.0, 0.0));
+    std::size_t dragged = _dragged.size();
+    if (dragged == 0)
+        return;
+
+    // the multiple of every column the offsets take, for x, y and z at once
+    std::vector<double> y(3 * dragged);
+    for (std::size_t a = 0; a < dragged; a++)
+    {
+        double sum[3] = { offsets[a].x, offsets[a].y, offsets[a].z };
+        for (std::size_t k = 0; k < a; k++)
+            for (int axis = 0; axis < 3; axis++)
+                sum[axis] -= _dragFactor[a * dragged + k] * y[3 * k + axis];
+        for (int axis = 0; axis < 3; axis++)
+            y[3 * a + axis] = sum[axis] / _dragFactor[a * dragged + a];
+    }
+    for (std::size_t a = dragged; a-- > 0;)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            y[3 * a + axis] /= _dragFactor[a * dragged + a];
+        for (std::size_t k = 0; k < a; k++)
+            for (int axis = 0; axis < 3; axis++)
+                y[3 * k + axis] -= _dragFactor[a * dragged + k] * y[3 * a + axis];
+    }
+
+    for (std::size_t point = 0; point < _pointCount; point++)
+    {
+        double sum[3] = { 0.0, 0.0, 0.0 };
+        for (std::size_t a = 0; a < dragged; a++)
+        {
+            double weight = _columns[a * _pointCount + point];
+            for (int axis = 0; axis < 3; axis++)
+                sum[axis] += weight * y[3 * a + axis];
+        }
+        gridOffsets[point] = Vector(sum[0], sum[1], sum[2]);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef _DIRECT_MANIPULATOR_H
+#define _DIRECT_MANIPULATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+#include "GridBuilder.h"
+#include "Mesh.h"
+
+// Moves the grid so that mesh vertices dragged by the user follow the mouse.
+// The binding deforms the mesh as d = B g, B a sparse matrix with a row of at most
+// 64 weights per vertex, so a drag of vertices c by offsets t moves the grid by
+//   dg = A^-1 B_c^T (B_c A^-1 B_c^T)^-1 t,   A = B^T B + stiffness * I
+// which puts the dragged vertices exactly where they are dragged to while changing
+// the rest of the mesh, and a little the grid itself, as little as can be in the least
+// squares sense. A is factored once per binding, each drag solves it once for every
+// dragged vertex, and every move of the mouse after that only takes the small system
+// of the dragged vertices, however large the mesh.
+class DirectManipulator
+{
+    public:
+
+    DirectManipulator();
+
+    // build and factor A for mesh's binding to gridBuilder's grid, which is
+    // left alone if it was already done for this binding and grid layout, false
+    // if the grid is too fine for A to be factored quickly
+    bool bind(Mesh& mesh, GridBuilder& gridBuilder);
+    void clear();
+    bool isBound() const;
+
+    // start dragging the given distinct vertices of the bound mesh
+    void beginDrag(const std::vector<int>& vertices);
+    int getDraggedCount() const;
+    // the move of every grid point that takes dragged vertex k offsets[k] away from
+    // where it was when the drag began
+    void solveDrag(const std::vector<Vector>& offsets, std::vector<Vector>& gridOffsets) const;
+
+    private:
+    // the grid points vertex depends on and their weights, its row of the weight matrix,
+    // returns how many
+    int getRow(int vertex, int* points, double* weights) const;
+    // the lower triangle of the sum of w w^T over the given vertices of one B-spline
+    // cell, into local by rows of MAX_ROW
+    void sumBSplineCell(const uint32_t* vertices, int count, double* local) const;
+    // solve L L^T x = x in place
+    void solveFactor(std::vector<double>& x) const;
+
+    // the binding, as the mesh keeps it, and the grid layout it is for, the streams
+    // grouping the vertices by cell and the matrix giving their rows
+    const WeightStreams* _weights;
+    const WeightMatrix* _matrix;
+    Grid _gridType;
+    int _gridSize;
+    std::size_t _pointCount;
+    unsigned long long _bindingStamp;
+    const GridBuilder* _grid;
+    unsigned long long _layoutVersion;
+
+    // the lower triangle of A and then its Cholesky factor L by rows, row i holding
+    // columns [_first[i], i] from _rowStart[i], the envelope fill-in stays within
+    std::vector<int> _first;
+    std::vector<std::size_t> _rowStart;
+    std::vector<double> _factor;
+
+    // the dragged vertices, A^-1 B_c^T as one column of _pointCount per vertex, and the
+    // Cholesky factor of B_c A^-1 B_c^T, dense as only a few vertices are dragged at once
+    std::vector<int> _dragged;
+    std::vector<double> _columns;
+    std::vector<double> _dragFactor;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef _FRAME_STATS_H
+#define _FRAME_STATS_H
+
+#include <cstddef>
+#include <vector>
+
+// Times of the last frames drawn: the time from the start of the previous frame,
+// the time spent drawing, and the number of input events handled in one go.
+// Frames drawn after a pause have an interval of 0 and are left out of the interval figures
+class FrameStats
+{
+    public:
+
+    FrameStats(std::size_t capacity = 120) : _frames(capacity), _next(0), _count(0), _total(0) {}
+
+    // record a frame, times are in seconds
+    void addFrame(double interval, double drawTime, int events)
+    {
+        Frame& frame = _frames[_next];
+        frame.interval = interval;
+        frame.drawTime = drawTime;
+        frame.events = events;
+        _next = (_next + 1) % _frames.size();
+        if (_count < _frames.size())
+            _count++;
+        _total++;
+    }
+
+    // frames recorded since the start, and those the averages and maxima are over
+    unsigned long long getTotalFrames() const { return _total; }
+    std::size_t getFrameCount() const { return _count; }
+
+    double getAverageInterval() const { return average(&Frame::interval); }
+    double getMaxInterval() const { return maximum(&Frame::interval); }
+    double getAverageDrawTime() const { return average(&Frame::drawTime); }
+    double getMaxDrawTime() const { return maximum(&Frame::drawTime); }
+    double getAverageEvents() const
+    {
+        double events = 0.0;
+        for (std::size_t frame = 0; frame < _count; frame++)
+            events += _frames[frame].events;
+        return _count > 0 ? events / _count : 0.0;
+    }
+
+    private:
+    struct Frame
+    {
+        double interval;
+        double drawTime;
+        int events;
+    };
+
+    double average(double Frame::*time) const
+    {
+        double sum = 0.0;
+        std::size_t count = 0;
+        for (std::size_t frame = 0; frame < _count; frame++)
+        {
+            if (time == &Frame::interval && _frames[frame].interval <= 0.0)
+                continue;
+            sum += _frames[frame].*time;
+            count++;
+        }
+        return count > 0 ? sum / count : 0.0;
+    }
+    double maximum(double Frame::*time) const
+    {
+        double longest = 0.0;
+        for (std::size_t frame = 0; frame < _count; frame++)
+            if (_frames[frame].*time > longest)
+                longest = _frames[frame].*time;
+        return longest;
+    }
+
+    // ring of the last frames, _next is overwritten next
+    std::vector<Frame> _frames;
+    std::size_t _next;
+    std::size_t _count;
+    unsigned long long _total;
+};
+
+#endif
@@ -1,16 +1,47 @@
-#include <GL/gl.h>
-#include <GL/glu.h>
-
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <random>
+#include <utility>
 #include <chrono>
+#include <cmath>
+#include <math.h>
 
 #include "GridBuilder.h"
+#include "PointTree.h"
 
 #include "delaunator.hpp"
 
+// versions are handed out from one counter so that no two grids share one,
+// 0 is left for results that were never computed
+static std::atomic<unsigned long long> nextGridVersion(1);
+// samples of the falloff curve over the attenuation radius
+static const int FALLOFF_SAMPLES = 256;
+// the most points a grid file may hold, a dense lattice of 512 points a side
+static const uint64_t MAX_GRID_FILE_POINTS = 1ull << 27;
+
+// the points a grid of the given type and size has, 0 if that is more than a grid file may
+// hold, a sparse grid has at most this many
+static uint64_t gridPointCount(Grid gridType, int gridSize)
+{
+    if (gridSize < 2 || (uint64_t)gridSize > MAX_GRID_FILE_POINTS)
+        return 0;
+    uint64_t side = gridSize;
+    uint64_t points = side * side;
+    if (points > MAX_GRID_FILE_POINTS)
+        return 0;
+    if (gridType == Grid::Trilinear || gridType == Grid::BSpline || gridType == Grid::SparseTrilinear)
+        points *= side;
+    return points <= MAX_GRID_FILE_POINTS ? points : 0;
+}
+
 // default constructor
 GridBuilder::GridBuilder()
 {
+    _version = 0;
+    _layoutVersion = 0;
+    _boundsValid = false;
+    _hashLayout = 0;
     _gridSize = 2;
     _gridType = Grid::Bilinear;
     _grid.resize(0.0);
@@ -22,6 +53,10 @@ Grid GridBuilder::getGridType()
 {
     return _gridType;
 }
+bool GridBuilder::isVolumetric() const
+{
+    return _gridType == Grid::Trilinear || _gridType == Grid::BSpline || _gridType == Grid::SparseTrilinear;
+}
 int GridBuilder::getGridSize()
 {
     return _gridSize;
@@ -31,22 +66,143 @@ const Vector& GridBuilder::getGridVertex(int index) const
     return _grid[index];
 }
 
+void GridBuilder::getGridEdges(std::vector<uint32_t>& edges) const
+{
+    edges.clear();
+    uint32_t gridSize = _gridSize;
+    switch (_gridType)
+    {
+    case Grid::Bilinear:
+        // x lines then y lines
+        for (uint32_t row = 0; row < gridSize; row++)
+            for (uint32_t col = 0; col + 1 < gridSize; col++)
+                edges.insert(edges.end(), { row * gridSize + col, row * gridSize + col + 1 });
+        for (uint32_t row = 0; row + 1 < gridSize; row++)
+            for (uint32_t col = 0; col < gridSize; col++)
+                edges.insert(edges.end(), { row * gridSize + col, (row + 1) * gridSize + col });
+        break;
+    case Grid::Barycentric:
+    {
+        // triangles share their inner edges, so each is kept once
+        std::vector<uint64_t> triangleEdges;
+        for (unsigned int triangle = 0; triangle + 2 < _triangles.size(); triangle += 3)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint64_t a = _triangles[triangle + corner];
+                uint64_t b = _triangles[triangle + (corner + 1) % 3];
+                triangleEdges.push_back(std::min(a, b) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(triangleEdges.begin(), triangleEdges.end());
+        triangleEdges.erase(std::unique(triangleEdges.begin(), triangleEdges.end()), triangleEdges.end());
+        for (unsigned int edge = 0; edge < triangleEdges.size(); edge++)
+            edges.insert(edges.end(), { (uint32_t)(triangleEdges[edge] >> 32), (uint32_t)triangleEdges[edge] });
+        break;
+    }
+    case Grid::Trilinear:
+    case Grid::BSpline:
+    {
+        // x, y then z lines
+        uint32_t layer = gridSize * gridSize;
+        for (uint32_t cel = 0; cel < gridSize; cel++)
+            for (uint32_t row = 0; row < gridSize; row++)
+                for (uint32_t col = 0; col + 1 < gridSize; col++)
+                    edges.insert(edges.end(), { cel * layer + row * gridSize + col, cel * layer + row * gridSize + col + 1 });
+        for (uint32_t cel = 0; cel < gridSize; cel++)
+            for (uint32_t row = 0; row + 1 < gridSize; row++)
+                for (uint32_t col = 0; col < gridSize; col++)
+                    edges.insert(edges.end(), { cel * layer + row * gridSize + col, cel * layer + (row + 1) * gridSize + col });
+        for (uint32_t cel = 0; cel + 1 < gridSize; cel++)
+            for (uint32_t row = 0; row < gridSize; row++)
+                for (uint32_t col = 0; col < gridSize; col++)
+                    edges.insert(edges.end(), { cel * layer + row * gridSize + col, (cel + 1) * layer + row * gridSize + col });
+        break;
+    }
+    case Grid::SparseTrilinear:
+        _sparseLattice.getEdges(edges);
+        break;
+    default:
+        break;
+    }
+}
+
 void GridBuilder::setGridVector(int index, Vector vertex)
 {
+    markPointsChanged();
+    Vector previous = _grid[index];
     _grid[index] = vertex;
+    pointMoved(index, previous);
 }
 
 void GridBuilder::setGridSize(int size)
 {
     _gridSize = size;
+    markChanged();
 }
 void GridBuilder::setGridType(Grid gridType)
 {
     _gridType = gridType;
+    markChanged();
+}
+
+unsigned long long GridBuilder::getVersion() const
+{
+    return _version;
+}
+
+unsigned long long GridBuilder::getLayoutVersion() const
+{
+    return _layoutVersion;
+}
+
+bool GridBuilder::getChangedPoints(unsigned long long since, std::vector<int>& points) const
+{
+    points.clear();
+    if (since < _layoutVersion || since > _version)
+        return false;
+    for (int point = 0; point < (int)_pointVersions.size(); point++)
+        if (_pointVersions[point] > since)
+            points.push_back(point);
+    return true;
+}
+
+void GridBuilder::markChanged()
+{
+    _version = nextGridVersion++;
+    _layoutVersion = _version;
+    _boundsValid = false;
+}
+
+void GridBuilder::markPointsChanged()
+{
+    _version = nextGridVersion++;
+    // versions older than the layout are never asked about, so the old ones can stay
+    _pointVersions.resize(_grid.size(), 0);
+}
+
+void GridBuilder::pointMoved(int index, const Vector& previous)
+{
+    if (_boundsValid)
+    {
+        // a point leaving a bound might have been the only one on it, the bounds are found again then
+        if (previous.x == _boundsMin.x || previous.x == _boundsMax.x || previous.y == _boundsMin.y || previous.y == _boundsMax.y)
+            _boundsValid = false;
+        else
+        {
+            _boundsMin.x = std::min(_boundsMin.x, _grid[index].x);
+            _boundsMin.y = std::min(_boundsMin.y, _grid[index].y);
+            _boundsMax.x = std::max(_boundsMax.x, _grid[index].x);
+            _boundsMax.y = std::max(_boundsMax.y, _grid[index].y);
+        }
+    }
+    if (_hashLayout == _layoutVersion)
+        _pointHash.movePoint(index, _grid[index]);
+    _pointVersions[index] = _version;
 }
 
 // generate the current grid
-void GridBuilder::generateGrid(float modelSize)
+void GridBuilder::generateGrid(float modelSize, const Vector* vertices, std::size_t count)
 {
     switch (_gridType)
     {
@@ -62,111 +218,292 @@ void GridBuilder::generateGrid(float modelSize)
             // generate triangular mesh
             generateRegular3DGrid(modelSize);
             break;
+        case Grid::BSpline:
+            generateBSplineGrid(modelSize);
+            break;
+        case Grid::SparseTrilinear:
+            generateSparseGrid(modelSize, vertices, count);
+            break;
         default:
             break;
     }
+    // keep a copy of the undeformed grid for saving
+    _restGrid = _grid;
+    markChanged();
 }
 
-// draw the current grid
-void GridBuilder::drawGrid()
+// save the grid as its type and size followed by each vertex's rest and deformed position
+bool GridBuilder::saveGrid(std::string fileName, float modelSize)
 {
-    switch (_gridType)
+    std::ofstream gridFile;
+    gridFile.open(fileName, std::ofstream::trunc);
+    if (!gridFile.is_open())
+        return false;
+
+    // grid type and size
+    gridFile << static_cast<int>(_gridType) << " " << _gridSize << "\n";
+    // number of grid vertices
+    gridFile << _grid.size() << "\n";
+    // each vertex as rest then deformed position, scaled to a unit model
+    for (unsigned int vertex = 0; vertex < _grid.size(); vertex++)
     {
-    case Grid::Bilinear:
-        draw2DGrid();
-        break;
-    case Grid::Barycentric:
-        drawTriangularGrid();
-        break;
-    case Grid::Trilinear:
-        draw3DGrid();
-        break;
-    default:
-        break;
+        Vector rest = _restGrid[vertex] / modelSize;
+        Vector deformed = _grid[vertex] / modelSize;
+        gridFile << rest.x << " " << rest.y << " " << rest.z << " "
+            << deformed.x << " " << deformed.y << " " << deformed.z << "\n";
+    }
+    gridFile.close();
+
+    return !gridFile.fail();
+}
+
+// load a grid file, scaling it to the model it will be applied to
+bool GridBuilder::loadGrid(std::string fileName, float modelSize, std::vector<Vector>& deformedGrid)
+{
+    std::ifstream gridFile(fileName);
+    if (!gridFile.is_open())
+        return false;
+
+    int gridType = 0, gridSize = 0;
+    unsigned int nVertices = 0;
+    gridFile >> gridType >> gridSize >> nVertices;
+    if (gridFile.fail() || gridType < 0 || gridType > static_cast<int>(Grid::SparseTrilinear) || gridSize < 2)
+        return false;
+    if (static_cast<Grid>(gridType) == Grid::BSpline && gridSize < MIN_BSPLINE_SIZE)
+        return false;
+    // the deformation indexes the grid by its size, so the file must have every point of it,
+    // a sparse grid any number of them up to that
+    uint64_t gridPoints = gridPointCount(static_cast<Grid>(gridType), gridSize);
+    if (gridPoints == 0 || nVertices > gridPoints)
+        return false;
+    if (static_cast<Grid>(gridType) != Grid::SparseTrilinear && nVertices != gridPoints)
+        return false;
+
+    std::vector<Vector> restGrid(nVertices);
+    deformedGrid.resize(nVertices);
+    for (unsigned int vertex = 0; vertex < nVertices; vertex++)
+    {
+        gridFile >> restGrid[vertex].x >> restGrid[vertex].y >> restGrid[vertex].z
+            >> deformedGrid[vertex].x >> deformedGrid[vertex].y >> deformedGrid[vertex].z;
+        if (gridFile.fail())
+            return false;
+        if (!std::isfinite(restGrid[vertex].x) || !std::isfinite(restGrid[vertex].y) || !std::isfinite(restGrid[vertex].z)
+            || !std::isfinite(deformedGrid[vertex].x) || !std::isfinite(deformedGrid[vertex].y) || !std::isfinite(deformedGrid[vertex].z))
+            return false;
+        restGrid[vertex] = restGrid[vertex] * modelSize;
+        deformedGrid[vertex] = deformedGrid[vertex] * modelSize;
     }
+    // the cells of a sparse grid are found again from where its points rest
+    SparseLattice sparseLattice;
+    if (static_cast<Grid>(gridType) == Grid::SparseTrilinear && !sparseLattice.rebuild(gridSize, modelSize, restGrid))
+        return false;
+
+    _gridType = static_cast<Grid>(gridType);
+    _gridSize = gridSize;
+    _grid = restGrid;
+    _restGrid = restGrid;
+    // the triangulation is rebuilt from the rest positions
+    if (_gridType == Grid::Barycentric)
+        triangulateGrid();
+    if (_gridType == Grid::SparseTrilinear)
+        _sparseLattice = std::move(sparseLattice);
+    markChanged();
+
+    return true;
 }
 
-void GridBuilder::moveVertex(Vector move, int index, bool attenuation, int attenuationScale)
+// move every grid vertex to its new position, going through shiftPoint keeps the triangulation in sync
+void GridBuilder::setGrid(std::vector<Vector>& grid)
 {
+    // the vertices that move take one new version, so that only their vertices are deformed again
+    markPointsChanged();
+    for (unsigned int vertex = 0; vertex < _grid.size() && vertex < grid.size(); vertex++)
+    {
+        if (grid[vertex].x != _grid[vertex].x || grid[vertex].y != _grid[vertex].y || grid[vertex].z != _grid[vertex].z)
+            shiftPoint(grid[vertex] - _grid[vertex], vertex);
+    }
+}
+
+void GridBuilder::setGridPoints(const std::vector<int>& points, const std::vector<Vector>& positions)
+{
+    markPointsChanged();
+    for (std::size_t point = 0; point < points.size(); point++)
+    {
+        int index = points[point];
+        Vector previous = _grid[index];
+        _grid[index] = positions[point];
+        pointMoved(index, previous);
+    }
+}
+
+void GridBuilder::moveVertex(Vector move, int index, bool attenuation, int attenuationScale, float attenuationRadius)
+{
+    // within a radius a single vertex is weighed the same way as a selection of them
+    if (attenuation && attenuationRadius > 0.0)
+    {
+        moveVertices(move, std::vector<int>(1, index), attenuation, attenuationScale, attenuationRadius);
+        return;
+    }
+
+    // every vertex the drag moves takes the same new version
+    markPointsChanged();
     if (attenuation)
     {
-        Vector min = Vector(0.0, 0.0, 0.0);
-        Vector max = Vector(0.0, 0.0, 0.0);
-        // loop over each vertex and build two vectors representing the largest and smallest x and y values currently in the grid
-        for(unsigned int vertex = 0; vertex < _grid.size(); vertex++)
-        {
-            if(_grid[vertex].x < min.x)
-                min.x = _grid[vertex].x;
-            if(_grid[vertex].y < min.y)
-                min.y = _grid[vertex].y;
-            if(_grid[vertex].x > max.x)
-                max.x = _grid[vertex].x;
-            if(_grid[vertex].y > max.y)
-                max.y = _grid[vertex].y;
-        }
-        float maxDistance = (min - max).magnitude();
+        float maxDistance = getAttenuationDistance();
         for(int vertex = 0; vertex < (int)_grid.size(); vertex++)
         {
             if( vertex != index )
             {
-                // calculate new weight for given vertex
+                // calculate new weight for given vertex, squared by hand rather than through pow
                 // max attenuation slider value is 5.0
-                float weight = pow(1.0 - ((_grid[index] - _grid[vertex]).magnitude() / maxDistance ), 2.0 ) * ((float)attenuationScale / 5.0);
-                // now update the vertex
-                updateGrid(move * weight, vertex);
+                double falloff = 1.0 - ((_grid[index] - _grid[vertex]).magnitude() / maxDistance );
+                float weight = falloff * falloff * ((float)attenuationScale / 5.0);
+                // now update the vertex, those that don't move are left with their version
+                if (weight != 0.0)
+                    shiftPoint(move * weight, vertex);
             }
             else
             {
             // directly move grid vertex
-            updateGrid(move, vertex);
+            shiftPoint(move, vertex);
             }            
         }
     }
     else
     {
-        updateGrid(move, index);
+        shiftPoint(move, index);
         
     }
 }
 
-// update the triangulation mesh for a given vertex
-void GridBuilder::updateGrid(Vector move, int index)
+void GridBuilder::moveVertices(Vector move, const std::vector<int>& indices, bool attenuation, int attenuationScale, float attenuationRadius)
 {
-    switch (_gridType)
+    // every vertex the drag moves takes the same new version
+    markPointsChanged();
+    std::vector<int> selection(indices);
+    std::sort(selection.begin(), selection.end());
+    selection.erase(std::unique(selection.begin(), selection.end()), selection.end());
+    if (!attenuation || selection.empty())
+    {
+        for (unsigned int selected = 0; selected < selection.size(); selected++)
+            shiftPoint(move, selection[selected]);
+        return;
+    }
+
+    // the other vertices follow by their distance to the nearest selected one
+    std::vector<Vector> selectedPoints(selection.size());
+    for (unsigned int selected = 0; selected < selection.size(); selected++)
+        selectedPoints[selected] = _grid[selection[selected]];
+    PointTree selectionTree;
+    selectionTree.build(selectedPoints);
+
+    // the vertices that may follow: those in the hash cells around the selected ones, or else every vertex
+    std::vector<int> followers;
+    float maxDistance = 0.0;
+    if (attenuationRadius > 0.0)
+    {
+        // the points are hashed in cells of the radius, so only the cells around the selection are looked in
+        if (_hashLayout != _layoutVersion || _pointHash.getCellSize() != attenuationRadius)
         {
-        case Grid::Bilinear:
-            // directly move grid vertex
-            _grid[index].x += move.x;
-            _grid[index].y += move.y;
-            _grid[index].z += move.z;
-            break;
+            _pointHash.build(_grid, attenuationRadius);
+            _hashLayout = _layoutVersion;
+        }
+        _pointHash.findPointsNear(selection, attenuationRadius, followers);
+    }
+    else
+    {
+        maxDistance = getAttenuationDistance();
+        followers.resize(_grid.size());
+        for (unsigned int vertex = 0; vertex < _grid.size(); vertex++)
+            followers[vertex] = vertex;
+    }
 
-        case Grid::Barycentric:
-            // find all occurences of the vertex in the triangulation mesh for when rendering the mesh
-            for(unsigned int i = 0; i < _triangulationMesh.size(); i++)
-            {
-                if((_triangulationMesh[i].x == _grid[index].x) && (_triangulationMesh[i].y == _grid[index].y))
-                {
-                    _triangulationMesh[i].x += move.x;
-                    _triangulationMesh[i].y += move.y;
-                    _triangulationMesh[i].z += move.z;
-                }
-            }
-            // update the _grid vertex
-            _grid[index].x += move.x;
-            _grid[index].y += move.y;
-            _grid[index].z += move.z;
-            break;
-        case Grid::Trilinear:
-            // directly move grid vertex
-            _grid[index].x += move.x;
-            _grid[index].y += move.y;
-            _grid[index].z += move.z;
-            break;
-        
-        default:
-            break;
+    // weigh every follower once, before anything moves
+    std::vector<float> weights(followers.size(), 0.0f);
+    for (unsigned int follower = 0; follower < followers.size(); follower++)
+    {
+        int vertex = followers[follower];
+        if (std::binary_search(selection.begin(), selection.end(), vertex))
+            continue;
+        float distance = 0.0;
+        selectionTree.findNearest(_grid[vertex], distance);
+        // the cells around the selection also hold vertices just out of the radius, which don't move
+        if (attenuationRadius > 0.0)
+            weights[follower] = getFalloff(distance / attenuationRadius) * ((float)attenuationScale / 5.0);
+        else
+        {
+            double falloff = 1.0 - (distance / maxDistance);
+            weights[follower] = falloff * falloff * ((float)attenuationScale / 5.0);
         }
+    }
+    for (unsigned int follower = 0; follower < followers.size(); follower++)
+    {
+        if (weights[follower] != 0.0f)
+            shiftPoint(move * weights[follower], followers[follower]);
+    }
+    for (unsigned int selected = 0; selected < selection.size(); selected++)
+        shiftPoint(move, selection[selected]);
+}
+
+float GridBuilder::getAttenuationDistance()
+{
+    // the largest and smallest x and y values currently in the grid, only looked for again
+    // when a vertex on them moved
+    if (!_boundsValid)
+    {
+        _boundsMin = Vector(0.0, 0.0, 0.0);
+        _boundsMax = Vector(0.0, 0.0, 0.0);
+        for(unsigned int vertex = 0; vertex < _grid.size(); vertex++)
+        {
+            if(_grid[vertex].x < _boundsMin.x)
+                _boundsMin.x = _grid[vertex].x;
+            if(_grid[vertex].y < _boundsMin.y)
+                _boundsMin.y = _grid[vertex].y;
+            if(_grid[vertex].x > _boundsMax.x)
+                _boundsMax.x = _grid[vertex].x;
+            if(_grid[vertex].y > _boundsMax.y)
+                _boundsMax.y = _grid[vertex].y;
+        }
+        _boundsValid = true;
+    }
+    Vector min = _boundsMin;
+    return (min - _boundsMax).magnitude();
+}
+
+float GridBuilder::getFalloff(float distance)
+{
+    // (1 - d^2)^3 sampled once, it is smooth and flat at both ends so the vertices
+    // at the edge of the radius start moving gently
+    static const std::vector<float> table = []()
+    {
+        std::vector<float> samples(FALLOFF_SAMPLES + 1);
+        for (int sample = 0; sample <= FALLOFF_SAMPLES; sample++)
+        {
+            double d = (double)sample / FALLOFF_SAMPLES;
+            samples[sample] = (float)((1.0 - d * d) * (1.0 - d * d) * (1.0 - d * d));
+        }
+        return samples;
+    }();
+    if (!(distance < 1.0f))
+        return 0.0;
+    float position = std::max(distance, 0.0f) * FALLOFF_SAMPLES;
+    int sample = (int)position;
+    float fraction = position - sample;
+    return table[sample] + (table[sample + 1] - table[sample]) * fraction;
+}
+
+void GridBuilder::updateGrid(Vector move, int index)
+{
+    markPointsChanged();
+    shiftPoint(move, index);
+}
+
+// move a grid vertex, the barycentric triangulation refers to its vertices by index so it follows
+void GridBuilder::shiftPoint(Vector move, int index)
+{
+    Vector previous = _grid[index];
+    _grid[index] = _grid[index] + move;
+    pointMoved(index, previous);
 }
 //
 // Bilinear 
@@ -190,35 +527,6 @@ void GridBuilder::generateRegular2DGrid(float modelSize)
     }
 }
 
-// draw a regular 2D grid
-void GridBuilder::draw2DGrid()
-{
-    // draw all x lines
-    // y loop
-    glBegin(GL_LINES);
-    for(int row = 0; row < _gridSize; row++)
-    {   
-        // x loop
-        for(int col = 0; col < _gridSize - 1; col++)
-        {
-            glVertex3f(_grid[row * _gridSize + col    ].x, _grid[row * _gridSize + col    ].y, _grid[row * _gridSize + col    ].z);
-            glVertex3f(_grid[row * _gridSize + col + 1].x, _grid[row * _gridSize + col + 1].y, _grid[row * _gridSize + col + 1].z);
-        }
-    }
-    // draw all y lines
-    // y loop
-    for(int row = 0; row < _gridSize - 1; row++)
-    {   
-        // x loop
-        for(int col = 0; col < _gridSize; col++)
-        {
-            glVertex3f(_grid[row       * _gridSize + col].x, _grid[row       * _gridSize + col].y, _grid[row       * _gridSize + col].z);
-            glVertex3f(_grid[(row + 1) * _gridSize + col].x, _grid[(row + 1) * _gridSize + col].y, _grid[(row + 1) * _gridSize + col].z);
-        }
-    }
-    glEnd();
-}
-
 //
 // Barycentric
 //
@@ -226,23 +534,10 @@ void GridBuilder::draw2DGrid()
 // generate a triangular mesh using delaunay triangulation
 void GridBuilder::generateTriangularGrid(float modelSize)
 {
-    // a list of doubles representing 2D positions for the delaunay triangulator
-    std::vector<double> vertices;
-
     // set the number of points to generate
     _grid.resize(_gridSize * _gridSize);
-    vertices.resize(_gridSize * _gridSize * 2);
 
     // intialise the triangulation corner vertices
-    vertices[0] = -modelSize/2.0;
-    vertices[1] = modelSize/2.0;
-    vertices[2] = modelSize/2.0;
-    vertices[3] = modelSize/2.0;
-    vertices[4] = modelSize/2.0;
-    vertices[5] = -modelSize/2.0;
-    vertices[6] = -modelSize/2.0;
-    vertices[7] = -modelSize/2.0;
-    // also initialise _grid for mouse input
     _grid[0] = Vector(-modelSize/2.0, modelSize/2.0, 0.0);
     _grid[1] = Vector(modelSize/2.0, modelSize/2.0, 0.0);
     _grid[2] = Vector(modelSize/2.0, -modelSize/2.0, 0.0);
@@ -255,37 +550,31 @@ void GridBuilder::generateTriangularGrid(float modelSize)
     // generate a random coordinate within the grid described by the four previous positions
     for (unsigned int i = 4; i < _grid.size(); i++)
     {
-        vertices[i * 2] = distrib(generator);
-        vertices[i * 2 + 1] = distrib(generator);
-        _grid[i] = Vector(vertices[i * 2], vertices[i * 2 + 1], 0.0);        
+        float x = distrib(generator);
+        float y = distrib(generator);
+        _grid[i] = Vector(x, y, 0.0);
     }
 
-    //triangulation happens here
-    delaunator::Delaunator d(vertices);
-
-    // resize triangles vector to accomodate triangulation vertices
-    _triangulationMesh.resize(d.triangles.size());
-    // loop over to copy into _grid vertices
-    for (unsigned int i = 0; i < d.triangles.size(); i+=3)
-    {
-        // triangle points
-        _triangulationMesh[i    ] = Vector( d.coords[2 * d.triangles[i]], d.coords[2 * d.triangles[i] + 1], 0.0);
-        _triangulationMesh[i + 1] = Vector( d.coords[2 * d.triangles[i + 1]], d.coords[2 * d.triangles[i + 1] + 1], 0.0);
-        _triangulationMesh[i + 2] = Vector( d.coords[2 * d.triangles[i + 2]], d.coords[2 * d.triangles[i + 2] + 1], 0.0);        
-    }
+    triangulateGrid();
 }
 
-// draw triangular mesh
-void GridBuilder::drawTriangularGrid()
+// triangulate the current _grid vertices
+void GridBuilder::triangulateGrid()
 {
-    glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-    glBegin(GL_TRIANGLES);
-    for (unsigned int i = 0; i < _triangulationMesh.size(); i++)
+    // a list of doubles representing 2D positions for the delaunay triangulator
+    std::vector<double> vertices(_grid.size() * 2);
+    for (unsigned int i = 0; i < _grid.size(); i++)
     {
-        Vector* v = &(_triangulationMesh[i]);
-        glVertex3fv(&v->x);        
+        vertices[i * 2] = _grid[i].x;
+        vertices[i * 2 + 1] = _grid[i].y;
     }
-    glEnd();
+
+    //triangulation happens here
+    delaunator::Delaunator d(vertices);
+
+    // keep the triangles as indices into _grid
+    _triangles.assign(d.triangles.begin(), d.triangles.end());
+    _triangleLocator.build(_grid, _triangles);
 }
 
 //
@@ -315,61 +604,43 @@ void GridBuilder::generateRegular3DGrid(float modelSize)
     }
 }
 
-// draw a regular 3D grid
-void GridBuilder::draw3DGrid()
+//
+// B-spline
+//
+
+// a regular 3D lattice like the trilinear one, with one more layer of control points
+// outside the model on every side
+void GridBuilder::generateBSplineGrid(float modelSize)
 {
-    // draw all x lines
-    // y loop
-    glBegin(GL_LINES);
-    for(int cel = 0; cel < _gridSize; cel++)
-    {
-        for(int row = 0; row < _gridSize; row++)
-        {   
-            // x loop
-            for(int col = 0; col < _gridSize - 1; col++)
-            {
-                glVertex3f( _grid[cel*_gridSize*_gridSize + row*_gridSize + col].x, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + col].y, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + col].z);
-                glVertex3f( _grid[cel*_gridSize*_gridSize + row*_gridSize + (col+1)].x, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + (col+1)].y, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + (col+1)].z);
-            }
-        }
-    }
-    // draw all y lines
-    // y loop
+    if (_gridSize < MIN_BSPLINE_SIZE)
+        _gridSize = MIN_BSPLINE_SIZE;
+    _grid.resize(_gridSize * _gridSize * _gridSize);
+    float spacing = modelSize / (float)(_gridSize - 3);
+    // start a spacing beyond the far top left corner of the model
+    Vector startPos = Vector(-modelSize/2.0 - spacing, modelSize/2.0 + spacing, -modelSize/2.0 - spacing);
     for(int cel = 0; cel < _gridSize; cel++)
-    {
-        for(int row = 0; row < _gridSize - 1; row++)
-        {   
-            // x loop
-            for(int col = 0; col < _gridSize; col++)
-            {
-                glVertex3f( _grid[cel*_gridSize*_gridSize + row*_gridSize + col].x, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + col].y, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + col].z);
-                glVertex3f( _grid[cel*_gridSize*_gridSize + (row+1)*_gridSize + col].x, 
-                                _grid[cel*_gridSize*_gridSize + (row+1)*_gridSize + col].y, 
-                                _grid[cel*_gridSize*_gridSize + (row+1)*_gridSize + col].z);
-            }
-        }
-    }
-    // draw all z lines
-    for(int cel = 0; cel < _gridSize - 1; cel++)
     {
         for(int row = 0; row < _gridSize; row++)
         {
             for(int col = 0; col < _gridSize; col++)
             {
-                glVertex3f( _grid[cel*_gridSize*_gridSize + row*_gridSize + col].x, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + col].y, 
-                                _grid[cel*_gridSize*_gridSize + row*_gridSize + col].z);
-                glVertex3f( _grid[(cel+1)*_gridSize*_gridSize + row*_gridSize + col].x, 
-                                _grid[(cel+1)*_gridSize*_gridSize + row*_gridSize + col].y, 
-                                _grid[(cel+1)*_gridSize*_gridSize + row*_gridSize + col].z);
+                _grid[cel*_gridSize*_gridSize + row*_gridSize + col] = startPos +
+                    Vector(col * spacing, row * -spacing, cel * spacing);
             }
         }
     }
-    glEnd();
-}
\ No newline at end of file
+}
+
+//
+// Sparse trilinear
+//
+
+// the trilinear lattice's points around the vertices, in the same places as in the dense one
+void GridBuilder::generateSparseGrid(float modelSize, const Vector* vertices, std::size_t count)
+{
+    // without vertices every cell is built, as many points as the dense lattice
+    int maxSize = count == 0 ? MAX_FULL_SPARSE_SIZE : MAX_SPARSE_SIZE;
+    if (_gridSize > maxSize)
+        _gridSize = maxSize;
+    _sparseLattice.build(_gridSize, modelSize, vertices, count, _grid);
+}
@@ -1,55 +1,129 @@
 #ifndef _DEFORM_H
 #define _DEFORM_H
 
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "Vector.h"
+#include "PointHash.h"
+#include "SparseLattice.h"
+#include "TriangleLocator.h"
 
 enum struct Grid 
 {
-    Bilinear, Barycentric, Trilinear
+    Bilinear, Barycentric, Trilinear, BSpline, SparseTrilinear
 };
 
+// a cubic span needs four control points along each side
+static const int MIN_BSPLINE_SIZE = 4;
+
 // Grid builder class containts all data relating the 
-// deformable grid
+// deformable grid, drawing is left to GridRenderer
 class GridBuilder
 {
     public:
 
     GridBuilder();
 
-    // generate grid depending on grid type
-    void generateGrid(float modelSize);
-    // draw a grid depending on grid type
-    void drawGrid();
+    // generate grid depending on grid type, a sparse grid only has the cells around the
+    // given vertices, or every cell without them
+    void generateGrid(float modelSize, const Vector* vertices = nullptr, std::size_t count = 0);
+
+    // save the rest and deformed grid to a file, positions are stored relative to modelSize
+    bool saveGrid(std::string fileName, float modelSize);
+    // load a grid saved with saveGrid, the grid is left in its rest state so that
+    // a mesh can be bound to it and the saved positions are returned in deformedGrid
+    bool loadGrid(std::string fileName, float modelSize, std::vector<Vector>& deformedGrid);
+    // move every grid vertex to the given positions, those already there keep their version
+    void setGrid(std::vector<Vector>& grid);
+    // move the given points to exactly the given positions, all taking one new version
+    void setGridPoints(const std::vector<int>& points, const std::vector<Vector>& positions);
 
     // grid data 
     int _gridSize;
     Grid _gridType;
     std::vector<Vector> _grid;
-    std::vector<Vector> _triangulationMesh;
+    std::vector<Vector> _restGrid;
+    // triangulation of a barycentric grid, three indices into _grid per triangle
+    std::vector<int> _triangles;
+    // point location in the triangulation at rest, for binding
+    TriangleLocator _triangleLocator;
+    // cells and their corner points of a sparse trilinear grid, for binding and deforming
+    SparseLattice _sparseLattice;
 
-    // update the grid when dragging the mouse in deform widget
-    void moveVertex(Vector move, int index, bool attenuation, int attenuationScale);
+    // update the grid when dragging the mouse in deform widget, with attenuation the other
+    // vertices follow: by their distance across the whole grid if attenuationRadius is 0,
+    // or else only those within attenuationRadius of the vertex, by the falloff curve
+    void moveVertex(Vector move, int index, bool attenuation, int attenuationScale, float attenuationRadius = 0.0);
+    // move a selection of vertices together, with attenuation the other vertices follow by
+    // their distance to the nearest selected vertex, weighed once for the whole selection
+    void moveVertices(Vector move, const std::vector<int>& indices, bool attenuation, int attenuationScale, float attenuationRadius = 0.0);
     void updateGrid(Vector move, int index);
+    // the falloff of vertices within the attenuation radius, 1 at the dragged vertex
+    // down to 0 at distance 1, distance being relative to the radius
+    static float getFalloff(float distance);
 
     // Bilinear methods
-    void draw2DGrid();
     void generateRegular2DGrid(float modelSize);
     // Barycentric methods
-    void drawTriangularGrid();
     void generateTriangularGrid(float modelSize);
+    void triangulateGrid();
     // Trilinear methods
-    void draw3DGrid();
     void generateRegular3DGrid(float modelSize);
+    // B-spline methods, the lattice reaches a spacing past the model on every side
+    // so that the model is covered by whole spans
+    void generateBSplineGrid(float modelSize);
+    // Sparse trilinear methods, the trilinear lattice with only the cells around the vertices
+    void generateSparseGrid(float modelSize, const Vector* vertices, std::size_t count);
 
     void setGridSize(int size);
     void setGridType(Grid gridType);
     void setGridVector(int index, Vector vertex);
 
     Grid getGridType();
+    // whether the grid is a lattice around the mesh rather than a plane behind it,
+    // so that its points lie behind one another and the mesh needs its normals
+    bool isVolumetric() const;
     int getGridSize();
     const Vector& getGridVertex(int index) const;
+    // the edges of the grid as pairs of indices into _grid, each edge once
+    void getGridEdges(std::vector<uint32_t>& edges) const;
+    // changes whenever the grid does and is never the same for two grids,
+    // so that anything computed from a grid can be cached against it
+    unsigned long long getVersion() const;
+    // changes only when the grid is built again or its size or type change, not as points move
+    unsigned long long getLayoutVersion() const;
+    // the points that moved since the grid had version since, returns false
+    // if more than single points changed, the size or type for example
+    bool getChangedPoints(unsigned long long since, std::vector<int>& points) const;
+
+    private:
+    // give the grid a new version after changing all of it, or before moving points,
+    // which all take that version
+    void markChanged();
+    void markPointsChanged();
+    // move a point without giving the grid a new version
+    void shiftPoint(Vector move, int index);
+    // keep the bounds and the point hash up to date with a point that moved from previous
+    void pointMoved(int index, const Vector& previous);
+    // the diagonal of the bounds, which attenuation across the whole grid scales distances by
+    float getAttenuationDistance();
+
+    // bounds of the grid in x and y along with the origin, which attenuation across the
+    // whole grid scales distances by, valid while _boundsValid is set
+    Vector _boundsMin;
+    Vector _boundsMax;
+    bool _boundsValid;
+    // the grid's points hashed in cells of the attenuation radius, for the layout
+    // version _hashLayout, moved along with the points
+    PointHash _pointHash;
+    unsigned long long _hashLayout;
+
+    unsigned long long _version;
+    // version of the last change to the whole grid, and of the last move of every point
+    unsigned long long _layoutVersion;
+    std::vector<unsigned long long> _pointVersions;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,446 @@
+// buffer object and shader functions are declared by the headers themselves rather than looked up
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GridRenderer.h"
+#include "BufferWriter.h"
+
+// half the side of a point marker, in pixels
+static const float MARKER_SIZE = 3.0;
+
+static const float LINE_COLOUR[] = { 0.25, 0.25, 0.25, 1.0 };
+
+static const char* LINE_VERTEX_SHADER =
+    "#version 330\n"
+    "layout(location = 0) in vec3 position;\n"
+    "uniform mat4 matrix;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = matrix * vec4(position, 1.0);\n"
+    "}\n";
+
+static const char* LINE_FRAGMENT_SHADER =
+    "#version 330\n"
+    "uniform vec4 colour;\n"
+    "out vec4 fragmentColour;\n"
+    "void main()\n"
+    "{\n"
+    "    fragmentColour = colour;\n"
+    "}\n";
+
+// one instance per grid point, the quad is kept the same size on screen
+static const char* MARKER_VERTEX_SHADER =
+    "#version 330\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec2 corner;\n"
+    "layout(location = 2) in float inSelection;\n"
+    "uniform mat4 matrix;\n"
+    "uniform vec2 markerSize;\n"
+    "uniform int selected;\n"
+    "out vec4 markerColour;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 centre = matrix * vec4(position, 1.0);\n"
+    "    gl_Position = centre + vec4(corner * markerSize * centre.w, 0.0, 0.0);\n"
+    "    if (gl_InstanceID == selected)\n"
+    "        markerColour = vec4(0.9, 0.2, 0.1, 1.0);\n"
+    "    else if (inSelection > 0.5)\n"
+    "        markerColour = vec4(0.95, 0.6, 0.1, 1.0);\n"
+    "    else\n"
+    "        markerColour = vec4(0.2, 0.3, 0.9, 1.0);\n"
+    "}\n";
+
+static const char* MARKER_FRAGMENT_SHADER =
+    "#version 330\n"
+    "in vec4 markerColour;\n"
+    "out vec4 fragmentColour;\n"
+    "void main()\n"
+    "{\n"
+    "    fragmentColour = markerColour;\n"
+    "}\n";
+
+// compile and link a vertex and fragment shader, returns 0 on failure
+static GLuint linkProgram(const char* vertexSource, const char* fragmentSource)
+{
+    const char* sources[] = { vertexSource, fragmentSource };
+    GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    GLuint program = glCreateProgram();
+    for (int stage = 0; stage < 2; stage++)
+    {
+        GLuint shader = glCreateShader(types[stage]);
+        glShaderSource(shader, 1, &sources[stage], nullptr);
+        glCompileShader(shader);
+        GLint compiled = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (compiled != GL_TRUE)
+        {
+            char log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cerr << "Grid shader: " << log << std::endl;
+            glDeleteShader(shader);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glAttachShader(program, shader);
+        // flagged for deletion, it goes with the program
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GridRenderer::GridRenderer()
+{
+    _immediate = false;
+    _created = false;
+    _usable = false;
+    _lineProgram = 0;
+    _markerProgram = 0;
+    _lineMatrix = -1;
+    _lineColour = -1;
+    _markerMatrix = -1;
+    _markerSize = -1;
+    _markerSelected = -1;
+    _lineArray = 0;
+    _markerArray = 0;
+    _pointBuffer = 0;
+    _edgeBuffer = 0;
+    _cornerBuffer = 0;
+    _selectionBuffer = 0;
+    _selectionChanged = true;
+    _bufferGrid = nullptr;
+    _bufferVersion = 0;
+    _pointCount = 0;
+    _edgeCount = 0;
+}
+
+void GridRenderer::setImmediateMode(bool immediate)
+{
+    _immediate = immediate;
+}
+
+bool GridRenderer::getImmediateMode() const
+{
+    return _immediate;
+}
+
+void GridRenderer::setSelection(const std::vector<int>& points)
+{
+    std::fill(_selection.begin(), _selection.end(), 0);
+    for (std::size_t point = 0; point < points.size(); point++)
+    {
+        if ((std::size_t)points[point] >= _selection.size())
+            _selection.resize(points[point] + 1, 0);
+        _selection[points[point]] = 1;
+    }
+    _selectionChanged = true;
+}
+
+bool GridRenderer::createPrograms()
+{
+    if (_created)
+        return _usable;
+    _created = true;
+
+    // shaders need OpenGL 3.3, older contexts keep drawing in immediate mode
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 3 || (major == 3 && minor < 3))
+        return false;
+
+    _lineProgram = linkProgram(LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER);
+    _markerProgram = linkProgram(MARKER_VERTEX_SHADER, MARKER_FRAGMENT_SHADER);
+    if (_lineProgram == 0 || _markerProgram == 0)
+        return false;
+    _lineMatrix = glGetUniformLocation(_lineProgram, "matrix");
+    _lineColour = glGetUniformLocation(_lineProgram, "colour");
+    _markerMatrix = glGetUniformLocation(_markerProgram, "matrix");
+    _markerSize = glGetUniformLocation(_markerProgram, "markerSize");
+    _markerSelected = glGetUniformLocation(_markerProgram, "selected");
+
+    GLuint buffers[4];
+    glGenBuffers(4, buffers);
+    _pointBuffer = buffers[0];
+    _edgeBuffer = buffers[1];
+    _cornerBuffer = buffers[2];
+    _selectionBuffer = buffers[3];
+    static const float corners[] = { -1.0, -1.0,  1.0, -1.0,  -1.0, 1.0,  1.0, 1.0 };
+    glBindBuffer(GL_ARRAY_BUFFER, _cornerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+    // the edges and the markers both read the grid points from _pointBuffer
+    GLuint arrays[2];
+    glGenVertexArrays(2, arrays);
+    _lineArray = arrays[0];
+    _markerArray = arrays[1];
+    glBindVertexArray(_lineArray);
+    glBindBuffer(GL_ARRAY_BUFFER, _pointBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vector), nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _edgeBuffer);
+
+    glBindVertexArray(_markerArray);
+    glBindBuffer(GL_ARRAY_BUFFER, _pointBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vector), nullptr);
+    glVertexAttribDivisor(0, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, _cornerBuffer);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, _selectionBuffer);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_TRUE, 1, nullptr);
+    glVertexAttribDivisor(2, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    _usable = true;
+    return true;
+}
+
+void GridRenderer::updateBuffers(GridBuilder& gridBuilder)
+{
+    if (_bufferGrid == &gridBuilder && _bufferVersion == gridBuilder.getVersion())
+        return;
+
+    const std::vector<Vector>& grid = gridBuilder._grid;
+    std::vector<int> points;
+    glBindBuffer(GL_ARRAY_BUFFER, _pointBuffer);
+    // while dragging only the points that moved are written
+    bool written = _bufferGrid == &gridBuilder && _pointCount == grid.size() &&
+        gridBuilder.getChangedPoints(_bufferVersion, points) &&
+        writeElements(points, sizeof(Vector), [&](char* destination, int point)
+        {
+            std::memcpy(destination, &grid[point], sizeof(Vector));
+        });
+    if (!written)
+    {
+        // a new layout, the edges only change here
+        glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(Vector), grid.data(), GL_DYNAMIC_DRAW);
+        std::vector<uint32_t> edges;
+        gridBuilder.getGridEdges(edges);
+        glBindVertexArray(_lineArray);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, edges.size() * sizeof(uint32_t), edges.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        _pointCount = grid.size();
+        _edgeCount = edges.size();
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    _bufferGrid = &gridBuilder;
+    _bufferVersion = gridBuilder.getVersion();
+}
+
+void GridRenderer::updateSelection()
+{
+    // a flag for every point, so the selection is written whole when it or the layout changes
+    if (_selection.size() != _pointCount)
+    {
+        _selection.resize(_pointCount, 0);
+        _selectionChanged = true;
+    }
+    if (!_selectionChanged)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, _selectionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, _selection.size(), _selection.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    _selectionChanged = false;
+}
+
+// draw the current grid
+void GridRenderer::drawGrid(GridBuilder& gridBuilder, const float* matrix, int width, int height, int selected)
+{
+    if (!_immediate && createPrograms())
+    {
+        updateBuffers(gridBuilder);
+        updateSelection();
+
+        glUseProgram(_lineProgram);
+        glUniformMatrix4fv(_lineMatrix, 1, GL_FALSE, matrix);
+        glUniform4fv(_lineColour, 1, LINE_COLOUR);
+        glBindVertexArray(_lineArray);
+        glDrawElements(GL_LINES, _edgeCount, GL_UNSIGNED_INT, nullptr);
+
+        glUseProgram(_markerProgram);
+        glUniformMatrix4fv(_markerMatrix, 1, GL_FALSE, matrix);
+        glUniform2f(_markerSize, 2.0 * MARKER_SIZE / width, 2.0 * MARKER_SIZE / height);
+        glUniform1i(_markerSelected, selected);
+        glBindVertexArray(_markerArray);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _pointCount);
+
+        glBindVertexArray(0);
+        glUseProgram(0);
+        return;
+    }
+
+    switch (gridBuilder.getGridType())
+    {
+    case Grid::Bilinear:
+        draw2DGrid(gridBuilder);
+        break;
+    case Grid::Barycentric:
+        drawTriangularGrid(gridBuilder);
+        break;
+    case Grid::Trilinear:
+    case Grid::BSpline:
+        draw3DGrid(gridBuilder);
+        break;
+    case Grid::SparseTrilinear:
+        drawSparseGrid(gridBuilder);
+        break;
+    default:
+        break;
+    }
+}
+
+//
+// Bilinear 
+//
+
+// draw a regular 2D grid
+void GridRenderer::draw2DGrid(GridBuilder& gridBuilder)
+{
+    std::vector<Vector>& grid = gridBuilder._grid;
+    int gridSize = gridBuilder.getGridSize();
+
+    // draw all x lines
+    // y loop
+    glBegin(GL_LINES);
+    for(int row = 0; row < gridSize; row++)
+    {   
+        // x loop
+        for(int col = 0; col < gridSize - 1; col++)
+        {
+            glVertex3f(grid[row * gridSize + col    ].x, grid[row * gridSize + col    ].y, grid[row * gridSize + col    ].z);
+            glVertex3f(grid[row * gridSize + col + 1].x, grid[row * gridSize + col + 1].y, grid[row * gridSize + col + 1].z);
+        }
+    }
+    // draw all y lines
+    // y loop
+    for(int row = 0; row < gridSize - 1; row++)
+    {   
+        // x loop
+        for(int col = 0; col < gridSize; col++)
+        {
+            glVertex3f(grid[row       * gridSize + col].x, grid[row       * gridSize + col].y, grid[row       * gridSize + col].z);
+            glVertex3f(grid[(row + 1) * gridSize + col].x, grid[(row + 1) * gridSize + col].y, grid[(row + 1) * gridSize + col].z);
+        }
+    }
+    glEnd();
+}
+
+//
+// Barycentric
+//
+
+// draw triangular mesh
+void GridRenderer::drawTriangularGrid(GridBuilder& gridBuilder)
+{
+    std::vector<Vector>& grid = gridBuilder._grid;
+    std::vector<int>& triangles = gridBuilder._triangles;
+
+    glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+    glBegin(GL_TRIANGLES);
+    for (unsigned int i = 0; i < triangles.size(); i++)
+    {
+        Vector* v = &(grid[triangles[i]]);
+        glVertex3fv(&v->x);        
+    }
+    glEnd();
+}
+
+//
+// Trilinear
+//
+
+// draw a regular 3D grid
+void GridRenderer::draw3DGrid(GridBuilder& gridBuilder)
+{
+    std::vector<Vector>& grid = gridBuilder._grid;
+    int gridSize = gridBuilder.getGridSize();
+
+    // draw all x lines
+    // y loop
+    glBegin(GL_LINES);
+    for(int cel = 0; cel < gridSize; cel++)
+    {
+        for(int row = 0; row < gridSize; row++)
+        {   
+            // x loop
+            for(int col = 0; col < gridSize - 1; col++)
+            {
+                glVertex3f( grid[cel*gridSize*gridSize + row*gridSize + col].x, 
+                                grid[cel*gridSize*gridSize + row*gridSize + col].y, 
+                                grid[cel*gridSize*gridSize + row*gridSize + col].z);
+                glVertex3f( grid[cel*gridSize*gridSize + row*gridSize + (col+1)].x, 
+                                grid[cel*gridSize*gridSize + row*gridSize + (col+1)].y, 
+                                grid[cel*gridSize*gridSize + row*gridSize + (col+1)].z);
+            }
+        }
+    }
+    // draw all y lines
+    // y loop
+    for(int cel = 0; cel < gridSize; cel++)
+    {
+        for(int row = 0; row < gridSize - 1; row++)
+        {   
+            // x loop
+            for(int col = 0; col < gridSize; col++)
+            {
+                glVertex3f( grid[cel*gridSize*gridSize + row*gridSize + col].x, 
+                                grid[cel*gridSize*gridSize + row*gridSize + col].y, 
+                                grid[cel*gridSize*gridSize + row*gridSize + col].z);
+                glVertex3f( grid[cel*gridSize*gridSize + (row+1)*gridSize + col].x, 
+                                grid[cel*gridSize*gridSize + (row+1)*gridSize + col].y, 
+                                grid[cel*gridSize*gridSize + (row+1)*gridSize + col].z);
+            }
+        }
+    }
+    // draw all z lines
+    for(int cel = 0; cel < gridSize - 1; cel++)
+    {
+        for(int row = 0; row < gridSize; row++)
+        {
+            for(int col = 0; col < gridSize; col++)
+            {
+                glVertex3f( grid[cel*gridSize*gridSize + row*gridSize + col].x, 
+                                grid[cel*gridSize*gridSize + row*gridSize + col].y, 
+                                grid[cel*gridSize*gridSize + row*gridSize + col].z);
+                glVertex3f( grid[(cel+1)*gridSize*gridSize + row*gridSize + col].x, 
+                                grid[(cel+1)*gridSize*gridSize + row*gridSize + col].y, 
+                                grid[(cel+1)*gridSize*gridSize + row*gridSize + col].z);
+            }
+        }
+    }
+    glEnd();
+}
+
+//
+// Sparse trilinear
+//
+
+// draw the edges between the points of a sparse lattice
+void GridRenderer::drawSparseGrid(GridBuilder& gridBuilder)
+{
+    std::vector<Vector>& grid = gridBuilder._grid;
+    std::vector<uint32_t> edges;
+    gridBuilder.getGridEdges(edges);
+
+    glBegin(GL_LINES);
+    for (unsigned int i = 0; i < edges.size(); i++)
+        glVertex3fv(&grid[edges[i]].x);
+    glEnd();
+}
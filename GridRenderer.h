@@ -0,0 +1,81 @@
+#ifndef _GRID_RENDERER_H
+#define _GRID_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/gl.h>
+
+#include "Vector.h"
+#include "GridBuilder.h"
+
+// OpenGL drawing of the deformable grid held by a GridBuilder.
+// The grid points are kept in a vertex buffer that is only written where points
+// moved, the edges in an index buffer that only changes with the grid's layout,
+// and the points are drawn as instanced markers, all through shaders.
+class GridRenderer
+{
+    public:
+
+    GridRenderer();
+
+    // draw a grid depending on grid type, matrix is the column major projection times
+    // model view matrix, the viewport size in pixels sizes the markers and the
+    // selected point, if not -1, is highlighted
+    void drawGrid(GridBuilder& gridBuilder, const float* matrix, int width, int height, int selected);
+
+    // the points highlighted as selected from now on, the highlight is only drawn with shaders
+    void setSelection(const std::vector<int>& points);
+
+    // draw with glBegin and glEnd under the fixed function matrices instead of shaders
+    void setImmediateMode(bool immediate);
+    bool getImmediateMode() const;
+
+    // Bilinear
+    void draw2DGrid(GridBuilder& gridBuilder);
+    // Barycentric
+    void drawTriangularGrid(GridBuilder& gridBuilder);
+    // Trilinear
+    void draw3DGrid(GridBuilder& gridBuilder);
+    // Sparse trilinear, only the edges of the cells the lattice has
+    void drawSparseGrid(GridBuilder& gridBuilder);
+
+    private:
+    // compile the shaders and create the buffers the first time, returns false
+    // if the context can't run them so that immediate mode is used instead
+    bool createPrograms();
+    // bring the buffers up to date with the grid
+    void updateBuffers(GridBuilder& gridBuilder);
+    void updateSelection();
+
+    bool _immediate;
+    bool _created;
+    bool _usable;
+
+    GLuint _lineProgram;
+    GLuint _markerProgram;
+    GLint _lineMatrix;
+    GLint _lineColour;
+    GLint _markerMatrix;
+    GLint _markerSize;
+    GLint _markerSelected;
+
+    GLuint _lineArray;
+    GLuint _markerArray;
+    GLuint _pointBuffer;
+    GLuint _edgeBuffer;
+    GLuint _cornerBuffer;
+    GLuint _selectionBuffer;
+
+    // the grid and version the buffers hold
+    const GridBuilder* _bufferGrid;
+    unsigned long long _bufferVersion;
+    std::size_t _pointCount;
+    std::size_t _edgeCount;
+
+    // one flag per grid point, written to _selectionBuffer when it changed
+    std::vector<uint8_t> _selection;
+    bool _selectionChanged;
+};
+
+#endif
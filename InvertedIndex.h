@@ -0,0 +1,65 @@
+#ifndef _INVERTED_INDEX_H
+#define _INVERTED_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Inverse of a fixed fan-out relation, such as the grid points each vertex is bound to
+// or the vertices of each triangle: for every key it lists the items referring to it,
+// in increasing order, so that a change to a key can be followed to the items it affects.
+class InvertedIndex
+{
+    public:
+
+    // index itemCount items referring to keyCount keys, keys(item, k) gives the
+    // k'th of the fanOut distinct keys of an item
+    template <typename Keys>
+    void build(std::size_t keyCount, std::size_t itemCount, int fanOut, Keys keys)
+    {
+        // count the items of every key, then place them by a prefix sum of the counts
+        _start.assign(keyCount + 1, 0);
+        for (std::size_t item = 0; item < itemCount; item++)
+            for (int k = 0; k < fanOut; k++)
+                _start[keys(item, k) + 1]++;
+        for (std::size_t key = 0; key < keyCount; key++)
+            _start[key + 1] += _start[key];
+
+        std::vector<std::size_t> next(_start.begin(), _start.end() - 1);
+        _items.resize(_start[keyCount]);
+        for (std::size_t item = 0; item < itemCount; item++)
+            for (int k = 0; k < fanOut; k++)
+                _items[next[keys(item, k)]++] = static_cast<uint32_t>(item);
+    }
+
+    void clear()
+    {
+        _start.clear();
+        _items.clear();
+    }
+
+    bool isEmpty() const
+    {
+        return _start.empty();
+    }
+
+    // the items referring to key are [begin(key), end(key))
+    const uint32_t* begin(std::size_t key) const
+    {
+        return _items.data() + _start[key];
+    }
+    const uint32_t* end(std::size_t key) const
+    {
+        return _items.data() + _start[key + 1];
+    }
+    std::size_t count(std::size_t key) const
+    {
+        return _start[key + 1] - _start[key];
+    }
+
+    private:
+    std::vector<std::size_t> _start;
+    std::vector<uint32_t> _items;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include <algorithm>
+
+#include "LatticeAnimation.h"
+
+LatticeAnimation::LatticeAnimation()
+{
+    _interpolation = Interpolation::Smooth;
+}
+
+bool LatticeAnimation::setKeyframe(double time, const std::vector<Vector>& grid)
+{
+    if (!_keyframes.empty() && grid.size() != _keyframes[0].grid.size())
+        return false;
+
+    // the first keyframe at or after time
+    std::vector<Keyframe>::iterator key = std::lower_bound(_keyframes.begin(), _keyframes.end(), time,
+        [](const Keyframe& keyframe, double time) { return keyframe.time < time; });
+    if (key != _keyframes.end() && key->time == time)
+        key->grid = grid;
+    else
+        _keyframes.insert(key, { time, grid });
+    return true;
+}
+
+void LatticeAnimation::removeKeyframe(int key)
+{
+    _keyframes.erase(_keyframes.begin() + key);
+}
+
+void LatticeAnimation::clear()
+{
+    _keyframes.clear();
+}
+
+int LatticeAnimation::getKeyframeCount() const
+{
+    return _keyframes.size();
+}
+
+double LatticeAnimation::getKeyframeTime(int key) const
+{
+    return _keyframes[key].time;
+}
+
+const std::vector<Vector>& LatticeAnimation::getKeyframe(int key) const
+{
+    return _keyframes[key].grid;
+}
+
+double LatticeAnimation::getStartTime() const
+{
+    return _keyframes.empty() ? 0.0 : _keyframes.front().time;
+}
+
+double LatticeAnimation::getEndTime() const
+{
+    return _keyframes.empty() ? 0.0 : _keyframes.back().time;
+}
+
+void LatticeAnimation::setInterpolation(Interpolation interpolation)
+{
+    _interpolation = interpolation;
+}
+
+Interpolation LatticeAnimation::getInterpolation() const
+{
+    return _interpolation;
+}
+
+void LatticeAnimation::evaluate(double time, std::vector<Vector>& grid) const
+{
+    if (_keyframes.empty())
+    {
+        grid.clear();
+        return;
+    }
+    // held at the ends
+    if (time <= _keyframes.front().time)
+    {
+        grid = _keyframes.front().grid;
+        return;
+    }
+    if (time >= _keyframes.back().time)
+    {
+        grid = _keyframes.back().grid;
+        return;
+    }
+
+    // time falls between keyframes k and k + 1, the grid there is a sum of keyframes
+    // k - 1 to k + 2 with these weights, the same for every point
+    int last = _keyframes.size() - 1;
+    int k = std::upper_bound(_keyframes.begin(), _keyframes.end(), time,
+        [](double time, const Keyframe& keyframe) { return time < keyframe.time; }) - _keyframes.begin() - 1;
+    int keys[4] = { std::max(k - 1, 0), k, k + 1, std::min(k + 2, last) };
+    double span = _keyframes[k + 1].time - _keyframes[k].time;
+    double s = (time - _keyframes[k].time) / span;
+    double weights[4] = { 0.0, 1.0 - s, s, 0.0 };
+    if (_interpolation == Interpolation::Smooth)
+    {
+        // cubic Hermite between k and k + 1, the tangent at a keyframe being the slope
+        // between the keyframes either side of it, or to the one next to it at the ends
+        double s2 = s * s, s3 = s2 * s;
+        double startTangent = (s3 - 2.0 * s2 + s) * span / (_keyframes[keys[2]].time - _keyframes[keys[0]].time);
+        double endTangent = (s3 - s2) * span / (_keyframes[keys[3]].time - _keyframes[keys[1]].time);
+        weights[0] = -startTangent;
+        weights[1] = 2.0 * s3 - 3.0 * s2 + 1.0 - endTangent;
+        weights[2] = -2.0 * s3 + 3.0 * s2 + startTangent;
+        weights[3] = endTangent;
+    }
+
+    const Vector* before = _keyframes[keys[0]].grid.data();
+    const Vector* from = _keyframes[keys[1]].grid.data();
+    const Vector* to = _keyframes[keys[2]].grid.data();
+    const Vector* after = _keyframes[keys[3]].grid.data();
+    float w0 = weights[0], w1 = weights[1], w2 = weights[2], w3 = weights[3];
+    grid.resize(_keyframes[0].grid.size());
+    Vector* points = grid.data();
+    // a grid is small next to the mesh, so this stays on the calling thread and leaves the
+    // worker threads to the deformation running alongside it
+    for (std::size_t point = 0; point < grid.size(); point++)
+    {
+        points[point].x = w0 * before[point].x + w1 * from[point].x + w2 * to[point].x + w3 * after[point].x;
+        points[point].y = w0 * before[point].y + w1 * from[point].y + w2 * to[point].y + w3 * after[point].y;
+        points[point].z = w0 * before[point].z + w1 * from[point].z + w2 * to[point].z + w3 * after[point].z;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef _LATTICE_ANIMATION_H
+#define _LATTICE_ANIMATION_H
+
+#include <vector>
+
+#include "Vector.h"
+
+// how the grid moves between keyframes
+enum struct Interpolation
+{
+    Linear, Smooth
+};
+
+// Keyframes of the positions of every grid point, so that a grid can be animated over
+// time: the grid at any time is worked out from the keyframes around it, in a straight
+// line from one to the next or along a Catmull-Rom spline through them, which passes
+// through every keyframe with no jump in speed. Before the first keyframe and after
+// the last the grid stays where they have it.
+class LatticeAnimation
+{
+    public:
+
+    LatticeAnimation();
+
+    // keep the grid points as they are at time, replacing a keyframe already at that time,
+    // returns false if they aren't as many as those of the other keyframes
+    bool setKeyframe(double time, const std::vector<Vector>& grid);
+    void removeKeyframe(int key);
+    void clear();
+
+    // keyframes are kept in order of time
+    int getKeyframeCount() const;
+    double getKeyframeTime(int key) const;
+    const std::vector<Vector>& getKeyframe(int key) const;
+    double getStartTime() const;
+    double getEndTime() const;
+
+    void setInterpolation(Interpolation interpolation);
+    Interpolation getInterpolation() const;
+
+    // the grid points at time, on the calling thread, grid is left empty if there are no keyframes
+    void evaluate(double time, std::vector<Vector>& grid) const;
+
+    private:
+    struct Keyframe
+    {
+        double time;
+        std::vector<Vector> grid;
+    };
+
+    std::vector<Keyframe> _keyframes;
+    Interpolation _interpolation;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <numeric>
+
+#include "LatticeHierarchy.h"
+#include "Parallel.h"
+
+LatticeHierarchy::LatticeHierarchy()
+{
+}
+
+void LatticeHierarchy::generate(int coarseSize, int levelCount, float modelSize)
+{
+    _levels.clear();
+    _levels.resize(std::max(levelCount, 1));
+    int gridSize = std::max(coarseSize, 2);
+    for (int level = 0; level < (int)_levels.size(); level++)
+    {
+        LatticeLevel& current = _levels[level];
+        current.grid.setGridType(Grid::Trilinear);
+        current.grid.setGridSize(gridSize);
+        current.grid.generateGrid(modelSize);
+        // a level at rest is carried to its rest positions and has no moves of its own
+        current.carried = current.grid._grid;
+        current.offsets.assign(current.grid._grid.size(), Vector(0.0, 0.0, 0.0));
+        if (level > 0)
+            bindLevel(level);
+        current.version = current.grid.getVersion();
+        current.carriedFrom = level > 0 ? _levels[level - 1].grid.getVersion() : 0;
+        // every cell split in two
+        gridSize = 2 * (gridSize - 1) + 1;
+    }
+}
+
+int LatticeHierarchy::getLevelCount() const
+{
+    return _levels.size();
+}
+
+GridBuilder& LatticeHierarchy::getLevel(int level)
+{
+    return _levels[level].grid;
+}
+
+GridBuilder& LatticeHierarchy::getFinestLevel()
+{
+    return _levels.back().grid;
+}
+
+const std::vector<Vector>& LatticeHierarchy::getOffsets(int level) const
+{
+    return _levels[level].offsets;
+}
+
+// the points of a level lie on the points of the coarser level and halfway between
+// them, so their place in its cells is known exactly without going through positions
+void LatticeHierarchy::bindLevel(int level)
+{
+    LatticeLevel& current = _levels[level];
+    int gridSize = current.grid.getGridSize();
+    int coarseSize = _levels[level - 1].grid.getGridSize();
+    WeightStreams& binding = current.binding;
+    binding.resize(current.grid._grid.size());
+    for (int cel = 0; cel < gridSize; cel++)
+    {
+        for (int row = 0; row < gridSize; row++)
+        {
+            for (int col = 0; col < gridSize; col++)
+            {
+                int point = (cel * gridSize + row) * gridSize + col;
+                // points on the far side of the coarser lattice take its last cell
+                int cellX = std::min(col / 2, coarseSize - 2);
+                int cellY = std::min(row / 2, coarseSize - 2);
+                int cellZ = std::min(cel / 2, coarseSize - 2);
+                binding.u[point] = col * 0.5f - cellX;
+                binding.v[point] = row * 0.5f - cellY;
+                binding.w[point] = cel * 0.5f - cellZ;
+                binding.cell[point] = (cellZ * coarseSize + cellY) * coarseSize + cellX;
+            }
+        }
+    }
+}
+
+bool LatticeHierarchy::findCarriedPoints(int level, const std::vector<int>& moved, std::vector<int>& points) const
+{
+    // a coarser point only reaches the points of the cells around it, those within a
+    // point of its own place in the finer lattice
+    int gridSize = _levels[level].grid._gridSize;
+    int coarseSize = _levels[level - 1].grid._gridSize;
+    points.clear();
+    if (moved.size() * 27 > _levels[level].grid._grid.size() / 4)
+        return false;
+    for (std::size_t point = 0; point < moved.size(); point++)
+    {
+        int x = 2 * (moved[point] % coarseSize);
+        int y = 2 * (moved[point] / coarseSize % coarseSize);
+        int z = 2 * (moved[point] / (coarseSize * coarseSize));
+        for (int cel = std::max(z - 1, 0); cel <= std::min(z + 1, gridSize - 1); cel++)
+            for (int row = std::max(y - 1, 0); row <= std::min(y + 1, gridSize - 1); row++)
+                for (int col = std::max(x - 1, 0); col <= std::min(x + 1, gridSize - 1); col++)
+                    points.push_back((cel * gridSize + row) * gridSize + col);
+    }
+    return true;
+}
+
+std::size_t LatticeHierarchy::update()
+{
+    std::size_t updated = 0;
+    std::vector<int> moved, carried, coarseMoved, points;
+    std::vector<Vector> positions;
+    for (int level = 0; level < (int)_levels.size(); level++)
+    {
+        LatticeLevel& current = _levels[level];
+        GridBuilder& grid = current.grid;
+        std::size_t nPoints = grid._grid.size();
+        bool allPoints = false;
+
+        // points moved on this level since the last update, their moves become its own
+        moved.clear();
+        if (grid.getVersion() != current.version)
+        {
+            if (!grid.getChangedPoints(current.version, moved))
+            {
+                moved.resize(nPoints);
+                std::iota(moved.begin(), moved.end(), 0);
+                allPoints = true;
+            }
+            for (std::size_t point = 0; point < moved.size(); point++)
+            {
+                Vector position = grid._grid[moved[point]];
+                current.offsets[moved[point]] = position - current.carried[moved[point]];
+            }
+        }
+
+        // the coarser level moved since it last carried this one, its moved points take the
+        // points around them along
+        carried.clear();
+        const GridBuilder* coarser = level > 0 ? &_levels[level - 1].grid : nullptr;
+        if (coarser && coarser->getVersion() != current.carriedFrom)
+        {
+            const Vector* coarseGrid = coarser->_grid.data();
+            int coarseSize = coarser->_gridSize;
+            if (coarser->getChangedPoints(current.carriedFrom, coarseMoved) && findCarriedPoints(level, coarseMoved, carried))
+            {
+                std::sort(carried.begin(), carried.end());
+                carried.erase(std::unique(carried.begin(), carried.end()), carried.end());
+                for (std::size_t point = 0; point < carried.size(); point++)
+                    deformTrilinearStreams(current.binding, coarseGrid, coarseSize, current.carried.data(), carried[point], carried[point] + 1);
+            }
+            else
+            {
+                parallelFor(nPoints, [&](std::size_t begin, std::size_t end)
+                {
+                    deformTrilinearStreams(current.binding, coarseGrid, coarseSize, current.carried.data(), begin, end);
+                });
+                carried.resize(nPoints);
+                std::iota(carried.begin(), carried.end(), 0);
+                allPoints = true;
+            }
+            current.carriedFrom = coarser->getVersion();
+        }
+
+        // every point the level's moves or the coarser level touched goes where they take it,
+        // so that the level is always exactly carried + offsets
+        if (allPoints)
+        {
+            points.resize(nPoints);
+            std::iota(points.begin(), points.end(), 0);
+        }
+        else
+        {
+            points.resize(moved.size() + carried.size());
+            std::merge(moved.begin(), moved.end(), carried.begin(), carried.end(), points.begin());
+            points.erase(std::unique(points.begin(), points.end()), points.end());
+        }
+        if (!points.empty())
+        {
+            positions.resize(points.size());
+            parallelFor(points.size(), [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t point = begin; point < end; point++)
+                {
+                    Vector position = current.carried[points[point]];
+                    positions[point] = position + current.offsets[points[point]];
+                }
+            });
+            grid.setGridPoints(points, positions);
+            updated += points.size();
+        }
+        current.version = grid.getVersion();
+    }
+    return updated;
+}
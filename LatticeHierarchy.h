@@ -0,0 +1,67 @@
+#ifndef _LATTICE_HIERARCHY_H
+#define _LATTICE_HIERARCHY_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Vector.h"
+#include "DeformKernels.h"
+#include "GridBuilder.h"
+
+// Nested trilinear lattices, coarse to fine, so that a mesh can be shaped broadly with
+// a few points and in detail with many. Level 0 is a trilinear grid of coarseSize points
+// a side over the model and every level after it splits each cell of the one before in
+// two along every axis, so that its points take in those of the coarser level. A finer
+// lattice rides on the coarser one: its points are where the coarser lattice's
+// deformation takes them at rest, plus their own moves. The coarser deformation being
+// trilinear in each of its cells, the finest lattice then deforms the mesh exactly as
+// every level would one after another, and the mesh is bound to the finest level alone.
+// The points of every level are kept as the levels above put them, so that moving points
+// of one level only works that level and the finer ones out again, around those points.
+class LatticeHierarchy
+{
+    public:
+
+    LatticeHierarchy();
+
+    // lay out levelCount levels over the model, at rest
+    void generate(int coarseSize, int levelCount, float modelSize);
+    int getLevelCount() const;
+
+    // the lattice of a level with its points where the coarser levels and its own moves
+    // put them, to be drawn and moved like any grid, update takes its moves down the levels
+    GridBuilder& getLevel(int level);
+    // the finest level, the grid the mesh is bound to and deformed by
+    GridBuilder& getFinestLevel();
+    // the moves of the points of a level on top of where the coarser levels take them
+    const std::vector<Vector>& getOffsets(int level) const;
+
+    // take the points moved on every level since the last update as the moves of that
+    // level and carry them down the finer levels, returns how many points were carried
+    std::size_t update();
+
+    private:
+    struct LatticeLevel
+    {
+        GridBuilder grid;
+        // the binding of the level's points at rest to the coarser level, as the
+        // trilinear kernels read it, and where that level takes them
+        WeightStreams binding;
+        std::vector<Vector> carried;
+        std::vector<Vector> offsets;
+        // the version of the level's grid after the last update, and of the coarser
+        // level's grid it was carried by
+        unsigned long long version;
+        unsigned long long carriedFrom;
+    };
+
+    // bind the points of a level at rest to the cells of the coarser level
+    void bindLevel(int level);
+    // the points of a level the moved points of the coarser one carry, false if that
+    // is all of them
+    bool findCarriedPoints(int level, const std::vector<int>& moved, std::vector<int>& points) const;
+
+    std::vector<LatticeLevel> _levels;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+{
+    _data = nullptr;
+    _size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+// map a file into memory
+bool MappedFile::open(std::string fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    // we usually read the file front to back
+    madvise(mapping, fileStat.st_size, MADV_SEQUENTIAL);
+
+    _data = static_cast<char*>(mapping);
+    _size = fileStat.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data != nullptr)
+        munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+}
+
+void MappedFile::release(std::size_t offset)
+{
+    std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    std::size_t length = std::min(offset, _size) / pageSize * pageSize;
+    if (_data != nullptr && length > 0)
+        madvise(_data, length, MADV_DONTNEED);
+}
+
+bool MappedFile::isOpen() const
+{
+    return _data != nullptr;
+}
+
+char* MappedFile::data() const
+{
+    return _data;
+}
+
+std::size_t MappedFile::size() const
+{
+    return _size;
+}
@@ -0,0 +1,37 @@
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file through mmap. Pages are mapped private so
+// writes through data() are copy-on-write and never reach the file.
+class MappedFile
+{
+    public:
+
+    MappedFile();
+    ~MappedFile();
+
+    // map the file, returns false if it could not be opened or mapped
+    bool open(std::string fileName);
+    void close();
+
+    // drop the pages before offset from memory, they are read again from
+    // the file if they are used after this
+    void release(std::size_t offset);
+
+    bool isOpen() const;
+    char* data() const;
+    std::size_t size() const;
+
+    private:
+    // a mapping can't be copied, it is shared through a pointer instead
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    char* _data;
+    std::size_t _size;
+};
+
+#endif
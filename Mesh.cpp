@@ -1,81 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
-#include <GL/gl.h>
-#include <GL/glu.h>
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "MeshParser.h"
+#include "MeshWelder.h"
+#include "Parallel.h"
 
-#include <QMessageBox>
+// triangles per part of a text mesh formatted on one thread
+static const std::size_t TEXT_PART_TRIANGLES = 1 << 14;
+// bytes kept for the text line of a vertex, three floats to 6 digits take at most 39
+static const std::size_t TEXT_LINE_SLOT = 48;
+// the largest grid a stored binding may be for, so that its cells fit in an int
+static const int MAX_STORED_GRID_SIZE = 1024;
 
-#include "Mesh.h"
+// stamps are handed out from one counter so that no two meshes or caches share one
+static std::atomic<unsigned long long> nextMeshStamp(1);
 
 // initialise Mesh variables
 Mesh::Mesh()
 {
     _meshMidPoint = Vector(0.0, 0.0, 0.0);
+    _minCoords = Vector(0.0, 0.0, 0.0);
+    _maxCoords = Vector(0.0, 0.0, 0.0);
     _modelSize = 1.0;
     _meshVertices.resize(0.0);
-    _weights.resize(0.0);
-    _faces.resize(0.0);
+    _triangles.resize(0);
+    _weights.resize(0);
+    _weightsGridType = Grid::Bilinear;
+    _weightsGridSize = 0;
+    _storedWeights = false;
+    _deformedGrid = nullptr;
+    _deformedVersion = 0;
+    _normalsVersion = 0;
+    _updatedFrom = 0;
+    _meshStamp = nextMeshStamp++;
+    _bindingStamp = nextMeshStamp++;
+    _weightMatrixStamp = 0;
+    _deformedStamp = nextMeshStamp++;
+    _normalsStamp = nextMeshStamp++;
+    _verticesUpdatedFrom = 0;
+    _normalsUpdatedFrom = 0;
+}
+
+// sum the vertices of the triangles in order, so that the midpoint is exactly
+// the one found for the same mesh as a triangle soup
+static Vector sumTriangleVertices(const Vector* vertices, const uint32_t* indices, std::size_t nIndices)
+{
+    // the same float additions as summing Vectors, without a call per vertex
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (std::size_t index = 0; index < nIndices; index++)
+    {
+        const Vector& vertex = vertices[indices[index]];
+        x = x + vertex.x;
+        y = y + vertex.y;
+        z = z + vertex.z;
+    }
+    return Vector(x, y, z);
+}
+
+// subtract the midpoint of the triangles from each of the vertices, keeping track of the bounds
+static void centreVertices(Vector* vertices, std::size_t nVertices, const uint32_t* indices, std::size_t nIndices,
+    Vector& midPoint, Vector& minCoords, Vector& maxCoords)
+{
+    minCoords = Vector(1000000.0, 1000000.0, 1000000.0);
+    maxCoords = Vector(-1000000.0, -1000000.0, -1000000.0);
+    // the midpoint is over the triangles, so shared vertices count once per triangle
+    midPoint = sumTriangleVertices(vertices, indices, nIndices);
+
+    // the bounds of each part of the vertices, taken in order so that they are those
+    // of a single pass
+    std::mutex boundsMutex;
+    std::vector<std::pair<std::size_t, std::pair<Vector, Vector>>> partBounds;
+    parallelFor(nVertices, [&](std::size_t begin, std::size_t end)
+    {
+        Vector partMin = minCoords, partMax = maxCoords;
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            // keep running track of the bounds
+            if (vertices[vertex].x < partMin.x) partMin.x = vertices[vertex].x;
+            if (vertices[vertex].y < partMin.y) partMin.y = vertices[vertex].y;
+            if (vertices[vertex].z < partMin.z) partMin.z = vertices[vertex].z;
+
+            if (vertices[vertex].x > partMax.x) partMax.x = vertices[vertex].x;
+            if (vertices[vertex].y > partMax.y) partMax.y = vertices[vertex].y;
+            if (vertices[vertex].z > partMax.z) partMax.z = vertices[vertex].z;
+        }
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        partBounds.push_back({ begin, { partMin, partMax } });
+    });
+    std::sort(partBounds.begin(), partBounds.end(),
+        [](const std::pair<std::size_t, std::pair<Vector, Vector>>& a, const std::pair<std::size_t, std::pair<Vector, Vector>>& b)
+        { return a.first < b.first; });
+    for (std::size_t part = 0; part < partBounds.size(); part++)
+    {
+        const Vector& partMin = partBounds[part].second.first;
+        const Vector& partMax = partBounds[part].second.second;
+        if (partMin.x < minCoords.x) minCoords.x = partMin.x;
+        if (partMin.y < minCoords.y) minCoords.y = partMin.y;
+        if (partMin.z < minCoords.z) minCoords.z = partMin.z;
+
+        if (partMax.x > maxCoords.x) maxCoords.x = partMax.x;
+        if (partMax.y > maxCoords.y) maxCoords.y = partMax.y;
+        if (partMax.z > maxCoords.z) maxCoords.z = partMax.z;
+    }
+
+    // now set the midpoint's location
+    midPoint = midPoint / nIndices;
+
+    // now go back through the vertices, subtracting the mid point
+    float midX = midPoint.x, midY = midPoint.y, midZ = midPoint.z;
+    parallelFor(nVertices, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            vertices[vertex].x = vertices[vertex].x - midX;
+            vertices[vertex].y = vertices[vertex].y - midY;
+            vertices[vertex].z = vertices[vertex].z - midZ;
+        }
+    });
 }
 
 // Mesh methods (called by DeformWidget)                            //
 // -----------------------------------------------------------------//
 //                                                                  //
 
-// load requested mesh from file
-void Mesh::loadMesh(std::string fileName)
+// load requested mesh from file, binary mesh files are recognised by their header
+bool Mesh::loadMesh(std::string fileName)
+{
+    if (isMeshFile(fileName))
+        return loadBinaryMesh(fileName);
+
+    return loadTextMesh(fileName);
+}
+
+// map a text mesh file and parse it on every thread, falls back to reading
+// it as a stream when it can't be mapped (pipes, empty files)
+bool Mesh::loadTextMesh(std::string fileName)
+{
+    MappedFile file;
+    if (!file.open(fileName))
+        return streamTextMesh(fileName);
+
+    // any binding belonged to the previous mesh
+    _weights.clear();
+    _storedWeights = false;
+    meshChanged();
+
+    if (!parseMeshText(file.data(), file.data() + file.size(), _meshVertices, _minCoords, _maxCoords))
+    {
+        _modelSize = 1.0;
+        _meshVertices.clear();
+        _triangles.clear();
+        return false;
+    }
+
+    // the midpoint is summed in file order so that it is exactly the one streamTextMesh finds
+    _meshMidPoint = Vector(0.0, 0.0, 0.0);
+    for (std::size_t vertex = 0; vertex < _meshVertices.size(); vertex++)
+        _meshMidPoint = _meshMidPoint + _meshVertices[vertex];
+    _meshMidPoint = _meshMidPoint / _meshVertices.size();
+
+    // weld before centring, so that only vertices that were identical in the file are merged
+    weldMesh();
+
+    // now go back through the vertices, subtracting the mid point
+    std::size_t nVertices = _meshVertices.size();
+    Vector* vertices = _meshVertices.data();
+    parallelFor(nVertices, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+            vertices[vertex] = vertices[vertex] - _meshMidPoint;
+    });
+
+    // the bounding sphere radius is just half the distance between these
+    _modelSize = (_maxCoords - _minCoords).magnitude();
+    // this happens if a mesh file only contains the same vertices
+    if (_modelSize == 0.0)
+    {
+        _modelSize = 1.0;
+        _meshVertices.clear();
+        _triangles.clear();
+        return false;
+    }
+    return true;
+}
+
+// read a text mesh file one number at a time
+bool Mesh::streamTextMesh(std::string fileName)
 {
     try 
     {
         std::ifstream inFile(fileName);
+        if (!inFile.is_open())
+            throw std::exception();
 
-        Vector minCoords = Vector(1000000.0, 1000000.0, 1000000.0);
-	    Vector maxCoords = Vector(-1000000.0, -1000000.0, -1000000.0);
-        
         // open the input file
         
-        // set the number of vertices and faces
-        float nTriangles = 0, nVertices = 0;
-        
-        // set the midpoint to the origin
-        _meshMidPoint = Vector(0.0, 0.0, 0.0);
+        // set the number of vertices and faces, the count is read as a double and the
+        // loop runs on an integer so that meshes above 2^24 vertices load whole
+        double nTriangles = 0;
+        std::size_t nVertices = 0;
+
+        // any binding belonged to the previous mesh
+        _weights.clear();
+        _storedWeights = false;
+        meshChanged();
 
         // read in the number of vertices
         inFile >> nTriangles;
-        nVertices = nTriangles * 3;
+        if (nTriangles < 0)
+            throw std::exception();
+        nVertices = static_cast<std::size_t>(nTriangles) * 3;
 
         // now allocate space for them all
         _meshVertices.clear();
         _meshVertices.resize(nVertices);
         
         // now loop to read the vertices in, and hope nothing goes wrong
-        for (int vertex = 0; vertex < nVertices; vertex++)
+        for (std::size_t vertex = 0; vertex < nVertices; vertex++)
         {
             inFile >> _meshVertices[vertex].x >> _meshVertices[vertex].y >> _meshVertices[vertex].z;
-
-            // keep running track of midpoint, &c.
-            _meshMidPoint = _meshMidPoint + _meshVertices[vertex];
-            if (_meshVertices[vertex].x < minCoords.x) minCoords.x = _meshVertices[vertex].x;
-            if (_meshVertices[vertex].y < minCoords.y) minCoords.y = _meshVertices[vertex].y;
-            if (_meshVertices[vertex].z < minCoords.z) minCoords.z = _meshVertices[vertex].z;
-
-            if (_meshVertices[vertex].x > maxCoords.x) maxCoords.x = _meshVertices[vertex].x;
-            if (_meshVertices[vertex].y > maxCoords.y) maxCoords.y = _meshVertices[vertex].y;
-            if (_meshVertices[vertex].z > maxCoords.z) maxCoords.z = _meshVertices[vertex].z;
         }
 
+        // merge the vertices shared by triangles
+        weldMesh();
+
         // now sort out the size of a bounding sphere for viewing
         // and also set the midpoint's location
-        _meshMidPoint = _meshMidPoint / _meshVertices.size();
-        
-        // now go back through the vertices, subtracting the mid point
-        for (int vertex = 0; vertex < nVertices; vertex++)
-        {
-            _meshVertices[vertex] = _meshVertices[vertex] - _meshMidPoint;
-        } 
+        centreVertices(_meshVertices.data(), _meshVertices.size(), _triangles.data(), _triangles.size(),
+            _meshMidPoint, _minCoords, _maxCoords);
 
         // the bounding sphere radius is just half the distance between these
-        _modelSize = (maxCoords - minCoords).magnitude();
+        _modelSize = (_maxCoords - _minCoords).magnitude();
         // this happens if a mesh file only contains the same vertices
         if(_modelSize == 0.0)
             throw std::exception();
@@ -84,242 +247,899 @@ void Mesh::loadMesh(std::string fileName)
     {
         _modelSize = 1.0;
         _meshVertices.clear();
-        QMessageBox errorMsg;
-        errorMsg.setText("Could not open file.");
-        errorMsg.exec();
+        _triangles.clear();
+        return false;
     }
+    return true;
 }
 
-// save the deformed mesh to a file, we need the grid data to deform the vertices 
-void Mesh::saveMesh(std::string fileName, GridBuilder* gridBuilder)
+// replace the triangle soup with its unique vertices and an index per triangle corner
+void Mesh::weldMesh()
+{
+    std::vector<Vector> vertices;
+    std::vector<uint32_t> triangles;
+    weldVertices(_meshVertices.data(), _meshVertices.size(), vertices, triangles);
+    _meshVertices.swap(vertices);
+    _triangles.swap(triangles);
+}
+
+// map a binary mesh file and use its sections in place
+bool Mesh::loadBinaryMesh(std::string fileName)
 {
-    try
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    MeshFileHeader header;
+    // this happens if a mesh file only contains the same vertices
+    if (!file->open(fileName) || !readMeshFileHeader(*file, header) || header.modelSize == 0.0
+        || header.indexCount % 3 != 0)
     {
-        // open a mesh file
-        std::ofstream meshFile;
-        // clear the mesh file
-        meshFile.open(fileName, std::ofstream::trunc);
-        // then start adding the mesh data
-        
-        // number of faces
-        meshFile << _meshVertices.size() / 3 << "\n";
-        // each vertex
-        for(unsigned int vertex = 0; vertex < _meshVertices.size(); vertex++)
+        _modelSize = 1.0;
+        _meshVertices.clear();
+        _triangles.clear();
+        return false;
+    }
+
+    _meshVertices.map(file, header.positionOffset, header.vertexCount);
+    if (header.indexCount > 0)
+    {
+        // an indexed mesh is used in place, once every index is known to be in range
+        _triangles.map(file, header.indexOffset, header.indexCount);
+        const uint32_t* indices = _triangles.data();
+        std::atomic<bool> inRange(true);
+        parallelFor(_triangles.size(), [&](std::size_t begin, std::size_t end)
         {
-            switch(gridBuilder->_gridType)
-            {
-                case Grid::Bilinear:
-                {
-                    Vector deformedVertex = deformBilinear(vertex, gridBuilder->_grid, gridBuilder->_gridSize);
-                    meshFile << deformedVertex.x << " " << deformedVertex.y << " " << deformedVertex.z << "\n";
-                    break;
-                }
-                case Grid::Barycentric:
-                {
-                    Vector deformedVertex = deformBarycentric(vertex++, gridBuilder->_triangulationMesh);
-                    meshFile << deformedVertex.x << " " << deformedVertex.y << " " << deformedVertex.z << "\n";
-                    break;
-                }
-                case Grid::Trilinear:
-                {
-                    Vector deformedVertex = deformTrilinear(vertex, gridBuilder->_grid, gridBuilder->_gridSize);
-                    meshFile << deformedVertex.x << " " << deformedVertex.y << " " << deformedVertex.z << "\n";
-                    break;
-                }
-            }
+            for (std::size_t index = begin; index < end; index++)
+                if (indices[index] >= header.vertexCount)
+                    inRange = false;
+        });
+        if (!inRange)
+        {
+            _modelSize = 1.0;
+            _meshVertices.clear();
+            _triangles.clear();
+            return false;
         }
-        meshFile.close();
-    
     }
-    catch(const std::exception& e)
+    else
     {
-        QMessageBox errorMsg;
-        errorMsg.setText("Could not open file.");
-        errorMsg.exec();
+        // a triangle soup, as written by the streaming pipeline, is welded on load
+        _meshVertices.resize(header.vertexCount);
+        weldMesh();
     }
-    
+
+    // a stored binding is used if the grid matches when binding
+    _weights.clear();
+    meshChanged();
+    _storedWeights = header.weightCount > 0 && header.weightCount == _meshVertices.size()
+        && header.weightGridType >= 0 && header.weightGridType <= static_cast<int32_t>(Grid::BSpline)
+        && header.weightGridSize >= 2 && header.weightGridSize <= MAX_STORED_GRID_SIZE;
+    if (_storedWeights)
+    {
+        _weightsGridType = static_cast<Grid>(header.weightGridType);
+        _weightsGridSize = header.weightGridSize;
+        // a binding with cells outside its grid is dropped and worked out again when binding
+        _storedWeights = readWeights(reinterpret_cast<const Vector*>(file->data() + header.weightOffset),
+            reinterpret_cast<const Vector*>(file->data() + header.faceOffset));
+        if (!_storedWeights)
+            _weights.clear();
+    }
+
+    _meshMidPoint = Vector(header.midPoint[0], header.midPoint[1], header.midPoint[2]);
+    _minCoords = Vector(header.minCoords[0], header.minCoords[1], header.minCoords[2]);
+    _maxCoords = Vector(header.maxCoords[0], header.maxCoords[1], header.maxCoords[2]);
+    _modelSize = header.modelSize;
+    return true;
+}
+
+// write the mesh as loaded to a binary mesh file, along with its binding to
+// gridBuilder's grid if one is given so that it need not be computed again
+bool Mesh::saveBinaryMesh(std::string fileName, GridBuilder* gridBuilder)
+{
+    MeshFileHeader header;
+    initMeshFileHeader(header);
+    header.vertexCount = _meshVertices.size();
+    header.indexCount = _triangles.size();
+    header.midPoint[0] = _meshMidPoint.x; header.midPoint[1] = _meshMidPoint.y; header.midPoint[2] = _meshMidPoint.z;
+    header.minCoords[0] = _minCoords.x; header.minCoords[1] = _minCoords.y; header.minCoords[2] = _minCoords.z;
+    header.maxCoords[0] = _maxCoords.x; header.maxCoords[1] = _maxCoords.y; header.maxCoords[2] = _maxCoords.z;
+    header.modelSize = _modelSize;
+
+    // a barycentric binding depends on a random triangulation and a sparse one on the cells
+    // the lattice has, so neither is stored
+    std::vector<Vector> weights, faces;
+    if (gridBuilder != nullptr && gridBuilder->getGridType() != Grid::Barycentric
+        && gridBuilder->getGridType() != Grid::SparseTrilinear && _weights.size() == _meshVertices.size())
+    {
+        header.weightCount = _weights.size();
+        header.weightGridType = static_cast<int32_t>(gridBuilder->getGridType());
+        header.weightGridSize = gridBuilder->getGridSize();
+        writeWeights(weights, faces);
+    }
+
+    return writeMeshFile(fileName, header, _meshVertices.data(), _triangles.data(), weights.data(), faces.data());
+}
+
+// save the deformed mesh to a file, we need the grid data to deform the vertices 
+bool Mesh::saveMesh(std::string fileName, GridBuilder* gridBuilder)
+{
+    if (hasMeshFileExtension(fileName))
+    {
+        // the deformed mesh is centred the same way as when loading a text mesh
+        std::vector<Vector> deformedVertices;
+        deformMesh(gridBuilder, deformedVertices);
+        MeshFileHeader header;
+        centreDeformedMesh(deformedVertices, header);
+
+        return writeMeshFile(fileName, header, deformedVertices.data(), _triangles.data(), nullptr, nullptr);
+    }
+
+    // open a mesh file
+    std::ofstream meshFile;
+    // clear the mesh file
+    meshFile.open(fileName, std::ofstream::trunc);
+    if (!meshFile.is_open())
+        return false;
+
+    // the unique vertices deformed in one go, then written out as text
+    std::vector<std::string> parts;
+    formatTextMesh(getDeformedVertices(gridBuilder), parts);
+    for (std::size_t part = 0; part < parts.size(); part++)
+        meshFile.write(parts[part].data(), parts[part].size());
+    meshFile.close();
+
+    return !meshFile.fail();
+}
+
+void Mesh::centreDeformedMesh(std::vector<Vector>& deformedVertices, MeshFileHeader& header) const
+{
+    initMeshFileHeader(header);
+    Vector midPoint, minCoords, maxCoords;
+    centreVertices(deformedVertices.data(), deformedVertices.size(), _triangles.data(), _triangles.size(),
+        midPoint, minCoords, maxCoords);
+    header.vertexCount = deformedVertices.size();
+    header.indexCount = _triangles.size();
+    header.midPoint[0] = midPoint.x; header.midPoint[1] = midPoint.y; header.midPoint[2] = midPoint.z;
+    header.minCoords[0] = minCoords.x; header.minCoords[1] = minCoords.y; header.minCoords[2] = minCoords.z;
+    header.maxCoords[0] = maxCoords.x; header.maxCoords[1] = maxCoords.y; header.maxCoords[2] = maxCoords.z;
+    header.modelSize = (maxCoords - minCoords).magnitude();
+}
+
+void Mesh::formatTextMesh(const std::vector<Vector>& deformedVertices, std::vector<std::string>& parts) const
+{
+    // the line of every unique vertex, formatted once however many triangles share it,
+    // its length in the first byte of its slot
+    std::size_t nVertices = deformedVertices.size();
+    std::unique_ptr<char[]> lines(new char[nVertices * TEXT_LINE_SLOT]);
+    parallelFor(nVertices, [&](std::size_t begin, std::size_t end)
+    {
+        // general notation to 6 digits is %g, which is how a stream writes a float by
+        // default, so the text is the same
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            char* line = lines.get() + vertex * TEXT_LINE_SLOT + 1;
+            char* lineEnd = line + TEXT_LINE_SLOT - 1;
+            char* next = std::to_chars(line, lineEnd, (double)deformedVertices[vertex].x, std::chars_format::general, 6).ptr;
+            *next++ = ' ';
+            next = std::to_chars(next, lineEnd, (double)deformedVertices[vertex].y, std::chars_format::general, 6).ptr;
+            *next++ = ' ';
+            next = std::to_chars(next, lineEnd, (double)deformedVertices[vertex].z, std::chars_format::general, 6).ptr;
+            *next++ = '\n';
+            line[-1] = next - line;
+        }
+    });
+
+    // number of faces, then each vertex of each triangle, text files stay a triangle soup
+    std::size_t nTriangles = _triangles.size() / 3;
+    parts.resize(std::max<std::size_t>((nTriangles + TEXT_PART_TRIANGLES - 1) / TEXT_PART_TRIANGLES, 1));
+    parallelFor(parts.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t part = begin; part < end; part++)
+        {
+            std::string& text = parts[part];
+            text.clear();
+            if (part == 0)
+                text += std::to_string(nTriangles) + "\n";
+            std::size_t last = std::min(nTriangles, (part + 1) * TEXT_PART_TRIANGLES) * 3;
+            for (std::size_t index = part * TEXT_PART_TRIANGLES * 3; index < last; index++)
+            {
+                const char* line = lines.get() + _triangles[index] * TEXT_LINE_SLOT;
+                text.append(line + 1, line[0]);
+            }
+        }
+    });
+}
+
+// use a chunk of a mesh as the mesh, the previous vertices are handed back
+void Mesh::swapVertices(std::vector<Vector>& vertices, float modelSize)
+{
+    _meshVertices.swap(vertices);
+    _triangles.clear();
+    _modelSize = modelSize;
+    meshChanged();
 }
 
 // generates vertex weights depending on the type of grid chosen
-void Mesh::getVertexWeights(GridBuilder* gridBuilder)
+bool Mesh::getVertexWeights(GridBuilder* gridBuilder)
 {
+    // weights loaded with a binary mesh are used when they match the grid
+    if (_storedWeights)
+    {
+        if (_weightsGridType == gridBuilder->getGridType() && _weightsGridSize == gridBuilder->getGridSize()
+            && storedWeightsFit(gridBuilder))
+            return true;
+        _storedWeights = false;
+    }
+    _weightsGridType = gridBuilder->getGridType();
+    _weightsGridSize = gridBuilder->getGridSize();
+    invalidateDeformed();
+
     switch (gridBuilder->getGridType())
     {
     case Grid::Bilinear:
         getBilinearWeights(gridBuilder->_gridSize);
         break;
     case Grid::Barycentric:
-        getBarycentricWeights(gridBuilder->_triangulationMesh);
+        getBarycentricWeights(gridBuilder->_triangleLocator);
         break;
     case Grid::Trilinear:
         getTrilinearWeights(gridBuilder->_gridSize);
         break;
+    case Grid::BSpline:
+        getBSplineWeights(gridBuilder->_gridSize);
+        break;
+    case Grid::SparseTrilinear:
+        return getSparseTrilinearWeights(gridBuilder->_sparseLattice);
     default:
         break;
     }
+    return true;
 }
 
-// draws the mesh as loaded from the file
-void Mesh::drawMesh(GridBuilder* gridBuilder)
+// deforms every vertex of the mesh with the SIMD kernels the cpu supports,
+// the switch happens once rather than per vertex
+void Mesh::deformMesh(GridBuilder* gridBuilder, std::vector<Vector>& deformedVertices)
 {
+    deformedVertices.resize(_meshVertices.size());
+    Vector* deformed = deformedVertices.data();
+    const Vector* grid = gridBuilder->_grid.data();
+    const int* triangles = gridBuilder->_triangles.data();
+    const int32_t* corners = gridBuilder->_sparseLattice.getCorners();
+    int gridSize = gridBuilder->getGridSize();
     switch (gridBuilder->getGridType())
     {
         case Grid::Bilinear:
-            drawBilinearMesh(gridBuilder->_grid, gridBuilder->getGridSize());
+            parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformBilinearStreams(_weights, grid, gridSize, deformed, begin, end);
+            });
             break;
         case Grid::Barycentric:
-            drawBarycentricMesh(gridBuilder->_triangulationMesh);
-           break;
+            parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformBarycentricStreams(_weights, grid, triangles, deformed, begin, end);
+            });
+            break;
         case Grid::Trilinear:
-            drawTrilinearMesh(gridBuilder->_grid, gridBuilder->getGridSize());
-           break;
-
+            parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformTrilinearStreams(_weights, grid, gridSize, deformed, begin, end);
+            });
+            break;
+        case Grid::BSpline:
+            parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformBSplineStreams(_weights, grid, gridSize, deformed, begin, end);
+            });
+            break;
+        case Grid::SparseTrilinear:
+            parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformSparseTrilinearStreams(_weights, grid, corners, deformed, begin, end);
+            });
+            break;
         default:
+            deformedVertices.assign(_meshVertices.begin(), _meshVertices.end());
             break;
     }
 }
 
-// Biliear                                                          //
-// -----------------------------------------------------------------//
-//                                                                  //
-
-// for each vertex in the mesh, determine what is u,v weights are
-void Mesh::getBilinearWeights(int gridSize)
+// the grid points of a vertex of each grid type, every row of a type is as long
+static int weightRowLength(Grid gridType)
 {
-    // resize weights vertex
-    _weights.resize(_meshVertices.size());
-    _faces.resize(_meshVertices.size());
-    // determine what the grid origin is
-    Vector gridOrigin = Vector(-_modelSize/2.0, _modelSize/2.0, 0.0);
-    // iterate over each mesh vertex 
-    for (unsigned int vertex = 0; vertex < _meshVertices.size(); vertex++)
-    {
-        // determine what it's grid row and column (face) it belongs to
-        // Vector from grid origin to vertex position
-        Vector toOrigin = (gridOrigin - _meshVertices[vertex]) / (_modelSize / (gridSize-1));
-        // Add data to weights and faces for easy rendering
-        _weights[vertex] = Vector((int)toOrigin.x - toOrigin.x, toOrigin.y - (int)toOrigin.y, 0.0);
-        _faces[vertex] = Vector(-(int)toOrigin.x, (int)toOrigin.y, 0.0);
+    switch (gridType)
+    {
+    case Grid::Bilinear:
+        return 4;
+    case Grid::Barycentric:
+        return 3;
+    case Grid::Trilinear:
+    case Grid::SparseTrilinear:
+        return 8;
+    case Grid::BSpline:
+        return 64;
+    default:
+        return 0;
     }
 }
 
-// mesh draw function for a regular grid using bilinear interpolation
-void Mesh::drawBilinearMesh(std::vector<Vector>& gridVertices, int gridSize)
-{
-    glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-    glBegin(GL_TRIANGLES);
-    // for each vertex, draw a vertex at the interpolated position
-    for(unsigned int vertex = 0; vertex < _meshVertices.size(); )
-    {
-       Vector v0 = deformBilinear(vertex++, gridVertices, gridSize);
-       Vector v1 = deformBilinear(vertex++, gridVertices, gridSize);
-       Vector v2 = deformBilinear(vertex++, gridVertices, gridSize);
-       
-       // We don't compute the normals here because we are in fact squishing all
-       // the faces of the model onto the xy plane, which gives awful results for 3d
-       // meshes and overlapping faces
-       glVertex3fv(&v0.x);
-       glVertex3fv(&v1.x);
-       glVertex3fv(&v2.x);
+void Mesh::fillWeightRows(GridBuilder* gridBuilder, std::size_t begin, std::size_t end,
+    int32_t* columns, float* values) const
+{
+    // the weights are worked out in doubles
+    int gridSize = gridBuilder->getGridSize();
+    int layer = gridSize * gridSize;
+    std::size_t count = _weights.size();
+    switch (gridBuilder->getGridType())
+    {
+    case Grid::Bilinear:
+        for (std::size_t vertex = begin; vertex < end; vertex++, columns += 4, values += 4)
+        {
+            double u = _weights.u[vertex], v = _weights.v[vertex];
+            for (int corner = 0; corner < 4; corner++)
+            {
+                int x = corner & 1, y = corner >> 1;
+                columns[corner] = _weights.cell[vertex] + x + y * gridSize;
+                values[corner] = (x ? u : 1 - u) * (y ? v : 1 - v);
+            }
+        }
+        break;
+    case Grid::Barycentric:
+        for (std::size_t vertex = begin; vertex < end; vertex++, columns += 3, values += 3)
+        {
+            const int* corners = gridBuilder->_triangles.data() + _weights.cell[vertex];
+            columns[0] = corners[0];
+            columns[1] = corners[1];
+            columns[2] = corners[2];
+            values[0] = _weights.u[vertex];
+            values[1] = _weights.v[vertex];
+            values[2] = _weights.w[vertex];
+        }
+        break;
+    case Grid::Trilinear:
+        for (std::size_t vertex = begin; vertex < end; vertex++, columns += 8, values += 8)
+        {
+            double u = _weights.u[vertex], v = _weights.v[vertex], w = _weights.w[vertex];
+            for (int corner = 0; corner < 8; corner++)
+            {
+                int x = corner & 1, y = (corner >> 1) & 1, z = corner >> 2;
+                columns[corner] = _weights.cell[vertex] + x + y * gridSize + z * layer;
+                values[corner] = (x ? u : 1 - u) * (y ? v : 1 - v) * (z ? w : 1 - w);
+            }
+        }
+        break;
+    case Grid::BSpline:
+        for (std::size_t vertex = begin; vertex < end; vertex++, columns += 64, values += 64)
+        {
+            // the product of the basis along x, y and z, (x y) z as the manipulator takes it
+            const float* basis = _weights.basis.data() + vertex;
+            double bx[4], by[4], bz[4];
+            for (int k = 0; k < 4; k++)
+            {
+                bx[k] = basis[k * count];
+                by[k] = basis[(4 + k) * count];
+                bz[k] = basis[(8 + k) * count];
+            }
+            for (int z = 0; z < 4; z++)
+            {
+                for (int y = 0; y < 4; y++)
+                {
+                    int corner = (z * 4 + y) * 4;
+                    int point = _weights.cell[vertex] + y * gridSize + z * layer;
+                    for (int x = 0; x < 4; x++)
+                    {
+                        columns[corner + x] = point + x;
+                        values[corner + x] = bx[x] * by[y] * bz[z];
+                    }
+                }
+            }
+        }
+        break;
+    case Grid::SparseTrilinear:
+        for (std::size_t vertex = begin; vertex < end; vertex++, columns += 8, values += 8)
+        {
+            // the lattice lists the corners in the order of the dense cell's
+            const int32_t* corners = gridBuilder->_sparseLattice.getCorners() + 8 * _weights.cell[vertex];
+            double u = _weights.u[vertex], v = _weights.v[vertex], w = _weights.w[vertex];
+            for (int corner = 0; corner < 8; corner++)
+            {
+                int x = corner & 1, y = (corner >> 1) & 1, z = corner >> 2;
+                columns[corner] = corners[corner];
+                values[corner] = (x ? u : 1 - u) * (y ? v : 1 - v) * (z ? w : 1 - w);
+            }
+        }
+        break;
+    default:
+        break;
     }
-    glEnd();
 }
 
-// returns the bilinear interpolation of a given vertex relative to its grid vertices 
-Vector Mesh::deformBilinear(int vertex, std::vector<Vector>& gridVertices, int gridSize)
+const WeightMatrix& Mesh::getWeightMatrix(GridBuilder* gridBuilder)
 {
-    // get the row and column indices for face point calc
-    // row and col are both in relation to gridsize with the top right 
-    // corner as the origin
-    int row = _faces[vertex].y;
-    int col = _faces[vertex].x;
-    // get weights
-    float u = _weights[vertex].x; 
-    float v = _weights[vertex].y;
-    // calculate vertex position based on grid vertices which we can access with row and col
-    Vector p00 = gridVertices[(row + 1) * gridSize + col    ];
-    Vector p10 = gridVertices[(row + 1) * gridSize + col + 1];
-    Vector p01 = gridVertices[row * gridSize + col    ];
-    Vector p11 = gridVertices[row * gridSize + col + 1];
+    if (_weightMatrixStamp == _bindingStamp)
+        return _weightMatrix;
 
-    Vector deformedVertex = p10 * u * v + p00 * v * (1-u) + p11 * u * (1-v) + p01 * (1-u) * (1-v);
-    return deformedVertex;
+    int rowLength = weightRowLength(gridBuilder->getGridType());
+    _weightMatrix.resize(_weights.size(), rowLength);
+    parallelFor(_weights.size(), [&](std::size_t begin, std::size_t end)
+    {
+        fillWeightRows(gridBuilder, begin, end, _weightMatrix.columns.data() + begin * rowLength,
+            _weightMatrix.values.data() + begin * rowLength);
+    });
+    _weightMatrixStamp = _bindingStamp;
+    return _weightMatrix;
 }
 
+void Mesh::deformSparse(GridBuilder* gridBuilder, std::vector<Vector>& deformedVertices)
+{
+    const WeightMatrix& matrix = getWeightMatrix(gridBuilder);
+    deformedVertices.resize(_meshVertices.size());
+    Vector* deformed = deformedVertices.data();
+    const Vector* grid = gridBuilder->_grid.data();
+    parallelFor(matrix.rows(), [&](std::size_t begin, std::size_t end)
+    {
+        ::deformSparse(matrix, grid, deformed, begin, end);
+    });
+}
 
-// Barycentric                                                      //
-// -----------------------------------------------------------------//
-//                                                                  //
+// vertices whose rows are worked out together, few enough for the rows to stay in
+// cache while every pose reads them
+static const std::size_t POSE_BLOCK = 128;
 
-void Mesh::getBarycentricWeights(std::vector<Vector>& triangulationMesh)
+void Mesh::deformPoses(GridBuilder* gridBuilder, const std::vector<const Vector*>& poses,
+    std::vector<std::vector<Vector>>& deformedPoses)
 {
-    // for each vertex in the mesh, apply the halfplane test on the whole triangular mesh 
-    // for the triangle that satisfies the test, determine the weights associated and store in _weights vector
-    // for each triangle in the triangular  
-    _weights.resize(_meshVertices.size());
-    _faces.resize(_meshVertices.size());
+    std::size_t poseCount = poses.size();
+    std::size_t pointCount = gridBuilder->_grid.size();
+    std::size_t vertexCount = _weights.size();
+    deformedPoses.resize(poseCount);
+    for (std::size_t pose = 0; pose < poseCount; pose++)
+        deformedPoses[pose].resize(vertexCount);
 
-    for(unsigned int vertex = 0; vertex < _meshVertices.size(); vertex++)
+    // the poses POSE_LANES at a time, each group every point's x of its poses then y then z
+    std::size_t groups = (poseCount + POSE_LANES - 1) / POSE_LANES;
+    std::size_t groupSize = pointCount * 3 * POSE_LANES;
+    std::vector<float, AlignedAllocator<float> > packed(groups * groupSize, 0.0f);
+    parallelFor(pointCount, [&](std::size_t begin, std::size_t end)
     {
-        // get weights for the vertex depending ontriangulation mesh
-        for(unsigned int triangle = 0; triangle < triangulationMesh.size(); triangle+=3)
+        for (std::size_t pose = 0; pose < poseCount; pose++)
         {
-            // calculate the areas of the triangles and two of its subtriangles
-            float triangleArea = Vector::dot(Vector(0.0, 0.0, 1.0), 
-                Vector::cross(triangulationMesh[triangle + 1] - triangulationMesh[triangle], triangulationMesh[triangle + 2] - triangulationMesh[triangle]));
-            float zeta1 = Vector::dot(Vector(0.0, 0.0, 1.0), 
-                Vector::cross(_meshVertices[vertex] - triangulationMesh[triangle], triangulationMesh[triangle + 2] - triangulationMesh[triangle]));
-            float zeta2 = Vector::dot(Vector(0.0, 0.0, 1.0), 
-                Vector::cross(triangulationMesh[triangle + 1] - triangulationMesh[triangle], _meshVertices[vertex] - triangulationMesh[triangle]));
-
-            // get the values of s and t 
-            float s = zeta1 / triangleArea;
-            float t = zeta2 / triangleArea;
-
-            // if s and t satisfiy these conditions, then the point is inside the triangle!
-            if (( (0.0 <= s) && (s <= 1.0) ) && ( (0.0 <= t) && (t <= 1.0) ) && (s + t <= 1.0)) 
+            float* group = packed.data() + pose / POSE_LANES * groupSize + pose % POSE_LANES;
+            for (std::size_t point = begin; point < end; point++)
             {
-                // store alpha, beta, gamma
-                _weights[vertex] = Vector(1 - s - t, s, t);
-                // store the triangulation vertices for when we want to draw the model mesh
-                _faces[vertex] = Vector(triangle, triangle + 1, triangle + 2);
-                // break the loop over triangulation mesh
-                break;
+                group[point * 3 * POSE_LANES] = poses[pose][point].x;
+                group[(point * 3 + 1) * POSE_LANES] = poses[pose][point].y;
+                group[(point * 3 + 2) * POSE_LANES] = poses[pose][point].z;
+            }
+        }
+    });
+    std::vector<Vector*> outputs(poseCount);
+    for (std::size_t pose = 0; pose < poseCount; pose++)
+        outputs[pose] = deformedPoses[pose].data();
+
+    // the rows of a block of vertices are worked out once and used for every pose
+    int rowLength = weightRowLength(gridBuilder->getGridType());
+    parallelFor(vertexCount, [&](std::size_t begin, std::size_t end)
+    {
+        WeightMatrix rows;
+        for (std::size_t first = begin; first < end; first += POSE_BLOCK)
+        {
+            std::size_t last = std::min(first + POSE_BLOCK, end);
+            rows.resize(last - first, rowLength);
+            fillWeightRows(gridBuilder, first, last, rows.columns.data(), rows.values.data());
+            for (std::size_t group = 0; group < groups; group++)
+            {
+                int lanes = std::min<std::size_t>(POSE_LANES, poseCount - group * POSE_LANES);
+                deformSparsePoses(rows, packed.data() + group * groupSize, lanes,
+                    outputs.data() + group * POSE_LANES, first);
             }
         }
+    });
+}
+
+const std::vector<Vector>& Mesh::getDeformedVertices(GridBuilder* gridBuilder)
+{
+    if (_deformedGrid != gridBuilder || _deformedVersion != gridBuilder->getVersion())
+    {
+        bool updated = updateDeformed(gridBuilder);
+        if (!updated)
+        {
+            deformMesh(gridBuilder, _deformedVertices);
+            _updatedFrom = 0;
+        }
+        _verticesUpdatedFrom = updated ? _deformedStamp : 0;
+        _deformedStamp = nextMeshStamp++;
+        _deformedGrid = gridBuilder;
+        _deformedVersion = gridBuilder->getVersion();
     }
+    return _deformedVertices;
+}
 
+// flat normal of a deformed triangle
+static inline Vector triangleNormal(const Vector* deformed, const uint32_t* indices, std::size_t triangle)
+{
+    // now compute the normal vector
+    Vector v0 = deformed[indices[triangle * 3]];
+    Vector v1 = deformed[indices[triangle * 3 + 1]];
+    Vector v2 = deformed[indices[triangle * 3 + 2]];
+    Vector uVec = v1 - v0;
+    Vector vVec = v2 - v0;
+    return Vector::cross(uVec, vVec).normalise();
 }
 
-void Mesh::drawBarycentricMesh(std::vector<Vector>& triangulationMesh)
+const std::vector<Vector>& Mesh::getDeformedNormals(GridBuilder* gridBuilder)
 {
-    glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-    glBegin(GL_TRIANGLES);
-    // iterate over the mesh vertices
-    // get the vertex's weights
-    // get the positions of each vertex stored in faces (by id)
-    // interpolate based on weights and faces
-    for (unsigned int vertex = 0; vertex < _meshVertices.size(); )
+    const Vector* deformed = getDeformedVertices(gridBuilder).data();
+    if (_normalsVersion != _deformedVersion)
     {
-        Vector v0 = deformBarycentric(vertex++, triangulationMesh);
-        Vector v1 = deformBarycentric(vertex++, triangulationMesh);
-        Vector v2 = deformBarycentric(vertex++, triangulationMesh);
-        
-        // Don't draw normal for same reasons as bilinear
-        glVertex3fv(&v0.x);
-        glVertex3fv(&v1.x);
-        glVertex3fv(&v2.x);
+        bool updated = updateNormals();
+        if (!updated)
+        {
+            _deformedNormals.resize(_triangles.size() / 3);
+            const uint32_t* indices = _triangles.data();
+            parallelFor(_deformedNormals.size(), [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t triangle = begin; triangle < end; triangle++)
+                    _deformedNormals[triangle] = triangleNormal(deformed, indices, triangle);
+            });
+        }
+        _normalsUpdatedFrom = updated ? _normalsStamp : 0;
+        _normalsStamp = nextMeshStamp++;
+        _normalsVersion = _deformedVersion;
+    }
+    return _deformedNormals;
+}
+
+void Mesh::getDeformedFrame(GridBuilder* gridBuilder, bool normals, DeformedFrame& frame)
+{
+    frame.vertices = &getDeformedVertices(gridBuilder);
+    frame.normals = normals ? &getDeformedNormals(gridBuilder) : nullptr;
+    frame.vertexStamp = _deformedStamp;
+    frame.normalStamp = normals ? _normalsStamp : 0;
+    // an update only lists what changed since the stamp just before it
+    frame.updatedVertices = &_updatedVertices;
+    frame.updatedTriangles = &_updatedTriangles;
+    frame.verticesUpdatedFrom = _verticesUpdatedFrom;
+    frame.normalsUpdatedFrom = normals ? _normalsUpdatedFrom : 0;
+}
+
+unsigned long long Mesh::getMeshStamp() const
+{
+    return _meshStamp;
+}
+
+unsigned long long Mesh::getBindingStamp() const
+{
+    return _bindingStamp;
+}
+
+// past this share of the mesh it is quicker to deform all of it with the SIMD kernels
+// than to deform the scattered vertices one at a time
+static const std::size_t UPDATE_SHARE = 4;
+
+bool Mesh::updateDeformed(GridBuilder* gridBuilder)
+{
+    std::vector<int> points;
+    if (_deformedVersion == 0 || _deformedGrid != gridBuilder ||
+        !gridBuilder->getChangedPoints(_deformedVersion, points))
+    {
+        // the grid was rebuilt, so the index may no longer match it
+        _pointVertices.clear();
+        return false;
+    }
+    if (_weightsGridType != gridBuilder->getGridType() || _weightsGridSize != gridBuilder->getGridSize())
+        return false;
+
+    // the vertices depending on a point are those whose cell or triangle has it as a corner
+    const Vector* grid = gridBuilder->_grid.data();
+    const int* triangles = gridBuilder->_triangles.data();
+    const int32_t* corners = gridBuilder->_sparseLattice.getCorners();
+    int gridSize = gridBuilder->getGridSize();
+    const int32_t* cells = _weights.cell.data();
+    if (_pointVertices.isEmpty())
+    {
+        int layer = gridSize * gridSize;
+        switch (gridBuilder->getGridType())
+        {
+        case Grid::Bilinear:
+            _pointVertices.build(gridBuilder->_grid.size(), _weights.size(), 4, [&](std::size_t vertex, int corner)
+            {
+                return cells[vertex] + (corner & 1) + (corner >> 1) * gridSize;
+            });
+            break;
+        case Grid::Barycentric:
+            _pointVertices.build(gridBuilder->_grid.size(), _weights.size(), 3, [&](std::size_t vertex, int corner)
+            {
+                return triangles[cells[vertex] + corner];
+            });
+            break;
+        case Grid::Trilinear:
+            _pointVertices.build(gridBuilder->_grid.size(), _weights.size(), 8, [&](std::size_t vertex, int corner)
+            {
+                return cells[vertex] + (corner & 1) + ((corner >> 1) & 1) * gridSize + (corner >> 2) * layer;
+            });
+            break;
+        case Grid::BSpline:
+            // the 4x4x4 control points of the span, so a point only reaches the vertices of its 64 spans
+            _pointVertices.build(gridBuilder->_grid.size(), _weights.size(), 64, [&](std::size_t vertex, int corner)
+            {
+                return cells[vertex] + (corner & 3) + ((corner >> 2) & 3) * gridSize + (corner >> 4) * layer;
+            });
+            break;
+        case Grid::SparseTrilinear:
+            _pointVertices.build(gridBuilder->_grid.size(), _weights.size(), 8, [&](std::size_t vertex, int corner)
+            {
+                return corners[8 * cells[vertex] + corner];
+            });
+            break;
+        default:
+            return false;
+        }
+    }
+
+    std::size_t affected = 0;
+    for (unsigned int point = 0; point < points.size(); point++)
+        affected += _pointVertices.count(points[point]);
+    if (affected > _weights.size() / UPDATE_SHARE)
+        return false;
+
+    // a vertex bound to several of the points is only deformed once
+    _updatedVertices.clear();
+    for (unsigned int point = 0; point < points.size(); point++)
+        _updatedVertices.insert(_updatedVertices.end(), _pointVertices.begin(points[point]), _pointVertices.end(points[point]));
+    if (points.size() > 1)
+    {
+        std::sort(_updatedVertices.begin(), _updatedVertices.end());
+        _updatedVertices.erase(std::unique(_updatedVertices.begin(), _updatedVertices.end()), _updatedVertices.end());
     }
-    glEnd();
+    _updatedFrom = _deformedVersion;
+
+    Vector* deformed = _deformedVertices.data();
+    const uint32_t* vertices = _updatedVertices.data();
+    switch (gridBuilder->getGridType())
+    {
+        case Grid::Bilinear:
+            parallelFor(_updatedVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformBilinearVertices(_weights, grid, gridSize, deformed, vertices + begin, end - begin);
+            });
+            break;
+        case Grid::Barycentric:
+            parallelFor(_updatedVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformBarycentricVertices(_weights, grid, triangles, deformed, vertices + begin, end - begin);
+            });
+            break;
+        case Grid::Trilinear:
+            parallelFor(_updatedVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformTrilinearVertices(_weights, grid, gridSize, deformed, vertices + begin, end - begin);
+            });
+            break;
+        case Grid::BSpline:
+            parallelFor(_updatedVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformBSplineVertices(_weights, grid, gridSize, deformed, vertices + begin, end - begin);
+            });
+            break;
+        case Grid::SparseTrilinear:
+            parallelFor(_updatedVertices.size(), [&](std::size_t begin, std::size_t end)
+            {
+                deformSparseTrilinearVertices(_weights, grid, corners, deformed, vertices + begin, end - begin);
+            });
+            break;
+        default:
+            break;
+    }
+    return true;
 }
 
-Vector Mesh::deformBarycentric(int vertex, std::vector<Vector>& triangulationMesh)
+// compute again the normals of the triangles of the vertices the last update deformed,
+// returns false if the normals are not just one update behind
+bool Mesh::updateNormals()
 {
-    // get triangle data for desired vertex and multiply by the corresponding weight
-    Vector deformedVertex = triangulationMesh[_faces[vertex].x] * _weights[vertex].x + 
-                                triangulationMesh[_faces[vertex].y] * _weights[vertex].y + 
-                                triangulationMesh[_faces[vertex].z] * _weights[vertex].z;
-    return deformedVertex;
+    std::size_t triangleCount = _triangles.size() / 3;
+    if (_updatedFrom == 0 || _normalsVersion != _updatedFrom || _deformedNormals.size() != triangleCount)
+        return false;
+
+    const uint32_t* indices = _triangles.data();
+    if (_vertexTriangles.isEmpty())
+    {
+        _vertexTriangles.build(_meshVertices.size(), triangleCount, 3, [&](std::size_t triangle, int corner)
+        {
+            return indices[triangle * 3 + corner];
+        });
+    }
+
+    _updatedTriangles.clear();
+    for (std::size_t vertex = 0; vertex < _updatedVertices.size(); vertex++)
+    {
+        uint32_t index = _updatedVertices[vertex];
+        _updatedTriangles.insert(_updatedTriangles.end(), _vertexTriangles.begin(index), _vertexTriangles.end(index));
+        if (_updatedTriangles.size() > 3 * triangleCount / UPDATE_SHARE)
+            return false;
+    }
+    std::sort(_updatedTriangles.begin(), _updatedTriangles.end());
+    _updatedTriangles.erase(std::unique(_updatedTriangles.begin(), _updatedTriangles.end()), _updatedTriangles.end());
+
+    const Vector* deformed = _deformedVertices.data();
+    const uint32_t* triangles = _updatedTriangles.data();
+    parallelFor(_updatedTriangles.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t triangle = begin; triangle < end; triangle++)
+            _deformedNormals[triangles[triangle]] = triangleNormal(deformed, indices, triangles[triangle]);
+    });
+    return true;
+}
+
+void Mesh::invalidateDeformed()
+{
+    // the binding changes with the mesh or the grid, and so does the deformation
+    _bindingStamp = nextMeshStamp++;
+    _weightMatrix.clear();
+    _weightMatrixStamp = 0;
+    _deformedGrid = nullptr;
+    _deformedVersion = 0;
+    _normalsVersion = 0;
+    _updatedFrom = 0;
+    _pointVertices.clear();
+    _vertexTriangles.clear();
+    _verticesUpdatedFrom = 0;
+    _normalsUpdatedFrom = 0;
+}
+
+void Mesh::meshChanged()
+{
+    _meshStamp = nextMeshStamp++;
+    invalidateDeformed();
+}
+
+// fill the weight streams from the weights and faces of a binary mesh file, false if
+// a cell doesn't lie in a grid of the stored size
+bool Mesh::readWeights(const Vector* weights, const Vector* faces)
+{
+    _weights.resize(_meshVertices.size());
+    int gridSize = _weightsGridSize;
+    std::atomic<bool> inRange(true);
+    parallelFor(_weights.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            _weights.u[vertex] = weights[vertex].x;
+            _weights.v[vertex] = weights[vertex].y;
+            _weights.w[vertex] = weights[vertex].z;
+            // faces hold the column, row and layer of the cell, whole numbers within the grid
+            const Vector& face = faces[vertex];
+            if (!(face.x >= 0 && face.x < gridSize && face.y >= 0 && face.y < gridSize && face.z >= 0 && face.z < gridSize)
+                || face.x != (int)face.x || face.y != (int)face.y || face.z != (int)face.z)
+            {
+                inRange = false;
+                _weights.cell[vertex] = 0;
+                continue;
+            }
+            _weights.cell[vertex] = ((int)face.z * gridSize + (int)face.y) * gridSize + (int)face.x;
+        }
+    });
+    if (!inRange)
+        return false;
+    // the basis is not stored, it follows from the place in the span
+    if (_weightsGridType == Grid::BSpline)
+        fillBSplineBasis();
+    return true;
+}
+
+// whether every point the stored binding reads lies in the grid it is used with, a
+// triangulation loaded with a grid need not have as many triangles as the one bound to
+bool Mesh::storedWeightsFit(const GridBuilder* gridBuilder) const
+{
+    int64_t gridSize = gridBuilder->_gridSize;
+    int64_t points = gridBuilder->_grid.size();
+    // how far past its cell a vertex reads, in points or in the triangulation
+    int64_t reach = 0;
+    switch (_weightsGridType)
+    {
+    case Grid::Bilinear:
+        reach = gridSize + 1;
+        break;
+    case Grid::Barycentric:
+        points = gridBuilder->_triangles.size();
+        reach = 2;
+        break;
+    case Grid::Trilinear:
+        reach = gridSize * gridSize + gridSize + 1;
+        break;
+    case Grid::BSpline:
+        reach = 3 * (gridSize * gridSize + gridSize + 1);
+        break;
+    default:
+        return false;
+    }
+    std::atomic<bool> inRange(true);
+    parallelFor(_weights.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+            if (_weights.cell[vertex] < 0 || _weights.cell[vertex] + reach >= points)
+                inRange = false;
+    });
+    return inRange;
+}
+
+// the weights and faces of a binary mesh file, which hold the cell as column, row and layer
+void Mesh::writeWeights(std::vector<Vector>& weights, std::vector<Vector>& faces)
+{
+    weights.resize(_weights.size());
+    faces.resize(_weights.size());
+    int gridSize = _weightsGridSize;
+    for (std::size_t vertex = 0; vertex < _weights.size(); vertex++)
+    {
+        int cell = _weights.cell[vertex];
+        weights[vertex] = Vector(_weights.u[vertex], _weights.v[vertex], _weights.w[vertex]);
+        faces[vertex] = Vector(cell % gridSize, cell / gridSize % gridSize, cell / (gridSize * gridSize));
+    }
+}
+
+// Biliear                                                          //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+// for each vertex in the mesh, determine what is u,v weights are
+void Mesh::getBilinearWeights(int gridSize)
+{
+    // resize weights vertex
+    _weights.resize(_meshVertices.size());
+    // determine what the grid origin is
+    Vector gridOrigin = Vector(-_modelSize/2.0, _modelSize/2.0, 0.0);
+    // every vertex is bound on its own, so the vertices are split across threads
+    parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            // determine what it's grid row and column (face) it belongs to
+            // Vector from grid origin to vertex position
+            Vector toOrigin = (gridOrigin - _meshVertices[vertex]) / (_modelSize / (gridSize-1));
+            // store the weights and the cell's top left point, row and col are both in
+            // relation to gridsize with the top left corner as the origin
+            _weights.u[vertex] = (int)toOrigin.x - toOrigin.x;
+            _weights.v[vertex] = toOrigin.y - (int)toOrigin.y;
+            _weights.w[vertex] = 0.0;
+            _weights.cell[vertex] = (int)toOrigin.y * gridSize - (int)toOrigin.x;
+        }
+    });
+}
+
+
+// Barycentric                                                      //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+void Mesh::getBarycentricWeights(const TriangleLocator& triangleLocator)
+{
+    // for each vertex in the mesh, find the triangle of the triangulation containing it
+    // and store the weights associated with it
+    _weights.resize(_meshVertices.size());
+
+    // every vertex is bound on its own, so the vertices are split across threads
+    parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            // a vertex outside of the triangulation follows the second vertex of the first triangle
+            _weights.u[vertex] = 0.0;
+            _weights.v[vertex] = 1.0;
+            _weights.w[vertex] = 0.0;
+            _weights.cell[vertex] = 0;
+
+            int triangle;
+            float s, t;
+            if (triangleLocator.locate(_meshVertices[vertex], triangle, s, t))
+            {
+                // store alpha, beta, gamma
+                _weights.u[vertex] = 1 - s - t;
+                _weights.v[vertex] = s;
+                _weights.w[vertex] = t;
+                // store where the triangle's vertex indices start in the triangulation
+                _weights.cell[vertex] = triangle;
+            }
+        }
+    });
 }
 
 // Trilinear                                                        //
@@ -331,105 +1151,125 @@ void Mesh::getTrilinearWeights(int gridSize)
 {
     // resize weights vertex
     _weights.resize(_meshVertices.size());
-    _faces.resize(_meshVertices.size());
     // determine what the grid origin is
     Vector gridOrigin = Vector(-_modelSize/2.0, _modelSize/2.0, -_modelSize/2.0);
-    // iterate over each mesh vertex 
-    for (unsigned int vertex = 0; vertex < _meshVertices.size(); vertex++)
-    {
-        // determine what it's grid row and column (face) it belongs to
-        // Vector from grid origin to vertex position
-        Vector toOrigin = (gridOrigin - _meshVertices[vertex]) / (_modelSize / (gridSize-1));
-        // Add data to weights and faces for easy rendering
-        _weights[vertex] = Vector((int)toOrigin.x - toOrigin.x, toOrigin.y - (int)toOrigin.y, (int)toOrigin.z - toOrigin.z);
-        _faces[vertex] = Vector(-(int)toOrigin.x, (int)toOrigin.y, -(int)toOrigin.z);
-    }
+    // every vertex is bound on its own, so the vertices are split across threads
+    parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            // determine what it's grid row and column (face) it belongs to
+            // Vector from grid origin to vertex position
+            Vector toOrigin = (gridOrigin - _meshVertices[vertex]) / (_modelSize / (gridSize-1));
+            // store the weights and the cell's front top left point
+            _weights.u[vertex] = (int)toOrigin.x - toOrigin.x;
+            _weights.v[vertex] = toOrigin.y - (int)toOrigin.y;
+            _weights.w[vertex] = (int)toOrigin.z - toOrigin.z;
+            _weights.cell[vertex] = (-(int)toOrigin.z * gridSize + (int)toOrigin.y) * gridSize - (int)toOrigin.x;
+        }
+    });
 }
 
-void Mesh::drawTrilinearMesh(std::vector<Vector>& gridVertices, int gridSize)
+// B-spline                                                         //
+// -----------------------------------------------------------------//
+//                                                                  //
+
+// like trilinear, with the span and place in it found along the lattice of control points,
+// which starts a spacing before the model, and 4x4x4 of them around the span weighed
+void Mesh::getBSplineWeights(int gridSize)
 {
-    glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-    glBegin(GL_TRIANGLES);
-    // for each vertex, draw a vertex at the interpolated position
-    for(unsigned int vertex = 0; vertex < _meshVertices.size(); )
+    _weights.resize(_meshVertices.size());
+    float spacing = _modelSize / (gridSize - 3);
+    // the far top left control point
+    Vector gridOrigin = Vector(-_modelSize/2.0 - spacing, _modelSize/2.0 + spacing, -_modelSize/2.0 - spacing);
+    parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
     {
-        Vector v0 = deformTrilinear(vertex++, gridVertices, gridSize);
-        Vector v1 = deformTrilinear(vertex++, gridVertices, gridSize);
-        Vector v2 = deformTrilinear(vertex++, gridVertices, gridSize);
-        // now compute the normal vector
-        Vector uVec = v1 - v0;
-        Vector vVec = v2 - v0;
-        Vector normal = Vector::cross(uVec, vVec).normalise();
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            // in spacings from the origin, rows going down
+            Vector toVertex = (Vector(_meshVertices[vertex]) - gridOrigin) / spacing;
+            float along[3] = { toVertex.x, -toVertex.y, toVertex.z };
+            int first[3];
+            float local[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                // the model lies in spans 1 to gridSize - 3, vertices on its far side take the last one
+                int span = std::min(std::max((int)std::floor(along[axis]), 1), gridSize - 3);
+                local[axis] = along[axis] - span;
+                first[axis] = span - 1;
+            }
+            _weights.u[vertex] = local[0];
+            _weights.v[vertex] = local[1];
+            _weights.w[vertex] = local[2];
+            _weights.cell[vertex] = (first[2] * gridSize + first[1]) * gridSize + first[0];
+        }
+    });
+    fillBSplineBasis();
+}
 
-        glNormal3fv(&normal.x);
-        glVertex3fv(&v0.x);
-        glVertex3fv(&v1.x);
-        glVertex3fv(&v2.x);
-    }
-    glEnd();
-}
-
-Vector Mesh::deformTrilinear(int vertex, std::vector<Vector>& gridVertices, int gridSize)
-{
-    // get the row and column indices for face point calc
-        // row and col are both in relation to gridsize with the top right 
-        // corner as the origin
-        int cel = _faces[vertex].z;
-        int row = _faces[vertex].y;
-        int col = _faces[vertex].x;
-        // get weights
-        float u = _weights[vertex].x; 
-        float v = _weights[vertex].y;
-        float w = _weights[vertex].z;
-        // fetch vectors
-        Vector p000 = gridVertices[cel*gridSize*gridSize + row*gridSize + col];
-        Vector p001 = gridVertices[cel*gridSize*gridSize + row*gridSize + col+1];
-        Vector p010 = gridVertices[cel*gridSize*gridSize + (row+1)*gridSize + col];
-        Vector p011 = gridVertices[cel*gridSize*gridSize + (row+1)*gridSize + col+1];
-        Vector p100 = gridVertices[(cel+1)*gridSize*gridSize + row*gridSize + col];
-        Vector p101 = gridVertices[(cel+1)*gridSize*gridSize + row*gridSize + col+1];
-        Vector p110 = gridVertices[(cel+1)*gridSize*gridSize + (row+1)*gridSize + col];
-        Vector p111 = gridVertices[(cel+1)*gridSize*gridSize + (row+1)*gridSize + col+1];
-
-        // calculate vertex position based on grid vertices which we can access with row and col (x and y)
-        Vector p0 = p011 * u * v + p010 * v * (1 - u) + p001 * u * (1 - v) + p000 * (1 - u) * (1 - v);
-        Vector p1 = p111 * u * v + p110 * v * (1 - u) + p101 * u * (1 - v) + p100 * (1 - u) * (1 - v);
-        // apply another step for z
-        Vector deformedVertex = p0 * (1-w) + p1 * w;
-
-        return deformedVertex;
+// the uniform cubic B-spline basis along each axis, worked out in doubles
+void Mesh::fillBSplineBasis()
+{
+    std::size_t count = _weights.size();
+    _weights.basis.resize(12 * count);
+    float* basis = _weights.basis.data();
+    parallelFor(count, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            double local[3] = { _weights.u[vertex], _weights.v[vertex], _weights.w[vertex] };
+            for (int axis = 0; axis < 3; axis++)
+            {
+                double t = local[axis];
+                double s = 1.0 - t;
+                float* weights = basis + 4 * axis * count + vertex;
+                weights[0] = s * s * s / 6.0;
+                weights[count] = (3.0 * t * t * t - 6.0 * t * t + 4.0) / 6.0;
+                weights[2 * count] = (-3.0 * t * t * t + 3.0 * t * t + 3.0 * t + 1.0) / 6.0;
+                weights[3 * count] = t * t * t / 6.0;
+            }
+        }
+    });
 }
 
-// Utility                                                          //
+// Sparse trilinear                                                 //
 // -----------------------------------------------------------------//
 //                                                                  //
 
-// Utility function for drawing mesh as in file
-void Mesh::drawFileMesh()
-{
-    glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-    glBegin(GL_TRIANGLES);
-
-    // assume CCW order
-    for (unsigned int vertex = 0; vertex < _meshVertices.size(); )
-    { 
-        // use increment to step through them
-        Vector *v0 = &(_meshVertices[vertex++]);
-        Vector *v1 = &(_meshVertices[vertex++]);
-        Vector *v2 = &(_meshVertices[vertex++]);
-        // now compute the normal vector
-        Vector uVec = *v1 - *v0;
-        Vector vVec = *v2 - *v0;
-        Vector normal = Vector::cross(uVec, vVec).normalise();
-
-        glNormal3fv(&normal.x);
-        glVertex3fv(&v0->x);
-        glVertex3fv(&v1->x);
-        glVertex3fv(&v2->x);
-    }
-    glEnd();
+// the cell and weights of the trilinear binding, the cell then looked up in the lattice
+bool Mesh::getSparseTrilinearWeights(const SparseLattice& lattice)
+{
+    _weights.resize(_meshVertices.size());
+    std::atomic<bool> bound(true);
+    parallelFor(_meshVertices.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t vertex = begin; vertex < end; vertex++)
+        {
+            int col, row, cel;
+            float u, v, w;
+            lattice.locate(_meshVertices[vertex], col, row, cel, u, v, w);
+            int cell = lattice.findCell(col, row, cel);
+            // a vertex in a cell the lattice doesn't have, from a grid built around another
+            // mesh, can't be deformed, it is kept within the lattice until bound again
+            if (cell < 0)
+            {
+                bound = false;
+                u = v = w = 0.0;
+                cell = 0;
+            }
+            _weights.u[vertex] = u;
+            _weights.v[vertex] = v;
+            _weights.w[vertex] = w;
+            _weights.cell[vertex] = cell;
+        }
+    });
+    return bound;
 }
 
+// Utility                                                          //
+// -----------------------------------------------------------------//
+//                                                                  //
+
 // check mesh
 bool Mesh::isEmpty()
 {
@@ -444,3 +1284,38 @@ float Mesh::getModelSize()
 {
     return _modelSize;
 }
+
+int Mesh::getVertexCount()
+{
+    return _meshVertices.size();
+}
+
+const Vector& Mesh::getVertex(int index) const
+{
+    return _meshVertices[index];
+}
+
+const Vector* Mesh::getVertices() const
+{
+    return _meshVertices.data();
+}
+
+int Mesh::getIndexCount()
+{
+    return _triangles.size();
+}
+
+const uint32_t* Mesh::getIndices() const
+{
+    return _triangles.data();
+}
+
+const WeightStreams& Mesh::getWeights() const
+{
+    return _weights;
+}
+
+const Vector& Mesh::getMidPoint() const
+{
+    return _meshMidPoint;
+}
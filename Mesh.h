@@ -1,12 +1,36 @@
 #ifndef _MESH_H
 #define _MESH_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "Vector.h"
+#include "DeformKernels.h"
 #include "GridBuilder.h"
+#include "InvertedIndex.h"
+#include "MeshArray.h"
+#include "MeshFile.h"
 
+// A deformation of a mesh as it is drawn: the deformed unique vertices, the flat normal
+// of every triangle if they were asked for, and stamps that are never the same for two
+// contents so that copies of them, such as buffer objects, can be kept up to date.
+// A copy of the vertices (normals) with a stamp from verticesUpdatedFrom (normalsUpdatedFrom)
+// on only needs the vertices (triangles) listed, a stamp of 0 means any may have changed
+struct DeformedFrame
+{
+    const std::vector<Vector>* vertices;
+    const std::vector<Vector>* normals;
+    unsigned long long vertexStamp;
+    unsigned long long normalStamp;
+    const std::vector<uint32_t>* updatedVertices;
+    const std::vector<uint32_t>* updatedTriangles;
+    unsigned long long verticesUpdatedFrom;
+    unsigned long long normalsUpdatedFrom;
+};
+
+// Mesh class holds the loaded mesh data and its binding to a grid,
+// it does not depend on Qt or OpenGL so it can be used headless
 class Mesh
 {
     public:
@@ -14,48 +38,159 @@ class Mesh
     // constructor
     Mesh();
 
-    // method for loading mesh
-    void loadMesh(std::string fileName);
-    // method for saving the deformed mesh data 
-    void saveMesh(std::string fileName, GridBuilder* gridBuilder);
+    // method for loading mesh, returns false if the file could not be read
+    bool loadMesh(std::string fileName);
+    // method for saving the deformed mesh data, returns false if the file could not be written,
+    // files with the .bmesh extension are written in the binary format
+    bool saveMesh(std::string fileName, GridBuilder* gridBuilder);
+    // parse a text mesh file on every thread
+    bool loadTextMesh(std::string fileName);
+    // read a text mesh file serially through a stream
+    bool streamTextMesh(std::string fileName);
+    // map a binary mesh file and use it in place
+    bool loadBinaryMesh(std::string fileName);
+    // save the mesh as loaded in the binary format, with its binding if gridBuilder is given
+    bool saveBinaryMesh(std::string fileName, GridBuilder* gridBuilder);
+    // centre deformed unique vertices in place as saveMesh writes them to a binary file,
+    // filling in header for them and the mesh's indices
+    void centreDeformedMesh(std::vector<Vector>& deformedVertices, MeshFileHeader& header) const;
+    // the text saveMesh writes for deformed unique vertices, formatted on every thread into
+    // parts to be written one after the other, so that their buffers can be reused
+    void formatTextMesh(const std::vector<Vector>& deformedVertices, std::vector<std::string>& parts) const;
+
+    // swap in vertices that are already centred, so that a mesh too large to
+    // load can be bound and deformed one chunk at a time, the chunk has no triangles
+    void swapVertices(std::vector<Vector>& vertices, float modelSize);
+
+    // method for getting the right vertex weights depending on grid type, false if a
+    // vertex lies in a cell the grid doesn't have, which only a sparse grid can lack
+    bool getVertexWeights(GridBuilder* gridBuilder);
+    // deform every unique vertex of the mesh into deformedVertices
+    void deformMesh(GridBuilder* gridBuilder, std::vector<Vector>& deformedVertices);
+    // the unique vertices deformed by gridBuilder's grid, only deformed again
+    // when the grid or the binding changed since the last call, and then only
+    // the vertices bound to the points that moved if just a few did
+    const std::vector<Vector>& getDeformedVertices(GridBuilder* gridBuilder);
+    // flat normal of every deformed triangle, cached and updated in the same way
+    const std::vector<Vector>& getDeformedNormals(GridBuilder* gridBuilder);
+
+    // the cached deformation, with the normals if asked for, along with the vertices
+    // (triangles) its last update touched, in increasing order
+    void getDeformedFrame(GridBuilder* gridBuilder, bool normals, DeformedFrame& frame);
+    // stamp that changes with the vertices and triangles of the mesh, and is
+    // never the same for two contents, as the stamps of a DeformedFrame
+    unsigned long long getMeshStamp() const;
+    // stamp that changes with the binding of the vertices to a grid
+    unsigned long long getBindingStamp() const;
 
-    // draw mesh functions
-    void drawMesh(GridBuilder* gridBuilder);
-    // method for getting the right vertex weights depending on grid type
-    void getVertexWeights(GridBuilder* gridBuilder);
-    
     // bilinear
     void getBilinearWeights(int gridSize);
-    void drawBilinearMesh(std::vector<Vector>& gridVertices, int gridSize);
-    Vector deformBilinear(int vertex, std::vector<Vector>& gridVertices, int gridSize);
 
     // barycentric
-    void getBarycentricWeights(std::vector<Vector>& triangulationMesh);
-    void drawBarycentricMesh(std::vector<Vector>& triangulationMesh);
-    Vector deformBarycentric(int vertex, std::vector<Vector>& triangulationMesh);
+    void getBarycentricWeights(const TriangleLocator& triangleLocator);
 
     // trilinear
     void getTrilinearWeights(int gridSize);
-    void drawTrilinearMesh(std::vector<Vector>& gridVertices, int gridSize);
-    Vector deformTrilinear(int vertex, std::vector<Vector>& gridVertices, int gridSize);
 
-    // draw mesh as it was on load
-    void drawFileMesh();
-    // check for whether a mesh has been loaded 
+    // cubic B-spline
+    void getBSplineWeights(int gridSize);
+
+    // sparse trilinear, the same cell and weights as trilinear with the cell's index in the lattice
+    bool getSparseTrilinearWeights(const SparseLattice& lattice);
+
+    // the binding of every unique vertex, as the deformation kernels read it
+    const WeightStreams& getWeights() const;
+    // the same binding as a sparse matrix, a row of grid points and weights per unique
+    // vertex whatever the grid type, built the first time it is asked for after
+    // binding to gridBuilder's grid
+    const WeightMatrix& getWeightMatrix(GridBuilder* gridBuilder);
+    // deform every unique vertex as the weight matrix times the grid, as deformMesh
+    // does through the kernels of the grid type
+    void deformSparse(GridBuilder* gridBuilder, std::vector<Vector>& deformedVertices);
+    // deform every unique vertex by each of the grids in poses, laid out as gridBuilder's
+    // grid, into deformedPoses[pose], exactly as deformSparse would by that grid but with
+    // every vertex's weights worked out once for all the poses
+    void deformPoses(GridBuilder* gridBuilder, const std::vector<const Vector*>& poses,
+        std::vector<std::vector<Vector>>& deformedPoses);
+
+    // check for whether a mesh has been loaded
     bool isEmpty();
     float getModelSize();
-
+    const Vector& getMidPoint() const;
+    // access to the unique vertices of the mesh as it was on load
+    int getVertexCount();
+    const Vector& getVertex(int index) const;
+    const Vector* getVertices() const;
+    // three indices into the unique vertices per triangle
+    int getIndexCount();
+    const uint32_t* getIndices() const;
 
     private:
-    // Mesh Data
-    std::vector<Vector> _meshVertices;
-    std::vector<Vector> _weights;
-    std::vector<Vector> _faces;
+    // weld the triangle soup in _meshVertices into unique vertices and _triangles
+    void weldMesh();
+    // forget the cached deformation after the mesh or its binding change
+    void invalidateDeformed();
+    // give the mesh a new stamp after loading other vertices or triangles
+    void meshChanged();
+    // deform again just the vertices bound to the grid points that moved since the
+    // cached deformation, returns false if it is quicker to deform the whole mesh
+    bool updateDeformed(GridBuilder* gridBuilder);
+    bool updateNormals();
+    // convert between _weights and the weights and faces sections of a binary mesh file
+    bool readWeights(const Vector* weights, const Vector* faces);
+    void writeWeights(std::vector<Vector>& weights, std::vector<Vector>& faces);
+    // whether the stored binding only reads points of the given grid
+    bool storedWeightsFit(const GridBuilder* gridBuilder) const;
+    // the B-spline basis of every vertex from its place in its span
+    void fillBSplineBasis();
+    // the weight matrix rows of vertices [begin, end) into columns and values
+    void fillWeightRows(GridBuilder* gridBuilder, std::size_t begin, std::size_t end,
+        int32_t* columns, float* values) const;
+
+    // Mesh Data, either owned or mapped from a binary mesh file
+    MeshArray<Vector> _meshVertices;
+    MeshArray<uint32_t> _triangles;
+    // binding per unique vertex
+    WeightStreams _weights;
+    // _weights as a sparse matrix and the binding stamp it was built for, 0 if none
+    WeightMatrix _weightMatrix;
+    unsigned long long _weightMatrixStamp;
+
+    // the grid _weights were computed for, and whether they came from a file
+    Grid _weightsGridType;
+    int _weightsGridSize;
+    bool _storedWeights;
+
+    // cached deformation and the grid and version it was computed for, 0 if none
+    std::vector<Vector> _deformedVertices;
+    std::vector<Vector> _deformedNormals;
+    const GridBuilder* _deformedGrid;
+    unsigned long long _deformedVersion;
+    unsigned long long _normalsVersion;
+    // the vertices the last update deformed again and the version it started
+    // from, 0 if the whole mesh was deformed
+    std::vector<uint32_t> _updatedVertices;
+    std::vector<uint32_t> _updatedTriangles;
+    unsigned long long _updatedFrom;
+    // stamps of the mesh and the caches, and those the caches had before their last
+    // update, 0 if they were computed again whole
+    unsigned long long _meshStamp;
+    unsigned long long _bindingStamp;
+    unsigned long long _deformedStamp;
+    unsigned long long _normalsStamp;
+    unsigned long long _verticesUpdatedFrom;
+    unsigned long long _normalsUpdatedFrom;
+    // the vertices bound to every grid point and the triangles of every vertex,
+    // built the first time a point is moved after binding
+    InvertedIndex _pointVertices;
+    InvertedIndex _vertexTriangles;
 
     //std::string
 
     Vector _meshMidPoint;
+    Vector _minCoords;
+    Vector _maxCoords;
     float _modelSize;
 };
 
-#endif
\ No newline at end of file
+#endif
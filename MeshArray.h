@@ -0,0 +1,108 @@
+#ifndef _MESH_ARRAY_H
+#define _MESH_ARRAY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Array of mesh data that either owns its elements or points into a
+// mapped binary mesh file, so mapped data can be used without copying.
+// It mirrors the parts of std::vector that Mesh uses.
+template <typename T>
+class MeshArray
+{
+    public:
+
+    MeshArray() : _data(nullptr), _size(0) {}
+
+    // copies share the mapping or own a copy of the elements
+    MeshArray(const MeshArray& other) : _data(nullptr), _size(0) { *this = other; }
+    MeshArray& operator=(const MeshArray& other)
+    {
+        if (this == &other)
+            return *this;
+        _file = other._file;
+        if (isMapped())
+        {
+            _owned.clear();
+            _data = other._data;
+        }
+        else
+        {
+            _owned.assign(other._data, other._data + other._size);
+            _data = _owned.data();
+        }
+        _size = other._size;
+        return *this;
+    }
+
+    // point the array at count elements of a mapped file, starting at offset bytes
+    void map(std::shared_ptr<MappedFile> file, std::size_t offset, std::size_t count)
+    {
+        _owned.clear();
+        _owned.shrink_to_fit();
+        _file = file;
+        _data = reinterpret_cast<T*>(file->data() + offset);
+        _size = count;
+    }
+
+    // resizing always leaves the array owning its data
+    void resize(std::size_t count)
+    {
+        if (isMapped())
+        {
+            std::vector<T> copy(_data, _data + std::min(count, _size));
+            _file.reset();
+            _owned.swap(copy);
+        }
+        _owned.resize(count);
+        _data = _owned.data();
+        _size = count;
+    }
+
+    // exchange the elements with those of a vector, leaving the array owning its data
+    void swap(std::vector<T>& elements)
+    {
+        if (isMapped())
+        {
+            _file.reset();
+            _owned.clear();
+        }
+        _owned.swap(elements);
+        _data = _owned.data();
+        _size = _owned.size();
+    }
+
+    void clear()
+    {
+        _file.reset();
+        _owned.clear();
+        _data = _owned.data();
+        _size = 0;
+    }
+
+    bool isMapped() const { return _file != nullptr; }
+    bool empty() const { return _size == 0; }
+    std::size_t size() const { return _size; }
+
+    T* data() { return _data; }
+    const T* data() const { return _data; }
+    T* begin() { return _data; }
+    T* end() { return _data + _size; }
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+
+    T& operator[](std::size_t index) { return _data[index]; }
+    const T& operator[](std::size_t index) const { return _data[index]; }
+
+    private:
+    std::vector<T> _owned;
+    std::shared_ptr<MappedFile> _file;
+    T* _data;
+    std::size_t _size;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <cstring>
+#include <fstream>
+
+#include "MeshFile.h"
+
+// round an offset up to the section alignment
+uint64_t alignMeshFileOffset(uint64_t offset)
+{
+    return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+// write zeros up to the next section boundary
+static void padStream(std::ofstream& meshFile, uint64_t& offset)
+{
+    static const char zeros[MESH_FILE_ALIGNMENT] = {};
+    uint64_t aligned = alignMeshFileOffset(offset);
+    meshFile.write(zeros, aligned - offset);
+    offset = aligned;
+}
+
+void initMeshFileHeader(MeshFileHeader& header)
+{
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+    header.version = MESH_FILE_VERSION;
+    header.headerSize = sizeof(MeshFileHeader);
+}
+
+// lay out the sections one after the other
+void layoutMeshFile(MeshFileHeader& header)
+{
+    header.positionOffset = alignMeshFileOffset(sizeof(MeshFileHeader));
+    header.indexOffset = alignMeshFileOffset(header.positionOffset + header.vertexCount * sizeof(Vector));
+    header.weightOffset = alignMeshFileOffset(header.indexOffset + header.indexCount * sizeof(uint32_t));
+    header.faceOffset = alignMeshFileOffset(header.weightOffset + header.weightCount * sizeof(Vector));
+}
+
+bool writeMeshFile(std::string fileName, MeshFileHeader& header, const Vector* positions,
+    const uint32_t* indices, const Vector* weights, const Vector* faces)
+{
+    layoutMeshFile(header);
+
+    std::ofstream meshFile(fileName, std::ofstream::binary | std::ofstream::trunc);
+    if (!meshFile.is_open())
+        return false;
+
+    uint64_t offset = sizeof(MeshFileHeader);
+    meshFile.write(reinterpret_cast<const char*>(&header), sizeof(MeshFileHeader));
+    padStream(meshFile, offset);
+
+    meshFile.write(reinterpret_cast<const char*>(positions), header.vertexCount * sizeof(Vector));
+    offset += header.vertexCount * sizeof(Vector);
+    padStream(meshFile, offset);
+
+    if (header.indexCount > 0)
+    {
+        meshFile.write(reinterpret_cast<const char*>(indices), header.indexCount * sizeof(uint32_t));
+        offset += header.indexCount * sizeof(uint32_t);
+        padStream(meshFile, offset);
+    }
+
+    if (header.weightCount > 0)
+    {
+        meshFile.write(reinterpret_cast<const char*>(weights), header.weightCount * sizeof(Vector));
+        offset += header.weightCount * sizeof(Vector);
+        padStream(meshFile, offset);
+        meshFile.write(reinterpret_cast<const char*>(faces), header.weightCount * sizeof(Vector));
+    }
+
+    meshFile.close();
+    return !meshFile.fail();
+}
+
+// whether a section of count elements at offset is aligned and inside the file, worked out
+// so that counts and offsets too large for the file can't wrap around
+static bool sectionFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+{
+    return offset % MESH_FILE_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+bool readMeshFileHeader(const MappedFile& file, MeshFileHeader& header)
+{
+    if (!file.isOpen() || file.size() < sizeof(MeshFileHeader))
+        return false;
+
+    std::memcpy(&header, file.data(), sizeof(MeshFileHeader));
+    if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0)
+        return false;
+    // newer versions may only add fields to the end of the header
+    if (header.version > MESH_FILE_VERSION || header.headerSize < sizeof(MeshFileHeader))
+        return false;
+
+    // every section must be aligned and inside the file
+    uint64_t fileSize = file.size();
+    if (!sectionFits(header.positionOffset, header.vertexCount, sizeof(Vector), fileSize))
+        return false;
+    if (header.indexCount > 0 && !sectionFits(header.indexOffset, header.indexCount, sizeof(uint32_t), fileSize))
+        return false;
+    if (header.weightCount > 0 && (!sectionFits(header.weightOffset, header.weightCount, sizeof(Vector), fileSize) ||
+        !sectionFits(header.faceOffset, header.weightCount, sizeof(Vector), fileSize)))
+        return false;
+
+    return true;
+}
+
+bool isMeshFile(std::string fileName)
+{
+    std::ifstream meshFile(fileName, std::ifstream::binary);
+    char magic[sizeof(MESH_FILE_MAGIC)];
+    meshFile.read(magic, sizeof(magic));
+    return meshFile.good() && std::memcmp(magic, MESH_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool hasMeshFileExtension(std::string fileName)
+{
+    return fileName.size() >= MESH_FILE_EXTENSION.size() &&
+        fileName.compare(fileName.size() - MESH_FILE_EXTENSION.size(), MESH_FILE_EXTENSION.size(), MESH_FILE_EXTENSION) == 0;
+}
@@ -0,0 +1,76 @@
+#ifndef _MESH_FILE_H
+#define _MESH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Vector.h"
+#include "MappedFile.h"
+
+// Binary mesh container (.bmesh), little endian:
+//
+//   header          MeshFileHeader, padded to MESH_FILE_ALIGNMENT
+//   positions       vertexCount * 3 float32, centred on midPoint
+//   indices         indexCount uint32 (optional, three per triangle)
+//   weights, faces  weightCount * 3 float32 each (optional, a binding
+//                   to the grid described by weightGridType/Size)
+//
+// Every section starts on a MESH_FILE_ALIGNMENT boundary so that a mapped
+// file can be used in place as arrays of Vector.
+
+const char MESH_FILE_MAGIC[8] = {'F', 'F', 'D', 'M', 'E', 'S', 'H', '\0'};
+const uint32_t MESH_FILE_VERSION = 1;
+const std::size_t MESH_FILE_ALIGNMENT = 64;
+const std::string MESH_FILE_EXTENSION = ".bmesh";
+
+struct MeshFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    // section sizes, in elements
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t weightCount;
+
+    // section offsets from the start of the file, in bytes
+    uint64_t positionOffset;
+    uint64_t indexOffset;
+    uint64_t weightOffset;
+    uint64_t faceOffset;
+
+    // the mesh was centred by subtracting midPoint, the bounds are
+    // of the uncentred positions
+    float midPoint[3];
+    float modelSize;
+    float minCoords[3];
+    float maxCoords[3];
+
+    // the grid the weights were computed for
+    int32_t weightGridType;
+    int32_t weightGridSize;
+};
+
+// Vector must be three packed floats to be read in place
+static_assert(sizeof(Vector) == 3 * sizeof(float), "Vector is not packed");
+
+// fill in the magic number and version of a header, zeroing everything else
+void initMeshFileHeader(MeshFileHeader& header);
+// round an offset up to the section alignment
+uint64_t alignMeshFileOffset(uint64_t offset);
+// compute the section offsets of a header from its counts
+void layoutMeshFile(MeshFileHeader& header);
+// write a mesh file, offsets are computed from the counts in the header,
+// indices, weights and faces can be null when their count is 0
+bool writeMeshFile(std::string fileName, MeshFileHeader& header, const Vector* positions,
+    const uint32_t* indices, const Vector* weights, const Vector* faces);
+// check the header of a mapped mesh file and that its sections fit in the file
+bool readMeshFileHeader(const MappedFile& file, MeshFileHeader& header);
+// check whether a file starts with the mesh file magic number
+bool isMeshFile(std::string fileName);
+// check whether a file name has the binary mesh extension
+bool hasMeshFileExtension(std::string fileName);
+
+#endif
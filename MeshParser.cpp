@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <vector>
+
+#include "MeshParser.h"
+#include "Parallel.h"
+
+// chunks per thread, so that threads finishing early can't leave others with much more to do
+static const std::size_t CHUNKS_PER_THREAD = 4;
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char* skipSpace(const char* text, const char* end)
+{
+    while (text < end && isSpace(*text))
+        text++;
+    return text;
+}
+
+// parse one number the way ifstream >> does, moving text past it
+template <typename T>
+static bool parseNumber(const char*& text, const char* end, T& value)
+{
+    if (text < end && *text == '+')
+        text++;
+    std::from_chars_result result = std::from_chars(text, end, value);
+    if (result.ec != std::errc() || (result.ptr < end && !isSpace(*result.ptr)))
+        return false;
+    text = result.ptr;
+    return true;
+}
+
+// count the whitespace separated numbers in a chunk
+static std::size_t countTokens(const char* text, const char* end)
+{
+    std::size_t count = 0;
+    bool inToken = false;
+    for (; text < end; text++)
+    {
+        bool space = isSpace(*text);
+        if (!space && !inToken)
+            count++;
+        inToken = !space;
+    }
+    return count;
+}
+
+bool parseMeshNumber(const char*& text, const char* end, float& value)
+{
+    text = skipSpace(text, end);
+    return parseNumber(text, end, value);
+}
+
+bool parseMeshNumber(const char*& text, const char* end, double& value)
+{
+    text = skipSpace(text, end);
+    return parseNumber(text, end, value);
+}
+
+bool parseMeshText(const char* begin, const char* end, MeshArray<Vector>& vertices, Vector& minCoords, Vector& maxCoords)
+{
+    // read in the number of triangles
+    const char* text = skipSpace(begin, end);
+    double nTriangles = 0;
+    if (!parseNumber(text, end, nTriangles) || nTriangles < 0)
+        return false;
+    std::size_t nFloats = static_cast<std::size_t>(nTriangles) * 9;
+
+    // split the rest of the file into chunks ending on a new line
+    std::size_t nChunks = threadCount() * CHUNKS_PER_THREAD;
+    std::vector<const char*> chunkStart(nChunks + 1, end);
+    chunkStart[0] = text;
+    for (std::size_t chunk = 1; chunk < nChunks; chunk++)
+    {
+        const char* split = std::max(chunkStart[chunk - 1], text + (end - text) * chunk / nChunks);
+        split = std::find(split, end, '\n');
+        chunkStart[chunk] = split < end ? split + 1 : end;
+    }
+
+    // first pass counts the numbers in each chunk to know where its vertices go
+    std::vector<std::size_t> chunkOffset(nChunks + 1, 0);
+    parallelFor(nChunks, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+            chunkOffset[chunk + 1] = countTokens(chunkStart[chunk], chunkStart[chunk + 1]);
+    });
+    for (std::size_t chunk = 0; chunk < nChunks; chunk++)
+        chunkOffset[chunk + 1] += chunkOffset[chunk];
+    if (chunkOffset[nChunks] < nFloats)
+        return false;
+
+    // now allocate space for them all
+    vertices.clear();
+    vertices.resize(nFloats / 3);
+    // a file of no triangles has no vertices to parse into
+    float* coords = vertices.empty() ? nullptr : &vertices.data()->x;
+
+    // second pass parses the numbers and keeps track of the bounds of each chunk
+    std::vector<Vector> chunkMin(nChunks, Vector(1000000.0, 1000000.0, 1000000.0));
+    std::vector<Vector> chunkMax(nChunks, Vector(-1000000.0, -1000000.0, -1000000.0));
+    std::atomic<bool> failed(false);
+    parallelFor(nChunks, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last && !failed; chunk++)
+        {
+            float* minChunk = &chunkMin[chunk].x;
+            float* maxChunk = &chunkMax[chunk].x;
+            const char* chunkText = chunkStart[chunk];
+            const char* chunkEnd = chunkStart[chunk + 1];
+            for (std::size_t index = chunkOffset[chunk]; index < std::min(chunkOffset[chunk + 1], nFloats); index++)
+            {
+                chunkText = skipSpace(chunkText, chunkEnd);
+                if (!parseNumber(chunkText, chunkEnd, coords[index]))
+                {
+                    failed = true;
+                    break;
+                }
+                minChunk[index % 3] = std::min(minChunk[index % 3], coords[index]);
+                maxChunk[index % 3] = std::max(maxChunk[index % 3], coords[index]);
+            }
+        }
+    });
+    if (failed)
+        return false;
+
+    minCoords = Vector(1000000.0, 1000000.0, 1000000.0);
+    maxCoords = Vector(-1000000.0, -1000000.0, -1000000.0);
+    for (std::size_t chunk = 0; chunk < nChunks; chunk++)
+    {
+        minCoords.x = std::min(minCoords.x, chunkMin[chunk].x);
+        minCoords.y = std::min(minCoords.y, chunkMin[chunk].y);
+        minCoords.z = std::min(minCoords.z, chunkMin[chunk].z);
+        maxCoords.x = std::max(maxCoords.x, chunkMax[chunk].x);
+        maxCoords.y = std::max(maxCoords.y, chunkMax[chunk].y);
+        maxCoords.z = std::max(maxCoords.z, chunkMax[chunk].z);
+    }
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef _MESH_PARSER_H
+#define _MESH_PARSER_H
+
+#include <cstddef>
+
+#include "Vector.h"
+#include "MeshArray.h"
+
+// Parse the text of a .mesh file (a triangle count followed by three
+// coordinates per vertex) held in memory. The text is split into line
+// aligned chunks parsed on every thread, the bounds of the vertices are
+// gathered in the same pass. Returns false if the text is malformed or
+// holds fewer vertices than the triangle count says.
+bool parseMeshText(const char* begin, const char* end, MeshArray<Vector>& vertices, Vector& minCoords, Vector& maxCoords);
+// skip white space then parse one number the way ifstream >> does, moving text past it
+bool parseMeshNumber(const char*& text, const char* end, float& value);
+bool parseMeshNumber(const char*& text, const char* end, double& value);
+
+#endif
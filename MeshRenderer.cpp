@@ -0,0 +1,295 @@
+// buffer object functions are declared by the headers themselves rather than looked up
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+
+#include <cstring>
+
+#include "MeshRenderer.h"
+#include "BufferWriter.h"
+#include "Parallel.h"
+
+MeshRenderer::MeshRenderer()
+{
+    _immediate = false;
+    _indexBuffer = 0;
+    _positionBuffer = 0;
+    _normalBuffer = 0;
+    _restPositionBuffer = 0;
+    _restNormalBuffer = 0;
+    _indexStamp = 0;
+    _positionStamp = 0;
+    _restStamp = 0;
+    _flatPositions = false;
+}
+
+void MeshRenderer::setImmediateMode(bool immediate)
+{
+    _immediate = immediate;
+}
+
+bool MeshRenderer::getImmediateMode() const
+{
+    return _immediate;
+}
+
+// draws the mesh deformed by the current grid, the mesh only deforms itself
+// again when the grid has changed so redrawing it as it is turned costs only the draw
+void MeshRenderer::drawMesh(Mesh& mesh, GridBuilder& gridBuilder)
+{
+    // We don't compute the normals for 2D grids because we are in fact squishing all
+    // the faces of the model onto the xy plane, which gives awful results for 3d
+    // meshes and overlapping faces
+    DeformedFrame frame;
+    mesh.getDeformedFrame(&gridBuilder, gridBuilder.isVolumetric(), frame);
+    drawMesh(mesh, frame);
+}
+
+void MeshRenderer::drawMesh(Mesh& mesh, const DeformedFrame& frame)
+{
+    if (_immediate)
+        drawTriangles(mesh, frame);
+    else if (frame.normals == nullptr)
+        drawIndexedTriangles(mesh, frame);
+    else
+        drawFlatTriangles(mesh, frame);
+}
+
+// the updated elements cover every change from updatedFrom on, stamps only increase
+bool MeshRenderer::canUpdate(unsigned long long stamp, unsigned long long updatedFrom, unsigned long long frameStamp)
+{
+    return updatedFrom != 0 && stamp >= updatedFrom && stamp < frameStamp;
+}
+
+void MeshRenderer::drawTriangles(Mesh& mesh, const DeformedFrame& frame)
+{
+    bool normals = frame.normals != nullptr;
+    const std::vector<Vector>& deformedVertices = *frame.vertices;
+    const Vector* triangleNormals = normals ? frame.normals->data() : nullptr;
+    const uint32_t* indices = mesh.getIndices();
+    glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+    glBegin(GL_TRIANGLES);
+    // for each triangle, draw the interpolated positions of its vertices
+    for(int index = 0; index < mesh.getIndexCount(); index += 3)
+    {
+        const Vector* v0 = &(deformedVertices[indices[index]]);
+        const Vector* v1 = &(deformedVertices[indices[index + 1]]);
+        const Vector* v2 = &(deformedVertices[indices[index + 2]]);
+        if (normals)
+            glNormal3fv(&triangleNormals[index / 3].x);
+        glVertex3fv(&v0->x);
+        glVertex3fv(&v1->x);
+        glVertex3fv(&v2->x);
+    }
+    glEnd();
+}
+
+// Utility function for drawing mesh as in file
+void MeshRenderer::drawFileMesh(Mesh& mesh)
+{
+    if (_immediate)
+    {
+        drawFileTriangles(mesh);
+        return;
+    }
+
+    updateIndexBuffer(mesh);
+    std::size_t triangleCount = mesh.getIndexCount() / 3;
+    if (_restStamp != mesh.getMeshStamp())
+    {
+        // the corners of every triangle with its flat normal, these never change
+        std::vector<Vector> positions(triangleCount * 3);
+        std::vector<Vector> normals(triangleCount * 3);
+        const Vector* vertices = mesh.getVertices();
+        const uint32_t* indices = mesh.getIndices();
+        parallelFor(triangleCount, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t triangle = begin; triangle < end; triangle++)
+            {
+                Vector v0 = vertices[indices[triangle * 3]];
+                Vector v1 = vertices[indices[triangle * 3 + 1]];
+                Vector v2 = vertices[indices[triangle * 3 + 2]];
+                // now compute the normal vector
+                Vector uVec = v1 - v0;
+                Vector vVec = v2 - v0;
+                Vector normal = Vector::cross(uVec, vVec).normalise();
+                positions[triangle * 3] = v0;
+                positions[triangle * 3 + 1] = v1;
+                positions[triangle * 3 + 2] = v2;
+                normals[triangle * 3] = normal;
+                normals[triangle * 3 + 1] = normal;
+                normals[triangle * 3 + 2] = normal;
+            }
+        });
+        glBindBuffer(GL_ARRAY_BUFFER, _restPositionBuffer);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(Vector), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, _restNormalBuffer);
+        glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(Vector), normals.data(), GL_STATIC_DRAW);
+        _restStamp = mesh.getMeshStamp();
+    }
+
+    glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, _restPositionBuffer);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vector), nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, _restNormalBuffer);
+    glNormalPointer(GL_FLOAT, sizeof(Vector), nullptr);
+    glDrawArrays(GL_TRIANGLES, 0, triangleCount * 3);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshRenderer::drawFileTriangles(Mesh& mesh)
+{
+    glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+    glBegin(GL_TRIANGLES);
+
+    // assume CCW order
+    const uint32_t* indices = mesh.getIndices();
+    for (int index = 0; index < mesh.getIndexCount(); )
+    {
+        // use increment to step through them
+        Vector v0 = mesh.getVertex(indices[index++]);
+        Vector v1 = mesh.getVertex(indices[index++]);
+        Vector v2 = mesh.getVertex(indices[index++]);
+        // now compute the normal vector
+        Vector uVec = v1 - v0;
+        Vector vVec = v2 - v0;
+        Vector normal = Vector::cross(uVec, vVec).normalise();
+
+        glNormal3fv(&normal.x);
+        glVertex3fv(&v0.x);
+        glVertex3fv(&v1.x);
+        glVertex3fv(&v2.x);
+    }
+    glEnd();
+}
+
+void MeshRenderer::updateIndexBuffer(Mesh& mesh)
+{
+    if (_indexBuffer == 0)
+    {
+        GLuint buffers[5];
+        glGenBuffers(5, buffers);
+        _indexBuffer = buffers[0];
+        _positionBuffer = buffers[1];
+        _normalBuffer = buffers[2];
+        _restPositionBuffer = buffers[3];
+        _restNormalBuffer = buffers[4];
+    }
+    if (_indexStamp != mesh.getMeshStamp())
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.getIndexCount() * sizeof(uint32_t), mesh.getIndices(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        _indexStamp = mesh.getMeshStamp();
+        // the deformation of another mesh is never updated in part
+        _positionStamp = 0;
+    }
+}
+
+void MeshRenderer::drawIndexedTriangles(Mesh& mesh, const DeformedFrame& frame)
+{
+    updateIndexBuffer(mesh);
+    const std::vector<Vector>& deformedVertices = *frame.vertices;
+    glBindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+    if (_positionStamp != frame.vertexStamp)
+    {
+        // after moving a few grid points only their vertices are sent again
+        bool written = !_flatPositions && canUpdate(_positionStamp, frame.verticesUpdatedFrom, frame.vertexStamp) &&
+            writeElements(*frame.updatedVertices, sizeof(Vector), [&](char* destination, uint32_t vertex)
+            {
+                std::memcpy(destination, &deformedVertices[vertex], sizeof(Vector));
+            });
+        if (!written)
+            glBufferData(GL_ARRAY_BUFFER, deformedVertices.size() * sizeof(Vector), deformedVertices.data(), GL_DYNAMIC_DRAW);
+        _positionStamp = frame.vertexStamp;
+        _flatPositions = false;
+    }
+
+    glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vector), nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+    glDrawElements(GL_TRIANGLES, mesh.getIndexCount(), GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshRenderer::drawFlatTriangles(Mesh& mesh, const DeformedFrame& frame)
+{
+    updateIndexBuffer(mesh);
+    const std::vector<Vector>& triangleNormals = *frame.normals;
+    const Vector* deformed = frame.vertices->data();
+    const uint32_t* indices = mesh.getIndices();
+    std::size_t triangleCount = mesh.getIndexCount() / 3;
+
+    // the normals change with the deformation, so their stamp covers the positions too
+    if (_positionStamp != frame.normalStamp)
+    {
+        const std::vector<uint32_t>* updated = frame.updatedTriangles;
+        bool written = false;
+        if (_flatPositions && canUpdate(_positionStamp, frame.normalsUpdatedFrom, frame.normalStamp))
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+            written = writeElements(*updated, 3 * sizeof(Vector), [&](char* destination, uint32_t triangle)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                    std::memcpy(destination + corner * sizeof(Vector), &deformed[indices[triangle * 3 + corner]], sizeof(Vector));
+            });
+            glBindBuffer(GL_ARRAY_BUFFER, _normalBuffer);
+            written = written && writeElements(*updated, 3 * sizeof(Vector), [&](char* destination, uint32_t triangle)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                    std::memcpy(destination + corner * sizeof(Vector), &triangleNormals[triangle], sizeof(Vector));
+            });
+        }
+        if (!written)
+        {
+            // the corners are written straight into the buffers on every thread
+            GLsizeiptr size = triangleCount * 3 * sizeof(Vector);
+            glBindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+            Vector* positions = static_cast<Vector*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            glBindBuffer(GL_ARRAY_BUFFER, _normalBuffer);
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+            Vector* normals = static_cast<Vector*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (positions != nullptr && normals != nullptr)
+            {
+                parallelFor(triangleCount, [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t corner = begin * 3; corner < end * 3; corner++)
+                    {
+                        positions[corner] = deformed[indices[corner]];
+                        normals[corner] = triangleNormals[corner / 3];
+                    }
+                });
+            }
+            written = positions != nullptr && normals != nullptr;
+            written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE && written;
+            glBindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+            written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE && written;
+        }
+        // a buffer lost while mapped is filled again on the next frame
+        _positionStamp = written ? frame.normalStamp : 0;
+        _flatPositions = true;
+    }
+
+    glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vector), nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, _normalBuffer);
+    glNormalPointer(GL_FLOAT, sizeof(Vector), nullptr);
+    glDrawArrays(GL_TRIANGLES, 0, triangleCount * 3);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
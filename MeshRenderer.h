@@ -0,0 +1,65 @@
+#ifndef _MESH_RENDERER_H
+#define _MESH_RENDERER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/gl.h>
+
+#include "Vector.h"
+#include "GridBuilder.h"
+#include "Mesh.h"
+
+// OpenGL drawing of a Mesh, kept out of Mesh so that the
+// deformation code does not depend on a GL context.
+// The mesh is drawn from buffer objects that are only written where the mesh's
+// cached deformation changed, immediate mode is kept to compare against.
+class MeshRenderer
+{
+    public:
+
+    MeshRenderer();
+
+    // draw the deformed mesh depending on grid type
+    void drawMesh(Mesh& mesh, GridBuilder& gridBuilder);
+    // draw a deformation of the mesh made elsewhere, by a DeformWorker for example,
+    // with flat normals if the frame has them
+    void drawMesh(Mesh& mesh, const DeformedFrame& frame);
+    // draw mesh as it was on load
+    void drawFileMesh(Mesh& mesh);
+
+    // draw with glBegin and glEnd instead of buffer objects
+    void setImmediateMode(bool immediate);
+    bool getImmediateMode() const;
+
+    private:
+    // immediate mode: draw the deformed triangles of the mesh, with flat normals if the frame has them
+    void drawTriangles(Mesh& mesh, const DeformedFrame& frame);
+    void drawFileTriangles(Mesh& mesh);
+
+    // buffer objects: without normals the unique vertices are drawn through the mesh's
+    // indices, flat normals need every corner of every triangle to be drawn on its own
+    void drawIndexedTriangles(Mesh& mesh, const DeformedFrame& frame);
+    void drawFlatTriangles(Mesh& mesh, const DeformedFrame& frame);
+    // whether a buffer filled from the frame stamp it has can be brought up to date by
+    // writing just the updated elements
+    static bool canUpdate(unsigned long long stamp, unsigned long long updatedFrom, unsigned long long frameStamp);
+    // create the buffers the first time, then fill the index buffer for every new mesh
+    void updateIndexBuffer(Mesh& mesh);
+
+    bool _immediate;
+
+    GLuint _indexBuffer;
+    GLuint _positionBuffer;
+    GLuint _normalBuffer;
+    GLuint _restPositionBuffer;
+    GLuint _restNormalBuffer;
+    // the mesh and cache stamps the buffers were filled from, and whether
+    // _positionBuffer holds the unique vertices or the corners of the triangles
+    unsigned long long _indexStamp;
+    unsigned long long _positionStamp;
+    unsigned long long _restStamp;
+    bool _flatPositions;
+};
+
+#endif
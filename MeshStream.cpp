@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "MeshStream.h"
+#include "BoundedQueue.h"
+#include "Mesh.h"
+#include "MeshParser.h"
+#include "Parallel.h"
+
+// default number of vertices read, deformed and written at a time
+static const std::size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+// a chunk of the mesh on its way through the pipeline
+struct MeshChunk
+{
+    std::size_t sequence;
+    std::vector<Vector> vertices;
+    std::vector<Vector> deformed;
+};
+
+MeshStream::MeshStream()
+{
+    _binary = false;
+    _text = nullptr;
+    _nextVertex = 0;
+    _vertexCount = 0;
+    _midPoint = Vector(0.0, 0.0, 0.0);
+    _modelSize = 1.0;
+    _chunkSize = DEFAULT_CHUNK_SIZE;
+    _workerCount = threadCount();
+}
+
+bool MeshStream::open(std::string fileName)
+{
+    if (!_file.open(fileName))
+        return false;
+
+    _midPoint = Vector(0.0, 0.0, 0.0);
+    _binary = readMeshFileHeader(_file, _header);
+    if (_binary)
+    {
+        // binary meshes are stored centred and their header has all we need
+        _vertexCount = _header.indexCount > 0 ? _header.indexCount : _header.vertexCount;
+        _modelSize = _header.modelSize;
+        rewind();
+        return _modelSize != 0.0;
+    }
+
+    // a text mesh needs a pass over it to find its midpoint and bounds
+    _nextVertex = 0;
+    _text = _file.data();
+    const char* end = _file.data() + _file.size();
+    double nTriangles = 0;
+    if (!parseMeshNumber(_text, end, nTriangles) || nTriangles < 0)
+        return false;
+    _vertexCount = static_cast<std::size_t>(nTriangles) * 3;
+
+    Vector midPoint = Vector(0.0, 0.0, 0.0);
+    Vector minCoords = Vector(1000000.0, 1000000.0, 1000000.0);
+    Vector maxCoords = Vector(-1000000.0, -1000000.0, -1000000.0);
+    std::vector<Vector> vertices(_chunkSize);
+    while (_nextVertex < _vertexCount)
+    {
+        long count = readVertices(vertices.data(), std::min(_chunkSize, _vertexCount - _nextVertex));
+        if (count <= 0)
+            return false;
+        // summed in file order so that the midpoint is exactly the one Mesh::loadMesh finds
+        for (long vertex = 0; vertex < count; vertex++)
+        {
+            midPoint = midPoint + vertices[vertex];
+            minCoords.x = std::min(minCoords.x, vertices[vertex].x);
+            minCoords.y = std::min(minCoords.y, vertices[vertex].y);
+            minCoords.z = std::min(minCoords.z, vertices[vertex].z);
+            maxCoords.x = std::max(maxCoords.x, vertices[vertex].x);
+            maxCoords.y = std::max(maxCoords.y, vertices[vertex].y);
+            maxCoords.z = std::max(maxCoords.z, vertices[vertex].z);
+        }
+    }
+    _midPoint = midPoint / _vertexCount;
+    _modelSize = (maxCoords - minCoords).magnitude();
+    rewind();
+    return _modelSize != 0.0;
+}
+
+void MeshStream::rewind()
+{
+    _nextVertex = 0;
+    _text = _file.data();
+    if (!_binary)
+    {
+        // skip the triangle count
+        double nTriangles = 0;
+        parseMeshNumber(_text, _file.data() + _file.size(), nTriangles);
+    }
+}
+
+// read the next vertices, centred once the midpoint is known
+long MeshStream::readVertices(Vector* vertices, std::size_t count)
+{
+    count = std::min(count, _vertexCount - _nextVertex);
+    if (_binary)
+    {
+        const Vector* positions = reinterpret_cast<const Vector*>(_file.data() + _header.positionOffset);
+        if (_header.indexCount > 0)
+        {
+            const uint32_t* indices = reinterpret_cast<const uint32_t*>(_file.data() + _header.indexOffset);
+            for (std::size_t vertex = 0; vertex < count; vertex++)
+            {
+                uint32_t index = indices[_nextVertex + vertex];
+                if (index >= _header.vertexCount)
+                    return -1;
+                vertices[vertex] = positions[index];
+            }
+        }
+        else
+        {
+            std::copy(positions + _nextVertex, positions + _nextVertex + count, vertices);
+        }
+    }
+    else
+    {
+        const char* end = _file.data() + _file.size();
+        for (std::size_t vertex = 0; vertex < count; vertex++)
+        {
+            if (!parseMeshNumber(_text, end, vertices[vertex].x) ||
+                !parseMeshNumber(_text, end, vertices[vertex].y) ||
+                !parseMeshNumber(_text, end, vertices[vertex].z))
+                return -1;
+            vertices[vertex] = vertices[vertex] - _midPoint;
+        }
+    }
+    _nextVertex += count;
+
+    // the pages read so far won't be needed again until the next pass,
+    // indexed positions are read in any order so they are kept
+    if (_binary && _header.indexCount == 0)
+        _file.release(_header.positionOffset + _nextVertex * sizeof(Vector));
+    else if (!_binary)
+        _file.release(_text - _file.data());
+    return count;
+}
+
+bool MeshStream::deform(GridBuilder* restGrid, GridBuilder* deformedGrid, std::string fileName)
+{
+    // the mesh goes to a file beside the output, so that a run failing partway through
+    // doesn't leave part of a mesh behind in its place
+    std::string partialName = fileName + ".tmp";
+    if (!writeDeformed(restGrid, deformedGrid, partialName, hasMeshFileExtension(fileName)))
+    {
+        std::remove(partialName.c_str());
+        return false;
+    }
+    if (std::rename(partialName.c_str(), fileName.c_str()) != 0)
+    {
+        std::remove(partialName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MeshStream::writeDeformed(GridBuilder* restGrid, GridBuilder* deformedGrid, std::string fileName, bool binaryOutput)
+{
+    std::ofstream meshFile(fileName, std::ofstream::binary | std::ofstream::trunc);
+    if (!meshFile.is_open())
+        return false;
+
+    // the binary header is written again once the bounds are known
+    MeshFileHeader header;
+    initMeshFileHeader(header);
+    header.vertexCount = _vertexCount;
+    layoutMeshFile(header);
+    std::vector<char> padding(header.positionOffset, 0);
+    if (binaryOutput)
+        meshFile.write(padding.data(), header.positionOffset);
+    else
+        meshFile << _vertexCount / 3 << "\n";
+
+    // every chunk buffer the pipeline will ever use is allocated here
+    std::vector<MeshChunk> chunks(2 * _workerCount + 2);
+    BoundedQueue<MeshChunk*> freeChunks(chunks.size());
+    BoundedQueue<MeshChunk*> readChunks(chunks.size());
+    BoundedQueue<MeshChunk*> deformedChunks(chunks.size());
+    for (unsigned int chunk = 0; chunk < chunks.size(); chunk++)
+        freeChunks.push(&chunks[chunk]);
+
+    std::atomic<bool> failed(false);
+    rewind();
+
+    // read stage
+    std::thread reader([&]()
+    {
+        MeshChunk* chunk;
+        for (std::size_t sequence = 0; _nextVertex < _vertexCount && !failed && freeChunks.pop(chunk); sequence++)
+        {
+            chunk->sequence = sequence;
+            chunk->vertices.resize(std::min(_chunkSize, _vertexCount - _nextVertex));
+            if (readVertices(chunk->vertices.data(), chunk->vertices.size()) != (long)chunk->vertices.size())
+            {
+                failed = true;
+                break;
+            }
+            readChunks.push(chunk);
+        }
+        readChunks.close();
+    });
+
+    // bind and deform stage, each worker binds its chunks to its own mesh
+    std::atomic<unsigned int> activeWorkers(_workerCount);
+    std::vector<std::thread> workers;
+    for (unsigned int worker = 0; worker < _workerCount; worker++)
+    {
+        workers.emplace_back([&]()
+        {
+            Mesh mesh;
+            MeshChunk* chunk;
+            while (readChunks.pop(chunk))
+            {
+                mesh.swapVertices(chunk->vertices, _modelSize);
+                // a chunk outside the cells of a sparse grid fails the whole mesh
+                if (!mesh.getVertexWeights(restGrid))
+                    failed = true;
+                mesh.deformMesh(deformedGrid, chunk->deformed);
+                mesh.swapVertices(chunk->vertices, _modelSize);
+                deformedChunks.push(chunk);
+            }
+            if (--activeWorkers == 0)
+                deformedChunks.close();
+        });
+    }
+
+    // write stage, chunks can finish out of order so they wait until their turn
+    Vector midPoint = Vector(0.0, 0.0, 0.0);
+    Vector minCoords = Vector(1000000.0, 1000000.0, 1000000.0);
+    Vector maxCoords = Vector(-1000000.0, -1000000.0, -1000000.0);
+    std::map<std::size_t, MeshChunk*> pending;
+    std::size_t nextSequence = 0;
+    MeshChunk* chunk;
+    while (deformedChunks.pop(chunk))
+    {
+        pending[chunk->sequence] = chunk;
+        while (!pending.empty() && pending.begin()->first == nextSequence)
+        {
+            chunk = pending.begin()->second;
+            pending.erase(pending.begin());
+            nextSequence++;
+
+            std::vector<Vector>& deformed = chunk->deformed;
+            if (binaryOutput)
+            {
+                // summed in order so the midpoint matches Mesh::saveMesh
+                for (std::size_t vertex = 0; vertex < deformed.size(); vertex++)
+                {
+                    midPoint = midPoint + deformed[vertex];
+                    minCoords.x = std::min(minCoords.x, deformed[vertex].x);
+                    minCoords.y = std::min(minCoords.y, deformed[vertex].y);
+                    minCoords.z = std::min(minCoords.z, deformed[vertex].z);
+                    maxCoords.x = std::max(maxCoords.x, deformed[vertex].x);
+                    maxCoords.y = std::max(maxCoords.y, deformed[vertex].y);
+                    maxCoords.z = std::max(maxCoords.z, deformed[vertex].z);
+                }
+                meshFile.write(reinterpret_cast<const char*>(deformed.data()), deformed.size() * sizeof(Vector));
+            }
+            else
+            {
+                for (std::size_t vertex = 0; vertex < deformed.size(); vertex++)
+                    meshFile << deformed[vertex].x << " " << deformed[vertex].y << " " << deformed[vertex].z << "\n";
+            }
+            if (meshFile.fail())
+                failed = true;
+            freeChunks.push(chunk);
+        }
+    }
+    freeChunks.close();
+    reader.join();
+    for (unsigned int worker = 0; worker < workers.size(); worker++)
+        workers[worker].join();
+
+    if (failed || nextSequence * _chunkSize < _vertexCount)
+        return false;
+    if (!binaryOutput)
+    {
+        meshFile.close();
+        return !meshFile.fail();
+    }
+
+    // pad the positions and close the file, then go back over it to centre the
+    // vertices and fill in the header
+    uint64_t positionsEnd = header.positionOffset + _vertexCount * sizeof(Vector);
+    meshFile.write(padding.data(), alignMeshFileOffset(positionsEnd) - positionsEnd);
+    meshFile.close();
+    if (meshFile.fail())
+        return false;
+
+    midPoint = midPoint / _vertexCount;
+    header.midPoint[0] = midPoint.x; header.midPoint[1] = midPoint.y; header.midPoint[2] = midPoint.z;
+    header.minCoords[0] = minCoords.x; header.minCoords[1] = minCoords.y; header.minCoords[2] = minCoords.z;
+    header.maxCoords[0] = maxCoords.x; header.maxCoords[1] = maxCoords.y; header.maxCoords[2] = maxCoords.z;
+    header.modelSize = (maxCoords - minCoords).magnitude();
+
+    std::fstream centreFile(fileName, std::fstream::binary | std::fstream::in | std::fstream::out);
+    centreFile.write(reinterpret_cast<const char*>(&header), sizeof(MeshFileHeader));
+    std::vector<Vector>& vertices = chunks[0].vertices;
+    for (std::size_t first = 0; first < _vertexCount; first += _chunkSize)
+    {
+        std::size_t count = std::min(_chunkSize, _vertexCount - first);
+        vertices.resize(count);
+        std::streamoff offset = header.positionOffset + first * sizeof(Vector);
+        centreFile.seekg(offset);
+        centreFile.read(reinterpret_cast<char*>(vertices.data()), count * sizeof(Vector));
+        for (std::size_t vertex = 0; vertex < count; vertex++)
+            vertices[vertex] = vertices[vertex] - midPoint;
+        centreFile.seekp(offset);
+        centreFile.write(reinterpret_cast<const char*>(vertices.data()), count * sizeof(Vector));
+    }
+    centreFile.close();
+    return !centreFile.fail();
+}
+
+float MeshStream::getModelSize()
+{
+    return _modelSize;
+}
+
+std::size_t MeshStream::getVertexCount()
+{
+    return _vertexCount;
+}
+
+void MeshStream::setChunkSize(std::size_t chunkSize)
+{
+    _chunkSize = std::max<std::size_t>(chunkSize, 1);
+}
+
+void MeshStream::setWorkerCount(unsigned int workerCount)
+{
+    _workerCount = std::max(workerCount, 1u);
+}
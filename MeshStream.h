@@ -0,0 +1,63 @@
+#ifndef _MESH_STREAM_H
+#define _MESH_STREAM_H
+
+#include <cstddef>
+#include <string>
+
+#include "Vector.h"
+#include "GridBuilder.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+
+// Deforms a mesh file into another without ever holding the whole mesh.
+// A reader thread parses the input a chunk at a time, worker threads bind
+// and deform the chunks and a writer thread writes them out in order. The
+// stages are connected by bounded queues and chunk buffers are recycled,
+// so memory use depends on the chunk size and thread count, not on the
+// size of the mesh.
+class MeshStream
+{
+    public:
+
+    MeshStream();
+
+    // open a text or binary mesh, finding its midpoint and size from the
+    // header of a binary mesh or from a pass over a text mesh
+    bool open(std::string fileName);
+    // bind each chunk to restGrid, deform it with deformedGrid and write it
+    // to fileName, in the binary format if it ends in .bmesh, false if a chunk
+    // lies outside the cells of a sparse restGrid, fileName is only replaced once
+    // every chunk has been written
+    bool deform(GridBuilder* restGrid, GridBuilder* deformedGrid, std::string fileName);
+
+    float getModelSize();
+    std::size_t getVertexCount();
+    // number of vertices per chunk and number of deforming threads
+    void setChunkSize(std::size_t chunkSize);
+    void setWorkerCount(unsigned int workerCount);
+
+    private:
+    // go back to the first vertex
+    void rewind();
+    // read up to count uncentred vertices, returns the number read or -1 on a parse error
+    long readVertices(Vector* vertices, std::size_t count);
+    // deform into fileName as it is, in the binary format or not
+    bool writeDeformed(GridBuilder* restGrid, GridBuilder* deformedGrid, std::string fileName, bool binaryOutput);
+
+    MappedFile _file;
+    bool _binary;
+    MeshFileHeader _header;
+
+    // position of the next vertex in the file
+    const char* _text;
+    std::size_t _nextVertex;
+
+    std::size_t _vertexCount;
+    Vector _midPoint;
+    float _modelSize;
+
+    std::size_t _chunkSize;
+    unsigned int _workerCount;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <cstring>
+
+#include "MeshWelder.h"
+#include "Parallel.h"
+
+// hash partitions per thread, each partition is welded by one thread
+static const std::size_t PARTITIONS_PER_THREAD = 4;
+static const uint32_t EMPTY_SLOT = 0xffffffff;
+
+// bit pattern of a coordinate, with -0.0 and 0.0 treated as the same position
+static uint32_t coordinateBits(float coordinate)
+{
+    if (coordinate == 0.0f)
+        coordinate = 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &coordinate, sizeof(bits));
+    return bits;
+}
+
+static uint32_t hashPosition(const Vector& position)
+{
+    uint64_t hash = coordinateBits(position.x) * 0x9e3779b97f4a7c15ull;
+    hash ^= coordinateBits(position.y) * 0xc2b2ae3d27d4eb4full;
+    hash ^= coordinateBits(position.z) * 0x165667b19e3779f9ull;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 32;
+    return static_cast<uint32_t>(hash);
+}
+
+static bool samePosition(const Vector& a, const Vector& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+void weldVertices(const Vector* soup, std::size_t count, std::vector<Vector>& vertices, std::vector<uint32_t>& indices)
+{
+    std::size_t nPartitions = threadCount() * PARTITIONS_PER_THREAD;
+    // the soup is split into as many chunks as there are partitions
+    std::size_t nChunks = nPartitions;
+    auto chunkBegin = [&](std::size_t chunk) { return count * chunk / nChunks; };
+
+    // hash every position and count how many land in each partition, per chunk
+    std::vector<uint32_t> hashes(count);
+    std::vector<std::size_t> partitionOffsets(nChunks * nPartitions, 0);
+    parallelFor(nChunks, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+        {
+            for (std::size_t vertex = chunkBegin(chunk); vertex < chunkBegin(chunk + 1); vertex++)
+            {
+                hashes[vertex] = hashPosition(soup[vertex]);
+                partitionOffsets[chunk * nPartitions + hashes[vertex] % nPartitions]++;
+            }
+        }
+    });
+
+    // lay each partition's vertices out chunk after chunk, so that they are in soup order
+    std::vector<std::size_t> partitionStart(nPartitions + 1, 0);
+    std::size_t offset = 0;
+    for (std::size_t partition = 0; partition < nPartitions; partition++)
+    {
+        partitionStart[partition] = offset;
+        for (std::size_t chunk = 0; chunk < nChunks; chunk++)
+        {
+            std::size_t chunkCount = partitionOffsets[chunk * nPartitions + partition];
+            partitionOffsets[chunk * nPartitions + partition] = offset;
+            offset += chunkCount;
+        }
+    }
+    partitionStart[nPartitions] = offset;
+
+    std::vector<uint32_t> order(count);
+    parallelFor(nChunks, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+        {
+            std::size_t* offsets = &partitionOffsets[chunk * nPartitions];
+            for (std::size_t vertex = chunkBegin(chunk); vertex < chunkBegin(chunk + 1); vertex++)
+                order[offsets[hashes[vertex] % nPartitions]++] = vertex;
+        }
+    });
+
+    // weld each partition with its own hash table, every vertex is mapped to
+    // the first soup vertex with the same position
+    std::vector<uint32_t> firstVertex(count);
+    parallelFor(nPartitions, [&](std::size_t first, std::size_t last)
+    {
+        std::vector<uint32_t> table;
+        for (std::size_t partition = first; partition < last; partition++)
+        {
+            std::size_t size = partitionStart[partition + 1] - partitionStart[partition];
+            std::size_t tableSize = 16;
+            while (tableSize < size * 2)
+                tableSize *= 2;
+            table.assign(tableSize, EMPTY_SLOT);
+
+            for (std::size_t entry = partitionStart[partition]; entry < partitionStart[partition + 1]; entry++)
+            {
+                uint32_t vertex = order[entry];
+                // the partition used the low bits of the hash, the table uses the high ones
+                std::size_t slot = (hashes[vertex] / nPartitions) & (tableSize - 1);
+                while (table[slot] != EMPTY_SLOT && !samePosition(soup[table[slot]], soup[vertex]))
+                    slot = (slot + 1) & (tableSize - 1);
+                if (table[slot] == EMPTY_SLOT)
+                    table[slot] = vertex;
+                firstVertex[vertex] = table[slot];
+            }
+        }
+    });
+
+    // number the unique vertices in soup order, reusing hashes for the new indices
+    std::vector<uint32_t>& newIndex = hashes;
+    std::vector<std::size_t> chunkUnique(nChunks + 1, 0);
+    parallelFor(nChunks, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+            for (std::size_t vertex = chunkBegin(chunk); vertex < chunkBegin(chunk + 1); vertex++)
+                chunkUnique[chunk + 1] += firstVertex[vertex] == vertex;
+    });
+    for (std::size_t chunk = 0; chunk < nChunks; chunk++)
+        chunkUnique[chunk + 1] += chunkUnique[chunk];
+
+    vertices.resize(chunkUnique[nChunks]);
+    parallelFor(nChunks, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+        {
+            uint32_t next = chunkUnique[chunk];
+            for (std::size_t vertex = chunkBegin(chunk); vertex < chunkBegin(chunk + 1); vertex++)
+            {
+                if (firstVertex[vertex] == vertex)
+                {
+                    vertices[next] = soup[vertex];
+                    newIndex[vertex] = next++;
+                }
+            }
+        }
+    });
+
+    // a vertex's first occurrence may be in an earlier chunk, so this needs every new index
+    indices.resize(count);
+    parallelFor(count, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t vertex = first; vertex < last; vertex++)
+            indices[vertex] = newIndex[firstVertex[vertex]];
+    });
+}
@@ -0,0 +1,16 @@
+#ifndef _MESH_WELDER_H
+#define _MESH_WELDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+
+// Weld the identical positions of a triangle soup into unique vertices and
+// an index buffer with one index per soup vertex. Unique vertices keep the
+// order in which they first appear in the soup, so the result does not
+// depend on the number of threads the work is split across.
+void weldVertices(const Vector* soup, std::size_t count, std::vector<Vector>& vertices, std::vector<uint32_t>& indices);
+
+#endif
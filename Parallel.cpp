@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Parallel.h"
+
+// chunks per thread, enough for threads that finish early to take over
+// the work of slow ones
+static const std::size_t CHUNKS_PER_THREAD = 8;
+
+// set on pool threads, and on the calling thread while it works on a job
+static thread_local bool insideJob = false;
+
+// Workers that sleep between jobs instead of being started for every call
+class ThreadPool
+{
+    public:
+
+    ThreadPool()
+    {
+        _threadCount = hardwareThreads();
+        _stop = false;
+        _generation = 0;
+        _busyWorkers = 0;
+        _body = nullptr;
+        _count = 0;
+        _chunkSize = 1;
+        _nChunks = 0;
+    }
+
+    ~ThreadPool()
+    {
+        stopWorkers();
+    }
+
+    static unsigned int hardwareThreads()
+    {
+        unsigned int count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    unsigned int threadCount()
+    {
+        return _threadCount;
+    }
+
+    void setThreadCount(unsigned int count)
+    {
+        // wait for any job to finish before replacing the workers
+        std::lock_guard<std::mutex> job(_jobMutex);
+        stopWorkers();
+        _threadCount = count == 0 ? hardwareThreads() : count;
+    }
+
+    void run(std::size_t count, const std::function<void(std::size_t, std::size_t)>& body)
+    {
+        if (count == 0)
+            return;
+        std::size_t chunkSize = std::max<std::size_t>(1, count / (_threadCount * CHUNKS_PER_THREAD));
+        if (_threadCount <= 1 || chunkSize >= count || insideJob)
+        {
+            body(0, count);
+            return;
+        }
+        std::unique_lock<std::mutex> job(_jobMutex, std::try_to_lock);
+        if (!job.owns_lock())
+        {
+            body(0, count);
+            return;
+        }
+        if (_workers.empty())
+            startWorkers();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _body = &body;
+            _count = count;
+            _chunkSize = chunkSize;
+            _nChunks = (count + chunkSize - 1) / chunkSize;
+            _nextChunk = 0;
+            _busyWorkers = _workers.size();
+            _generation++;
+        }
+        _wake.notify_all();
+
+        // the calling thread works on the job too
+        insideJob = true;
+        runChunks();
+        insideJob = false;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _busyWorkers == 0; });
+        _body = nullptr;
+    }
+
+    private:
+
+    void startWorkers()
+    {
+        _stop = false;
+        for (unsigned int worker = 1; worker < _threadCount; worker++)
+            _workers.emplace_back(&ThreadPool::work, this);
+    }
+
+    void stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (unsigned int worker = 0; worker < _workers.size(); worker++)
+            _workers[worker].join();
+        _workers.clear();
+    }
+
+    void work()
+    {
+        insideJob = true;
+        unsigned long long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [&]() { return _stop || _generation != seen; });
+                if (_stop)
+                    return;
+                seen = _generation;
+            }
+            runChunks();
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (--_busyWorkers == 0)
+                    _done.notify_all();
+            }
+        }
+    }
+
+    // take chunks of the current job until there are none left
+    void runChunks()
+    {
+        for (std::size_t chunk = _nextChunk++; chunk < _nChunks; chunk = _nextChunk++)
+        {
+            std::size_t begin = chunk * _chunkSize;
+            (*_body)(begin, std::min(begin + _chunkSize, _count));
+        }
+    }
+
+    std::atomic<unsigned int> _threadCount;
+    std::vector<std::thread> _workers;
+
+    // one job runs at a time
+    std::mutex _jobMutex;
+    // guards the job and the worker state below
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    bool _stop;
+    unsigned long long _generation;
+    std::size_t _busyWorkers;
+
+    // the current job
+    const std::function<void(std::size_t, std::size_t)>* _body;
+    std::size_t _count;
+    std::size_t _chunkSize;
+    std::size_t _nChunks;
+    std::atomic<std::size_t> _nextChunk;
+};
+
+static ThreadPool& threadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned int threadCount()
+{
+    return threadPool().threadCount();
+}
+
+void setThreadCount(unsigned int count)
+{
+    threadPool().setThreadCount(count);
+}
+
+void parallelFor(std::size_t count, const std::function<void(std::size_t begin, std::size_t end)>& body)
+{
+    threadPool().run(count, body);
+}
@@ -0,0 +1,17 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// number of threads parallelFor splits work across
+unsigned int threadCount();
+// change the number of threads, 0 goes back to one per core
+void setThreadCount(unsigned int count);
+// split [0, count) into chunks that the calling thread and a pool of persistent
+// worker threads take in turn, calling body on each, returns once every chunk is done.
+// Calls made from inside body, or while another thread's call is running, run on the
+// calling thread alone
+void parallelFor(std::size_t count, const std::function<void(std::size_t begin, std::size_t end)>& body);
+
+#endif
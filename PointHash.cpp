@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+
+#include "PointHash.h"
+
+// cell coordinates are kept within this so that far away points can't overflow them
+static const float MAX_CELL = 1 << 30;
+// the cells looked in reach this much further than the radius, so that rounding never
+// leaves out a point the distance test takes
+static const float RADIUS_PADDING = 1e-4f;
+
+PointHash::PointHash()
+{
+    clear();
+}
+
+void PointHash::clear()
+{
+    _cellSize = 0.0;
+    _buckets.clear();
+    _pointCells.clear();
+}
+
+bool PointHash::isBuilt() const
+{
+    return !_buckets.empty();
+}
+
+float PointHash::getCellSize() const
+{
+    return _cellSize;
+}
+
+void PointHash::build(const std::vector<Vector>& points, float cellSize)
+{
+    clear();
+    _cellSize = cellSize;
+
+    // about one bucket per point
+    std::size_t nBuckets = 1;
+    while (nBuckets < points.size())
+        nBuckets *= 2;
+    _buckets.resize(nBuckets);
+    _pointCells.resize(points.size());
+    for (std::size_t point = 0; point < points.size(); point++)
+    {
+        _pointCells[point] = cellOf(points[point]);
+        _buckets[bucketOf(_pointCells[point])].push_back(point);
+    }
+}
+
+void PointHash::movePoint(int point, const Vector& position)
+{
+    Cell cell = cellOf(position);
+    Cell& previous = _pointCells[point];
+    if (cell.x == previous.x && cell.y == previous.y && cell.z == previous.z)
+        return;
+
+    std::vector<int>& bucket = _buckets[bucketOf(previous)];
+    std::vector<int>::iterator entry = std::find(bucket.begin(), bucket.end(), point);
+    *entry = bucket.back();
+    bucket.pop_back();
+    previous = cell;
+    _buckets[bucketOf(cell)].push_back(point);
+}
+
+void PointHash::findPoints(const std::vector<Vector>& points, const Vector& centre, float radius, std::vector<int>& found) const
+{
+    found.clear();
+    if (_buckets.empty())
+        return;
+
+    Vector around = centre;
+    float reach = radius * (1.0f + RADIUS_PADDING);
+    Cell first = cellOf(around - Vector(reach, reach, reach));
+    Cell last = cellOf(around + Vector(reach, reach, reach));
+    double nCells = (double)(last.x - first.x + 1) * (last.y - first.y + 1) * (last.z - first.z + 1);
+    if (nCells > (double)_pointCells.size())
+    {
+        // a radius spanning more cells than there are points is quicker to test point by point
+        for (std::size_t point = 0; point < points.size(); point++)
+        {
+            Vector position = points[point];
+            if ((position - around).magnitude() < radius)
+                found.push_back(point);
+        }
+        return;
+    }
+
+    for (int z = first.z; z <= last.z; z++)
+    {
+        for (int y = first.y; y <= last.y; y++)
+        {
+            for (int x = first.x; x <= last.x; x++)
+            {
+                Cell cell = { x, y, z };
+                const std::vector<int>& bucket = _buckets[bucketOf(cell)];
+                for (std::size_t entry = 0; entry < bucket.size(); entry++)
+                {
+                    int point = bucket[entry];
+                    const Cell& pointCell = _pointCells[point];
+                    // skip the points of other cells sharing the bucket, they are found with their own cell
+                    if (pointCell.x != x || pointCell.y != y || pointCell.z != z)
+                        continue;
+                    Vector position = points[point];
+                    if ((position - around).magnitude() < radius)
+                        found.push_back(point);
+                }
+            }
+        }
+    }
+    // in index order, as a scan of every point would find them
+    std::sort(found.begin(), found.end());
+}
+
+void PointHash::findPointsNear(const std::vector<int>& centres, float radius, std::vector<int>& found) const
+{
+    found.clear();
+    if (_buckets.empty())
+        return;
+
+    // the cells of the centres, each once, then the cells around them
+    std::vector<Cell> cells(centres.size());
+    for (std::size_t centre = 0; centre < centres.size(); centre++)
+        cells[centre] = _pointCells[centres[centre]];
+    auto before = [](const Cell& a, const Cell& b)
+    {
+        return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+    };
+    auto same = [](const Cell& a, const Cell& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+    std::sort(cells.begin(), cells.end(), before);
+    cells.erase(std::unique(cells.begin(), cells.end(), same), cells.end());
+    int reach = (int)std::ceil(radius * (1.0f + RADIUS_PADDING) / _cellSize);
+    std::vector<Cell> around;
+    around.reserve(cells.size() * (2 * reach + 1) * (2 * reach + 1) * (2 * reach + 1));
+    for (std::size_t cell = 0; cell < cells.size(); cell++)
+        for (int z = -reach; z <= reach; z++)
+            for (int y = -reach; y <= reach; y++)
+                for (int x = -reach; x <= reach; x++)
+                    around.push_back({ cells[cell].x + x, cells[cell].y + y, cells[cell].z + z });
+    std::sort(around.begin(), around.end(), before);
+    around.erase(std::unique(around.begin(), around.end(), same), around.end());
+
+    for (std::size_t cell = 0; cell < around.size(); cell++)
+    {
+        const std::vector<int>& bucket = _buckets[bucketOf(around[cell])];
+        for (std::size_t entry = 0; entry < bucket.size(); entry++)
+        {
+            int point = bucket[entry];
+            if (same(_pointCells[point], around[cell]))
+                found.push_back(point);
+        }
+    }
+    std::sort(found.begin(), found.end());
+}
+
+PointHash::Cell PointHash::cellOf(const Vector& position) const
+{
+    Cell cell;
+    cell.x = (int)std::min(std::max(std::floor(position.x / _cellSize), -MAX_CELL), MAX_CELL);
+    cell.y = (int)std::min(std::max(std::floor(position.y / _cellSize), -MAX_CELL), MAX_CELL);
+    cell.z = (int)std::min(std::max(std::floor(position.z / _cellSize), -MAX_CELL), MAX_CELL);
+    return cell;
+}
+
+std::size_t PointHash::bucketOf(const Cell& cell) const
+{
+    uint32_t hash = (uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u;
+    return hash & (_buckets.size() - 1);
+}
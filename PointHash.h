@@ -0,0 +1,51 @@
+#ifndef _POINT_HASH_H
+#define _POINT_HASH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+
+// Hashed grid of cubic cells over a set of points, so that the points within a
+// radius of a position are found by looking in the few cells around it instead of
+// at every point. Only the cells holding points take memory, and a point that
+// moves is only taken out of its bucket when it leaves its cell.
+class PointHash
+{
+    public:
+
+    PointHash();
+
+    // hash every point into cells of the given size
+    void build(const std::vector<Vector>& points, float cellSize);
+    void clear();
+    bool isBuilt() const;
+    float getCellSize() const;
+
+    // follow a point to its new position
+    void movePoint(int point, const Vector& position);
+
+    // the points within radius of centre, points are the positions the hash was
+    // built and moved with, found is cleared first
+    void findPoints(const std::vector<Vector>& points, const Vector& centre, float radius, std::vector<int>& found) const;
+    // the points of every cell within radius of the cell of one of the centres, which takes
+    // in every point within radius of them, each once and in index order
+    void findPointsNear(const std::vector<int>& centres, float radius, std::vector<int>& found) const;
+
+    private:
+    struct Cell
+    {
+        int x, y, z;
+    };
+
+    Cell cellOf(const Vector& position) const;
+    std::size_t bucketOf(const Cell& cell) const;
+
+    float _cellSize;
+    // a power of two number of buckets, each the points of the cells hashed to it
+    std::vector<std::vector<int>> _buckets;
+    // the cell of every point, as points of other cells can share its bucket
+    std::vector<Cell> _pointCells;
+};
+
+#endif
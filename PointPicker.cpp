@@ -0,0 +1,513 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "PointPicker.h"
+
+// past this share of the points moved since the buckets were built, they are built again
+static const std::size_t MOVED_SHARE = 16;
+// the most points in a leaf of the hierarchy
+static const uint32_t LEAF_POINTS = 8;
+// the deepest the hierarchy can be for 2^32 points split in halves
+static const int MAX_DEPTH = 64;
+// the boxes tested are grown by this fraction of their size and of the radius, so that
+// rounding never leaves out a point the exact test takes
+static const float QUERY_PADDING = 1e-4f;
+
+// a point turned by the view, summed in the order the widget always has
+static Vector turnPoint(const float rotation[4][4], const Vector& point)
+{
+    return Vector(rotation[0][0]*point.x + rotation[1][0]*point.y + rotation[2][0]*point.z,
+                  rotation[0][1]*point.x + rotation[1][1]*point.y + rotation[2][1]*point.z,
+                  rotation[0][2]*point.x + rotation[1][2]*point.y + rotation[2][2]*point.z);
+}
+
+// whether a turned point is within radius of the click, and nearer the viewer than the best so far
+static bool isPicked(const Vector& turned, int point, float x, float y, float radius, int best, float bestDepth)
+{
+    if (!((Vector(x, y, 0.0) - Vector(turned.x, turned.y, 0.0)).magnitude() < radius))
+        return false;
+    return best == -1 || bestDepth < turned.z || (bestDepth == turned.z && point < best);
+}
+
+static float coordinate(const Vector& vector, int axis)
+{
+    return axis == 0 ? vector.x : (axis == 1 ? vector.y : vector.z);
+}
+
+PointPicker::PointPicker()
+{
+    clear();
+}
+
+void PointPicker::clear()
+{
+    _screenGrid = nullptr;
+    _screenVersion = 0;
+    std::memset(_screenRotation, 0, sizeof(_screenRotation));
+    _screenPoints.clear();
+    _minX = 0.0;
+    _minY = 0.0;
+    _bucketsPerX = 0.0;
+    _bucketsPerY = 0.0;
+    _columns = 1;
+    _rows = 1;
+    _bucketStart.assign(2, 0);
+    _bucketPoints.clear();
+    _movedPoints.clear();
+    _moved.clear();
+
+    _treeGrid = nullptr;
+    _treeVersion = 0;
+    _treeSize = 0;
+    _nodes.clear();
+    _treePoints.clear();
+    _pointLeaves.clear();
+}
+
+void PointPicker::update(const GridBuilder& gridBuilder, const float rotation[4][4])
+{
+    updateScreen(gridBuilder, rotation);
+    updateTree(gridBuilder);
+}
+
+int PointPicker::pickLinear(const GridBuilder& gridBuilder, const float rotation[4][4], float x, float y, float radius)
+{
+    return pickPoints(gridBuilder._grid, rotation, x, y, radius);
+}
+
+int PointPicker::pickPoints(const std::vector<Vector>& points, const float rotation[4][4], float x, float y, float radius)
+{
+    int best = -1;
+    float bestDepth = 0.0;
+    for (std::size_t point = 0; point < points.size(); point++)
+    {
+        Vector turned = turnPoint(rotation, points[point]);
+        if (isPicked(turned, (int)point, x, y, radius, best, bestDepth))
+        {
+            best = (int)point;
+            bestDepth = turned.z;
+        }
+    }
+    return best;
+}
+
+//
+// Screen buckets
+//
+
+int PointPicker::pickScreen(const GridBuilder& gridBuilder, const float rotation[4][4], float x, float y, float radius)
+{
+    updateScreen(gridBuilder, rotation);
+
+    // every bucket the square around the click overlaps
+    float padding = QUERY_PADDING * (radius + std::fabs(x) + std::fabs(y));
+    int firstColumn = bucketColumn(x - radius - padding);
+    int lastColumn = bucketColumn(x + radius + padding);
+    int firstRow = bucketRow(y - radius - padding);
+    int lastRow = bucketRow(y + radius + padding);
+
+    int best = -1;
+    float bestDepth = 0.0;
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        for (int column = firstColumn; column <= lastColumn; column++)
+        {
+            int bucket = row * _columns + column;
+            for (uint32_t entry = _bucketStart[bucket]; entry < _bucketStart[bucket + 1]; entry++)
+            {
+                uint32_t point = _bucketPoints[entry];
+                if (!_moved[point] && isPicked(_screenPoints[point], point, x, y, radius, best, bestDepth))
+                {
+                    best = point;
+                    bestDepth = _screenPoints[point].z;
+                }
+            }
+        }
+    }
+    for (std::size_t moved = 0; moved < _movedPoints.size(); moved++)
+    {
+        uint32_t point = _movedPoints[moved];
+        if (isPicked(_screenPoints[point], point, x, y, radius, best, bestDepth))
+        {
+            best = point;
+            bestDepth = _screenPoints[point].z;
+        }
+    }
+    return best;
+}
+
+void PointPicker::selectPolygon(const GridBuilder& gridBuilder, const float rotation[4][4], const std::vector<float>& polygon, std::vector<int>& selected)
+{
+    updateScreen(gridBuilder, rotation);
+    selected.clear();
+    if (polygon.size() < 6)
+        return;
+
+    // every bucket the polygon's bounds overlap
+    float minX = polygon[0], maxX = polygon[0];
+    float minY = polygon[1], maxY = polygon[1];
+    for (std::size_t corner = 2; corner + 1 < polygon.size(); corner += 2)
+    {
+        minX = std::min(minX, polygon[corner]);
+        maxX = std::max(maxX, polygon[corner]);
+        minY = std::min(minY, polygon[corner + 1]);
+        maxY = std::max(maxY, polygon[corner + 1]);
+    }
+    int firstColumn = bucketColumn(minX);
+    int lastColumn = bucketColumn(maxX);
+    int firstRow = bucketRow(minY);
+    int lastRow = bucketRow(maxY);
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        for (int column = firstColumn; column <= lastColumn; column++)
+        {
+            int bucket = row * _columns + column;
+            for (uint32_t entry = _bucketStart[bucket]; entry < _bucketStart[bucket + 1]; entry++)
+            {
+                uint32_t point = _bucketPoints[entry];
+                if (!_moved[point] && inPolygon(polygon, _screenPoints[point].x, _screenPoints[point].y))
+                    selected.push_back(point);
+            }
+        }
+    }
+    for (std::size_t moved = 0; moved < _movedPoints.size(); moved++)
+    {
+        uint32_t point = _movedPoints[moved];
+        if (inPolygon(polygon, _screenPoints[point].x, _screenPoints[point].y))
+            selected.push_back(point);
+    }
+    std::sort(selected.begin(), selected.end());
+}
+
+bool PointPicker::inPolygon(const std::vector<float>& polygon, float x, float y)
+{
+    // count the edges a ray from the point towards +x crosses
+    bool inside = false;
+    std::size_t corners = polygon.size() / 2;
+    for (std::size_t corner = 0, previous = corners - 1; corner < corners; previous = corner++)
+    {
+        float x0 = polygon[previous * 2], y0 = polygon[previous * 2 + 1];
+        float x1 = polygon[corner * 2], y1 = polygon[corner * 2 + 1];
+        if ((y1 > y) != (y0 > y) && x < x0 + (y - y0) * (x1 - x0) / (y1 - y0))
+            inside = !inside;
+    }
+    return inside;
+}
+
+void PointPicker::updateScreen(const GridBuilder& gridBuilder, const float rotation[4][4])
+{
+    float view[9];
+    for (int row = 0; row < 3; row++)
+        for (int column = 0; column < 3; column++)
+            view[row * 3 + column] = rotation[row][column];
+    bool sameView = &gridBuilder == _screenGrid && std::memcmp(view, _screenRotation, sizeof(view)) == 0;
+    if (sameView && gridBuilder.getVersion() == _screenVersion)
+        return;
+
+    // a few points dragged under the same view are turned again and set apart
+    const std::vector<Vector>& grid = gridBuilder._grid;
+    std::vector<int> points;
+    if (sameView && grid.size() == _screenPoints.size() && gridBuilder.getChangedPoints(_screenVersion, points)
+        && _movedPoints.size() + points.size() <= grid.size() / MOVED_SHARE)
+    {
+        for (std::size_t changed = 0; changed < points.size(); changed++)
+        {
+            int point = points[changed];
+            _screenPoints[point] = turnPoint(rotation, grid[point]);
+            if (!_moved[point])
+            {
+                _moved[point] = 1;
+                _movedPoints.push_back(point);
+            }
+        }
+    }
+    else
+    {
+        _screenPoints.resize(grid.size());
+        for (std::size_t point = 0; point < grid.size(); point++)
+            _screenPoints[point] = turnPoint(rotation, grid[point]);
+        buildBuckets();
+    }
+
+    _screenGrid = &gridBuilder;
+    _screenVersion = gridBuilder.getVersion();
+    std::memcpy(_screenRotation, view, sizeof(view));
+}
+
+void PointPicker::buildBuckets()
+{
+    std::size_t nPoints = _screenPoints.size();
+    _movedPoints.clear();
+    _moved.assign(nPoints, 0);
+    _bucketPoints.resize(nPoints);
+    if (nPoints == 0)
+    {
+        _columns = 1;
+        _rows = 1;
+        _bucketStart.assign(2, 0);
+        return;
+    }
+
+    // bounds of the points on screen
+    float minX = _screenPoints[0].x, maxX = _screenPoints[0].x;
+    float minY = _screenPoints[0].y, maxY = _screenPoints[0].y;
+    for (std::size_t point = 1; point < nPoints; point++)
+    {
+        minX = std::min(minX, _screenPoints[point].x);
+        maxX = std::max(maxX, _screenPoints[point].x);
+        minY = std::min(minY, _screenPoints[point].y);
+        maxY = std::max(maxY, _screenPoints[point].y);
+    }
+
+    // about one bucket per point
+    _columns = std::max(1, (int)std::ceil(std::sqrt((double)nPoints)));
+    _rows = _columns;
+    _minX = minX;
+    _minY = minY;
+    _bucketsPerX = _columns / std::max(maxX - minX, 1e-30f);
+    _bucketsPerY = _rows / std::max(maxY - minY, 1e-30f);
+
+    // count the points of each bucket, then lay the buckets out one after the other
+    std::vector<uint32_t> buckets(nPoints);
+    _bucketStart.assign(_columns * _rows + 1, 0);
+    for (std::size_t point = 0; point < nPoints; point++)
+    {
+        buckets[point] = bucketRow(_screenPoints[point].y) * _columns + bucketColumn(_screenPoints[point].x);
+        _bucketStart[buckets[point] + 1]++;
+    }
+    for (int bucket = 0; bucket < _columns * _rows; bucket++)
+        _bucketStart[bucket + 1] += _bucketStart[bucket];
+    std::vector<uint32_t> next(_bucketStart.begin(), _bucketStart.end() - 1);
+    for (std::size_t point = 0; point < nPoints; point++)
+        _bucketPoints[next[buckets[point]]++] = point;
+}
+
+int PointPicker::bucketColumn(float x) const
+{
+    float column = std::floor((x - _minX) * _bucketsPerX);
+    return (int)std::min(std::max(column, 0.0f), (float)(_columns - 1));
+}
+
+int PointPicker::bucketRow(float y) const
+{
+    float row = std::floor((y - _minY) * _bucketsPerY);
+    return (int)std::min(std::max(row, 0.0f), (float)(_rows - 1));
+}
+
+//
+// Bounding volume hierarchy
+//
+
+int PointPicker::pickRay(const GridBuilder& gridBuilder, const float rotation[4][4], float x, float y, float radius)
+{
+    updateTree(gridBuilder);
+    if (_nodes.empty())
+        return -1;
+    const std::vector<Vector>& grid = gridBuilder._grid;
+
+    // the screen axes and the view direction in the model, the ray runs along the
+    // view direction through the click
+    float axes[3][3];
+    float lengths[3][3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int component = 0; component < 3; component++)
+        {
+            axes[axis][component] = rotation[component][axis];
+            lengths[axis][component] = std::fabs(rotation[component][axis]);
+        }
+    }
+    float click[2] = { x, y };
+
+    int best = -1;
+    float bestDepth = 0.0;
+    uint32_t stack[MAX_DEPTH];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0)
+    {
+        const Node& node = _nodes[stack[--size]];
+
+        // the box seen along each axis spans its centre's coordinate give or take
+        // its half size's, it is skipped if that misses the square around the ray or
+        // lies behind the best point
+        float centre[3], half[3];
+        float extent = radius;
+        for (int component = 0; component < 3; component++)
+        {
+            centre[component] = 0.5f * (node.min[component] + node.max[component]);
+            half[component] = 0.5f * (node.max[component] - node.min[component]);
+            extent += std::fabs(centre[component]) + half[component];
+        }
+        float padding = QUERY_PADDING * extent;
+        bool missed = false;
+        float span[3];
+        float along[3];
+        for (int axis = 0; axis < 3 && !missed; axis++)
+        {
+            along[axis] = axes[axis][0] * centre[0] + axes[axis][1] * centre[1] + axes[axis][2] * centre[2];
+            span[axis] = lengths[axis][0] * half[0] + lengths[axis][1] * half[1] + lengths[axis][2] * half[2] + padding;
+            if (axis < 2)
+                missed = std::fabs(along[axis] - click[axis]) > radius + span[axis];
+        }
+        if (missed || (best != -1 && along[2] + span[2] < bestDepth))
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t entry = node.first; entry < node.first + node.count; entry++)
+            {
+                uint32_t point = _treePoints[entry];
+                Vector turned = turnPoint(rotation, grid[point]);
+                if (isPicked(turned, point, x, y, radius, best, bestDepth))
+                {
+                    best = point;
+                    bestDepth = turned.z;
+                }
+            }
+        }
+        else
+        {
+            // the child nearer the viewer goes on top, so that it is walked first
+            // and the one behind it can often be skipped
+            const Node& first = _nodes[node.first];
+            const Node& second = _nodes[node.first + 1];
+            float firstDepth = 0.0, secondDepth = 0.0;
+            for (int component = 0; component < 3; component++)
+            {
+                firstDepth += axes[2][component] * (first.min[component] + first.max[component]);
+                secondDepth += axes[2][component] * (second.min[component] + second.max[component]);
+            }
+            bool firstNearer = firstDepth > secondDepth;
+            stack[size++] = firstNearer ? node.first + 1 : node.first;
+            stack[size++] = firstNearer ? node.first : node.first + 1;
+        }
+    }
+    return best;
+}
+
+void PointPicker::updateTree(const GridBuilder& gridBuilder)
+{
+    if (&gridBuilder == _treeGrid && gridBuilder.getVersion() == _treeVersion)
+        return;
+
+    // moving points keeps the hierarchy, only the bounds above them are computed again
+    const std::vector<Vector>& grid = gridBuilder._grid;
+    std::vector<int> points;
+    if (&gridBuilder != _treeGrid || grid.size() != _treeSize || !gridBuilder.getChangedPoints(_treeVersion, points))
+    {
+        _nodes.clear();
+        _treePoints.resize(grid.size());
+        for (std::size_t point = 0; point < grid.size(); point++)
+            _treePoints[point] = point;
+        _pointLeaves.resize(grid.size());
+        if (!grid.empty())
+        {
+            _nodes.reserve(2 * (grid.size() / LEAF_POINTS + 1));
+            _nodes.resize(1);
+            _nodes[0].parent = 0;
+            buildNode(grid, 0, 0, grid.size());
+            refitNode(grid, 0);
+        }
+    }
+    else if (points.size() > grid.size() / LEAF_POINTS)
+        refitNode(grid, 0);
+    else
+    {
+        for (std::size_t changed = 0; changed < points.size(); changed++)
+        {
+            uint32_t node = _pointLeaves[points[changed]];
+            fitNode(grid, node);
+            while (node != 0)
+            {
+                node = _nodes[node].parent;
+                fitNode(grid, node);
+            }
+        }
+    }
+
+    _treeGrid = &gridBuilder;
+    _treeVersion = gridBuilder.getVersion();
+    _treeSize = grid.size();
+}
+
+void PointPicker::buildNode(const std::vector<Vector>& grid, uint32_t node, uint32_t first, uint32_t count)
+{
+    _nodes[node].first = first;
+    _nodes[node].count = count;
+    if (count <= LEAF_POINTS)
+    {
+        for (uint32_t entry = first; entry < first + count; entry++)
+            _pointLeaves[_treePoints[entry]] = node;
+        return;
+    }
+
+    // split the points in halves across the longest side of their bounds
+    float min[3] = { grid[_treePoints[first]].x, grid[_treePoints[first]].y, grid[_treePoints[first]].z };
+    float max[3] = { min[0], min[1], min[2] };
+    for (uint32_t entry = first + 1; entry < first + count; entry++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], coordinate(grid[_treePoints[entry]], axis));
+            max[axis] = std::max(max[axis], coordinate(grid[_treePoints[entry]], axis));
+        }
+    }
+    int axis = 0;
+    if (max[1] - min[1] > max[axis] - min[axis])
+        axis = 1;
+    if (max[2] - min[2] > max[axis] - min[axis])
+        axis = 2;
+    uint32_t half = count / 2;
+    std::nth_element(_treePoints.begin() + first, _treePoints.begin() + first + half, _treePoints.begin() + first + count,
+        [&grid, axis](uint32_t a, uint32_t b) { return coordinate(grid[a], axis) < coordinate(grid[b], axis); });
+
+    uint32_t children = _nodes.size();
+    _nodes.resize(children + 2);
+    _nodes[node].first = children;
+    _nodes[node].count = 0;
+    _nodes[children].parent = node;
+    _nodes[children + 1].parent = node;
+    buildNode(grid, children, first, half);
+    buildNode(grid, children + 1, first + half, count - half);
+}
+
+void PointPicker::refitNode(const std::vector<Vector>& grid, uint32_t node)
+{
+    if (_nodes[node].count == 0)
+    {
+        refitNode(grid, _nodes[node].first);
+        refitNode(grid, _nodes[node].first + 1);
+    }
+    fitNode(grid, node);
+}
+
+void PointPicker::fitNode(const std::vector<Vector>& grid, uint32_t node)
+{
+    Node& current = _nodes[node];
+    if (current.count > 0)
+    {
+        const Vector& point = grid[_treePoints[current.first]];
+        current.min[0] = current.max[0] = point.x;
+        current.min[1] = current.max[1] = point.y;
+        current.min[2] = current.max[2] = point.z;
+        for (uint32_t entry = current.first + 1; entry < current.first + current.count; entry++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                current.min[axis] = std::min(current.min[axis], coordinate(grid[_treePoints[entry]], axis));
+                current.max[axis] = std::max(current.max[axis], coordinate(grid[_treePoints[entry]], axis));
+            }
+        }
+        return;
+    }
+
+    const Node& first = _nodes[current.first];
+    const Node& second = _nodes[current.first + 1];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        current.min[axis] = std::min(first.min[axis], second.min[axis]);
+        current.max[axis] = std::max(first.max[axis], second.max[axis]);
+    }
+}
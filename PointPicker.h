@@ -0,0 +1,101 @@
+#ifndef _POINT_PICKER_H
+#define _POINT_PICKER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+#include "GridBuilder.h"
+
+// Finds the grid point under a click without testing every point.
+// Picking on screen keeps the grid points turned by the view in a grid of buckets,
+// built again only when the view turns or many points moved. Picking along the
+// ray through the click walks a bounding volume hierarchy over the points at
+// their place in the model, which the view turning leaves alone and moving
+// points only refits. Both pick the point a linear scan would: the one nearest
+// the viewer within radius of the click, the lowest index of those equally near.
+// The view is a rotation as the arcball keeps it, a point p is seen at
+// x = rotation[0][0]*p.x + rotation[1][0]*p.y + rotation[2][0]*p.z, and y and
+// depth likewise from the second and third columns.
+class PointPicker
+{
+    public:
+
+    PointPicker();
+
+    // bring both caches up to date with the grid and view, so that the next pick is quick
+    void update(const GridBuilder& gridBuilder, const float rotation[4][4]);
+    void clear();
+
+    // index of the point picked through the screen buckets, -1 if none is within radius
+    int pickScreen(const GridBuilder& gridBuilder, const float rotation[4][4], float x, float y, float radius);
+    // index of the point picked along the ray through (x, y), -1 if none is within radius
+    int pickRay(const GridBuilder& gridBuilder, const float rotation[4][4], float x, float y, float radius);
+
+    // the linear scan both picks are checked against
+    static int pickLinear(const GridBuilder& gridBuilder, const float rotation[4][4], float x, float y, float radius);
+    // the same scan over any points, such as the vertices of the deformed mesh
+    static int pickPoints(const std::vector<Vector>& points, const float rotation[4][4], float x, float y, float radius);
+
+    // the points seen inside a polygon on screen, given as x, y pairs, in index order,
+    // through the screen buckets its bounds overlap
+    void selectPolygon(const GridBuilder& gridBuilder, const float rotation[4][4], const std::vector<float>& polygon, std::vector<int>& selected);
+    // whether (x, y) is inside the polygon, by the even-odd rule
+    static bool inPolygon(const std::vector<float>& polygon, float x, float y);
+
+    private:
+    // a node of the hierarchy, a leaf holds _treePoints[first, first + count), the
+    // children of an inner node are first and first + 1
+    struct Node
+    {
+        float min[3];
+        float max[3];
+        uint32_t first;
+        uint32_t count;
+        uint32_t parent;
+    };
+
+    void updateScreen(const GridBuilder& gridBuilder, const float rotation[4][4]);
+    void buildBuckets();
+    // bucket holding a point, points outside the buckets go to the nearest one
+    int bucketColumn(float x) const;
+    int bucketRow(float y) const;
+
+    void updateTree(const GridBuilder& gridBuilder);
+    // split points [first, first + count) of _treePoints under node
+    void buildNode(const std::vector<Vector>& grid, uint32_t node, uint32_t first, uint32_t count);
+    // recompute the bounds of node and below from the points where they are now
+    void refitNode(const std::vector<Vector>& grid, uint32_t node);
+    // recompute the bounds of node alone, from its points or its children
+    void fitNode(const std::vector<Vector>& grid, uint32_t node);
+
+    // the grid, its version and the view the screen positions were computed for
+    const GridBuilder* _screenGrid;
+    unsigned long long _screenVersion;
+    float _screenRotation[9];
+    // every point turned by the view, x and y on screen and z its depth
+    std::vector<Vector> _screenPoints;
+
+    // bucket grid bounds and size
+    float _minX, _minY;
+    float _bucketsPerX, _bucketsPerY;
+    int _columns, _rows;
+    // the points of bucket b are _bucketPoints[_bucketStart[b], _bucketStart[b + 1])
+    std::vector<uint32_t> _bucketStart;
+    std::vector<uint32_t> _bucketPoints;
+    // points that moved since the buckets were built are left in their old bucket,
+    // skipped there and tested apart
+    std::vector<uint32_t> _movedPoints;
+    std::vector<char> _moved;
+
+    // the grid and version the hierarchy's bounds were computed for
+    const GridBuilder* _treeGrid;
+    unsigned long long _treeVersion;
+    std::size_t _treeSize;
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _treePoints;
+    // the leaf holding each point
+    std::vector<uint32_t> _pointLeaves;
+};
+
+#endif
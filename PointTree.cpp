@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include "PointTree.h"
+
+static float coordinate(const Vector& vector, int axis)
+{
+    return axis == 0 ? vector.x : (axis == 1 ? vector.y : vector.z);
+}
+
+PointTree::PointTree()
+{
+    clear();
+}
+
+void PointTree::clear()
+{
+    _points.clear();
+    _order.clear();
+    _axes.clear();
+}
+
+bool PointTree::isEmpty() const
+{
+    return _points.empty();
+}
+
+void PointTree::build(const std::vector<Vector>& points)
+{
+    _points = points;
+    _order.resize(points.size());
+    _axes.assign(points.size(), 0);
+    for (std::size_t point = 0; point < points.size(); point++)
+        _order[point] = point;
+    buildRange(0, points.size());
+}
+
+void PointTree::buildRange(uint32_t first, uint32_t count)
+{
+    if (count <= 1)
+        return;
+
+    float min[3] = { _points[_order[first]].x, _points[_order[first]].y, _points[_order[first]].z };
+    float max[3] = { min[0], min[1], min[2] };
+    for (uint32_t entry = first + 1; entry < first + count; entry++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], coordinate(_points[_order[entry]], axis));
+            max[axis] = std::max(max[axis], coordinate(_points[_order[entry]], axis));
+        }
+    }
+    int axis = 0;
+    if (max[1] - min[1] > max[axis] - min[axis])
+        axis = 1;
+    if (max[2] - min[2] > max[axis] - min[axis])
+        axis = 2;
+
+    uint32_t half = count / 2;
+    std::nth_element(_order.begin() + first, _order.begin() + first + half, _order.begin() + first + count,
+        [this, axis](uint32_t a, uint32_t b) { return coordinate(_points[a], axis) < coordinate(_points[b], axis); });
+    _axes[first + half] = axis;
+    buildRange(first, half);
+    buildRange(first + half + 1, count - half - 1);
+}
+
+int PointTree::findNearest(const Vector& position, float& distance) const
+{
+    int best = -1;
+    float bestSquared = 0.0;
+    searchRange(position, 0, _points.size(), best, bestSquared);
+    if (best != -1)
+        distance = (Vector(_points[best]) - position).magnitude();
+    return best;
+}
+
+void PointTree::searchRange(const Vector& position, uint32_t first, uint32_t count, int& best, float& bestSquared) const
+{
+    if (count == 0)
+        return;
+    uint32_t half = count / 2;
+    uint32_t point = _order[first + half];
+    const Vector& pivot = _points[point];
+
+    float dx = pivot.x - position.x;
+    float dy = pivot.y - position.y;
+    float dz = pivot.z - position.z;
+    float squared = dx*dx + dy*dy + dz*dz;
+    if (best == -1 || squared < bestSquared || (squared == bestSquared && (int)point < best))
+    {
+        best = point;
+        bestSquared = squared;
+    }
+
+    // the side of the split holding position first, the other only if the split is no further than the best
+    int axis = _axes[first + half];
+    float split = coordinate(pivot, axis) - coordinate(position, axis);
+    bool below = split > 0.0;
+    if (below)
+        searchRange(position, first, half, best, bestSquared);
+    else
+        searchRange(position, first + half + 1, count - half - 1, best, bestSquared);
+    if (split * split <= bestSquared)
+    {
+        if (below)
+            searchRange(position, first + half + 1, count - half - 1, best, bestSquared);
+        else
+            searchRange(position, first, half, best, bestSquared);
+    }
+}
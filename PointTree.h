@@ -0,0 +1,37 @@
+#ifndef _POINT_TREE_H
+#define _POINT_TREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+
+// k-d tree over a set of points, laid out in one array with the median of every
+// range in its middle, for the nearest of the points to any position.
+// It keeps its own copy of the points.
+class PointTree
+{
+    public:
+
+    PointTree();
+
+    void build(const std::vector<Vector>& points);
+    void clear();
+    bool isEmpty() const;
+
+    // index of the point nearest position, the lowest of those equally near, and its
+    // distance as (point - position).magnitude(), -1 if there are no points
+    int findNearest(const Vector& position, float& distance) const;
+
+    private:
+    // put the median of [first, first + count) across its longest side in the middle, then split the halves
+    void buildRange(uint32_t first, uint32_t count);
+    void searchRange(const Vector& position, uint32_t first, uint32_t count, int& best, float& bestSquared) const;
+
+    std::vector<Vector> _points;
+    // the points in tree order, and the axis each one splits its range across
+    std::vector<uint32_t> _order;
+    std::vector<uint8_t> _axes;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SparseLattice.h"
+#include "Parallel.h"
+
+// bits of each coordinate in a key, column lowest so that keys sort layer by layer, row by row
+static const int KEY_BITS = 21;
+static const uint64_t KEY_MASK = (1ull << KEY_BITS) - 1;
+// no coordinates pack into this, it marks the empty slots of a table
+static const uint64_t EMPTY_KEY = ~0ull;
+// spreads the coordinates over the bits of the hash, the golden ratio in 64 bits
+static const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+static inline uint64_t hashKey(uint64_t key)
+{
+    uint64_t hash = key * HASH_MULTIPLIER;
+    return hash ^ (hash >> 32);
+}
+
+static inline int keyCoordinate(uint64_t key, int axis)
+{
+    return (key >> (axis * KEY_BITS)) & KEY_MASK;
+}
+
+// add the keys from low to high steps along an axis from each key, those within
+// [0, limit], and keep every key once and in order
+static void dilateKeys(std::vector<uint64_t>& keys, int axis, int low, int high, int limit)
+{
+    std::size_t count = keys.size();
+    keys.reserve(count * (high - low + 1));
+    for (std::size_t key = 0; key < count; key++)
+    {
+        int coordinate = keyCoordinate(keys[key], axis);
+        for (int step = low; step <= high; step++)
+        {
+            if (step != 0 && coordinate + step >= 0 && coordinate + step <= limit)
+                keys.push_back(keys[key] + ((uint64_t)(int64_t)step << (axis * KEY_BITS)));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+void SparseLattice::KeyTable::build(const std::vector<uint64_t>& entries)
+{
+    std::size_t size = 2;
+    while (size < 2 * entries.size())
+        size *= 2;
+    keys.assign(size, EMPTY_KEY);
+    values.assign(size, -1);
+    mask = size - 1;
+    for (std::size_t entry = 0; entry < entries.size(); entry++)
+    {
+        uint64_t slot = hashKey(entries[entry]) & mask;
+        while (keys[slot] != EMPTY_KEY)
+            slot = (slot + 1) & mask;
+        keys[slot] = entries[entry];
+        values[slot] = entry;
+    }
+}
+
+void SparseLattice::KeyTable::clear()
+{
+    keys.assign(2, EMPTY_KEY);
+    values.assign(2, -1);
+    mask = 1;
+}
+
+int SparseLattice::KeyTable::find(uint64_t key) const
+{
+    // the table is at most half full, so a run of filled slots soon ends
+    uint64_t slot = hashKey(key) & mask;
+    while (keys[slot] != EMPTY_KEY)
+    {
+        if (keys[slot] == key)
+            return values[slot];
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+SparseLattice::SparseLattice()
+{
+    clear();
+}
+
+void SparseLattice::clear()
+{
+    _gridSize = 2;
+    _modelSize = 1.0;
+    _pointKeys.clear();
+    _points.clear();
+    _cells.clear();
+    _corners.clear();
+}
+
+uint64_t SparseLattice::packKey(int col, int row, int cel)
+{
+    return (uint64_t)col | (uint64_t)row << KEY_BITS | (uint64_t)cel << (2 * KEY_BITS);
+}
+
+void SparseLattice::build(int gridSize, float modelSize, const Vector* positions, std::size_t count, std::vector<Vector>& points)
+{
+    clear();
+    _gridSize = std::min(std::max(gridSize, 2), count == 0 ? MAX_FULL_SPARSE_SIZE : MAX_SPARSE_SIZE);
+    _modelSize = modelSize;
+
+    std::vector<uint64_t> keys;
+    if (count == 0)
+    {
+        // every point, like a dense lattice
+        keys.reserve((std::size_t)_gridSize * _gridSize * _gridSize);
+        for (int cel = 0; cel < _gridSize; cel++)
+            for (int row = 0; row < _gridSize; row++)
+                for (int col = 0; col < _gridSize; col++)
+                    keys.push_back(packKey(col, row, cel));
+    }
+    else
+    {
+        // the cell of every position, found the way the binding finds it
+        keys.resize(count);
+        parallelFor(count, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t position = begin; position < end; position++)
+            {
+                int col, row, cel;
+                float u, v, w;
+                locate(positions[position], col, row, cel, u, v, w);
+                keys[position] = packKey(col, row, cel);
+            }
+        });
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        // the cells around them, one axis at a time so that there are never many more keys than cells
+        for (int axis = 0; axis < 3; axis++)
+            dilateKeys(keys, axis, -1, 1, _gridSize - 2);
+        // and their corners
+        for (int axis = 0; axis < 3; axis++)
+            dilateKeys(keys, axis, 0, 1, _gridSize - 1);
+    }
+    setPoints(keys);
+
+    // the rest positions as the dense lattice works them out
+    points.resize(_pointKeys.size());
+    Vector startPos = Vector(-modelSize/2.0, modelSize/2.0, -modelSize/2.0);
+    int lastPoint = _gridSize - 1;
+    parallelFor(points.size(), [&](std::size_t begin, std::size_t end)
+    {
+        Vector origin = startPos;
+        for (std::size_t point = begin; point < end; point++)
+        {
+            int col = keyCoordinate(_pointKeys[point], 0);
+            int row = keyCoordinate(_pointKeys[point], 1);
+            int cel = keyCoordinate(_pointKeys[point], 2);
+            points[point] = origin + Vector(col * modelSize / (float)lastPoint, row * -modelSize / (float)lastPoint, cel * modelSize / (float)lastPoint);
+        }
+    });
+}
+
+bool SparseLattice::rebuild(int gridSize, float modelSize, const std::vector<Vector>& points)
+{
+    clear();
+    if (gridSize < 2 || gridSize > MAX_SPARSE_SIZE)
+        return false;
+    _gridSize = gridSize;
+    _modelSize = modelSize;
+
+    // the nearest lattice point to each position
+    float spacing = modelSize / (float)(gridSize - 1);
+    float half = modelSize / 2.0;
+    std::vector<uint64_t> keys(points.size());
+    for (std::size_t point = 0; point < points.size(); point++)
+    {
+        long col = std::lround((points[point].x + half) / spacing);
+        long row = std::lround((half - points[point].y) / spacing);
+        long cel = std::lround((points[point].z + half) / spacing);
+        if (col < 0 || row < 0 || cel < 0 || col >= gridSize || row >= gridSize || cel >= gridSize)
+            return false;
+        keys[point] = packKey(col, row, cel);
+    }
+    std::vector<uint64_t> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+        return false;
+
+    setPoints(keys);
+    if (_corners.empty())
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+void SparseLattice::setPoints(const std::vector<uint64_t>& pointKeys)
+{
+    _pointKeys = pointKeys;
+    _points.build(_pointKeys);
+
+    // a point is the front top left corner of a cell if the lattice has the other seven
+    std::vector<uint64_t> cellKeys;
+    _corners.clear();
+    int lastCell = _gridSize - 2;
+    for (std::size_t point = 0; point < _pointKeys.size(); point++)
+    {
+        int col = keyCoordinate(_pointKeys[point], 0);
+        int row = keyCoordinate(_pointKeys[point], 1);
+        int cel = keyCoordinate(_pointKeys[point], 2);
+        if (col > lastCell || row > lastCell || cel > lastCell)
+            continue;
+        int32_t corners[8];
+        int corner = 0;
+        for (; corner < 8; corner++)
+        {
+            corners[corner] = _points.find(packKey(col + (corner & 1), row + ((corner >> 1) & 1), cel + (corner >> 2)));
+            if (corners[corner] < 0)
+                break;
+        }
+        if (corner < 8)
+            continue;
+        cellKeys.push_back(_pointKeys[point]);
+        _corners.insert(_corners.end(), corners, corners + 8);
+    }
+    _cells.build(cellKeys);
+}
+
+int SparseLattice::getGridSize() const
+{
+    return _gridSize;
+}
+
+std::size_t SparseLattice::getPointCount() const
+{
+    return _pointKeys.size();
+}
+
+std::size_t SparseLattice::getCellCount() const
+{
+    return _corners.size() / 8;
+}
+
+void SparseLattice::locate(const Vector& position, int& col, int& row, int& cel, float& u, float& v, float& w) const
+{
+    // as in Mesh::getTrilinearWeights, so that a vertex takes the same cell and weights
+    Vector gridOrigin = Vector(-_modelSize/2.0, _modelSize/2.0, -_modelSize/2.0);
+    Vector toOrigin = (gridOrigin - position) / (_modelSize / (_gridSize-1));
+    u = (int)toOrigin.x - toOrigin.x;
+    v = toOrigin.y - (int)toOrigin.y;
+    w = (int)toOrigin.z - toOrigin.z;
+    col = -(int)toOrigin.x;
+    row = (int)toOrigin.y;
+    cel = -(int)toOrigin.z;
+
+    // beyond the lattice the place is measured from the last cell
+    int lastCell = _gridSize - 2;
+    int clamped = std::min(std::max(col, 0), lastCell);
+    u += col - clamped;
+    col = clamped;
+    clamped = std::min(std::max(row, 0), lastCell);
+    v += row - clamped;
+    row = clamped;
+    clamped = std::min(std::max(cel, 0), lastCell);
+    w += cel - clamped;
+    cel = clamped;
+}
+
+int SparseLattice::findCell(int col, int row, int cel) const
+{
+    return _cells.find(packKey(col, row, cel));
+}
+
+int SparseLattice::findPoint(int col, int row, int cel) const
+{
+    return _points.find(packKey(col, row, cel));
+}
+
+const int32_t* SparseLattice::getCorners() const
+{
+    return _corners.data();
+}
+
+void SparseLattice::getEdges(std::vector<uint32_t>& edges) const
+{
+    edges.clear();
+    int lastPoint = _gridSize - 1;
+    for (std::size_t point = 0; point < _pointKeys.size(); point++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (keyCoordinate(_pointKeys[point], axis) == lastPoint)
+                continue;
+            int next = _points.find(_pointKeys[point] + (1ull << (axis * KEY_BITS)));
+            if (next >= 0)
+                edges.insert(edges.end(), { (uint32_t)point, (uint32_t)next });
+        }
+    }
+}
+
+std::size_t SparseLattice::getMemoryUsage() const
+{
+    return _pointKeys.capacity() * sizeof(uint64_t)
+        + _points.keys.capacity() * sizeof(uint64_t) + _points.values.capacity() * sizeof(int32_t)
+        + _cells.keys.capacity() * sizeof(uint64_t) + _cells.values.capacity() * sizeof(int32_t)
+        + _corners.capacity() * sizeof(int32_t);
+}
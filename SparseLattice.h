@@ -0,0 +1,88 @@
+#ifndef _SPARSE_LATTICE_H
+#define _SPARSE_LATTICE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+#include "AlignedAllocator.h"
+
+// the most points a side of a sparse lattice, so that a point's coordinates pack into a key
+static const int MAX_SPARSE_SIZE = 1 << 20;
+// the most points a side of a sparse lattice built without positions, which has every cell
+// and so every point of the dense lattice
+static const int MAX_FULL_SPARSE_SIZE = 64;
+
+// A trilinear lattice of gridSize points a side over the model, laid out like the dense
+// one, that only has the cells the mesh lies in and the cells next to those. Points and
+// cells are found by their lattice coordinates in open addressed hash tables and every
+// cell lists its eight corner points, so that the lattice takes memory for the cells
+// around the mesh's surface rather than for the whole cube, and binding or deforming a
+// vertex is one lookup and one gather however many points a side the lattice has.
+// The cells of the lattice are every cell whose eight corners it has, so that the same
+// lattice comes back from the positions of its points alone.
+class SparseLattice
+{
+    public:
+
+    SparseLattice();
+    void clear();
+
+    // the cells holding any of the positions and every cell next to one of those, of a
+    // lattice of gridSize points a side over a cube of side modelSize around the origin,
+    // or every cell if there are no positions. The rest positions of the points are
+    // returned in points, in lattice order, layer by layer and row by row. Without positions
+    // the lattice has at most MAX_FULL_SPARSE_SIZE points a side
+    void build(int gridSize, float modelSize, const Vector* positions, std::size_t count, std::vector<Vector>& points);
+    // the lattice whose points rest at points, in that order, false if they don't all lie on
+    // distinct points of a lattice of gridSize points a side or don't make a single cell
+    bool rebuild(int gridSize, float modelSize, const std::vector<Vector>& points);
+
+    int getGridSize() const;
+    std::size_t getPointCount() const;
+    std::size_t getCellCount() const;
+
+    // the cell a position lies in, as column, row and layer, and its place in it, with the
+    // arithmetic of the dense trilinear binding; positions beyond the lattice take its last cell
+    void locate(const Vector& position, int& col, int& row, int& cel, float& u, float& v, float& w) const;
+    // the index of a cell or point, -1 if the lattice doesn't have it
+    int findCell(int col, int row, int cel) const;
+    int findPoint(int col, int row, int cel) const;
+    // the eight corner points of every cell, cell * 8 onwards: the front top left point,
+    // the next column, the next row, both, then the same a layer further back
+    const int32_t* getCorners() const;
+
+    // the edges between points next to one another along x, y and z, each once
+    void getEdges(std::vector<uint32_t>& edges) const;
+    // the bytes the hash tables and the corners take
+    std::size_t getMemoryUsage() const;
+
+    private:
+    // open addressed hash table from keys to indices, kept at most half full
+    struct KeyTable
+    {
+        std::vector<uint64_t> keys;
+        std::vector<int32_t> values;
+        uint64_t mask;
+
+        // hash keys[i] to i for every key
+        void build(const std::vector<uint64_t>& entries);
+        void clear();
+        int find(uint64_t key) const;
+    };
+
+    // a point or cell's coordinates packed into one key
+    static uint64_t packKey(int col, int row, int cel);
+    // make the lattice of the given points, in their order, with every cell they make
+    void setPoints(const std::vector<uint64_t>& pointKeys);
+
+    int _gridSize;
+    float _modelSize;
+    std::vector<uint64_t> _pointKeys;
+    KeyTable _points;
+    KeyTable _cells;
+    std::vector<int32_t, AlignedAllocator<int32_t> > _corners;
+};
+
+#endif
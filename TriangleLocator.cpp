@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+
+#include "TriangleLocator.h"
+
+// bounding boxes are grown by this fraction of the triangulation's size, so that a
+// point the halfplane test accepts just outside a triangle still finds it
+static const float BOUNDS_PADDING = 1e-5f;
+
+TriangleLocator::TriangleLocator()
+{
+    clear();
+}
+
+void TriangleLocator::clear()
+{
+    _triangles.clear();
+    _bucketStart.assign(2, 0);
+    _bucketTriangles.clear();
+    _minX = 0.0;
+    _minY = 0.0;
+    _bucketsPerX = 0.0;
+    _bucketsPerY = 0.0;
+    _columns = 1;
+    _rows = 1;
+}
+
+void TriangleLocator::build(const std::vector<Vector>& vertices, const std::vector<int>& triangles)
+{
+    clear();
+    _triangles.resize(triangles.size());
+    for (std::size_t index = 0; index < triangles.size(); index++)
+        _triangles[index] = vertices[triangles[index]];
+    std::size_t nTriangles = _triangles.size() / 3;
+    if (nTriangles == 0)
+        return;
+
+    // bounds of the whole triangulation
+    float minX = _triangles[0].x, maxX = _triangles[0].x;
+    float minY = _triangles[0].y, maxY = _triangles[0].y;
+    for (std::size_t vertex = 1; vertex < nTriangles * 3; vertex++)
+    {
+        minX = std::min(minX, _triangles[vertex].x);
+        maxX = std::max(maxX, _triangles[vertex].x);
+        minY = std::min(minY, _triangles[vertex].y);
+        maxY = std::max(maxY, _triangles[vertex].y);
+    }
+    float padding = BOUNDS_PADDING * std::max(maxX - minX, maxY - minY);
+
+    // about one bucket per triangle
+    _columns = std::max(1, (int)std::ceil(std::sqrt((double)nTriangles)));
+    _rows = _columns;
+    _minX = minX - padding;
+    _minY = minY - padding;
+    _bucketsPerX = _columns / std::max(maxX - minX + 2 * padding, 1e-30f);
+    _bucketsPerY = _rows / std::max(maxY - minY + 2 * padding, 1e-30f);
+
+    // count the triangles overlapping each bucket, then lay the buckets out one after the other
+    std::vector<int> bounds(nTriangles * 4);
+    _bucketStart.assign(_columns * _rows + 1, 0);
+    for (std::size_t triangle = 0; triangle < nTriangles; triangle++)
+    {
+        const Vector* vertices = &_triangles[triangle * 3];
+        float left = std::min(std::min(vertices[0].x, vertices[1].x), vertices[2].x) - padding;
+        float right = std::max(std::max(vertices[0].x, vertices[1].x), vertices[2].x) + padding;
+        float bottom = std::min(std::min(vertices[0].y, vertices[1].y), vertices[2].y) - padding;
+        float top = std::max(std::max(vertices[0].y, vertices[1].y), vertices[2].y) + padding;
+        int first = bucket(left, bottom);
+        int last = bucket(right, top);
+        int* box = &bounds[triangle * 4];
+        box[0] = first % _columns;
+        box[1] = first / _columns;
+        box[2] = last % _columns;
+        box[3] = last / _columns;
+        for (int row = box[1]; row <= box[3]; row++)
+            for (int column = box[0]; column <= box[2]; column++)
+                _bucketStart[row * _columns + column + 1]++;
+    }
+    for (int bucket = 0; bucket < _columns * _rows; bucket++)
+        _bucketStart[bucket + 1] += _bucketStart[bucket];
+
+    // fill the buckets in triangle order
+    _bucketTriangles.resize(_bucketStart.back());
+    std::vector<uint32_t> next(_bucketStart.begin(), _bucketStart.end() - 1);
+    for (std::size_t triangle = 0; triangle < nTriangles; triangle++)
+    {
+        const int* box = &bounds[triangle * 4];
+        for (int row = box[1]; row <= box[3]; row++)
+            for (int column = box[0]; column <= box[2]; column++)
+                _bucketTriangles[next[row * _columns + column]++] = triangle;
+    }
+}
+
+int TriangleLocator::bucket(float x, float y) const
+{
+    float column = (x - _minX) * _bucketsPerX;
+    float row = (y - _minY) * _bucketsPerY;
+    // the comparisons are written so that NaNs land in the first bucket
+    int c = column >= 0.0f ? (column < _columns ? (int)column : _columns - 1) : 0;
+    int r = row >= 0.0f ? (row < _rows ? (int)row : _rows - 1) : 0;
+    return r * _columns + c;
+}
+
+bool TriangleLocator::locate(const Vector& point, int& triangle, float& s, float& t) const
+{
+    if (_triangles.empty())
+        return false;
+
+    // a triangle containing the point overlaps its bucket, and the bucket lists its
+    // triangles in order, so this is the same triangle a scan over all of them finds
+    int b = bucket(point.x, point.y);
+    for (uint32_t entry = _bucketStart[b]; entry < _bucketStart[b + 1]; entry++)
+    {
+        int first = _bucketTriangles[entry] * 3;
+        if (inTriangle(&_triangles[first], point, s, t))
+        {
+            triangle = first;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TriangleLocator::inTriangle(const Vector* triangle, const Vector& point, float& s, float& t)
+{
+    Vector p0 = triangle[0], p1 = triangle[1], p2 = triangle[2], p = point;
+    // calculate the areas of the triangles and two of its subtriangles
+    float triangleArea = Vector::dot(Vector(0.0, 0.0, 1.0), Vector::cross(p1 - p0, p2 - p0));
+    float zeta1 = Vector::dot(Vector(0.0, 0.0, 1.0), Vector::cross(p - p0, p2 - p0));
+    float zeta2 = Vector::dot(Vector(0.0, 0.0, 1.0), Vector::cross(p1 - p0, p - p0));
+
+    // get the values of s and t
+    s = zeta1 / triangleArea;
+    t = zeta2 / triangleArea;
+
+    // if s and t satisfiy these conditions, then the point is inside the triangle!
+    return ((0.0 <= s) && (s <= 1.0)) && ((0.0 <= t) && (t <= 1.0)) && (s + t <= 1.0);
+}
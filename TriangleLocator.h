@@ -0,0 +1,50 @@
+#ifndef _TRIANGLE_LOCATOR_H
+#define _TRIANGLE_LOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Vector.h"
+
+// Uniform grid of buckets over the bounding boxes of the triangles of a
+// triangulation, so that the triangle containing a point is found by testing
+// the few triangles overlapping the point's bucket instead of every triangle.
+// It keeps its own copy of the triangles so that it stays at rest while the
+// triangulation is dragged around.
+class TriangleLocator
+{
+    public:
+
+    TriangleLocator();
+
+    // build the buckets for triangles given as three indices into vertices each
+    void build(const std::vector<Vector>& vertices, const std::vector<int>& triangles);
+    void clear();
+
+    // find the first triangle containing point in the xy plane, given as the position
+    // of its first index in the triangulation, along with the point's s and t barycentric coordinates;
+    // returns false if no triangle contains it
+    bool locate(const Vector& point, int& triangle, float& s, float& t) const;
+
+    // the halfplane test of a point against one triangle
+    static bool inTriangle(const Vector* triangle, const Vector& point, float& s, float& t);
+
+    private:
+    // bucket holding a point, points outside the buckets go to the nearest one
+    int bucket(float x, float y) const;
+
+    // positions of the vertices of every triangle
+    std::vector<Vector> _triangles;
+
+    // bucket grid bounds and size
+    float _minX, _minY;
+    float _bucketsPerX, _bucketsPerY;
+    int _columns, _rows;
+
+    // the triangles of bucket b are _bucketTriangles[_bucketStart[b], _bucketStart[b + 1]),
+    // in increasing order
+    std::vector<uint32_t> _bucketStart;
+    std::vector<uint32_t> _bucketTriangles;
+};
+
+#endif
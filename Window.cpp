@@ -7,27 +7,38 @@
 
 #include "Window.h"
 
+// largest grid size the slider offers, a dense grid has size^3 points while a sparse
+// lattice only has those around the mesh, so it can be much finer
+static const int MAX_GRID_SIZE = 10;
+static const int MAX_SPARSE_GRID_SIZE = 512;
+
 Window::Window(QWidget *parent) 
     : QWidget(parent)
 {
     // OpenGL widget
     deformGroupBox = new QGroupBox(tr("Preview"));
     deform = new DeformWidget(this);
+    frameStatsLabel = new QLabel(this);
     deformLayout = new QGridLayout;
 
     deformLayout->setContentsMargins(0,0,0,20);
     deformLayout->addWidget(deform, 0, 0, Qt::AlignCenter);
+    deformLayout->addWidget(frameStatsLabel, 1, 0, Qt::AlignCenter);
     deformGroupBox->setLayout(deformLayout);
     
     // file options layout
     fileGroupBox = new QGroupBox(tr("File Options"));
     loadButton = new QPushButton("Load", this);
     saveButton = new QPushButton("Save", this);
+    loadGridButton = new QPushButton("Load grid", this);
+    saveGridButton = new QPushButton("Save grid", this);
     fileLayout = new QGridLayout;
 
     fileLayout->setAlignment(Qt::AlignTop);
     fileLayout->addWidget(loadButton, 0, 0, 1, 1);
     fileLayout->addWidget(saveButton, 0, 2, 1, 1);
+    fileLayout->addWidget(loadGridButton, 1, 0, 1, 1);
+    fileLayout->addWidget(saveGridButton, 1, 2, 1, 1);
     fileGroupBox->setLayout(fileLayout);
 
     // grid options layout
@@ -38,24 +49,32 @@ Window::Window(QWidget *parent)
     regular2DGrid = new QCheckBox("Regular grid (2D)", this);
     triangular2DGrid = new QCheckBox("Triangular grid", this);
     regular3DGrid = new QCheckBox("Regular grid (3D)", this);
+    bsplineGrid = new QCheckBox("B-spline lattice (3D)", this);
+    sparseGrid = new QCheckBox("Sparse lattice (3D)", this);
     changeGridButton = new QPushButton("Apply changes", this);
+    dragMesh = new QCheckBox("Drag the mesh surface", this);
     resetRotation = new QPushButton("Reset rotation", this);
     gridLayout = new QGridLayout;
 
-    gridSlider->setRange(2, 10);    
+    gridSlider->setRange(2, MAX_GRID_SIZE);
     gridSlider->setSingleStep(1);   
     regular2DGrid->setCheckState(Qt::Checked);
     gridCheckBoxes->setExclusive(true);
     gridCheckBoxes->addButton(regular2DGrid, 0);
     gridCheckBoxes->addButton(triangular2DGrid, 1);
     gridCheckBoxes->addButton(regular3DGrid, 2);
+    gridCheckBoxes->addButton(bsplineGrid, 3);
+    gridCheckBoxes->addButton(sparseGrid, 4);
 
     gridLayout->addWidget(gridSliderLabel, 0, 0);
     gridLayout->addWidget(gridSlider, 1, 0, 1, 3);
     gridLayout->addWidget(regular2DGrid, 2, 0);
     gridLayout->addWidget(triangular2DGrid, 3, 0);
     gridLayout->addWidget(regular3DGrid, 4, 0);
-    gridLayout->addWidget(changeGridButton, 5, 1, 1, 2);
+    gridLayout->addWidget(bsplineGrid, 5, 0);
+    gridLayout->addWidget(sparseGrid, 6, 0);
+    gridLayout->addWidget(changeGridButton, 7, 1, 1, 2);
+    gridLayout->addWidget(dragMesh, 8, 0);
     gridLayout->addWidget(resetRotation, 10, 0, 1, 2);
     gridGroupBox->setLayout(gridLayout);
 
@@ -63,6 +82,8 @@ Window::Window(QWidget *parent)
     attenuationGroupBox = new QGroupBox(tr("Attenuation Options"));
     attenuationSliderLabel = new QLabel(tr("Attenuation scale"), this);
     attenuationSlider = new QSlider(Qt::Horizontal, this);
+    attenuationRadiusLabel = new QLabel(tr("Attenuation radius (0 for the whole grid)"), this);
+    attenuationRadiusSlider = new QSlider(Qt::Horizontal, this);
     attenuation = new QCheckBox("Apply attenuation", this);
     attenuationLayout = new QGridLayout;
 
@@ -70,7 +91,12 @@ Window::Window(QWidget *parent)
     attenuationSlider->setSingleStep(1);
     attenuationLayout->addWidget(attenuationSliderLabel, 1, 0);
     attenuationLayout->addWidget(attenuationSlider, 2, 0, 1, 3);
-    attenuationLayout->addWidget(attenuation, 3, 0);
+    // in tenths of the model's size
+    attenuationRadiusSlider->setRange(0, 10);
+    attenuationRadiusSlider->setSingleStep(1);
+    attenuationLayout->addWidget(attenuationRadiusLabel, 3, 0);
+    attenuationLayout->addWidget(attenuationRadiusSlider, 4, 0, 1, 3);
+    attenuationLayout->addWidget(attenuation, 5, 0);
     attenuationGroupBox->setLayout(attenuationLayout);
 
     // Window layout
@@ -88,19 +114,27 @@ Window::Window(QWidget *parent)
     QObject::connect(saveButton, SIGNAL(clicked()), this, SLOT(saveFileDialog()));
     QObject::connect(this, SIGNAL(loadMeshFile(QString)), deform, SLOT(loadMesh(QString)));
     QObject::connect(this, SIGNAL(saveMeshFile(QString)), deform, SLOT(saveMesh(QString)));
+    QObject::connect(loadGridButton, SIGNAL(clicked()), this, SLOT(loadGridDialog()));
+    QObject::connect(saveGridButton, SIGNAL(clicked()), this, SLOT(saveGridDialog()));
+    QObject::connect(this, SIGNAL(loadGridFile(QString)), deform, SLOT(loadGrid(QString)));
+    QObject::connect(this, SIGNAL(saveGridFile(QString)), deform, SLOT(saveGrid(QString)));
     QObject::connect(gridSlider, SIGNAL(valueChanged(int)), deform, SLOT(changeGridSize(int)));
     QObject::connect(gridCheckBoxes, SIGNAL(buttonClicked(int)), deform, SLOT(changeGridType(int)));
+    QObject::connect(gridCheckBoxes, SIGNAL(buttonClicked(int)), this, SLOT(changeGridType(int)));
     QObject::connect(attenuationSlider, SIGNAL(valueChanged(int)), deform, SLOT(changeAttenuation(int)));
+    QObject::connect(attenuationRadiusSlider, SIGNAL(valueChanged(int)), deform, SLOT(changeAttenuationRadius(int)));
     QObject::connect(attenuation, SIGNAL(stateChanged(int)), deform, SLOT(setAttenuation(int)));
     QObject::connect(changeGridButton, SIGNAL(clicked()), deform, SLOT(buildGrid()));
+    QObject::connect(dragMesh, SIGNAL(stateChanged(int)), deform, SLOT(setMeshDragging(int)));
     QObject::connect(resetRotation, SIGNAL(clicked()), deform, SLOT(resetRotation()));
+    QObject::connect(deform, SIGNAL(frameStatsChanged(QString)), frameStatsLabel, SLOT(setText(QString)));
 }
 
 // opens up a file browser dialog and emits a signal to the GL widget if a mesh file is chosen
 void Window::loadFileDialog()
 {
     // open dialog
-    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Mesh"), "./", tr("Meshes (*.mesh)"));
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Mesh"), "./", tr("Meshes (*.mesh *.bmesh)"));
     
     // check name chosen is not empty
     if (!fileName.isEmpty())
@@ -112,7 +146,7 @@ void Window::loadFileDialog()
 void Window::saveFileDialog()
 {
     // open di  alog
-    QString fileName = QFileDialog::getSaveFileName(this, tr("Load Mesh"), "./", tr("Meshes (*.mesh)"));
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Load Mesh"), "./", tr("Meshes (*.mesh *.bmesh)"));
 
     // check name is not empty (user has inputted something, otherwise just close dialog)
     if (!fileName.isEmpty() )
@@ -127,8 +161,8 @@ void Window::saveFileDialog()
         }
         else
         {   
-            // user entered an extension that is not .mesh
-            if (fileInf.completeSuffix() != QString("mesh"))
+            // user entered an extension that is not .mesh or the binary .bmesh
+            if (fileInf.completeSuffix() != QString("mesh") && fileInf.completeSuffix() != QString("bmesh"))
             {
                 fileName.replace(fileInf.completeSuffix(), QString("mesh"));
             }
@@ -163,3 +197,36 @@ void Window::saveFileDialog()
         }        
     }
 }
+
+// opens up a file browser dialog and emits a signal to the GL widget if a grid file is chosen
+void Window::loadGridDialog()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Load Grid"), "./", tr("Grids (*.grid)"));
+
+    if (!fileName.isEmpty())
+    {
+        emit loadGridFile(fileName);
+    }
+}
+
+// save the grid so it can be applied to meshes with the ffd command line tool
+void Window::saveGridDialog()
+{
+    // the native dialog asks before overwriting an existing file
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save Grid"), "./", tr("Grids (*.grid)"));
+
+    if (!fileName.isEmpty())
+    {
+        if (QFileInfo(fileName).suffix().isEmpty())
+        {
+            fileName.append(".grid");
+        }
+        emit saveGridFile(fileName);
+    }
+}
+
+void Window::changeGridType(int type)
+{
+    // the value is clamped to the new range, which the grid size follows
+    gridSlider->setRange(2, static_cast<Grid>(type) == Grid::SparseTrilinear ? MAX_SPARSE_GRID_SIZE : MAX_GRID_SIZE);
+}
@@ -20,21 +20,30 @@ class Window : public  QWidget
     public slots:
     void loadFileDialog();
     void saveFileDialog();
+    void loadGridDialog();
+    void saveGridDialog();
+    // fit the grid size slider to the grid type
+    void changeGridType(int type);
     signals:
     void loadMeshFile(QString fileName);
     void saveMeshFile(QString fileName);
+    void loadGridFile(QString fileName);
+    void saveGridFile(QString fileName);
 
     private:
     // widgets for mesh preview
     QGroupBox *deformGroupBox;
     QGridLayout *deformLayout;
     DeformWidget *deform;
+    QLabel *frameStatsLabel;
 
     // widgets for file options
     QGroupBox *fileGroupBox;
     QGridLayout *fileLayout;
     QPushButton *loadButton;
     QPushButton *saveButton;
+    QPushButton *loadGridButton;
+    QPushButton *saveGridButton;
     
     // widgets for grid control
     QGroupBox *gridGroupBox;
@@ -44,7 +53,10 @@ class Window : public  QWidget
     QCheckBox *regular2DGrid;
     QCheckBox *triangular2DGrid;
     QCheckBox *regular3DGrid;
+    QCheckBox *bsplineGrid;
+    QCheckBox *sparseGrid;
     QButtonGroup *gridCheckBoxes;
+    QCheckBox *dragMesh;
     QPushButton *changeGridButton;
     
     // widgets for attenuation
@@ -52,6 +64,8 @@ class Window : public  QWidget
     QGridLayout *attenuationLayout;
     QLabel *attenuationSliderLabel;
     QSlider *attenuationSlider;
+    QLabel *attenuationRadiusLabel;
+    QSlider *attenuationRadiusSlider;
     QCheckBox *attenuation;
     
     QPushButton *resetRotation;
@@ -1,24 +1,24 @@
-######################################################################
-# Automatically generated by qmake (3.1) Thu Oct 15 18:33:35 2020
-######################################################################
+# The deformation code is built once as a library without Qt or OpenGL,
+# then linked by the GUI and by the command line tool.
+TEMPLATE = subdirs
 
-QT+=opengl
-LIBS+=-lGLU
-TEMPLATE = app
-TARGET = assignment1
-INCLUDEPATH += .
+SUBDIRS = ffdcore ffdgui ffdcli ffdbench ffdrender
 
-# The following define makes your compiler warn you if you use any
-# feature of Qt which has been marked as deprecated (the exact warnings
-# depend on your compiler). Please consult the documentation of the
-# deprecated API in order to know how to port your code away from it.
-DEFINES += QT_DEPRECATED_WARNINGS
+ffdcore.file = ffdcore.pro
+ffdcore.makefile = Makefile.ffdcore
 
-# You can also make your code fail to compile if you use deprecated APIs.
-# In order to do so, uncomment the following line.
-# You can also select to disable deprecated APIs only up to a certain version of Qt.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+ffdgui.file = ffdgui.pro
+ffdgui.makefile = Makefile.ffdgui
+ffdgui.depends = ffdcore
 
-# Input
-HEADERS += DeformWidget.h Window.h Vector.h GridBuilder.h Mesh.h Ball.h BallAux.h BallMath.h
-SOURCES += DeformWidget.cpp main.cpp Window.cpp Vector.cpp GridBuilder.cpp Mesh.cpp Ball.cpp BallAux.cpp BallMath.cpp
+ffdcli.file = ffdcli.pro
+ffdcli.makefile = Makefile.ffdcli
+ffdcli.depends = ffdcore
+
+ffdbench.file = ffdbench.pro
+ffdbench.makefile = Makefile.ffdbench
+ffdbench.depends = ffdcore
+
+ffdrender.file = ffdrender.pro
+ffdrender.makefile = Makefile.ffdrender
+ffdrender.depends = ffdcore
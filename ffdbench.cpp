@@ -0,0 +1,1929 @@
+// Benchmarks for the deformation core, timings are printed to stdout
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AnimationExporter.h"
+#include "DeformKernels.h"
+#include "DeformWorker.h"
+#include "DirectManipulator.h"
+#include "GridBuilder.h"
+#include "LatticeAnimation.h"
+#include "LatticeHierarchy.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "PointPicker.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " load <input.mesh> [repeats]" << std::endl;
+    std::cerr << "       " << program << " deform <input.mesh> <grid type 0-3> <grid size> [repeats]" << std::endl;
+    std::cerr << "       " << program << " bind <input.mesh> <grid size> [scanned vertices]" << std::endl;
+    std::cerr << "       " << program << " scale <input.mesh> <grid size> [max threads] [repeats]" << std::endl;
+    std::cerr << "       " << program << " drag <input.mesh> <grid size> [moves]" << std::endl;
+    std::cerr << "       " << program << " worker <input.mesh> <grid size> [moves]" << std::endl;
+    std::cerr << "       " << program << " pick <grid points> [clicks]" << std::endl;
+    std::cerr << "       " << program << " attenuate <grid points> [moves] [radius]" << std::endl;
+    std::cerr << "       " << program << " select <grid points> [moves] [radius]" << std::endl;
+    std::cerr << "       " << program << " manipulate <input.mesh> <grid size> [drags] [dragged vertices]" << std::endl;
+    std::cerr << "       " << program << " spline <input.mesh> [max grid size] [repeats]" << std::endl;
+    std::cerr << "       " << program << " sparse <input.mesh> <grid size> [repeats]" << std::endl;
+    std::cerr << "       " << program << " poses <input.mesh> <grid type 0-4> <grid size> [max poses]" << std::endl;
+    std::cerr << "       " << program << " levels <input.mesh> <coarse grid size> <levels> [edits]" << std::endl;
+    std::cerr << "       " << program << " animate <input.mesh> <grid type 0-4> <grid size> <output directory> [frames] [.bmesh|.mesh]" << std::endl;
+    std::cerr << "       " << program << " lattice <input.mesh> [max grid size] [max dense size] [repeats]" << std::endl;
+}
+
+// compare the serial stream loader with the parallel one on a text mesh
+static int benchLoad(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int repeats = argc > 3 ? std::atoi(argv[3]) : 1;
+
+    Mesh serialMesh, parallelMesh;
+    double serialTime = 1e30, parallelTime = 1e30;
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        Clock::time_point start = Clock::now();
+        if (!serialMesh.streamTextMesh(fileName))
+        {
+            std::cerr << "Could not load mesh " << fileName << std::endl;
+            return 1;
+        }
+        serialTime = std::min(serialTime, secondsSince(start));
+
+        start = Clock::now();
+        if (!parallelMesh.loadTextMesh(fileName))
+        {
+            std::cerr << "Could not load mesh " << fileName << std::endl;
+            return 1;
+        }
+        parallelTime = std::min(parallelTime, secondsSince(start));
+    }
+
+    // both loaders must give exactly the same mesh
+    bool identical = serialMesh.getVertexCount() == parallelMesh.getVertexCount()
+        && serialMesh.getModelSize() == parallelMesh.getModelSize()
+        && serialMesh.getIndexCount() == parallelMesh.getIndexCount()
+        && std::memcmp(serialMesh.getVertices(), parallelMesh.getVertices(), serialMesh.getVertexCount() * sizeof(Vector)) == 0
+        && std::memcmp(serialMesh.getIndices(), parallelMesh.getIndices(), serialMesh.getIndexCount() * sizeof(uint32_t)) == 0;
+
+    std::cout << "triangles: " << serialMesh.getIndexCount() / 3 << ", unique vertices: " << serialMesh.getVertexCount()
+        << ", threads: " << threadCount() << std::endl;
+    std::cout << "stream:   " << serialTime << " s" << std::endl;
+    std::cout << "parallel: " << parallelTime << " s (" << serialTime / parallelTime << "x)" << std::endl;
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// the deformation as it was done before the weight streams, one Vector at a time,
+// with the weights and faces of every vertex stored as Vectors
+static void referenceDeform(Grid gridType, const std::vector<Vector>& weights, const std::vector<Vector>& faces,
+    GridBuilder& gridBuilder, std::vector<Vector>& deformed)
+{
+    std::vector<Vector>& gridVertices = gridBuilder._grid;
+    std::vector<int>& triangles = gridBuilder._triangles;
+    int gridSize = gridBuilder.getGridSize();
+    for (std::size_t vertex = 0; vertex < weights.size(); vertex++)
+    {
+        int col = faces[vertex].x, row = faces[vertex].y, cel = faces[vertex].z;
+        float u = weights[vertex].x, v = weights[vertex].y, w = weights[vertex].z;
+        if (gridType == Grid::Bilinear)
+        {
+            Vector p00 = gridVertices[(row + 1) * gridSize + col    ];
+            Vector p10 = gridVertices[(row + 1) * gridSize + col + 1];
+            Vector p01 = gridVertices[row * gridSize + col    ];
+            Vector p11 = gridVertices[row * gridSize + col + 1];
+            deformed[vertex] = p10 * u * v + p00 * v * (1-u) + p11 * u * (1-v) + p01 * (1-u) * (1-v);
+        }
+        else if (gridType == Grid::Barycentric)
+        {
+            deformed[vertex] = gridVertices[triangles[faces[vertex].x]] * u +
+                                gridVertices[triangles[faces[vertex].y]] * v +
+                                gridVertices[triangles[faces[vertex].z]] * w;
+        }
+        else
+        {
+            Vector p000 = gridVertices[cel*gridSize*gridSize + row*gridSize + col];
+            Vector p001 = gridVertices[cel*gridSize*gridSize + row*gridSize + col+1];
+            Vector p010 = gridVertices[cel*gridSize*gridSize + (row+1)*gridSize + col];
+            Vector p011 = gridVertices[cel*gridSize*gridSize + (row+1)*gridSize + col+1];
+            Vector p100 = gridVertices[(cel+1)*gridSize*gridSize + row*gridSize + col];
+            Vector p101 = gridVertices[(cel+1)*gridSize*gridSize + row*gridSize + col+1];
+            Vector p110 = gridVertices[(cel+1)*gridSize*gridSize + (row+1)*gridSize + col];
+            Vector p111 = gridVertices[(cel+1)*gridSize*gridSize + (row+1)*gridSize + col+1];
+            Vector p0 = p011 * u * v + p010 * v * (1 - u) + p001 * u * (1 - v) + p000 * (1 - u) * (1 - v);
+            Vector p1 = p111 * u * v + p110 * v * (1 - u) + p101 * u * (1 - v) + p100 * (1 - u) * (1 - v);
+            deformed[vertex] = p0 * (1-w) + p1 * w;
+        }
+    }
+}
+
+// the B-spline deformation one Vector at a time, from the basis of the binding,
+// summing along x, then y, then z as the kernels do
+static void referenceBSpline(const WeightStreams& streams, GridBuilder& gridBuilder, std::vector<Vector>& deformed)
+{
+    std::vector<Vector>& gridVertices = gridBuilder._grid;
+    int gridSize = gridBuilder.getGridSize();
+    std::size_t count = streams.size();
+    for (std::size_t vertex = 0; vertex < count; vertex++)
+    {
+        float bx[4], by[4], bz[4];
+        for (int k = 0; k < 4; k++)
+        {
+            bx[k] = streams.basis[k * count + vertex];
+            by[k] = streams.basis[(4 + k) * count + vertex];
+            bz[k] = streams.basis[(8 + k) * count + vertex];
+        }
+        Vector volume;
+        for (int cel = 0; cel < 4; cel++)
+        {
+            Vector plane;
+            for (int row = 0; row < 4; row++)
+            {
+                const Vector* p = &gridVertices[streams.cell[vertex] + (cel * gridSize + row) * gridSize];
+                Vector p0 = p[0], p1 = p[1], p2 = p[2], p3 = p[3];
+                Vector line = p0 * bx[0] + p1 * bx[1] + p2 * bx[2] + p3 * bx[3];
+                plane = row == 0 ? line * by[0] : plane + line * by[row];
+            }
+            volume = cel == 0 ? plane * bz[0] : volume + plane * bz[cel];
+        }
+        deformed[vertex] = volume;
+    }
+}
+
+// compare the deformation kernels for every instruction set the cpu supports with
+// the Vector code they replaced, on one thread so the rates are per core
+static int benchDeform(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int type = std::atoi(argv[3]);
+    // the sparse lattice has no Vector code to compare with, the lattice bench checks its kernels
+    if (type < 0 || type > static_cast<int>(Grid::BSpline))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    Grid gridType = static_cast<Grid>(type);
+    int gridSize = std::atoi(argv[4]);
+    int repeats = argc > 5 ? std::atoi(argv[5]) : 5;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    GridBuilder gridBuilder;
+    gridBuilder.setGridType(gridType);
+    gridBuilder.setGridSize(gridSize);
+    gridBuilder.generateGrid(mesh.getModelSize());
+    mesh.getVertexWeights(&gridBuilder);
+    // move every other grid point so that the deformation is not the identity
+    for (unsigned int point = 0; point < gridBuilder._grid.size(); point += 2)
+        gridBuilder.moveVertex(Vector(0.01 * mesh.getModelSize(), 0.02 * mesh.getModelSize(), 0.0), point, false, 1);
+
+    // the binding as the Vector code stored it
+    const WeightStreams& streams = mesh.getWeights();
+    std::size_t nVertices = streams.size();
+    std::vector<Vector> weights(nVertices), faces(nVertices);
+    for (std::size_t vertex = 0; vertex < nVertices; vertex++)
+    {
+        int cell = streams.cell[vertex];
+        weights[vertex] = Vector(streams.u[vertex], streams.v[vertex], streams.w[vertex]);
+        if (gridType == Grid::Barycentric)
+            faces[vertex] = Vector(cell, cell + 1, cell + 2);
+        else
+            faces[vertex] = Vector(cell % gridSize, cell / gridSize % gridSize, cell / (gridSize * gridSize));
+    }
+
+    std::vector<Vector> reference(nVertices);
+    double referenceTime = 1e30;
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        Clock::time_point start = Clock::now();
+        if (gridType == Grid::BSpline)
+            referenceBSpline(streams, gridBuilder, reference);
+        else
+            referenceDeform(gridType, weights, faces, gridBuilder, reference);
+        referenceTime = std::min(referenceTime, secondsSince(start));
+    }
+    std::cout << "vertices: " << nVertices << ", grid size: " << gridSize << std::endl;
+    std::cout << "vector:  " << nVertices / referenceTime / 1e6 << " Mvertices/s" << std::endl;
+
+    KernelLevel defaultLevel = getKernelLevel();
+    bool identical = true;
+    std::vector<Vector> deformed(nVertices);
+    for (int level = 0; level <= static_cast<int>(supportedKernelLevel()); level++)
+    {
+        setKernelLevel(static_cast<KernelLevel>(level));
+        double kernelTime = 1e30;
+        for (int repeat = 0; repeat < repeats; repeat++)
+        {
+            Clock::time_point start = Clock::now();
+            if (gridType == Grid::Bilinear)
+                deformBilinearStreams(streams, gridBuilder._grid.data(), gridSize, deformed.data(), 0, nVertices);
+            else if (gridType == Grid::Barycentric)
+                deformBarycentricStreams(streams, gridBuilder._grid.data(), gridBuilder._triangles.data(), deformed.data(), 0, nVertices);
+            else if (gridType == Grid::Trilinear)
+                deformTrilinearStreams(streams, gridBuilder._grid.data(), gridSize, deformed.data(), 0, nVertices);
+            else
+                deformBSplineStreams(streams, gridBuilder._grid.data(), gridSize, deformed.data(), 0, nVertices);
+            kernelTime = std::min(kernelTime, secondsSince(start));
+        }
+        bool same = std::memcmp(deformed.data(), reference.data(), nVertices * sizeof(Vector)) == 0;
+        identical = identical && same;
+        std::cout << kernelLevelName(static_cast<KernelLevel>(level)) << ": " << nVertices / kernelTime / 1e6
+            << " Mvertices/s (" << referenceTime / kernelTime << "x)" << (same ? "" : " differs") << std::endl;
+    }
+    setKernelLevel(defaultLevel);
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// compare barycentric binding through the triangle locator with scanning every
+// triangle for every vertex, the scan is timed on the first vertices only since
+// it takes minutes on large meshes
+static int benchBind(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int gridSize = std::atoi(argv[3]);
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    std::size_t nVertices = mesh.getVertexCount();
+    std::size_t nScanned = argc > 4 ? std::min<std::size_t>(std::atol(argv[4]), nVertices) : nVertices;
+
+    GridBuilder gridBuilder;
+    gridBuilder.setGridType(Grid::Barycentric);
+    gridBuilder.setGridSize(gridSize);
+    gridBuilder.generateGrid(mesh.getModelSize());
+    // the triangles as three positions each, as the scan used to read them
+    std::vector<Vector> triangulationMesh(gridBuilder._triangles.size());
+    for (std::size_t index = 0; index < triangulationMesh.size(); index++)
+        triangulationMesh[index] = gridBuilder._grid[gridBuilder._triangles[index]];
+
+    Clock::time_point start = Clock::now();
+    gridBuilder._triangleLocator.build(gridBuilder._grid, gridBuilder._triangles);
+    double buildTime = secondsSince(start);
+
+    start = Clock::now();
+    mesh.getVertexWeights(&gridBuilder);
+    double locatorTime = secondsSince(start);
+
+    // the scan the locator replaced, the first triangle containing the vertex wins
+    std::vector<int> scanned(nScanned, -1);
+    start = Clock::now();
+    for (std::size_t vertex = 0; vertex < nScanned; vertex++)
+    {
+        float s, t;
+        for (std::size_t triangle = 0; triangle < triangulationMesh.size(); triangle += 3)
+        {
+            if (TriangleLocator::inTriangle(&triangulationMesh[triangle], mesh.getVertex(vertex), s, t))
+            {
+                scanned[vertex] = triangle;
+                break;
+            }
+        }
+    }
+    double scanTime = secondsSince(start) * nVertices / std::max<std::size_t>(nScanned, 1);
+
+    // unbound vertices have a weight of one on the second triangulation vertex
+    const WeightStreams& weights = mesh.getWeights();
+    bool identical = true;
+    for (std::size_t vertex = 0; vertex < nScanned; vertex++)
+        if (scanned[vertex] >= 0 ? weights.cell[vertex] != scanned[vertex] : weights.v[vertex] != 1.0f)
+            identical = false;
+
+    std::cout << "vertices: " << nVertices << ", control points: " << gridBuilder._grid.size()
+        << ", triangles: " << triangulationMesh.size() / 3 << std::endl;
+    std::cout << "scan:    " << scanTime << " s" << (nScanned < nVertices ? " (estimated from "
+        + std::to_string(nScanned) + " vertices)" : "") << std::endl;
+    std::cout << "locator: " << locatorTime << " s, built in " << buildTime << " s ("
+        << scanTime / (locatorTime + buildTime) << "x)" << std::endl;
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// time binding to every grid type on 1, 2, 4... threads, on a sixteenth, a quarter
+// and the whole of the mesh, checking every thread count binds exactly as one thread does
+static int benchScale(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int gridSize = std::atoi(argv[3]);
+    unsigned int maxThreads = argc > 4 ? std::atoi(argv[4]) : threadCount();
+    int repeats = argc > 5 ? std::atoi(argv[5]) : 3;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    std::vector<Vector> vertices(mesh.getVertices(), mesh.getVertices() + mesh.getVertexCount());
+
+    bool identical = true;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear", "bspline" };
+    std::cout << "grid         vertices  threads   time (s)  speedup" << std::endl;
+    for (int type = 0; type < 4; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        gridBuilder.setGridSize(gridSize);
+        gridBuilder.generateGrid(mesh.getModelSize());
+
+        for (std::size_t fraction = 16; fraction >= 1; fraction /= 4)
+        {
+            Mesh part;
+            std::vector<Vector> partVertices(vertices.begin(), vertices.begin() + vertices.size() / fraction);
+            part.swapVertices(partVertices, mesh.getModelSize());
+
+            WeightStreams serial;
+            double serialTime = 0.0;
+            for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+            {
+                setThreadCount(threads);
+                double bindTime = 1e30;
+                for (int repeat = 0; repeat < repeats; repeat++)
+                {
+                    Clock::time_point start = Clock::now();
+                    part.getVertexWeights(&gridBuilder);
+                    bindTime = std::min(bindTime, secondsSince(start));
+                }
+
+                const WeightStreams& weights = part.getWeights();
+                if (threads == 1)
+                {
+                    serial = weights;
+                    serialTime = bindTime;
+                }
+                bool same = weights.u == serial.u && weights.v == serial.v && weights.w == serial.w && weights.cell == serial.cell
+                    && weights.basis == serial.basis;
+                identical = identical && same;
+                std::printf("%-11s %9zu %8u %10.4f %8.2f%s\n", gridNames[type], weights.size(), threads,
+                    bindTime, serialTime / bindTime, same ? "" : " differs");
+            }
+        }
+    }
+    setThreadCount(0);
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// compare deforming the whole mesh with deforming just the vertices bound to a
+// moved grid point, as when dragging a point, normals included for volumetric grids
+static int benchDrag(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int gridSize = std::atoi(argv[3]);
+    int moves = argc > 4 ? std::atoi(argv[4]) : 100;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+
+    bool identical = true;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear", "bspline" };
+    std::cout << "grid          points  full (s) index (s)  drag (s)  speedup" << std::endl;
+    for (int type = 0; type < 4; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        gridBuilder.setGridSize(gridSize);
+        gridBuilder.generateGrid(mesh.getModelSize());
+        mesh.getVertexWeights(&gridBuilder);
+        bool normals = gridBuilder.isVolumetric();
+
+        // the first call deforms the whole mesh and fills the cache
+        Clock::time_point start = Clock::now();
+        mesh.getDeformedVertices(&gridBuilder);
+        if (normals)
+            mesh.getDeformedNormals(&gridBuilder);
+        double fullTime = secondsSince(start);
+
+        // move points spread over the grid, each a little, the first move
+        // also builds the index from points to vertices so it is timed apart
+        double indexTime = 0.0;
+        double dragTime = 0.0;
+        std::vector<Vector> reference;
+        for (int move = -1; move < moves; move++)
+        {
+            int point = (int)(((long long)(move + 1) * 7919) % gridBuilder._grid.size());
+            gridBuilder.moveVertex(Vector(0.01, -0.02, 0.015) * mesh.getModelSize(), point, false, 0);
+
+            start = Clock::now();
+            const std::vector<Vector>& deformed = mesh.getDeformedVertices(&gridBuilder);
+            if (normals)
+                mesh.getDeformedNormals(&gridBuilder);
+            if (move < 0)
+                indexTime = secondsSince(start);
+            else
+                dragTime += secondsSince(start);
+
+            mesh.deformMesh(&gridBuilder, reference);
+            identical = identical && std::memcmp(reference.data(), deformed.data(), reference.size() * sizeof(Vector)) == 0;
+        }
+        if (normals)
+        {
+            const std::vector<Vector>& deformedNormals = mesh.getDeformedNormals(&gridBuilder);
+            const uint32_t* indices = mesh.getIndices();
+            for (int triangle = 0; triangle < mesh.getIndexCount() / 3; triangle++)
+            {
+                Vector v0 = reference[indices[triangle * 3]];
+                Vector v1 = reference[indices[triangle * 3 + 1]];
+                Vector v2 = reference[indices[triangle * 3 + 2]];
+                Vector normal = Vector::cross(v1 - v0, v2 - v0).normalise();
+                identical = identical && std::memcmp(&normal, &deformedNormals[triangle], sizeof(Vector)) == 0;
+            }
+        }
+        dragTime /= moves;
+        std::printf("%-11s %8zu %9.5f %9.5f %9.5f %8.1f\n", gridNames[type], gridBuilder._grid.size(),
+            fullTime, indexTime, dragTime, fullTime / dragTime);
+    }
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// whether a frame holds the mesh deformed by gridBuilder, with the normals of trilinear grids
+static bool frameMatches(Mesh& mesh, GridBuilder& gridBuilder, const DeformedFrame& frame)
+{
+    std::vector<Vector> reference;
+    mesh.deformMesh(&gridBuilder, reference);
+    if (frame.vertices->size() != reference.size() ||
+        std::memcmp(reference.data(), frame.vertices->data(), reference.size() * sizeof(Vector)) != 0)
+        return false;
+    if (gridBuilder.getGridType() != Grid::Trilinear)
+        return frame.normals == nullptr;
+
+    const uint32_t* indices = mesh.getIndices();
+    for (int triangle = 0; triangle < mesh.getIndexCount() / 3; triangle++)
+    {
+        Vector v0 = reference[indices[triangle * 3]];
+        Vector v1 = reference[indices[triangle * 3 + 1]];
+        Vector v2 = reference[indices[triangle * 3 + 2]];
+        Vector normal = Vector::cross(v1 - v0, v2 - v0).normalise();
+        if (std::memcmp(&normal, &(*frame.normals)[triangle], sizeof(Vector)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// time what moving a grid point costs the thread publishing it to a DeformWorker, and how
+// long the frame takes to come back, then publish moves as fast as they come, as when
+// dragging quickly, and count the frames the worker drew them in
+static int benchWorker(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int gridSize = std::atoi(argv[3]);
+    int moves = argc > 4 ? std::atoi(argv[4]) : 100;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+
+    // frames are counted as the worker completes them
+    std::mutex mutex;
+    std::condition_variable frameDone;
+    int frames = 0;
+    DeformWorker worker;
+    worker.setFrameCallback([&]()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames++;
+        frameDone.notify_one();
+    });
+    auto waitForFrame = [&](int frame)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        frameDone.wait(lock, [&] { return frames >= frame; });
+    };
+
+    bool identical = true;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear" };
+    std::cout << "grid          points publish (ms) frame (ms)  burst (ms) frames" << std::endl;
+    for (int type = 0; type < 3; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        gridBuilder.setGridSize(gridSize);
+        gridBuilder.generateGrid(mesh.getModelSize());
+        mesh.getVertexWeights(&gridBuilder);
+        frames = 0;
+        worker.start(&mesh, gridBuilder);
+        waitForFrame(1);
+
+        // one move at a time, waiting for each frame, the first also builds the index
+        double publishTime = 0.0;
+        double frameTime = 0.0;
+        DeformedFrame frame;
+        for (int move = -1; move < moves; move++)
+        {
+            int point = (int)(((long long)(move + 1) * 7919) % gridBuilder._grid.size());
+            int expected = frames + 1;
+            Clock::time_point start = Clock::now();
+            gridBuilder.moveVertex(Vector(0.01, -0.02, 0.015) * mesh.getModelSize(), point, false, 0);
+            worker.publishGrid(gridBuilder);
+            double published = secondsSince(start);
+            waitForFrame(expected);
+            if (move >= 0)
+            {
+                publishTime += published;
+                frameTime += secondsSince(start);
+            }
+            identical = identical && worker.acquireFrame(frame) && frameMatches(mesh, gridBuilder, frame);
+            worker.releaseFrame();
+        }
+
+        // every move straight after the other, the worker deforms the latest when it gets to it
+        int burstStart = frames;
+        Clock::time_point start = Clock::now();
+        for (int move = 0; move < moves; move++)
+        {
+            int point = (int)(((long long)(move + 1) * 104729) % gridBuilder._grid.size());
+            gridBuilder.moveVertex(Vector(-0.01, 0.01, 0.02) * mesh.getModelSize(), point, false, 0);
+            worker.publishGrid(gridBuilder);
+        }
+        double burstTime = secondsSince(start);
+        worker.stop();
+        int burstFrames = frames - burstStart;
+        identical = identical && worker.acquireFrame(frame) && frameMatches(mesh, gridBuilder, frame);
+        worker.releaseFrame();
+
+        std::printf("%-11s %8zu %12.4f %10.3f %11.4f %6d\n", gridNames[type], gridBuilder._grid.size(),
+            publishTime / moves * 1e3, frameTime / moves * 1e3, burstTime / moves * 1e3, burstFrames);
+    }
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// a rotation as the arcball keeps it, from a random unit quaternion
+static void randomRotation(std::mt19937& random, float rotation[4][4])
+{
+    std::normal_distribution<float> normal;
+    float x = normal(random), y = normal(random), z = normal(random), w = normal(random);
+    float length = std::sqrt(x*x + y*y + z*z + w*w);
+    x /= length; y /= length; z /= length; w /= length;
+    float matrix[4][4] = {
+        { 1 - 2*(y*y + z*z), 2*(x*y - w*z), 2*(x*z + w*y), 0 },
+        { 2*(x*y + w*z), 1 - 2*(x*x + z*z), 2*(y*z - w*x), 0 },
+        { 2*(x*z - w*y), 2*(y*z + w*x), 1 - 2*(x*x + y*y), 0 },
+        { 0, 0, 0, 1 } };
+    std::memcpy(rotation, matrix, sizeof(matrix));
+}
+
+// compare picking grid points through the screen buckets and along the ray
+// through the hierarchy with testing every point
+static int benchPick(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    int nPoints = std::atoi(argv[2]);
+    int clicks = argc > 3 ? std::atoi(argv[3]) : 200;
+
+    // the click radius the editor uses for a model of size 1
+    const float modelSize = 1.0;
+    const float radius = modelSize / 8.0;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> offset(-radius, radius);
+
+    bool identical = true;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear" };
+    std::cout << "grid          points linear (ms) build (ms) screen (ms)   ray (ms) drag (ms) turn (ms)" << std::endl;
+    for (int type = 0; type < 3; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        int gridSize = type == 2 ? (int)std::lround(std::cbrt((double)nPoints)) : (int)std::lround(std::sqrt((double)nPoints));
+        gridBuilder.setGridSize(std::max(gridSize, 2));
+        gridBuilder.generateGrid(modelSize);
+        std::size_t size = gridBuilder._grid.size();
+        float rotation[4][4];
+        randomRotation(random, rotation);
+
+        // clicks near a grid point, sometimes not near enough for any
+        auto click = [&](float& x, float& y)
+        {
+            Vector turned = gridBuilder._grid[random() % size];
+            x = rotation[0][0]*turned.x + rotation[1][0]*turned.y + rotation[2][0]*turned.z + 2.0f * offset(random);
+            y = rotation[0][1]*turned.x + rotation[1][1]*turned.y + rotation[2][1]*turned.z + 2.0f * offset(random);
+        };
+
+        PointPicker picker;
+        Clock::time_point start = Clock::now();
+        picker.update(gridBuilder, rotation);
+        double buildTime = secondsSince(start);
+
+        // clicks under the same view
+        double linearTime = 0.0, screenTime = 0.0, rayTime = 0.0;
+        for (int pick = 0; pick < clicks; pick++)
+        {
+            float x, y;
+            click(x, y);
+            start = Clock::now();
+            int linear = PointPicker::pickLinear(gridBuilder, rotation, x, y, radius);
+            linearTime += secondsSince(start);
+            start = Clock::now();
+            int screen = picker.pickScreen(gridBuilder, rotation, x, y, radius);
+            screenTime += secondsSince(start);
+            start = Clock::now();
+            int ray = picker.pickRay(gridBuilder, rotation, x, y, radius);
+            rayTime += secondsSince(start);
+            identical = identical && screen == linear && ray == linear;
+        }
+
+        // a point dragged before each click, both picks bring themselves up to date
+        double dragTime = 0.0;
+        for (int pick = 0; pick < clicks; pick++)
+        {
+            gridBuilder.moveVertex(Vector(offset(random), offset(random), offset(random)), random() % size, false, 0);
+            float x, y;
+            click(x, y);
+            start = Clock::now();
+            int screen = picker.pickScreen(gridBuilder, rotation, x, y, radius);
+            int ray = picker.pickRay(gridBuilder, rotation, x, y, radius);
+            dragTime += secondsSince(start);
+            identical = identical && screen == ray && ray == PointPicker::pickLinear(gridBuilder, rotation, x, y, radius);
+        }
+
+        // the view turned before each click, which only the ray pick is not affected by
+        double turnTime = 0.0;
+        for (int pick = 0; pick < clicks; pick++)
+        {
+            randomRotation(random, rotation);
+            float x, y;
+            click(x, y);
+            start = Clock::now();
+            int ray = picker.pickRay(gridBuilder, rotation, x, y, radius);
+            turnTime += secondsSince(start);
+            identical = identical && ray == picker.pickScreen(gridBuilder, rotation, x, y, radius)
+                && ray == PointPicker::pickLinear(gridBuilder, rotation, x, y, radius);
+        }
+
+        std::printf("%-11s %8zu %11.4f %10.3f %11.4f %10.4f %9.4f %9.4f\n", gridNames[type], size,
+            linearTime / clicks * 1e3, buildTime * 1e3, screenTime / clicks * 1e3, rayTime / clicks * 1e3,
+            dragTime / clicks * 1e3, turnTime / clicks * 1e3);
+    }
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// attenuation across the whole grid as GridBuilder::moveVertex first did it,
+// scanning for the bounds and calling pow for every vertex
+static void referenceAttenuate(std::vector<Vector>& grid, Vector move, int index, int attenuationScale)
+{
+    Vector min = Vector(0.0, 0.0, 0.0);
+    Vector max = Vector(0.0, 0.0, 0.0);
+    for (unsigned int vertex = 0; vertex < grid.size(); vertex++)
+    {
+        min.x = std::min(min.x, grid[vertex].x);
+        min.y = std::min(min.y, grid[vertex].y);
+        max.x = std::max(max.x, grid[vertex].x);
+        max.y = std::max(max.y, grid[vertex].y);
+    }
+    float maxDistance = (min - max).magnitude();
+    for (int vertex = 0; vertex < (int)grid.size(); vertex++)
+    {
+        float weight = vertex == index ? 1.0f : pow(1.0 - ((grid[index] - grid[vertex]).magnitude() / maxDistance), 2.0) * ((float)attenuationScale / 5.0);
+        grid[vertex] = grid[vertex] + move * weight;
+    }
+}
+
+// attenuation within a radius, testing every vertex
+static int referenceRadius(std::vector<Vector>& grid, Vector move, int index, int attenuationScale, float radius)
+{
+    std::vector<float> weights(grid.size(), 0.0f);
+    int moved = 0;
+    for (unsigned int vertex = 0; vertex < grid.size(); vertex++)
+    {
+        float distance = (grid[index] - grid[vertex]).magnitude();
+        if (distance < radius)
+        {
+            weights[vertex] = (int)vertex == index ? 1.0f : GridBuilder::getFalloff(distance / radius) * ((float)attenuationScale / 5.0);
+            moved++;
+        }
+    }
+    for (unsigned int vertex = 0; vertex < grid.size(); vertex++)
+        if (weights[vertex] != 0.0f || (int)vertex == index)
+            grid[vertex] = grid[vertex] + move * weights[vertex];
+    return moved;
+}
+
+// compare dragging a grid point with attenuation across the whole grid and within a radius
+// through the point hash with testing every vertex
+static int benchAttenuate(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    int nPoints = std::atoi(argv[2]);
+    int moves = argc > 3 ? std::atoi(argv[3]) : 100;
+    float radius = argc > 4 ? std::atof(argv[4]) : 0.1;
+
+    const float modelSize = 1.0;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> offset(-0.01, 0.01);
+
+    bool identical = true;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear" };
+    std::cout << "grid          points whole (ms)  scan (ms) radius (ms)  scan (ms)  moved" << std::endl;
+    for (int type = 0; type < 3; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        int gridSize = type == 2 ? (int)std::lround(std::cbrt((double)nPoints)) : (int)std::lround(std::sqrt((double)nPoints));
+        gridBuilder.setGridSize(std::max(gridSize, 2));
+        gridBuilder.generateGrid(modelSize);
+        std::size_t size = gridBuilder._grid.size();
+
+        // across the whole grid, the bounds are only scanned again when a vertex on them moved
+        std::vector<Vector> reference = gridBuilder._grid;
+        double wholeTime = 0.0, wholeScanTime = 0.0;
+        for (int move = 0; move < moves; move++)
+        {
+            Vector shift(offset(random), offset(random), offset(random));
+            int point = random() % size;
+            Clock::time_point start = Clock::now();
+            gridBuilder.moveVertex(shift, point, true, 3);
+            wholeTime += secondsSince(start);
+            start = Clock::now();
+            referenceAttenuate(reference, shift, point, 3);
+            wholeScanTime += secondsSince(start);
+        }
+        identical = identical && std::memcmp(reference.data(), gridBuilder._grid.data(), size * sizeof(Vector)) == 0;
+
+        // within the radius, only the vertices near the dragged one are looked at
+        double radiusTime = 0.0, radiusScanTime = 0.0;
+        long long moved = 0;
+        for (int move = 0; move < moves; move++)
+        {
+            Vector shift(offset(random), offset(random), offset(random));
+            int point = random() % size;
+            Clock::time_point start = Clock::now();
+            gridBuilder.moveVertex(shift, point, true, 3, radius * modelSize);
+            radiusTime += secondsSince(start);
+            start = Clock::now();
+            moved += referenceRadius(reference, shift, point, 3, radius * modelSize);
+            radiusScanTime += secondsSince(start);
+        }
+        identical = identical && std::memcmp(reference.data(), gridBuilder._grid.data(), size * sizeof(Vector)) == 0;
+
+        std::printf("%-11s %8zu %10.4f %10.4f %11.4f %10.4f %6lld\n", gridNames[type], size,
+            wholeTime / moves * 1e3, wholeScanTime / moves * 1e3, radiusTime / moves * 1e3,
+            radiusScanTime / moves * 1e3, moved / moves);
+    }
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// a selection moved with attenuation by the distance of every vertex to the nearest
+// selected one, found by testing every selected vertex
+static void referenceSelection(std::vector<Vector>& grid, Vector move, const std::vector<int>& selection,
+    int attenuationScale, float radius)
+{
+    Vector min = Vector(0.0, 0.0, 0.0);
+    Vector max = Vector(0.0, 0.0, 0.0);
+    for (unsigned int vertex = 0; vertex < grid.size(); vertex++)
+    {
+        min.x = std::min(min.x, grid[vertex].x);
+        min.y = std::min(min.y, grid[vertex].y);
+        max.x = std::max(max.x, grid[vertex].x);
+        max.y = std::max(max.y, grid[vertex].y);
+    }
+    float maxDistance = (min - max).magnitude();
+    std::vector<float> weights(grid.size(), 0.0f);
+    for (unsigned int vertex = 0; vertex < grid.size(); vertex++)
+    {
+        if (std::binary_search(selection.begin(), selection.end(), (int)vertex))
+        {
+            weights[vertex] = 1.0f;
+            continue;
+        }
+        float distance = 0.0;
+        for (unsigned int selected = 0; selected < selection.size(); selected++)
+        {
+            float toSelected = (grid[selection[selected]] - grid[vertex]).magnitude();
+            if (selected == 0 || toSelected < distance)
+                distance = toSelected;
+        }
+        if (radius > 0.0)
+        {
+            if (distance < radius)
+                weights[vertex] = GridBuilder::getFalloff(distance / radius) * ((float)attenuationScale / 5.0);
+        }
+        else
+        {
+            double falloff = 1.0 - (distance / maxDistance);
+            weights[vertex] = falloff * falloff * ((float)attenuationScale / 5.0);
+        }
+    }
+    for (unsigned int vertex = 0; vertex < grid.size(); vertex++)
+        if (weights[vertex] != 0.0f)
+            grid[vertex] = grid[vertex] + move * weights[vertex];
+}
+
+// compare selecting a box of grid points through the screen buckets with testing every
+// point, and moving the selection at once with dragging each of its points in turn
+static int benchSelect(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    int nPoints = std::atoi(argv[2]);
+    int moves = argc > 3 ? std::atoi(argv[3]) : 20;
+    float radius = argc > 4 ? std::atof(argv[4]) : 0.1;
+
+    const float modelSize = 1.0;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> offset(-0.01, 0.01);
+    float rotation[4][4];
+    randomRotation(random, rotation);
+
+    bool identical = true;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear" };
+    std::cout << "grid          points selected select (ms)  scan (ms) batched (ms) each (ms) whole (ms)" << std::endl;
+    for (int type = 0; type < 3; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        int gridSize = type == 2 ? (int)std::lround(std::cbrt((double)nPoints)) : (int)std::lround(std::sqrt((double)nPoints));
+        gridBuilder.setGridSize(std::max(gridSize, 2));
+        gridBuilder.generateGrid(modelSize);
+        std::size_t size = gridBuilder._grid.size();
+
+        // a box around the middle of the grid on screen
+        std::vector<float> box = { -0.1f, -0.05f, 0.15f, -0.05f, 0.15f, 0.1f, -0.1f, 0.1f };
+        PointPicker picker;
+        picker.update(gridBuilder, rotation);
+        std::vector<int> selection;
+        Clock::time_point start = Clock::now();
+        picker.selectPolygon(gridBuilder, rotation, box, selection);
+        double selectTime = secondsSince(start);
+        start = Clock::now();
+        std::vector<int> scanned;
+        for (std::size_t point = 0; point < size; point++)
+        {
+            const Vector& p = gridBuilder._grid[point];
+            if (PointPicker::inPolygon(box, rotation[0][0]*p.x + rotation[1][0]*p.y + rotation[2][0]*p.z,
+                                            rotation[0][1]*p.x + rotation[1][1]*p.y + rotation[2][1]*p.z))
+                scanned.push_back(point);
+        }
+        double scanTime = secondsSince(start);
+        identical = identical && scanned == selection;
+
+        // the selection moved at once within the radius, against the reference
+        std::vector<Vector> reference = gridBuilder._grid;
+        double batchedTime = 0.0;
+        for (int move = 0; move < moves; move++)
+        {
+            Vector shift(offset(random), offset(random), offset(random));
+            start = Clock::now();
+            gridBuilder.moveVertices(shift, selection, true, 3, radius * modelSize);
+            batchedTime += secondsSince(start);
+            referenceSelection(reference, shift, selection, 3, radius * modelSize);
+        }
+        identical = identical && std::memcmp(reference.data(), gridBuilder._grid.data(), size * sizeof(Vector)) == 0;
+
+        // as many drags as there are selected points, each with its own attenuation pass
+        GridBuilder separate = gridBuilder;
+        double eachTime = 0.0;
+        for (int move = 0; move < moves; move++)
+        {
+            Vector shift(offset(random), offset(random), offset(random));
+            start = Clock::now();
+            for (std::size_t selected = 0; selected < selection.size(); selected++)
+                separate.moveVertex(shift, selection[selected], true, 3, radius * modelSize);
+            eachTime += secondsSince(start);
+        }
+
+        // and across the whole grid, each vertex weighed by the nearest selected one
+        double wholeTime = 0.0;
+        for (int move = 0; move < moves; move++)
+        {
+            Vector shift(offset(random), offset(random), offset(random));
+            start = Clock::now();
+            gridBuilder.moveVertices(shift, selection, true, 3);
+            wholeTime += secondsSince(start);
+            referenceSelection(reference, shift, selection, 3, 0.0);
+        }
+        identical = identical && std::memcmp(reference.data(), gridBuilder._grid.data(), size * sizeof(Vector)) == 0;
+
+        std::printf("%-11s %8zu %8zu %11.4f %10.4f %12.4f %9.3f %10.3f\n", gridNames[type], size, selection.size(),
+            selectTime * 1e3, scanTime * 1e3, batchedTime / moves * 1e3, eachTime / moves * 1e3, wholeTime / moves * 1e3);
+    }
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// the grid points and weights of a vertex's binding, written out apart from DirectManipulator
+static int referenceRow(const GridBuilder& gridBuilder, const WeightStreams& weights, int vertex, int* points, double* rowWeights)
+{
+    double u = weights.u[vertex], v = weights.v[vertex], w = weights.w[vertex];
+    int cell = weights.cell[vertex];
+    int gridSize = gridBuilder._gridSize;
+    if (gridBuilder._gridType == Grid::Barycentric)
+    {
+        for (int corner = 0; corner < 3; corner++)
+            points[corner] = gridBuilder._triangles[cell + corner];
+        rowWeights[0] = u; rowWeights[1] = v; rowWeights[2] = w;
+        return 3;
+    }
+    if (gridBuilder._gridType == Grid::BSpline)
+    {
+        std::size_t count = weights.size();
+        for (int corner = 0; corner < 64; corner++)
+        {
+            int x = corner & 3, y = (corner >> 2) & 3, z = corner >> 4;
+            points[corner] = cell + x + y * gridSize + z * gridSize * gridSize;
+            rowWeights[corner] = (double)weights.basis[x * count + vertex] * weights.basis[(4 + y) * count + vertex]
+                * weights.basis[(8 + z) * count + vertex];
+        }
+        return 64;
+    }
+    int corners = gridBuilder._gridType == Grid::Trilinear ? 8 : 4;
+    for (int corner = 0; corner < corners; corner++)
+    {
+        int x = corner & 1, y = (corner >> 1) & 1, z = corner >> 2;
+        points[corner] = cell + x + y * gridSize + z * gridSize * gridSize;
+        rowWeights[corner] = (x ? u : 1 - u) * (y ? v : 1 - v) * (corners == 8 ? (z ? w : 1 - w) : 1.0);
+    }
+    return corners;
+}
+
+// dense Cholesky factor of the n by n matrix a in place, and a solve with it
+static void referenceFactor(std::vector<double>& a, int n)
+{
+    for (int row = 0; row < n; row++)
+        for (int column = 0; column <= row; column++)
+        {
+            double sum = a[row * n + column];
+            for (int k = 0; k < column; k++)
+                sum -= a[row * n + k] * a[column * n + k];
+            a[row * n + column] = row == column ? std::sqrt(sum) : sum / a[column * n + column];
+        }
+}
+
+static void referenceSolve(const std::vector<double>& factor, int n, std::vector<double>& x)
+{
+    for (int row = 0; row < n; row++)
+    {
+        for (int k = 0; k < row; k++)
+            x[row] -= factor[row * n + k] * x[k];
+        x[row] /= factor[row * n + row];
+    }
+    for (int row = n - 1; row >= 0; row--)
+    {
+        for (int k = row + 1; k < n; k++)
+            x[row] -= factor[k * n + row] * x[k];
+        x[row] /= factor[row * n + row];
+    }
+}
+
+// the grid moves for a drag through dense matrices, with the same stiffness and ridge
+static void referenceManipulate(const GridBuilder& gridBuilder, const WeightStreams& weights, const std::vector<int>& dragged,
+    const std::vector<Vector>& offsets, std::vector<double>& gridOffsets)
+{
+    int n = gridBuilder._grid.size();
+    int points[64];
+    double rowWeights[64];
+    std::vector<double> a(n * n, 0.0);
+    for (std::size_t vertex = 0; vertex < weights.size(); vertex++)
+    {
+        int count = referenceRow(gridBuilder, weights, vertex, points, rowWeights);
+        for (int i = 0; i < count; i++)
+            for (int j = 0; j < count; j++)
+                a[points[i] * n + points[j]] += rowWeights[i] * rowWeights[j];
+    }
+    double diagonal = 0.0;
+    for (int point = 0; point < n; point++)
+        diagonal += a[point * n + point];
+    for (int point = 0; point < n; point++)
+        a[point * n + point] += 0.1 * diagonal / n;
+    referenceFactor(a, n);
+
+    int k = dragged.size();
+    std::vector<std::vector<double>> columns(k, std::vector<double>(n, 0.0));
+    std::vector<double> s(k * k);
+    double trace = 0.0;
+    for (int c = 0; c < k; c++)
+    {
+        int count = referenceRow(gridBuilder, weights, dragged[c], points, rowWeights);
+        for (int i = 0; i < count; i++)
+            columns[c][points[i]] = rowWeights[i];
+        referenceSolve(a, n, columns[c]);
+    }
+    for (int c = 0; c < k; c++)
+    {
+        int count = referenceRow(gridBuilder, weights, dragged[c], points, rowWeights);
+        for (int d = 0; d < k; d++)
+        {
+            s[c * k + d] = 0.0;
+            for (int i = 0; i < count; i++)
+                s[c * k + d] += rowWeights[i] * columns[d][points[i]];
+        }
+        trace += s[c * k + c];
+    }
+    for (int c = 0; c < k; c++)
+        s[c * k + c] += 1e-9 * trace / k;
+    referenceFactor(s, k);
+
+    gridOffsets.assign(3 * n, 0.0);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        std::vector<double> y(k);
+        for (int c = 0; c < k; c++)
+            y[c] = axis == 0 ? offsets[c].x : (axis == 1 ? offsets[c].y : offsets[c].z);
+        referenceSolve(s, k, y);
+        for (int c = 0; c < k; c++)
+            for (int point = 0; point < n; point++)
+                gridOffsets[3 * point + axis] += columns[c][point] * y[c];
+    }
+}
+
+// drag mesh vertices directly: time binding, starting a drag and every move of it, and
+// check the dragged vertices land where they were dragged to, and on small grids that
+// the grid moved as a dense solve moves it
+static int benchManipulate(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int gridSize = std::atoi(argv[3]);
+    int drags = argc > 4 ? std::atoi(argv[4]) : 10;
+    int nDragged = argc > 5 ? std::atoi(argv[5]) : 1;
+    // mouse moves per drag
+    const int moves = 20;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> pickVertex(0, mesh.getVertexCount() - 1);
+    std::uniform_real_distribution<float> offset(-0.01, 0.01);
+
+    bool matches = true;
+    double worstError = 0.0;
+    double worstReference = 0.0;
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear", "bspline" };
+    std::cout << "grid        vertices   points  bind (ms) drag (ms)  move (ms) deform (ms)" << std::endl;
+    for (int type = 0; type < 4; type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        gridBuilder.setGridSize(gridSize);
+        gridBuilder.generateGrid(mesh.getModelSize());
+        mesh.getVertexWeights(&gridBuilder);
+        std::vector<Vector> deformed;
+        mesh.deformMesh(&gridBuilder, deformed);
+
+        DirectManipulator manipulator;
+        Clock::time_point start = Clock::now();
+        bool bound = manipulator.bind(mesh, gridBuilder);
+        double bindTime = secondsSince(start);
+        if (!bound)
+        {
+            std::printf("%-11s %8d %8zu  too fine to drag the mesh by\n", gridNames[type], mesh.getVertexCount(), gridBuilder._grid.size());
+            continue;
+        }
+
+        double dragTime = 0.0;
+        double moveTime = 0.0;
+        double deformTime = 0.0;
+        std::vector<Vector> gridOffsets;
+        for (int drag = 0; drag < drags; drag++)
+        {
+            std::vector<int> dragged;
+            while ((int)dragged.size() < nDragged)
+            {
+                int vertex = pickVertex(random);
+                if (std::find(dragged.begin(), dragged.end(), vertex) == dragged.end())
+                    dragged.push_back(vertex);
+            }
+            std::vector<Vector> startGrid = gridBuilder._grid;
+            std::vector<Vector> startVertices(nDragged);
+            for (int c = 0; c < nDragged; c++)
+                startVertices[c] = deformed[dragged[c]];
+
+            start = Clock::now();
+            manipulator.beginDrag(dragged);
+            dragTime += secondsSince(start);
+
+            // the dragged vertices go together, as vertices bound by the same weights can't go apart
+            std::vector<Vector> offsets(nDragged, Vector(0.0, 0.0, 0.0));
+            for (int move = 0; move < moves; move++)
+            {
+                Vector shift = Vector(offset(random), offset(random), offset(random)) * mesh.getModelSize();
+                for (int c = 0; c < nDragged; c++)
+                    offsets[c] = offsets[c] + shift;
+                start = Clock::now();
+                manipulator.solveDrag(offsets, gridOffsets);
+                std::vector<Vector> grid(startGrid.size());
+                for (std::size_t point = 0; point < grid.size(); point++)
+                    grid[point] = startGrid[point] + gridOffsets[point];
+                gridBuilder.setGrid(grid);
+                moveTime += secondsSince(start);
+
+                start = Clock::now();
+                mesh.deformMesh(&gridBuilder, deformed);
+                deformTime += secondsSince(start);
+            }
+            for (int c = 0; c < nDragged; c++)
+            {
+                Vector target = startVertices[c] + offsets[c];
+                worstError = std::max(worstError, (double)(deformed[dragged[c]] - target).magnitude() / mesh.getModelSize());
+            }
+
+            if (gridBuilder._grid.size() <= 1500 && drag < 3)
+            {
+                std::vector<double> reference;
+                referenceManipulate(gridBuilder, mesh.getWeights(), dragged, offsets, reference);
+                double largest = 0.0, difference = 0.0;
+                for (std::size_t point = 0; point < gridOffsets.size(); point++)
+                {
+                    const Vector& move = gridOffsets[point];
+                    largest = std::max({ largest, std::fabs(reference[3 * point]), std::fabs(reference[3 * point + 1]), std::fabs(reference[3 * point + 2]) });
+                    difference = std::max({ difference, std::fabs(move.x - reference[3 * point]),
+                        std::fabs(move.y - reference[3 * point + 1]), std::fabs(move.z - reference[3 * point + 2]) });
+                }
+                worstReference = std::max(worstReference, difference / largest);
+            }
+        }
+        std::printf("%-11s %8d %8zu %10.3f %9.4f %10.4f %11.3f\n", gridNames[type], mesh.getVertexCount(), gridBuilder._grid.size(),
+            bindTime * 1e3, dragTime / drags * 1e3, moveTime / (drags * moves) * 1e3, deformTime / (drags * moves) * 1e3);
+    }
+
+    // the vertices are deformed in floats, the grid is solved for in doubles
+    matches = worstError < 1e-4 && worstReference < 1e-4;
+    std::printf("largest miss of a dragged vertex: %.2e of the model, largest difference from the dense solve: %.2e\n",
+        worstError, worstReference);
+    std::cout << "matches: " << (matches ? "yes" : "no") << std::endl;
+    return matches ? 0 : 1;
+}
+
+// compare deforming through the weight matrix, one sparse matrix vector product for
+// every grid type, with the kernels written for each type, checks every level of the
+// product gives the same floats and how far they are from the type's own kernels
+static int benchSparse(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int gridSize = std::atoi(argv[3]);
+    int repeats = argc > 4 ? std::atoi(argv[4]) : 5;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    std::size_t nVertices = mesh.getVertexCount();
+    std::cout << "vertices: " << nVertices << ", grid size: " << gridSize << ", threads: " << threadCount() << std::endl;
+
+    bool identical = true;
+    double worstDifference = 0.0;
+    KernelLevel defaultLevel = getKernelLevel();
+    const char* gridNames[] = { "bilinear", "barycentric", "trilinear", "bspline", "sparsetri" };
+    std::cout << "grid        level    entries  matrix (ms)  kernel Mv/s  sparse Mv/s  ratio" << std::endl;
+    for (int type = 0; type <= static_cast<int>(Grid::SparseTrilinear); type++)
+    {
+        GridBuilder gridBuilder;
+        gridBuilder.setGridType(static_cast<Grid>(type));
+        gridBuilder.setGridSize(gridSize);
+        gridBuilder.generateGrid(mesh.getModelSize(), mesh.getVertices(), nVertices);
+        mesh.getVertexWeights(&gridBuilder);
+        for (unsigned int point = 0; point < gridBuilder._grid.size(); point += 2)
+            gridBuilder.moveVertex(Vector(0.01 * mesh.getModelSize(), 0.02 * mesh.getModelSize(), 0.0), point, false, 1);
+
+        Clock::time_point start = Clock::now();
+        const WeightMatrix& matrix = mesh.getWeightMatrix(&gridBuilder);
+        double matrixTime = secondsSince(start);
+
+        std::vector<Vector> scalarSparse;
+        for (int level = 0; level <= static_cast<int>(supportedKernelLevel()); level++)
+        {
+            setKernelLevel(static_cast<KernelLevel>(level));
+            std::vector<Vector> kernel, sparse;
+            double kernelTime = 1e30, sparseTime = 1e30;
+            for (int repeat = 0; repeat < repeats; repeat++)
+            {
+                start = Clock::now();
+                mesh.deformMesh(&gridBuilder, kernel);
+                kernelTime = std::min(kernelTime, secondsSince(start));
+                start = Clock::now();
+                mesh.deformSparse(&gridBuilder, sparse);
+                sparseTime = std::min(sparseTime, secondsSince(start));
+            }
+
+            if (level == 0)
+                scalarSparse = sparse;
+            bool same = std::memcmp(sparse.data(), scalarSparse.data(), nVertices * sizeof(Vector)) == 0;
+            identical = identical && same;
+            for (std::size_t vertex = 0; vertex < nVertices; vertex++)
+            {
+                Vector difference = sparse[vertex] - kernel[vertex];
+                worstDifference = std::max(worstDifference, (double)difference.magnitude() / mesh.getModelSize());
+            }
+            std::printf("%-11s %-6s %10zu %12.3f %12.2f %12.2f %6.2f%s\n", gridNames[type],
+                kernelLevelName(static_cast<KernelLevel>(level)), matrix.entries(), matrixTime * 1e3,
+                nVertices / kernelTime / 1e6, nVertices / sparseTime / 1e6, sparseTime / kernelTime, same ? "" : " differs");
+        }
+    }
+    setKernelLevel(defaultLevel);
+
+    std::printf("largest difference from the grid kernels: %.2e of the model\n", worstDifference);
+    bool matches = identical && worstDifference < 1e-5;
+    std::cout << "matches: " << (matches ? "yes" : "no") << std::endl;
+    return matches ? 0 : 1;
+}
+
+// compare deforming the mesh by many grids at once with deforming it by one grid at a
+// time, through the kernels of the grid type and through the weight matrix, and check
+// every pose comes out exactly as the weight matrix deforms it alone
+static int benchPoses(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int type = std::atoi(argv[3]);
+    if (type < 0 || type > static_cast<int>(Grid::SparseTrilinear))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    Grid gridType = static_cast<Grid>(type);
+    int gridSize = std::atoi(argv[4]);
+    int maxPoses = argc > 5 ? std::atoi(argv[5]) : 64;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    GridBuilder gridBuilder;
+    gridBuilder.setGridType(gridType);
+    gridBuilder.setGridSize(gridSize);
+    gridBuilder.generateGrid(mesh.getModelSize(), mesh.getVertices(), mesh.getVertexCount());
+    mesh.getVertexWeights(&gridBuilder);
+    mesh.getWeightMatrix(&gridBuilder);
+    std::size_t nVertices = mesh.getVertexCount();
+    std::vector<Vector> restGrid = gridBuilder._grid;
+
+    // every pose moves every grid point its own small random way
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> offset(-0.05f, 0.05f);
+    std::vector<std::vector<Vector>> poseGrids(maxPoses, restGrid);
+    for (int pose = 0; pose < maxPoses; pose++)
+        for (std::size_t point = 0; point < restGrid.size(); point++)
+            poseGrids[pose][point] = Vector(restGrid[point].x + offset(random) * mesh.getModelSize(),
+                restGrid[point].y + offset(random) * mesh.getModelSize(), restGrid[point].z + offset(random) * mesh.getModelSize());
+
+    std::cout << "vertices: " << nVertices << ", grid points: " << restGrid.size() << ", threads: " << threadCount()
+        << ", kernels: " << kernelLevelName(getKernelLevel()) << std::endl;
+    std::cout << "poses  kernels (s)  sparse (s)  batched (s)  batched Mposes*vertices/s  vs kernels  vs sparse" << std::endl;
+    bool identical = true;
+    for (int poseCount = 1; poseCount <= maxPoses; poseCount *= 2)
+    {
+        std::vector<const Vector*> poses(poseCount);
+        for (int pose = 0; pose < poseCount; pose++)
+            poses[pose] = poseGrids[pose].data();
+
+        // every method writes into meshes it wrote before, best of three
+        std::vector<std::vector<Vector>> kernel(poseCount), sparse(poseCount), batched;
+        double kernelTime = 1e30, sparseTime = 1e30, batchedTime = 1e30;
+        for (int repeat = 0; repeat < 3; repeat++)
+        {
+            Clock::time_point start = Clock::now();
+            for (int pose = 0; pose < poseCount; pose++)
+            {
+                gridBuilder._grid = poseGrids[pose];
+                mesh.deformMesh(&gridBuilder, kernel[pose]);
+            }
+            kernelTime = std::min(kernelTime, secondsSince(start));
+
+            start = Clock::now();
+            for (int pose = 0; pose < poseCount; pose++)
+            {
+                gridBuilder._grid = poseGrids[pose];
+                mesh.deformSparse(&gridBuilder, sparse[pose]);
+            }
+            sparseTime = std::min(sparseTime, secondsSince(start));
+
+            start = Clock::now();
+            mesh.deformPoses(&gridBuilder, poses, batched);
+            batchedTime = std::min(batchedTime, secondsSince(start));
+        }
+
+        for (int pose = 0; pose < poseCount; pose++)
+            identical = identical && std::memcmp(batched[pose].data(), sparse[pose].data(), nVertices * sizeof(Vector)) == 0;
+        std::printf("%5d %12.4f %11.4f %12.4f %26.1f %11.2f %10.2f\n", poseCount, kernelTime, sparseTime, batchedTime,
+            poseCount * nVertices / batchedTime / 1e6, kernelTime / batchedTime, sparseTime / batchedTime);
+    }
+    gridBuilder._grid = restGrid;
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// a smooth twist and bend over the model, what a user shapes a mesh into, applied
+// exactly to a position
+static Vector bendAndTwist(const Vector& position, float modelSize)
+{
+    double x = position.x / modelSize, y = position.y / modelSize, z = position.z / modelSize;
+    double angle = 1.2 * y;
+    double twistedX = x * std::cos(angle) - z * std::sin(angle);
+    double twistedZ = x * std::sin(angle) + z * std::cos(angle);
+    return Vector((twistedX + 0.3 * y * y) * modelSize, (y + 0.1 * std::sin(3.0 * x)) * modelSize, twistedZ * modelSize);
+}
+
+// the unit normal of every triangle of the mesh at the given positions
+static void triangleNormals(Mesh& mesh, const std::vector<Vector>& positions, std::vector<Vector>& normals)
+{
+    const uint32_t* indices = mesh.getIndices();
+    normals.resize(mesh.getIndexCount() / 3);
+    for (std::size_t triangle = 0; triangle < normals.size(); triangle++)
+    {
+        Vector v0 = positions[indices[triangle * 3]];
+        Vector v1 = positions[indices[triangle * 3 + 1]];
+        Vector v2 = positions[indices[triangle * 3 + 2]];
+        normals[triangle] = Vector::cross(v1 - v0, v2 - v0).normalise();
+    }
+}
+
+// compare trilinear grids with B-spline lattices of growing size at following the
+// same smooth deformation, the grid points put where the deformation takes them, by
+// how far the vertices and the shading normals end up from the exact deformation
+// and how fast the whole mesh deforms, so that the two can be compared at equal quality
+static int benchSpline(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int maxSize = argc > 3 ? std::atoi(argv[3]) : 10;
+    int repeats = argc > 4 ? std::atoi(argv[4]) : 3;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    float modelSize = mesh.getModelSize();
+    std::size_t nVertices = mesh.getVertexCount();
+    const Vector* vertices = mesh.getVertices();
+    std::vector<Vector> exact(nVertices);
+    for (std::size_t vertex = 0; vertex < nVertices; vertex++)
+        exact[vertex] = bendAndTwist(vertices[vertex], modelSize);
+    std::vector<Vector> exactNormals;
+    triangleNormals(mesh, exact, exactNormals);
+
+    std::cout << "vertices: " << nVertices << ", threads: " << threadCount() << std::endl;
+    std::cout << "grid        size   points  Mvertices/s  max error (%)  normal error (deg)" << std::endl;
+    for (int type = static_cast<int>(Grid::Trilinear); type <= static_cast<int>(Grid::BSpline); type++)
+    {
+        Grid gridType = static_cast<Grid>(type);
+        for (int size = gridType == Grid::BSpline ? MIN_BSPLINE_SIZE : 2; size <= maxSize; size++)
+        {
+            GridBuilder gridBuilder;
+            gridBuilder.setGridType(gridType);
+            gridBuilder.setGridSize(size);
+            gridBuilder.generateGrid(modelSize);
+            mesh.getVertexWeights(&gridBuilder);
+            for (std::size_t point = 0; point < gridBuilder._grid.size(); point++)
+                gridBuilder._grid[point] = bendAndTwist(gridBuilder._grid[point], modelSize);
+
+            std::vector<Vector> deformed;
+            double deformTime = 1e30;
+            for (int repeat = 0; repeat < repeats; repeat++)
+            {
+                Clock::time_point start = Clock::now();
+                mesh.deformMesh(&gridBuilder, deformed);
+                deformTime = std::min(deformTime, secondsSince(start));
+            }
+
+            double maxError = 0.0;
+            for (std::size_t vertex = 0; vertex < nVertices; vertex++)
+            {
+                Vector vertexPosition = deformed[vertex];
+                maxError = std::max(maxError, (double)(vertexPosition - exact[vertex]).magnitude());
+            }
+            std::vector<Vector> normals;
+            triangleNormals(mesh, deformed, normals);
+            double angleSum = 0.0;
+            for (std::size_t triangle = 0; triangle < normals.size(); triangle++)
+            {
+                double cosine = Vector::dot(normals[triangle], exactNormals[triangle]);
+                angleSum += std::acos(std::min(1.0, std::max(-1.0, cosine)));
+            }
+
+            std::printf("%-11s %4d %8zu %12.2f %14.4f %19.4f\n", type == static_cast<int>(Grid::BSpline) ? "bspline" : "trilinear",
+                size, gridBuilder._grid.size(), nVertices / deformTime / 1e6, 100.0 * maxError / modelSize,
+                angleSum / normals.size() * 180.0 / M_PI);
+        }
+    }
+    return 0;
+}
+
+// check a hierarchy of lattices bent at its coarsest level deforms the mesh as that
+// lattice alone does, then time editing points of every level, which only works out the
+// finer levels and the mesh again around the points moved, against working out every
+// level and the whole mesh again, and check both give the same grid and mesh
+static int benchLevels(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int coarseSize = std::atoi(argv[3]);
+    int levelCount = std::atoi(argv[4]);
+    int edits = argc > 5 ? std::atoi(argv[5]) : 100;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    float modelSize = mesh.getModelSize();
+    LatticeHierarchy hierarchy;
+    hierarchy.generate(coarseSize, levelCount, modelSize);
+    GridBuilder& finest = hierarchy.getFinestLevel();
+    Clock::time_point start = Clock::now();
+    mesh.getVertexWeights(&finest);
+    double bindTime = secondsSince(start);
+    mesh.getDeformedVertices(&finest);
+
+    std::cout << "vertices: " << mesh.getVertexCount() << ", levels:";
+    for (int level = 0; level < levelCount; level++)
+        std::cout << " " << hierarchy.getLevel(level).getGridSize() << "^3";
+    std::cout << ", threads: " << threadCount() << ", bind to finest (s): " << bindTime << std::endl;
+
+    // the coarse level bent alone, against a mesh bound to a lattice of the coarse size
+    GridBuilder& coarse = hierarchy.getLevel(0);
+    std::vector<Vector> bent(coarse._grid.size());
+    for (std::size_t point = 0; point < bent.size(); point++)
+        bent[point] = bendAndTwist(coarse._grid[point], modelSize);
+    coarse.setGrid(bent);
+    hierarchy.update();
+    const std::vector<Vector>& nested = mesh.getDeformedVertices(&finest);
+    Mesh coarseMesh;
+    coarseMesh.loadMesh(fileName);
+    GridBuilder coarseGrid;
+    coarseGrid.setGridType(Grid::Trilinear);
+    coarseGrid.setGridSize(coarseSize);
+    coarseGrid.generateGrid(modelSize);
+    coarseMesh.getVertexWeights(&coarseGrid);
+    coarseGrid.setGrid(bent);
+    std::vector<Vector> direct;
+    coarseMesh.deformMesh(&coarseGrid, direct);
+    double maxError = 0.0;
+    for (std::size_t vertex = 0; vertex < direct.size(); vertex++)
+    {
+        Vector difference = Vector(nested[vertex]) - direct[vertex];
+        maxError = std::max(maxError, (double)difference.magnitude());
+    }
+    std::cout << "coarse level alone against a " << coarseSize << "^3 lattice, max distance / model size: "
+        << maxError / modelSize << std::endl;
+
+    // random drags of single points, the same number on every level
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> offset(-0.02f, 0.02f);
+    std::cout << "level  grid points  update (ms)  points carried  mesh (ms)" << std::endl;
+    for (int level = 0; level < levelCount; level++)
+    {
+        GridBuilder& grid = hierarchy.getLevel(level);
+        std::uniform_int_distribution<int> pick(0, grid._grid.size() - 1);
+        double updateTime = 0.0, meshTime = 0.0;
+        std::size_t carried = 0;
+        for (int edit = 0; edit < edits; edit++)
+        {
+            grid.moveVertex(Vector(offset(random) * modelSize, offset(random) * modelSize, offset(random) * modelSize),
+                pick(random), false, 0);
+            start = Clock::now();
+            carried += hierarchy.update();
+            updateTime += secondsSince(start);
+            start = Clock::now();
+            mesh.getDeformedVertices(&finest);
+            meshTime += secondsSince(start);
+        }
+        std::printf("%5d %12zu %12.3f %15.0f %10.3f\n", level, grid._grid.size(), updateTime / edits * 1e3,
+            (double)carried / edits, meshTime / edits * 1e3);
+    }
+
+    // every level worked out again from the moves of each, and the whole mesh deformed by it
+    LatticeHierarchy reference;
+    reference.generate(coarseSize, levelCount, modelSize);
+    start = Clock::now();
+    for (int level = 0; level < levelCount; level++)
+    {
+        GridBuilder& grid = reference.getLevel(level);
+        std::vector<int> points(grid._grid.size());
+        std::vector<Vector> positions(grid._grid.size());
+        const std::vector<Vector>& offsets = hierarchy.getOffsets(level);
+        for (std::size_t point = 0; point < points.size(); point++)
+        {
+            points[point] = point;
+            positions[point] = grid._grid[point] + offsets[point];
+        }
+        grid.setGridPoints(points, positions);
+        reference.update();
+    }
+    double levelsTime = secondsSince(start);
+    std::vector<Vector> whole;
+    start = Clock::now();
+    mesh.deformMesh(&reference.getFinestLevel(), whole);
+    double wholeTime = secondsSince(start);
+    std::printf("every level and the whole mesh again: %.3f ms + %.3f ms\n", levelsTime * 1e3, wholeTime * 1e3);
+
+    bool matches = true;
+    const std::vector<Vector>& finestGrid = reference.getFinestLevel()._grid;
+    for (std::size_t point = 0; point < finestGrid.size(); point++)
+        matches = matches && finestGrid[point].x == finest._grid[point].x && finestGrid[point].y == finest._grid[point].y
+            && finestGrid[point].z == finest._grid[point].z;
+    const std::vector<Vector>& deformed = mesh.getDeformedVertices(&finest);
+    for (std::size_t vertex = 0; vertex < whole.size(); vertex++)
+        matches = matches && whole[vertex].x == deformed[vertex].x && whole[vertex].y == deformed[vertex].y
+            && whole[vertex].z == deformed[vertex].z;
+    std::cout << "matches: " << (matches ? "yes" : "no") << std::endl;
+    return matches ? 0 : 1;
+}
+
+// a hash of the bytes of a file, 0 if it can't be read
+static uint64_t fileHash(std::string fileName)
+{
+    std::ifstream file(fileName, std::ifstream::binary);
+    if (!file.is_open())
+        return 0;
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> buffer(1 << 20);
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        for (std::streamsize byte = 0; byte < file.gcount(); byte++)
+            hash = (hash ^ (unsigned char)buffer[byte]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// time exporting the frames of an animation with the stages one after the other, with
+// them overlapped, and just writing frames already deformed, which the pipeline can't beat,
+// then check both exports wrote the same files
+static int benchAnimate(int argc, char **argv)
+{
+    if (argc < 6)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int type = std::atoi(argv[3]);
+    if (type < 0 || type > static_cast<int>(Grid::SparseTrilinear))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    Grid gridType = static_cast<Grid>(type);
+    int gridSize = std::atoi(argv[4]);
+    std::string directory = argv[5];
+    int frameCount = argc > 6 ? std::atoi(argv[6]) : 100;
+    std::string extension = argc > 7 ? argv[7] : MESH_FILE_EXTENSION;
+    std::string framePattern = directory + "/frame_####" + extension;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    GridBuilder gridBuilder;
+    gridBuilder.setGridType(gridType);
+    gridBuilder.setGridSize(gridSize);
+    gridBuilder.generateGrid(mesh.getModelSize(), mesh.getVertices(), mesh.getVertexCount());
+    mesh.getVertexWeights(&gridBuilder);
+    std::vector<Vector> restGrid = gridBuilder._grid;
+
+    // the grid bends and twists one way, then the other, and back to rest
+    const float amounts[] = { 0.0f, 1.0f, -0.6f, 0.4f, 0.0f };
+    LatticeAnimation animation;
+    for (int key = 0; key < 5; key++)
+    {
+        std::vector<Vector> grid(restGrid.size());
+        for (std::size_t point = 0; point < grid.size(); point++)
+        {
+            Vector rest = restGrid[point];
+            Vector bent = bendAndTwist(rest, mesh.getModelSize());
+            grid[point] = rest + (bent - rest) * amounts[key];
+        }
+        animation.setKeyframe(key, grid);
+    }
+
+    std::cout << "vertices: " << mesh.getVertexCount() << ", grid points: " << restGrid.size() << ", frames: " << frameCount
+        << ", threads: " << threadCount() << ", kernels: " << kernelLevelName(getKernelLevel()) << std::endl;
+
+    // a frame written over and over, without interpolating or deforming
+    std::vector<Vector> deformed;
+    mesh.deformMesh(&gridBuilder, deformed);
+    MeshFileHeader header;
+    std::vector<std::string> text;
+    bool binary = hasMeshFileExtension(framePattern);
+    if (binary)
+        mesh.centreDeformedMesh(deformed, header);
+    else
+        mesh.formatTextMesh(deformed, text);
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        std::string frameName = AnimationExporter::frameFileName(framePattern, frame);
+        if (binary)
+        {
+            writeMeshFile(frameName, header, deformed.data(), mesh.getIndices(), nullptr, nullptr);
+        }
+        else
+        {
+            std::ofstream meshFile(frameName, std::ofstream::trunc);
+            for (std::size_t part = 0; part < text.size(); part++)
+                meshFile.write(text[part].data(), text[part].size());
+        }
+    }
+    double writeOnly = secondsSince(start);
+    double bytes = frameCount * (double)std::ifstream(AnimationExporter::frameFileName(framePattern, 0),
+        std::ifstream::binary | std::ifstream::ate).tellg();
+
+    std::cout << "export       interpolate (s)  deform (s)  write (s)  total (s)  frames/s   MB/s" << std::endl;
+    std::printf("write only   %15s %11s %10.3f %10.3f %9.1f %6.0f\n", "", "", writeOnly, writeOnly,
+        frameCount / writeOnly, bytes / writeOnly / 1e6);
+
+    AnimationExporter exporter;
+    std::vector<uint64_t> hashes(frameCount);
+    bool identical = true;
+    for (int pipelined = 0; pipelined < 2; pipelined++)
+    {
+        exporter.setPipelined(pipelined == 1);
+        if (!exporter.exportFrames(mesh, &gridBuilder, animation, frameCount, framePattern))
+        {
+            std::cerr << "Could not write frames " << framePattern << std::endl;
+            return 1;
+        }
+        const ExportStats& stats = exporter.getStats();
+        std::printf("%-12s %15.3f %11.3f %10.3f %10.3f %9.1f %6.0f\n", pipelined ? "pipelined" : "serial",
+            stats.interpolateTime, stats.deformTime, stats.writeTime, stats.totalTime,
+            frameCount / stats.totalTime, bytes / stats.totalTime / 1e6);
+        for (int frame = 0; frame < frameCount; frame++)
+        {
+            uint64_t hash = fileHash(AnimationExporter::frameFileName(framePattern, frame));
+            if (pipelined)
+                identical = identical && hash == hashes[frame];
+            else
+                hashes[frame] = hash;
+        }
+    }
+    for (int frame = 0; frame < frameCount; frame++)
+        std::remove(AnimationExporter::frameFileName(framePattern, frame).c_str());
+
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+// a trilinear grid of the given type and size over the mesh, bound and bent, with the
+// time taken to build and bind it and the deformed mesh
+static void bendLattice(Mesh& mesh, GridBuilder& gridBuilder, Grid gridType, int gridSize, int repeats,
+    double& buildTime, double& bindTime, double& deformTime, std::vector<Vector>& deformed)
+{
+    float modelSize = mesh.getModelSize();
+    gridBuilder.setGridType(gridType);
+    gridBuilder.setGridSize(gridSize);
+    Clock::time_point start = Clock::now();
+    gridBuilder.generateGrid(modelSize, mesh.getVertices(), mesh.getVertexCount());
+    buildTime = secondsSince(start);
+    bindTime = deformTime = 1e30;
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        start = Clock::now();
+        mesh.getVertexWeights(&gridBuilder);
+        bindTime = std::min(bindTime, secondsSince(start));
+    }
+    std::vector<int> points(gridBuilder._grid.size());
+    std::vector<Vector> bent(points.size());
+    for (std::size_t point = 0; point < points.size(); point++)
+    {
+        points[point] = point;
+        bent[point] = bendAndTwist(gridBuilder._grid[point], modelSize);
+    }
+    gridBuilder.setGridPoints(points, bent);
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        start = Clock::now();
+        mesh.deformMesh(&gridBuilder, deformed);
+        deformTime = std::min(deformTime, secondsSince(start));
+    }
+}
+
+// grow a sparse lattice around the mesh from a few points a side to hundreds, against the
+// dense trilinear grid while it fits: the points and memory each takes, the time to build,
+// bind and deform, and that the sparse lattice deforms the mesh exactly as the dense one,
+// on every kernel level and when only the vertices around a moved point are deformed again
+static int benchLattice(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[2];
+    int maxSize = argc > 3 ? std::atoi(argv[3]) : 256;
+    int maxDenseSize = argc > 4 ? std::atoi(argv[4]) : 128;
+    int repeats = argc > 5 ? std::atoi(argv[5]) : 3;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    std::size_t nVertices = mesh.getVertexCount();
+    std::cout << "vertices: " << nVertices << ", threads: " << threadCount() << std::endl;
+    std::cout << "size    points    cells  sparse MB  dense MB  build (ms)  bind (ms)  deform Mv/s  dense  kernels  update" << std::endl;
+
+    bool identical = true;
+    KernelLevel defaultLevel = getKernelLevel();
+    for (int size = 8; size <= maxSize; size *= 2)
+    {
+        GridBuilder sparseGrid;
+        std::vector<Vector> deformed;
+        double buildTime, bindTime, deformTime;
+        bendLattice(mesh, sparseGrid, Grid::SparseTrilinear, size, repeats, buildTime, bindTime, deformTime, deformed);
+        const SparseLattice& lattice = sparseGrid._sparseLattice;
+        // both grids hold the rest and the moved position of every point
+        double pointBytes = 2 * sizeof(Vector);
+        double sparseBytes = sparseGrid._grid.size() * pointBytes + lattice.getMemoryUsage();
+        double denseBytes = (double)size * size * size * pointBytes;
+
+        // the dense grid's points are those of the sparse lattice and more, so bent alike
+        const char* dense = "-";
+        if (size <= maxDenseSize)
+        {
+            Mesh denseMesh;
+            std::vector<Vector> vertices(mesh.getVertices(), mesh.getVertices() + nVertices);
+            denseMesh.swapVertices(vertices, mesh.getModelSize());
+            GridBuilder denseGrid;
+            std::vector<Vector> denseDeformed;
+            double denseBuild, denseBind, denseDeform;
+            bendLattice(denseMesh, denseGrid, Grid::Trilinear, size, 1, denseBuild, denseBind, denseDeform, denseDeformed);
+            bool same = std::memcmp(denseDeformed.data(), deformed.data(), nVertices * sizeof(Vector)) == 0;
+            dense = same ? "same" : "differs";
+            identical = identical && same;
+        }
+
+        bool sameKernels = true;
+        for (int level = 0; level <= static_cast<int>(supportedKernelLevel()); level++)
+        {
+            setKernelLevel(static_cast<KernelLevel>(level));
+            std::vector<Vector> levelDeformed;
+            mesh.deformMesh(&sparseGrid, levelDeformed);
+            sameKernels = sameKernels && std::memcmp(levelDeformed.data(), deformed.data(), nVertices * sizeof(Vector)) == 0;
+        }
+        setKernelLevel(defaultLevel);
+
+        // move a corner of the first vertex's cell, only the vertices of its cells are deformed again
+        mesh.getDeformedVertices(&sparseGrid);
+        int point = lattice.getCorners()[8 * mesh.getWeights().cell[0] + 7];
+        sparseGrid.moveVertex(Vector(0.01 * mesh.getModelSize(), 0.0, 0.02 * mesh.getModelSize()), point, false, 1);
+        const std::vector<Vector>& updated = mesh.getDeformedVertices(&sparseGrid);
+        mesh.deformMesh(&sparseGrid, deformed);
+        bool sameUpdate = std::memcmp(updated.data(), deformed.data(), nVertices * sizeof(Vector)) == 0;
+        identical = identical && sameKernels && sameUpdate;
+
+        std::printf("%4d %9zu %8zu %10.2f %9.2f %11.2f %10.2f %12.2f  %-6s %-8s %s\n", size, sparseGrid._grid.size(),
+            lattice.getCellCount(), sparseBytes / 1e6, denseBytes / 1e6, buildTime * 1e3, bindTime * 1e3,
+            nVertices / deformTime / 1e6, dense, sameKernels ? "same" : "differ", sameUpdate ? "same" : "differs");
+    }
+    std::cout << "sparse lattice matches the dense grid and itself: " << (identical ? "yes" : "no") << std::endl;
+    return identical ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "load") == 0)
+        return benchLoad(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "deform") == 0)
+        return benchDeform(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "bind") == 0)
+        return benchBind(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "scale") == 0)
+        return benchScale(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "drag") == 0)
+        return benchDrag(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "worker") == 0)
+        return benchWorker(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "pick") == 0)
+        return benchPick(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "attenuate") == 0)
+        return benchAttenuate(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "select") == 0)
+        return benchSelect(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "manipulate") == 0)
+        return benchManipulate(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "spline") == 0)
+        return benchSpline(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "sparse") == 0)
+        return benchSparse(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "poses") == 0)
+        return benchPoses(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "levels") == 0)
+        return benchLevels(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "animate") == 0)
+        return benchAnimate(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "lattice") == 0)
+        return benchLattice(argc, argv);
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,13 @@
+# Benchmarks for the deformation core
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= qt app_bundle
+TARGET = ffdbench
+INCLUDEPATH += .
+OBJECTS_DIR = .obj/ffdbench
+
+LIBS += -L$$OUT_PWD -lffdcore
+PRE_TARGETDEPS += $$OUT_PWD/libffdcore.a
+
+# Input
+SOURCES += ffdbench.cpp
@@ -0,0 +1,228 @@
+// Command line tool applying a saved grid to a mesh without a display
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AnimationExporter.h"
+#include "GridBuilder.h"
+#include "LatticeAnimation.h"
+#include "Mesh.h"
+#include "MeshStream.h"
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " [--stream] <input.mesh> <lattice.grid> <output.mesh>" << std::endl;
+    std::cerr << "       " << program << " --convert <input.mesh> <output.bmesh> [lattice.grid]" << std::endl;
+    std::cerr << "       " << program << " --animate <input.mesh> <frames> <output pattern> <key.grid>..." << std::endl;
+    std::cerr << "Meshes ending in .bmesh are written in the binary format, which is read" << std::endl;
+    std::cerr << "in place. Converting with a grid also stores the mesh's binding to it." << std::endl;
+    std::cerr << "--stream deforms the mesh a chunk at a time, for meshes larger than memory." << std::endl;
+    std::cerr << "--animate writes a mesh per frame, moving the grid smoothly through the saved" << std::endl;
+    std::cerr << "grids in turn, the last run of # in the pattern being the frame number." << std::endl;
+}
+
+// whether two grids rest at the same points in the same order, so that their points can be
+// blended one for one, a sparse grid's points being in the order of its file
+static bool sameRestGrid(const GridBuilder& first, const GridBuilder& second)
+{
+    return first._restGrid.size() == second._restGrid.size() &&
+        std::equal(first._restGrid.begin(), first._restGrid.end(), second._restGrid.begin(),
+            [](const Vector& a, const Vector& b) { return a.x == b.x && a.y == b.y && a.z == b.z; });
+}
+
+// load a grid at rest, bind the mesh to it and move it to its saved positions
+static bool applyGrid(Mesh& mesh, GridBuilder& gridBuilder, std::string gridFile, bool deform)
+{
+    std::vector<Vector> deformedGrid;
+    if (!gridBuilder.loadGrid(gridFile, mesh.getModelSize(), deformedGrid))
+    {
+        std::cerr << "Could not load grid " << gridFile << std::endl;
+        return false;
+    }
+    if (!mesh.getVertexWeights(&gridBuilder))
+    {
+        std::cerr << "The mesh lies outside the cells of grid " << gridFile << std::endl;
+        return false;
+    }
+    if (deform)
+        gridBuilder.setGrid(deformedGrid);
+    return true;
+}
+
+// convert a mesh to the binary format
+static int convert(int argc, char **argv)
+{
+    if (argc != 4 && argc != 5)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string inputFile = argv[2];
+    std::string outputFile = argv[3];
+
+    Mesh mesh;
+    if (!mesh.loadMesh(inputFile))
+    {
+        std::cerr << "Could not load mesh " << inputFile << std::endl;
+        return 1;
+    }
+
+    GridBuilder gridBuilder;
+    if (argc == 5 && !applyGrid(mesh, gridBuilder, argv[4], false))
+        return 1;
+
+    if (!mesh.saveBinaryMesh(outputFile, argc == 5 ? &gridBuilder : nullptr))
+    {
+        std::cerr << "Could not save mesh " << outputFile << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// deform a mesh without loading it whole
+static int stream(int argc, char **argv)
+{
+    if (argc != 5)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string inputFile = argv[2];
+    std::string gridFile = argv[3];
+    std::string outputFile = argv[4];
+
+    MeshStream meshStream;
+    if (!meshStream.open(inputFile))
+    {
+        std::cerr << "Could not load mesh " << inputFile << std::endl;
+        return 1;
+    }
+
+    // chunks are bound to the grid at rest and deformed with the saved grid
+    GridBuilder restGrid;
+    std::vector<Vector> deformedGrid;
+    if (!restGrid.loadGrid(gridFile, meshStream.getModelSize(), deformedGrid))
+    {
+        std::cerr << "Could not load grid " << gridFile << std::endl;
+        return 1;
+    }
+    GridBuilder gridBuilder = restGrid;
+    gridBuilder.setGrid(deformedGrid);
+
+    if (!meshStream.deform(&restGrid, &gridBuilder, outputFile))
+    {
+        std::cerr << "Could not deform mesh " << inputFile << " into " << outputFile << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// write a deformed mesh per frame of an animation through the saved grids
+static int animate(int argc, char **argv)
+{
+    if (argc < 6)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string inputFile = argv[2];
+    int frameCount = std::atoi(argv[3]);
+    std::string framePattern = argv[4];
+    if (frameCount < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Mesh mesh;
+    if (!mesh.loadMesh(inputFile))
+    {
+        std::cerr << "Could not load mesh " << inputFile << std::endl;
+        return 1;
+    }
+
+    // the mesh is bound to the first grid at rest, and the saved grids are keyframes
+    // one time unit apart
+    GridBuilder restGrid;
+    LatticeAnimation animation;
+    for (int key = 5; key < argc; key++)
+    {
+        GridBuilder keyGrid;
+        std::vector<Vector> deformedGrid;
+        if (!keyGrid.loadGrid(argv[key], mesh.getModelSize(), deformedGrid))
+        {
+            std::cerr << "Could not load grid " << argv[key] << std::endl;
+            return 1;
+        }
+        if (key == 5)
+            restGrid = keyGrid;
+        if (keyGrid.getGridType() != restGrid.getGridType() || keyGrid.getGridSize() != restGrid.getGridSize() ||
+            !sameRestGrid(keyGrid, restGrid) || !animation.setKeyframe(key - 5, deformedGrid))
+        {
+            std::cerr << "Grid " << argv[key] << " is not laid out as " << argv[5] << std::endl;
+            return 1;
+        }
+    }
+    if (!mesh.getVertexWeights(&restGrid))
+    {
+        std::cerr << "The mesh lies outside the cells of grid " << argv[5] << std::endl;
+        return 1;
+    }
+
+    AnimationExporter exporter;
+    if (!exporter.exportFrames(mesh, &restGrid, animation, frameCount, framePattern))
+    {
+        std::cerr << "Could not write frames " << framePattern << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "--convert") == 0)
+        return convert(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "--stream") == 0)
+        return stream(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "--animate") == 0)
+        return animate(argc, argv);
+
+    if (argc != 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::string inputFile = argv[1];
+    std::string gridFile = argv[2];
+    std::string outputFile = argv[3];
+
+    Mesh mesh;
+    if (!mesh.loadMesh(inputFile))
+    {
+        std::cerr << "Could not load mesh " << inputFile << std::endl;
+        return 1;
+    }
+
+    // the grid is loaded at rest so the mesh can be bound to it
+    GridBuilder gridBuilder;
+    if (!applyGrid(mesh, gridBuilder, gridFile, true))
+        return 1;
+
+    if (!mesh.saveMesh(outputFile, &gridBuilder))
+    {
+        std::cerr << "Could not save mesh " << outputFile << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+# Headless command line tool applying a saved grid to a mesh
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= qt app_bundle
+TARGET = ffd
+INCLUDEPATH += .
+OBJECTS_DIR = .obj/ffdcli
+
+LIBS += -L$$OUT_PWD -lffdcore
+PRE_TARGETDEPS += $$OUT_PWD/libffdcore.a
+
+# Input
+SOURCES += ffdcli.cpp
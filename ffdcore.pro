@@ -0,0 +1,13 @@
+# Deformation core: loading, binding, evaluation and saving of meshes
+TEMPLATE = lib
+CONFIG += staticlib c++17 thread
+CONFIG -= qt
+TARGET = ffdcore
+INCLUDEPATH += .
+OBJECTS_DIR = .obj/ffdcore
+# the SIMD deformation kernels must round exactly like the scalar ones
+QMAKE_CXXFLAGS += -ffp-contract=off
+
+# Input
+HEADERS += Vector.h GridBuilder.h PointHash.h PointTree.h DirectManipulator.h Mesh.h DeformWorker.h PointPicker.h MeshArray.h MeshFile.h MappedFile.h MeshParser.h Parallel.h MeshStream.h MeshWelder.h DeformKernels.h AlignedAllocator.h TriangleLocator.h BoundedQueue.h InvertedIndex.h LatticeAnimation.h AnimationExporter.h LatticeHierarchy.h SparseLattice.h delaunator.hpp
+SOURCES += Vector.cpp GridBuilder.cpp PointHash.cpp PointTree.cpp DirectManipulator.cpp Mesh.cpp DeformWorker.cpp PointPicker.cpp MeshFile.cpp MappedFile.cpp MeshParser.cpp Parallel.cpp MeshStream.cpp MeshWelder.cpp DeformKernels.cpp TriangleLocator.cpp LatticeAnimation.cpp AnimationExporter.cpp LatticeHierarchy.cpp SparseLattice.cpp
@@ -0,0 +1,28 @@
+######################################################################
+# Automatically generated by qmake (3.1) Thu Oct 15 18:33:35 2020
+######################################################################
+
+QT+=opengl
+LIBS+=-L$$OUT_PWD -lffdcore -lGLU
+PRE_TARGETDEPS += $$OUT_PWD/libffdcore.a
+TEMPLATE = app
+CONFIG += c++17
+TARGET = assignment1
+INCLUDEPATH += .
+OBJECTS_DIR = .obj/ffdgui
+MOC_DIR = .obj/ffdgui
+
+# The following define makes your compiler warn you if you use any
+# feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# You can also make your code fail to compile if you use deprecated APIs.
+# In order to do so, uncomment the following line.
+# You can also select to disable deprecated APIs only up to a certain version of Qt.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+# Input
+HEADERS += DeformWidget.h FrameStats.h Window.h GridRenderer.h MeshRenderer.h BufferWriter.h Ball.h BallAux.h BallMath.h
+SOURCES += DeformWidget.cpp main.cpp Window.cpp GridRenderer.cpp MeshRenderer.cpp Ball.cpp BallAux.cpp BallMath.cpp
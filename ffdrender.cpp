@@ -0,0 +1,290 @@
+// Headless benchmark of the mesh and grid renderers, drawing offscreen through EGL so that it
+// runs without a display, for example on Mesa llvmpipe
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "DeformWorker.h"
+#include "GridBuilder.h"
+#include "GridRenderer.h"
+#include "Mesh.h"
+#include "MeshRenderer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// same size as the editor's widget
+static const int FRAME_SIZE = 500;
+
+// drawing with buffer objects, in immediate mode, or with buffer objects from the
+// frames of a DeformWorker as the editor does
+enum Mode
+{
+    Buffers, Immediate, Worker
+};
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " <input.mesh> <grid type 0-4> <grid size> [frames]" << std::endl;
+}
+
+// make a GL context current with a framebuffer to draw into, without a window
+static bool createContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        return false;
+
+    GLuint framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, FRAME_SIZE, FRAME_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, FRAME_SIZE, FRAME_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+// the state DeformWidget sets up in initializeGL and resizeGL
+static void setupView(float modelSize)
+{
+    glViewport(0, 0, FRAME_SIZE, FRAME_SIZE);
+    glEnable(GL_DEPTH_TEST);
+    glShadeModel(GL_FLAT);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_LIGHTING);
+    glClearColor(1.0, 0.7, 0.7, 1.0);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-modelSize, modelSize, -modelSize, modelSize, -modelSize, modelSize);
+}
+
+// draw one frame of the mesh turned by angle, as DeformWidget::paintGL does, and wait for it,
+// returns the time spent issuing the draw, which includes deforming the mesh unless a worker does
+static double drawFrame(MeshRenderer& renderer, Mesh& mesh, GridBuilder& gridBuilder, DeformWorker* worker, float angle)
+{
+    static float lightPosition[] = {0.0, 0.0, 1.0, 0.0};
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+    glRotatef(angle, 0.3, 1.0, 0.0);
+    glFinish();
+    Clock::time_point start = Clock::now();
+    DeformedFrame frame;
+    if (worker == nullptr)
+        renderer.drawMesh(mesh, gridBuilder);
+    else if (worker->acquireFrame(frame))
+    {
+        renderer.drawMesh(mesh, frame);
+        worker->releaseFrame();
+    }
+    double drawTime = secondsSince(start);
+    glFinish();
+    return drawTime;
+}
+
+// draw one frame of the grid overlay alone turned by angle, with the point selected, and
+// wait for it, returns the time spent issuing the draw
+static double drawGridFrame(GridRenderer& renderer, GridBuilder& gridBuilder, float angle, int selected)
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glRotatef(angle, 0.3, 1.0, 0.0);
+
+    // the shaders take projection times model view, as DeformWidget::paintGL passes it
+    float projection[16], modelView[16], matrix[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 4; row++)
+        {
+            matrix[column * 4 + row] = 0.0;
+            for (int k = 0; k < 4; k++)
+                matrix[column * 4 + row] += projection[k * 4 + row] * modelView[column * 4 + k];
+        }
+
+    glFinish();
+    Clock::time_point start = Clock::now();
+    renderer.drawGrid(gridBuilder, matrix, FRAME_SIZE, FRAME_SIZE, selected);
+    double drawTime = secondsSince(start);
+    glFinish();
+    return drawTime;
+}
+
+// time frames of turning the grid overlay, then of dragging one grid point per frame, along
+// with the time spent in the renderer while dragging
+static void timeGridFrames(bool immediate, const GridBuilder& restGrid, float modelSize, int frames,
+    double& firstTime, double& turnTime, double& dragTime, double& issueTime)
+{
+    GridBuilder gridBuilder = restGrid;
+    GridRenderer renderer;
+    renderer.setImmediateMode(immediate);
+
+    Clock::time_point start = Clock::now();
+    drawGridFrame(renderer, gridBuilder, 0.0, -1);
+    firstTime = secondsSince(start);
+
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        drawGridFrame(renderer, gridBuilder, frame * 360.0 / frames, -1);
+    turnTime = secondsSince(start) / frames;
+
+    issueTime = 0.0;
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        int point = (int)(((long long)(frame + 1) * 7919) % gridBuilder._grid.size());
+        gridBuilder.moveVertex(Vector(0.01, -0.02, 0.015) * modelSize, point, false, 0);
+        issueTime += drawGridFrame(renderer, gridBuilder, 30.0, point);
+    }
+    dragTime = secondsSince(start) / frames;
+    issueTime /= frames;
+}
+
+// time frames of turning the mesh, then of dragging grid points one per frame, along with
+// the time spent in the renderer while turning, returns the pixels of the last grid
+static std::vector<unsigned char> timeFrames(Mode mode, Mesh& mesh, const GridBuilder& restGrid, int frames,
+    double& firstTime, double& turnTime, double& issueTime, double& dragTime)
+{
+    GridBuilder gridBuilder = restGrid;
+    mesh.getVertexWeights(&gridBuilder);
+
+    MeshRenderer renderer;
+    renderer.setImmediateMode(mode == Immediate);
+    DeformWorker deformWorker;
+    DeformWorker* worker = mode == Worker ? &deformWorker : nullptr;
+
+    // the first frame deforms the whole mesh and fills the buffers
+    Clock::time_point start = Clock::now();
+    if (worker != nullptr)
+    {
+        // stopping waits for the worker's first frame
+        worker->start(&mesh, gridBuilder);
+        worker->stop();
+        worker->resume();
+    }
+    drawFrame(renderer, mesh, gridBuilder, worker, 0.0);
+    firstTime = secondsSince(start);
+
+    issueTime = 0.0;
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        issueTime += drawFrame(renderer, mesh, gridBuilder, worker, frame * 360.0 / frames);
+    turnTime = secondsSince(start) / frames;
+    issueTime /= frames;
+
+    // one frame more than timed so that the indices of the incremental deformation are built,
+    // a worker draws the latest deformation it has rather than wait for the one of the move
+    for (int frame = -1; frame < frames; frame++)
+    {
+        if (frame == 0)
+            start = Clock::now();
+        int point = (int)(((long long)(frame + 1) * 7919) % gridBuilder._grid.size());
+        gridBuilder.moveVertex(Vector(0.01, -0.02, 0.015) * mesh.getModelSize(), point, false, 0);
+        if (worker != nullptr)
+            worker->publishGrid(gridBuilder);
+        drawFrame(renderer, mesh, gridBuilder, worker, 30.0);
+    }
+    dragTime = secondsSince(start) / frames;
+
+    // once the worker has caught up with the last move, its frame is the same as the others'
+    if (worker != nullptr)
+    {
+        worker->stop();
+        drawFrame(renderer, mesh, gridBuilder, worker, 30.0);
+    }
+
+    std::vector<unsigned char> pixels(FRAME_SIZE * FRAME_SIZE * 4);
+    glReadPixels(0, 0, FRAME_SIZE, FRAME_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string fileName = argv[1];
+    Grid gridType = static_cast<Grid>(std::atoi(argv[2]));
+    int gridSize = std::atoi(argv[3]);
+    int frames = argc > 4 ? std::atoi(argv[4]) : 20;
+
+    Mesh mesh;
+    if (!mesh.loadMesh(fileName))
+    {
+        std::cerr << "Could not load mesh " << fileName << std::endl;
+        return 1;
+    }
+    if (!createContext())
+    {
+        std::cerr << "Could not create an OpenGL context" << std::endl;
+        return 1;
+    }
+    std::cout << "renderer: " << glGetString(GL_RENDERER) << std::endl;
+    std::cout << "vertices: " << mesh.getVertexCount() << ", triangles: " << mesh.getIndexCount() / 3 << std::endl;
+    setupView(mesh.getModelSize());
+
+    // barycentric grids are jittered at random, so both modes start from the same one
+    GridBuilder restGrid;
+    restGrid.setGridType(gridType);
+    restGrid.setGridSize(gridSize);
+    restGrid.generateGrid(mesh.getModelSize(), mesh.getVertices(), mesh.getVertexCount());
+
+    const char* modeNames[] = { "buffers", "immediate", "worker" };
+    Mode modes[] = { Immediate, Buffers, Worker };
+    std::vector<unsigned char> pixels[3];
+    std::cout << "mode       first (ms)  turn (ms) issue (ms)  drag (ms)" << std::endl;
+    for (Mode mode : modes)
+    {
+        double firstTime, turnTime, issueTime, dragTime;
+        pixels[mode] = timeFrames(mode, mesh, restGrid, frames, firstTime, turnTime, issueTime, dragTime);
+        std::printf("%-10s %11.2f %10.2f %10.2f %10.2f\n", modeNames[mode], firstTime * 1e3, turnTime * 1e3,
+            issueTime * 1e3, dragTime * 1e3);
+    }
+
+    bool identical = pixels[Buffers] == pixels[Immediate] && pixels[Worker] == pixels[Immediate];
+    std::cout << "identical: " << (identical ? "yes" : "no") << std::endl;
+
+    // the overlay is drawn in other colours by the shaders, so it is only timed
+    std::cout << "grid points: " << restGrid._grid.size() << std::endl;
+    std::cout << "grid mode  first (ms)  turn (ms)  drag (ms) issue (ms)" << std::endl;
+    for (int immediate = 1; immediate >= 0; immediate--)
+    {
+        double firstTime, turnTime, dragTime, issueTime;
+        timeGridFrames(immediate, restGrid, mesh.getModelSize(), frames, firstTime, turnTime, dragTime, issueTime);
+        std::printf("%-10s %11.2f %10.2f %10.2f %10.2f\n", modeNames[immediate], firstTime * 1e3, turnTime * 1e3,
+            dragTime * 1e3, issueTime * 1e3);
+    }
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+# Headless benchmark of the mesh renderer, drawing offscreen through EGL
+TEMPLATE = app
+CONFIG += console c++17 thread
+CONFIG -= qt app_bundle
+TARGET = ffdrender
+INCLUDEPATH += .
+OBJECTS_DIR = .obj/ffdrender
+
+LIBS += -L$$OUT_PWD -lffdcore -lEGL -lGL
+PRE_TARGETDEPS += $$OUT_PWD/libffdcore.a
+
+# Input
+HEADERS += MeshRenderer.h GridRenderer.h BufferWriter.h
+SOURCES += ffdrender.cpp MeshRenderer.cpp GridRenderer.cpp
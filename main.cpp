@@ -1,11 +1,22 @@
 // Where the main window is created 
 #include <QApplication>
+#include <QSurfaceFormat>
 
 #include "DeformWidget.h"
 #include "Window.h"
 
 int main(int argc, char **argv)
 {
+    // the grid overlay uses OpenGL 3.3 shaders next to the fixed function mesh
+    // drawing, and unlike QGLWidget a QOpenGLWidget has no depth buffer unless asked
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CompatibilityProfile);
+    format.setDepthBufferSize(24);
+    // buffer swaps wait for the display, which paces the frames
+    format.setSwapInterval(1);
+    QSurfaceFormat::setDefaultFormat(format);
+
     QApplication app(argc, argv);
 
     Window aWindow(NULL);